@@ -123,12 +123,15 @@ ExSeq ExSeq_Join(ExSeq s1, ExSeq s2) {
         s1.Data = realloc(s1.Data, (size_t)s1.Cap*sizeof(*s1.Data) + 4);
         AssertAlloc(s1.Data);
 
-        memset(s1.Data + s1.Len, 0, (size_t)(s1.Cap - s1.Len + 4));
+        memset(s1.Data + s1.Len, 0,
+               sizeof(*s1.Data)*(size_t)(s1.Cap - s1.Len) + 4);
         capPtr = (int32_t*)(void*)(s1.Data + s1.Cap);
         *capPtr = s1.Cap;
     }
 
-    memcpy(s1.Data + s1.Len, s2.Data, (size_t)s2.Len * sizeof(*s2.Data));
+    if (s2.Len > 0) {
+        memcpy(s1.Data + s1.Len, s2.Data, (size_t)s2.Len*sizeof(*s2.Data));
+    }
     s1.Len +=  s2.Len;
 
     return s1;
@@ -189,10 +192,10 @@ ExBigSeq ExBigSeq_New(int64_t len) {
     if (!len) { return s; }    
 
     /* The last four bytes are used to store the underlying cap size. */
-    s.Data = malloc((size_t)cap*sizeof(*s.Data) + 4);
+    s.Data = malloc((size_t)cap*sizeof(*s.Data) + 8);
     AssertAlloc(s.Data);
 
-    memset(s.Data, 0, (size_t)cap*sizeof(*s.Data) + 4);
+    memset(s.Data, 0, (size_t)cap*sizeof(*s.Data) + 8);
     int64_t *capPtr = (int64_t*)(void*)(s.Data + s.Cap);
     *capPtr = s.Cap;
 
@@ -260,10 +263,10 @@ ExBigSeq ExBigSeq_Append(ExBigSeq s, Example tail) {
         s.Cap = (int64_t) (ALPHA * (float) (1 + s.Cap));
         s.Cap = ((s.Cap / 8) + (s.Cap % 8 != 0))*8;
 
-        s.Data = realloc(s.Data, (size_t)s.Cap*sizeof(*s.Data) + 4);
+        s.Data = realloc(s.Data, (size_t)s.Cap*sizeof(*s.Data) + 8);
         AssertAlloc(s.Data);
         
-        memset(s.Data + s.Len, 0, sizeof(*s.Data)*(size_t)(s.Cap - s.Len) + 4);
+        memset(s.Data + s.Len, 0, sizeof(*s.Data)*(size_t)(s.Cap - s.Len) + 8);
         capPtr = (int64_t*)(void*)(s.Data + s.Cap);
         *capPtr = s.Cap;
     }
@@ -284,15 +287,18 @@ ExBigSeq ExBigSeq_Join(ExBigSeq s1, ExBigSeq s2) {
         s1.Cap = (int64_t) (ALPHA * (float) (s1.Len + s2.Len));
         s1.Cap = ((s1.Cap / 8) + (s1.Cap % 8 != 0))*8;
 
-        s1.Data = realloc(s1.Data, (size_t)s1.Cap*sizeof(*s1.Data) + 4);
+        s1.Data = realloc(s1.Data, (size_t)s1.Cap*sizeof(*s1.Data) + 8);
         AssertAlloc(s1.Data);
 
-        memset(s1.Data + s1.Len, 0, (size_t)(s1.Cap - s1.Len + 4));
+        memset(s1.Data + s1.Len, 0,
+               sizeof(*s1.Data)*(size_t)(s1.Cap - s1.Len) + 8);
         capPtr = (int64_t*)(void*)(s1.Data + s1.Cap);
         *capPtr = s1.Cap;
     }
 
-    memcpy(s1.Data + s1.Len, s2.Data, (size_t)s2.Len * sizeof(*s2.Data));
+    if (s2.Len > 0) {
+        memcpy(s1.Data + s1.Len, s2.Data, (size_t)s2.Len*sizeof(*s2.Data));
+    }
     s1.Len +=  s2.Len;
 
     return s1;
@@ -329,9 +335,9 @@ ExBigSeq ExBigSeq_Extend(ExBigSeq s, int64_t n) {
     }
 
     s.Cap = ((n / 8) + (n % 8 != 0))*8;
-    s.Data = realloc(s.Data, (size_t)s.Cap*sizeof(*s.Data) + 4);
+    s.Data = realloc(s.Data, (size_t)s.Cap*sizeof(*s.Data) + 8);
     AssertAlloc(s.Data);
-    memset(s.Data + s.Len, 0, sizeof(*s.Data)*(size_t)(s.Cap - s.Len) + 4);
+    memset(s.Data + s.Len, 0, sizeof(*s.Data)*(size_t)(s.Cap - s.Len) + 8);
 
     int64_t *capPtr = (int64_t*)(void*)(s.Data + s.Cap);
     *capPtr = s.Cap;
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "algo_Gorl_v0_9.h"
+#include "quant.h"
+#include "stream.h"
+#include "util.h"
+#include "debug.h"
+
+/* gorlCHUNK_LEN is the number of values coded together. Chunks are
+ * independent, which keeps each byte stream well within the sizes
+ * util_EntropyEncode supports. */
+#define gorlCHUNK_LEN (1 << 16)
+
+/************************/
+/* Forward Declarations */
+/************************/
+
+/* gorlBuffer holds the scratch sequences which are reused between calls. */
+typedef struct gorlBuffer {
+    U8Seq Widths, Bytes, Comp;
+} gorlBuffer;
+
+void gorlWriteChunk(
+    stream_Writer *writer, gorlBuffer *buf,
+    uint8_t *data, int32_t elemSize, int32_t len
+);
+void gorlReadChunk(
+    stream_Reader *reader, gorlBuffer *buf,
+    uint8_t *data, int32_t elemSize, int32_t len
+);
+void gorlWriteBytes(stream_Writer *writer, gorlBuffer *buf, U8Seq raw);
+U8Seq gorlReadBytes(
+    stream_Reader *reader, gorlBuffer *buf, int32_t rawLen, U8Seq out
+);
+U8Seq gorlSetLen(U8Seq s, int32_t len);
+uint64_t gorlLoad(uint8_t *data, int32_t elemSize, int32_t i);
+void gorlStore(uint8_t *data, int32_t elemSize, int32_t i, uint64_t x);
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
+CField GorlCompress_v0_9(QField qf, void *buffer) {
+    gorlBuffer *buf = buffer;
+
+    stream_Writer writer = stream_NewWriter();
+    quant_WriteQuant(&writer, qf);
+    stream_Write(&writer, &qf.ElemSize, 4, 4);
+
+    /* Chunks never cross runs, so each has a single width. */
+    quant_Run run;
+    memset(&run, 0, sizeof(run));
+    while (quant_NextRun(qf, &run)) {
+        for (int64_t start = 0; start < run.Len; start += gorlCHUNK_LEN) {
+            int32_t len = run.Len - start < gorlCHUNK_LEN ?
+                (int32_t)(run.Len - start) : gorlCHUNK_LEN;
+            gorlWriteChunk(
+                &writer, buf, run.Data + (size_t)start*(size_t)run.ElemSize,
+                run.ElemSize, len
+            );
+        }
+    }
+
+    CField cf;
+    cf.Hd = qf.Hd;
+    cf.Data = writer.Data;
+    cf.DataLen = writer.Len;
+    cf.Checksum = 0;
+    return cf;
+}
+
+QField GorlDecompress_v0_9(CField cf, void *buffer) {
+    gorlBuffer *buf = buffer;
+
+    stream_Reader reader = stream_NewReader(
+        U8BigSeq_WrapArray(cf.Data, cf.DataLen)
+    );
+
+    QField qf;
+    qf.Hd = cf.Hd;
+    qf.Valid = false;
+    qf.Quant = quant_ReadQuant(&reader, cf.Hd.FieldCode);
+    stream_Read(&reader, &qf.ElemSize, 4, 4);
+
+    size_t bytes = quant_DataBytes(qf);
+    qf.Data = calloc(bytes > 0 ? bytes : 1, 1);
+    AssertAlloc(qf.Data);
+
+    quant_Run run;
+    memset(&run, 0, sizeof(run));
+    while (quant_NextRun(qf, &run)) {
+        for (int64_t start = 0; start < run.Len; start += gorlCHUNK_LEN) {
+            int32_t len = run.Len - start < gorlCHUNK_LEN ?
+                (int32_t)(run.Len - start) : gorlCHUNK_LEN;
+            gorlReadChunk(
+                &reader, buf, run.Data + (size_t)start*(size_t)run.ElemSize,
+                run.ElemSize, len
+            );
+        }
+    }
+
+    return qf;
+}
+
+void *GorlCAlloc_v0_9(void) {
+    gorlBuffer *buf = calloc(1, sizeof(*buf));
+    AssertAlloc(buf);
+    buf->Widths = U8Seq_Empty();
+    buf->Bytes = U8Seq_Empty();
+    buf->Comp = U8Seq_Empty();
+    return buf;
+}
+
+void GorlCFree_v0_9(void *buffer) {
+    gorlBuffer *buf = buffer;
+    U8Seq_Free(buf->Widths);
+    U8Seq_Free(buf->Bytes);
+    U8Seq_Free(buf->Comp);
+    free(buf);
+}
+
+void *GorlDAlloc_v0_9(void) {
+    return GorlCAlloc_v0_9();
+}
+
+void GorlDFree_v0_9(void *buffer) {
+    GorlCFree_v0_9(buffer);
+}
+
+/********************/
+/* Helper Functions */
+/********************/
+
+/* gorlWriteChunk codes the len values starting at data. A chunk is the
+ * number of residual bytes, followed by the entropy coded residual widths,
+ * two to a byte, and the entropy coded residual bytes, lowest first. */
+void gorlWriteChunk(
+    stream_Writer *writer, gorlBuffer *buf,
+    uint8_t *data, int32_t elemSize, int32_t len
+) {
+    buf->Widths = gorlSetLen(buf->Widths, (len + 1) / 2);
+    buf->Bytes = gorlSetLen(buf->Bytes, len*elemSize);
+    memset(buf->Widths.Data, 0, (size_t)buf->Widths.Len);
+
+    uint64_t prev = 0;
+    int32_t byteLen = 0;
+    for (int32_t i = 0; i < len; i++) {
+        uint64_t x = gorlLoad(data, elemSize, i);
+        uint8_t width = 0;
+        for (uint64_t r = x ^ prev; r > 0; r >>= 8) {
+            buf->Bytes.Data[byteLen++] = (uint8_t)r;
+            width++;
+        }
+        buf->Widths.Data[i / 2] |= (uint8_t)(width << 4*(i % 2));
+        prev = x;
+    }
+
+    stream_Write(writer, &byteLen, 4, 4);
+    gorlWriteBytes(writer, buf, buf->Widths);
+    gorlWriteBytes(writer, buf, U8Seq_Sub(buf->Bytes, 0, byteLen));
+}
+
+/* gorlReadChunk reverses gorlWriteChunk, writing len values to data. */
+void gorlReadChunk(
+    stream_Reader *reader, gorlBuffer *buf,
+    uint8_t *data, int32_t elemSize, int32_t len
+) {
+    int32_t byteLen;
+    stream_Read(reader, &byteLen, 4, 4);
+    buf->Widths = gorlReadBytes(reader, buf, (len + 1) / 2, buf->Widths);
+    buf->Bytes = gorlReadBytes(reader, buf, byteLen, buf->Bytes);
+
+    uint64_t prev = 0;
+    int32_t k = 0;
+    for (int32_t i = 0; i < len; i++) {
+        int32_t width = (buf->Widths.Data[i / 2] >> 4*(i % 2)) & 0xf;
+        DebugAssert(width <= elemSize && k + width <= byteLen) {
+            Panic("Residual %"PRId32" has an invalid width.", i);
+        }
+
+        uint64_t r = 0;
+        for (int32_t b = 0; b < width; b++) {
+            r |= (uint64_t)buf->Bytes.Data[k++] << 8*b;
+        }
+        prev ^= r;
+        gorlStore(data, elemSize, i, prev);
+    }
+}
+
+/* gorlWriteBytes entropy codes raw and writes it after its compressed
+ * length. Empty sequences are written as a length of zero. */
+void gorlWriteBytes(stream_Writer *writer, gorlBuffer *buf, U8Seq raw) {
+    int32_t compLen = 0;
+    if (raw.Len > 0) {
+        buf->Comp = util_EntropyEncode(raw, buf->Comp);
+        compLen = buf->Comp.Len;
+    }
+
+    stream_Write(writer, &compLen, 4, 4);
+    if (compLen > 0) {
+        stream_Write(writer, buf->Comp.Data, (size_t)compLen, 1);
+    }
+}
+
+/* gorlReadBytes reverses gorlWriteBytes, decoding rawLen bytes into out. */
+U8Seq gorlReadBytes(
+    stream_Reader *reader, gorlBuffer *buf, int32_t rawLen, U8Seq out
+) {
+    int32_t compLen;
+    stream_Read(reader, &compLen, 4, 4);
+    if (rawLen == 0) { return gorlSetLen(out, 0); }
+
+    buf->Comp = gorlSetLen(buf->Comp, compLen);
+    stream_Read(reader, buf->Comp.Data, (size_t)compLen, 1);
+    return util_UndoEntropyEncode(buf->Comp, rawLen, out);
+}
+
+U8Seq gorlSetLen(U8Seq s, int32_t len) {
+    s = U8Seq_Extend(s, len);
+    return U8Seq_Sub(s, 0, len);
+}
+
+uint64_t gorlLoad(uint8_t *data, int32_t elemSize, int32_t i) {
+    switch (elemSize) {
+    case 2: return ((uint16_t*)(void*)data)[i];
+    case 4: return ((uint32_t*)(void*)data)[i];
+    default: return ((uint64_t*)(void*)data)[i];
+    }
+}
+
+void gorlStore(uint8_t *data, int32_t elemSize, int32_t i, uint64_t x) {
+    switch (elemSize) {
+    case 2: ((uint16_t*)(void*)data)[i] = (uint16_t) x; return;
+    case 4: ((uint32_t*)(void*)data)[i] = (uint32_t) x; return;
+    default: ((uint64_t*)(void*)data)[i] = x; return;
+    }
+}
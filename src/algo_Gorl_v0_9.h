@@ -0,0 +1,26 @@
+#ifndef MNW_GORL_V0_9_H_
+#define MNW_GORL_V0_9_H_
+
+#include "types.h"
+
+/* The Gorl algorithm is lossless and is meant for fields quantized with
+ * FloatAccuracy.Lossless, in the style of Gorilla: each value is XORed with
+ * the one before it so that matching sign, exponent, and high mantissa bits
+ * become leading zeros. Only the non-zero low bytes of each residual are
+ * kept, along with a four-bit count of them, and both streams are passed
+ * through util_EntropyEncode. It works on any quantized field, but only pays
+ * off when neighbouring values share their high bits. */
+
+/* GorlVersion_v0_9 is 0.9.0-dev. */
+#define GorlVersion_v0_9 0x00000900
+
+CField GorlCompress_v0_9(QField qf, void *buffer);
+QField GorlDecompress_v0_9(CField cf, void *buffer);
+
+void *GorlCAlloc_v0_9(void);
+void GorlCFree_v0_9(void *buffer);
+
+void *GorlDAlloc_v0_9(void);
+void GorlDFree_v0_9(void *buffer);
+
+#endif
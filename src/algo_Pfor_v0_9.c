@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "algo_Pfor_v0_9.h"
+#include "quant.h"
+#include "stream.h"
+#include "debug.h"
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#define pforBLOCK_LEN 128
+/* A block starts with its minimum, its width, its patch count, and the width
+ * of its patches' high bits. */
+#define pforHEADER_BYTES 11
+/* pforMAX_BLOCK_BYTES bounds the size of a coded block. The low and high
+ * bits of a block together take at most 64 bits per value, each patch takes
+ * one more byte for its position, and each of the two packed runs can end on
+ * a partial byte. */
+#define pforMAX_BLOCK_BYTES (pforHEADER_BYTES + 9*pforBLOCK_LEN + 2)
+/* pforSLACK zero bytes follow the last block so that unpacking can always
+ * read nine bytes at a time. */
+#define pforSLACK 16
+
+#if defined(__SSSE3__)
+/* pforSHUFFLE gives the input byte which goes to byte j of a pair of k-byte
+ * values widened to 64 bits, with 0x80 meaning zero. */
+#define pforSHUFFLE(k, j) \
+    ((j) < 8 ? ((j) < (k) ? (j) : 0x80) : \
+     ((j) - 8 < (k) ? (j) - 8 + (k) : 0x80))
+#define pforSHUFFLE_ROW(k) { \
+    pforSHUFFLE(k, 0), pforSHUFFLE(k, 1), pforSHUFFLE(k, 2), \
+    pforSHUFFLE(k, 3), pforSHUFFLE(k, 4), pforSHUFFLE(k, 5), \
+    pforSHUFFLE(k, 6), pforSHUFFLE(k, 7), pforSHUFFLE(k, 8), \
+    pforSHUFFLE(k, 9), pforSHUFFLE(k, 10), pforSHUFFLE(k, 11), \
+    pforSHUFFLE(k, 12), pforSHUFFLE(k, 13), pforSHUFFLE(k, 14), \
+    pforSHUFFLE(k, 15) }
+
+/* pforShuffle holds the shuffle masks which unpack two values of width 8*k.
+ * Row 0 is unused. */
+static const uint8_t pforShuffle[8][16] = {
+    pforSHUFFLE_ROW(0), pforSHUFFLE_ROW(1), pforSHUFFLE_ROW(2),
+    pforSHUFFLE_ROW(3), pforSHUFFLE_ROW(4), pforSHUFFLE_ROW(5),
+    pforSHUFFLE_ROW(6), pforSHUFFLE_ROW(7)
+};
+#endif
+
+/************************/
+/* Forward Declarations */
+/************************/
+
+size_t pforWriteBlock(uint64_t *x, int32_t len, uint8_t *out);
+size_t pforReadBlock(const uint8_t *in, int32_t len, uint64_t *x);
+size_t pforPack(uint64_t *x, int32_t len, int32_t width, uint8_t *out);
+size_t pforUnpack(const uint8_t *in, int32_t len, int32_t width, uint64_t *x);
+uint64_t pforRead64(const uint8_t *p);
+void pforWrite64(uint8_t *p, uint64_t x);
+int32_t pforBitLen(uint64_t x);
+uint64_t pforLoad(void *data, int32_t elemSize, int64_t i);
+void pforStore(void *data, int32_t elemSize, int64_t i, uint64_t x);
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
+CField PforCompress_v0_9(QField qf, void *buffer) {
+    (void) buffer;
+
+    stream_Writer writer = stream_NewWriter();
+    quant_WriteQuant(&writer, qf);
+    stream_Write(&writer, &qf.ElemSize, 4, 4);
+
+    /* Blocks never cross runs, so each run can end on a short block. */
+    quant_Run run;
+    memset(&run, 0, sizeof(run));
+    int64_t blocks = 0;
+    while (quant_NextRun(qf, &run)) {
+        blocks += (run.Len + pforBLOCK_LEN - 1) / pforBLOCK_LEN;
+    }
+    uint8_t *out = calloc(
+        (size_t)blocks*pforMAX_BLOCK_BYTES + pforSLACK, sizeof(*out)
+    );
+    AssertAlloc(out);
+
+    uint64_t x[pforBLOCK_LEN];
+    int64_t outLen = 0;
+    memset(&run, 0, sizeof(run));
+    while (quant_NextRun(qf, &run)) {
+        for (int64_t start = 0; start < run.Len; start += pforBLOCK_LEN) {
+            int32_t len = run.Len - start < pforBLOCK_LEN ?
+                (int32_t)(run.Len - start) : pforBLOCK_LEN;
+            for (int32_t i = 0; i < len; i++) {
+                x[i] = pforLoad(run.Data, run.ElemSize, start + i);
+            }
+            outLen += (int64_t)pforWriteBlock(x, len, out + outLen);
+        }
+    }
+    outLen += pforSLACK;
+
+    stream_Write(&writer, &outLen, 8, 8);
+    stream_Write(&writer, out, (size_t)outLen, 1);
+    free(out);
+
+    CField cf;
+    cf.Hd = qf.Hd;
+    cf.Data = writer.Data;
+    cf.DataLen = writer.Len;
+    cf.Checksum = 0;
+    return cf;
+}
+
+QField PforDecompress_v0_9(CField cf, void *buffer) {
+    (void) buffer;
+
+    stream_Reader reader = stream_NewReader(
+        U8BigSeq_WrapArray(cf.Data, cf.DataLen)
+    );
+
+    QField qf;
+    qf.Hd = cf.Hd;
+    qf.Valid = false;
+    qf.Quant = quant_ReadQuant(&reader, cf.Hd.FieldCode);
+    stream_Read(&reader, &qf.ElemSize, 4, 4);
+
+    size_t bytes = quant_DataBytes(qf);
+    qf.Data = calloc(bytes > 0 ? bytes : 1, 1);
+    AssertAlloc(qf.Data);
+
+    /* Blocks are decoded in place rather than copied out of the reader. */
+    int64_t inLen;
+    stream_Read(&reader, &inLen, 8, 8);
+    const uint8_t *in = reader.Bytes.Data + reader.Offset;
+    DebugAssert(reader.Offset + (size_t)inLen <= (size_t)reader.Bytes.Len) {
+        Panic("Pfor blocks run past the end of the field.%s", "");
+    }
+
+    uint64_t x[pforBLOCK_LEN];
+    quant_Run run;
+    memset(&run, 0, sizeof(run));
+    while (quant_NextRun(qf, &run)) {
+        for (int64_t start = 0; start < run.Len; start += pforBLOCK_LEN) {
+            int32_t len = run.Len - start < pforBLOCK_LEN ?
+                (int32_t)(run.Len - start) : pforBLOCK_LEN;
+            in += pforReadBlock(in, len, x);
+            for (int32_t i = 0; i < len; i++) {
+                pforStore(run.Data, run.ElemSize, start + i, x[i]);
+            }
+        }
+    }
+
+    return qf;
+}
+
+void *PforCAlloc_v0_9(void) {
+    return NULL;
+}
+
+void PforCFree_v0_9(void *buffer) {
+    (void) buffer;
+}
+
+void *PforDAlloc_v0_9(void) {
+    return NULL;
+}
+
+void PforDFree_v0_9(void *buffer) {
+    (void) buffer;
+}
+
+/********************/
+/* Helper Functions */
+/********************/
+
+/* pforWriteBlock codes the len values in x to out, which must be zeroed, and
+ * returns the number of bytes written. x is overwritten. The block's width
+ * minimizes its size: every value pays for width bits, and every patch pays
+ * for a position byte and its remaining high bits. */
+size_t pforWriteBlock(uint64_t *x, int32_t len, uint8_t *out) {
+    uint64_t base = x[0];
+    for (int32_t i = 1; i < len; i++) {
+        if (x[i] < base) { base = x[i]; }
+    }
+
+    int32_t hist[65] = { 0 };
+    int32_t maxBits = 0;
+    for (int32_t i = 0; i < len; i++) {
+        x[i] -= base;
+        int32_t bits = pforBitLen(x[i]);
+        hist[bits]++;
+        if (bits > maxBits) { maxBits = bits; }
+    }
+
+    int32_t width = maxBits, patches = 0, above = 0;
+    int64_t minCost = (int64_t)len*maxBits;
+    for (int32_t w = maxBits - 1; w >= 0; w--) {
+        above += hist[w + 1];
+        int64_t cost = (int64_t)len*w + (int64_t)above*(8 + maxBits - w);
+        if (cost < minCost) {
+            minCost = cost;
+            width = w;
+            patches = above;
+        }
+    }
+    int32_t highWidth = maxBits - width;
+
+    pforWrite64(out, base);
+    out[8] = (uint8_t)width;
+    out[9] = (uint8_t)patches;
+    out[10] = (uint8_t)highWidth;
+    size_t k = pforHEADER_BYTES;
+    k += pforPack(x, len, width, out + k);
+
+    uint64_t highs[pforBLOCK_LEN];
+    int32_t p = 0;
+    for (int32_t i = 0; i < len && p < patches; i++) {
+        if (pforBitLen(x[i]) > width) {
+            out[k++] = (uint8_t)i;
+            highs[p++] = x[i] >> width;
+        }
+    }
+    k += pforPack(highs, patches, highWidth, out + k);
+
+    return k;
+}
+
+/* pforReadBlock reverses pforWriteBlock, writing len values to x, and
+ * returns the number of bytes read. */
+size_t pforReadBlock(const uint8_t *in, int32_t len, uint64_t *x) {
+    uint64_t base = pforRead64(in);
+    int32_t width = in[8], patches = in[9], highWidth = in[10];
+    size_t k = pforHEADER_BYTES;
+    k += pforUnpack(in + k, len, width, x);
+
+    const uint8_t *pos = in + k;
+    k += (size_t)patches;
+    uint64_t highs[pforBLOCK_LEN];
+    k += pforUnpack(in + k, patches, highWidth, highs);
+
+    for (int32_t p = 0; p < patches; p++) {
+        x[pos[p]] |= highs[p] << width;
+    }
+    for (int32_t i = 0; i < len; i++) { x[i] += base; }
+
+    return k;
+}
+
+/* pforPack ORs the low width bits of each value in x into out, lowest bits
+ * first, and returns the number of bytes used. out needs nine bytes of room
+ * past that. */
+size_t pforPack(uint64_t *x, int32_t len, int32_t width, uint8_t *out) {
+    if (width == 0) { return 0; }
+    uint64_t mask = width == 64 ? ~(uint64_t)0 : ((uint64_t)1 << width) - 1;
+
+    for (int32_t i = 0; i < len; i++) {
+        size_t bit = (size_t)i*(size_t)width;
+        uint8_t *p = out + bit/8;
+        uint32_t shift = (uint32_t)(bit % 8);
+        uint64_t v = x[i] & mask;
+
+        pforWrite64(p, pforRead64(p) | v << shift);
+        if (shift + (uint32_t)width > 64) {
+            p[8] |= (uint8_t)(v >> (64 - shift));
+        }
+    }
+
+    return ((size_t)len*(size_t)width + 7) / 8;
+}
+
+/* pforUnpack reverses pforPack and returns the number of bytes read. It may
+ * look at up to nine bytes past them. Each value is one unaligned read and a
+ * shift, with no dependence between values, so the loop pipelines well. */
+size_t pforUnpack(const uint8_t *in, int32_t len, int32_t width, uint64_t *x) {
+    if (width == 0) {
+        memset(x, 0, (size_t)len*sizeof(*x));
+        return 0;
+    }
+    uint64_t mask = width == 64 ? ~(uint64_t)0 : ((uint64_t)1 << width) - 1;
+    int32_t i = 0;
+
+#if defined(__SSSE3__)
+    /* Byte-aligned widths need no shifts, so each pair of values is one
+     * unaligned load and one shuffle. The load may read past the pair, so the
+     * last few pairs are left to the scalar loop. */
+    if (width % 8 == 0 && width < 64) {
+        size_t k = (size_t)width / 8, end = (size_t)len*k + 9;
+        __m128i shuffle = _mm_loadu_si128(
+            (const __m128i*)(const void*)pforShuffle[k]
+        );
+        for (; i + 2 <= len && (size_t)i*k + 16 <= end; i += 2) {
+            __m128i v = _mm_loadu_si128(
+                (const __m128i*)(const void*)(in + (size_t)i*k)
+            );
+            _mm_storeu_si128(
+                (__m128i*)(void*)(x + i), _mm_shuffle_epi8(v, shuffle)
+            );
+        }
+    }
+#endif
+
+    if (width <= 56) {
+        for (; i < len; i++) {
+            size_t bit = (size_t)i*(size_t)width;
+            x[i] = (pforRead64(in + bit/8) >> (bit % 8)) & mask;
+        }
+    } else {
+        for (; i < len; i++) {
+            size_t bit = (size_t)i*(size_t)width;
+            const uint8_t *p = in + bit/8;
+            uint32_t shift = (uint32_t)(bit % 8);
+            uint64_t v = pforRead64(p) >> shift;
+            if (shift > 0) { v |= (uint64_t)p[8] << (64 - shift); }
+            x[i] = v & mask;
+        }
+    }
+
+    return ((size_t)len*(size_t)width + 7) / 8;
+}
+
+/* pforRead64 and pforWrite64 read and write little endian integers at any
+ * alignment. Compilers turn them into single loads and stores. */
+uint64_t pforRead64(const uint8_t *p) {
+    uint64_t x = 0;
+    for (int i = 0; i < 8; i++) { x |= (uint64_t)p[i] << 8*i; }
+    return x;
+}
+
+void pforWrite64(uint8_t *p, uint64_t x) {
+    for (int i = 0; i < 8; i++) { p[i] = (uint8_t)(x >> 8*i); }
+}
+
+/* pforBitLen returns the number of bits needed to represent x. */
+int32_t pforBitLen(uint64_t x) {
+#if defined(__GNUC__)
+    return x == 0 ? 0 : 64 - __builtin_clzll(x);
+#else
+    int32_t n = 0;
+    for (; x > 0; x >>= 1) { n++; }
+    return n;
+#endif
+}
+
+uint64_t pforLoad(void *data, int32_t elemSize, int64_t i) {
+    switch (elemSize) {
+    case 2: return ((uint16_t*)data)[i];
+    case 4: return ((uint32_t*)data)[i];
+    default: return ((uint64_t*)data)[i];
+    }
+}
+
+void pforStore(void *data, int32_t elemSize, int64_t i, uint64_t x) {
+    switch (elemSize) {
+    case 2: ((uint16_t*)data)[i] = (uint16_t) x; return;
+    case 4: ((uint32_t*)data)[i] = (uint32_t) x; return;
+    default: ((uint64_t*)data)[i] = x; return;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef MNW_PFOR_V0_9_H_
+#define MNW_PFOR_V0_9_H_
+
+#include "types.h"
+
+/* The Pfor algorithm is lossless and is meant for integer fields, in the
+ * style of patched frame-of-reference coding (PFOR). Values are split into
+ * blocks of 128. Each block stores its minimum and packs the offsets from it
+ * at a single bit width, which is chosen from a histogram of the offsets'
+ * widths. The few offsets which don't fit are stored as patches: their
+ * positions and their remaining high bits. A handful of outliers therefore
+ * only cost their own bits instead of widening the whole block. */
+
+/* PforVersion_v0_9 is 0.9.0-dev. */
+#define PforVersion_v0_9 0x00000900
+
+CField PforCompress_v0_9(QField qf, void *buffer);
+QField PforDecompress_v0_9(CField cf, void *buffer);
+
+void *PforCAlloc_v0_9(void);
+void PforCFree_v0_9(void *buffer);
+
+void *PforDAlloc_v0_9(void);
+void PforDFree_v0_9(void *buffer);
+
+#endif
@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "algo_Svby_v0_9.h"
+#include "quant.h"
+#include "stream.h"
+#include "util.h"
+#include "debug.h"
+
+/* svbyCHUNK_LEN is the number of values coded together, which keeps each
+ * chunk well within the lengths supported by util_U32StreamVByte. */
+#define svbyCHUNK_LEN (1 << 16)
+
+/************************/
+/* Forward Declarations */
+/************************/
+
+/* svbyBuffer holds the scratch sequences which are reused between calls. */
+typedef struct svbyBuffer {
+    U32Seq Words;
+    U8Seq Bytes;
+} svbyBuffer;
+
+void svbyWriteChunk(
+    stream_Writer *writer, svbyBuffer *buf,
+    void *data, int32_t elemSize, int64_t start, int32_t len
+);
+void svbyReadChunk(
+    stream_Reader *reader, svbyBuffer *buf,
+    void *data, int32_t elemSize, int64_t start, int32_t len
+);
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
+CField SvbyCompress_v0_9(QField qf, void *buffer) {
+    svbyBuffer *buf = buffer;
+
+    stream_Writer writer = stream_NewWriter();
+    quant_WriteQuant(&writer, qf);
+    stream_Write(&writer, &qf.ElemSize, 4, 4);
+
+    /* Chunks never cross runs, so each has a single width. */
+    quant_Run run;
+    memset(&run, 0, sizeof(run));
+    while (quant_NextRun(qf, &run)) {
+        for (int64_t start = 0; start < run.Len; start += svbyCHUNK_LEN) {
+            int32_t len = run.Len - start < svbyCHUNK_LEN ?
+                (int32_t)(run.Len - start) : svbyCHUNK_LEN;
+            svbyWriteChunk(&writer, buf, run.Data, run.ElemSize, start, len);
+        }
+    }
+
+    CField cf;
+    cf.Hd = qf.Hd;
+    cf.Data = writer.Data;
+    cf.DataLen = writer.Len;
+    cf.Checksum = 0;
+    return cf;
+}
+
+QField SvbyDecompress_v0_9(CField cf, void *buffer) {
+    svbyBuffer *buf = buffer;
+
+    stream_Reader reader = stream_NewReader(
+        U8BigSeq_WrapArray(cf.Data, cf.DataLen)
+    );
+
+    QField qf;
+    qf.Hd = cf.Hd;
+    qf.Valid = false;
+    qf.Quant = quant_ReadQuant(&reader, cf.Hd.FieldCode);
+    stream_Read(&reader, &qf.ElemSize, 4, 4);
+
+    size_t bytes = quant_DataBytes(qf);
+    qf.Data = calloc(bytes > 0 ? bytes : 1, 1);
+    AssertAlloc(qf.Data);
+
+    quant_Run run;
+    memset(&run, 0, sizeof(run));
+    while (quant_NextRun(qf, &run)) {
+        for (int64_t start = 0; start < run.Len; start += svbyCHUNK_LEN) {
+            int32_t len = run.Len - start < svbyCHUNK_LEN ?
+                (int32_t)(run.Len - start) : svbyCHUNK_LEN;
+            svbyReadChunk(&reader, buf, run.Data, run.ElemSize, start, len);
+        }
+    }
+
+    return qf;
+}
+
+void *SvbyCAlloc_v0_9(void) {
+    svbyBuffer *buf = calloc(1, sizeof(*buf));
+    AssertAlloc(buf);
+    buf->Words = U32Seq_Empty();
+    buf->Bytes = U8Seq_Empty();
+    return buf;
+}
+
+void SvbyCFree_v0_9(void *buffer) {
+    svbyBuffer *buf = buffer;
+    U32Seq_Free(buf->Words);
+    U8Seq_Free(buf->Bytes);
+    free(buf);
+}
+
+void *SvbyDAlloc_v0_9(void) {
+    return SvbyCAlloc_v0_9();
+}
+
+void SvbyDFree_v0_9(void *buffer) {
+    SvbyCFree_v0_9(buffer);
+}
+
+/********************/
+/* Helper Functions */
+/********************/
+
+/* svbyWriteChunk codes the len values of data starting at start as 32-bit
+ * words, low halves first for eight-byte values, and writes them after their
+ * coded length. */
+void svbyWriteChunk(
+    stream_Writer *writer, svbyBuffer *buf,
+    void *data, int32_t elemSize, int64_t start, int32_t len
+) {
+    int32_t wordLen = elemSize == 8 ? 2*len : len;
+    buf->Words = U32Seq_Extend(buf->Words, wordLen);
+    buf->Words = U32Seq_Sub(buf->Words, 0, wordLen);
+    uint32_t *w = buf->Words.Data;
+
+    switch (elemSize) {
+    case 2:
+        for (int32_t i = 0; i < len; i++) {
+            w[i] = ((uint16_t*)data)[start + i];
+        }
+        break;
+    case 4:
+        memcpy(w, (uint32_t*)data + start, 4*(size_t)len);
+        break;
+    default:
+        for (int32_t i = 0; i < len; i++) {
+            uint64_t x = ((uint64_t*)data)[start + i];
+            w[2*i] = (uint32_t)x;
+            w[2*i + 1] = (uint32_t)(x >> 32);
+        }
+    }
+
+    buf->Bytes = util_U32StreamVByte(buf->Words, buf->Bytes);
+    int32_t byteLen = buf->Bytes.Len;
+    stream_Write(writer, &byteLen, 4, 4);
+    if (byteLen > 0) {
+        stream_Write(writer, buf->Bytes.Data, (size_t)byteLen, 1);
+    }
+}
+
+/* svbyReadChunk reverses svbyWriteChunk. The coded bytes are decoded where
+ * they sit in the reader. */
+void svbyReadChunk(
+    stream_Reader *reader, svbyBuffer *buf,
+    void *data, int32_t elemSize, int64_t start, int32_t len
+) {
+    int32_t byteLen;
+    stream_Read(reader, &byteLen, 4, 4);
+    DebugAssert(reader->Offset + (size_t)byteLen <=
+                (size_t)reader->Bytes.Len) {
+        Panic("Svby chunk runs past the end of the field.%s", "");
+    }
+    U8Seq in = U8Seq_WrapArray(
+        reader->Bytes.Data + reader->Offset, byteLen
+    );
+    reader->Offset += (size_t)byteLen;
+
+    int32_t wordLen = elemSize == 8 ? 2*len : len;
+    buf->Words = util_U32UndoStreamVByte(in, wordLen, buf->Words);
+    uint32_t *w = buf->Words.Data;
+
+    switch (elemSize) {
+    case 2:
+        for (int32_t i = 0; i < len; i++) {
+            ((uint16_t*)data)[start + i] = (uint16_t)w[i];
+        }
+        break;
+    case 4:
+        memcpy((uint32_t*)data + start, w, 4*(size_t)len);
+        break;
+    default:
+        for (int32_t i = 0; i < len; i++) {
+            ((uint64_t*)data)[start + i] =
+                (uint64_t)w[2*i] | (uint64_t)w[2*i + 1] << 32;
+        }
+    }
+}
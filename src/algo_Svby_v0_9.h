@@ -0,0 +1,25 @@
+#ifndef MNW_SVBY_V0_9_H_
+#define MNW_SVBY_V0_9_H_
+
+#include "types.h"
+
+/* The Svby algorithm is lossless and is meant for integer fields whose
+ * values span many orders of magnitude. Values are stored as StreamVByte
+ * varints (see util_U32StreamVByte), with two-bit length codes kept apart
+ * from the data bytes so that decoding is a table lookup and a byte shuffle
+ * per four values. Eight-byte values are split into their low and high
+ * halves, so a zero high half costs only its length code. */
+
+/* SvbyVersion_v0_9 is 0.9.0-dev. */
+#define SvbyVersion_v0_9 0x00000900
+
+CField SvbyCompress_v0_9(QField qf, void *buffer);
+QField SvbyDecompress_v0_9(CField cf, void *buffer);
+
+void *SvbyCAlloc_v0_9(void);
+void SvbyCFree_v0_9(void *buffer);
+
+void *SvbyDAlloc_v0_9(void);
+void SvbyDFree_v0_9(void *buffer);
+
+#endif
@@ -1,19 +1,58 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "algo_Test_v0_9.h"
+#include "quant.h"
+#include "stream.h"
+#include "debug.h"
 
-CField TestCompress_v0_9(QField cf, void *buffer) {
-    (void) cf;
+CField TestCompress_v0_9(QField qf, void *buffer) {
     (void) buffer;
 
-    CField dummy;
-    return dummy;
+    stream_Writer writer = stream_NewWriter();
+    quant_WriteQuant(&writer, qf);
+    stream_Write(&writer, &qf.ElemSize, 4, 4);
+
+    quant_Run run;
+    memset(&run, 0, sizeof(run));
+    while (quant_NextRun(qf, &run)) {
+        size_t bytes = (size_t)run.Len*(size_t)run.ElemSize;
+        stream_Write(&writer, run.Data, bytes, (size_t)run.ElemSize);
+    }
+
+    CField cf;
+    cf.Hd = qf.Hd;
+    cf.Data = writer.Data;
+    cf.DataLen = writer.Len;
+    cf.Checksum = 0;
+    return cf;
 }
 
 QField TestDecompress_v0_9(CField cf, void *buffer) {
-    (void) cf;
     (void) buffer;
-    
-    QField dummy;
-    return dummy;
+
+    stream_Reader reader = stream_NewReader(
+        U8BigSeq_WrapArray(cf.Data, cf.DataLen)
+    );
+
+    QField qf;
+    qf.Hd = cf.Hd;
+    qf.Valid = false;
+    qf.Quant = quant_ReadQuant(&reader, cf.Hd.FieldCode);
+    stream_Read(&reader, &qf.ElemSize, 4, 4);
+
+    size_t bytes = quant_DataBytes(qf);
+    qf.Data = calloc(bytes > 0 ? bytes : 1, 1);
+    AssertAlloc(qf.Data);
+
+    quant_Run run;
+    memset(&run, 0, sizeof(run));
+    while (quant_NextRun(qf, &run)) {
+        bytes = (size_t)run.Len*(size_t)run.ElemSize;
+        stream_Read(&reader, run.Data, bytes, (size_t)run.ElemSize);
+    }
+
+    return qf;
 }
 
 void *TestCAlloc_v0_9(void) {
@@ -3,6 +3,13 @@
 
 #include "types.h"
 
+/* The Test algorithm does no compression: it stores the quantization followed
+ * by the quantized values as little endian integers. It exists to check that
+ * everything around the compression step works. */
+
+/* TestVersion_v0_9 is 0.9.0-dev. */
+#define TestVersion_v0_9 0x00000900
+
 CField TestCompress_v0_9(QField cf, void *buffer);
 QField TestDecompress_v0_9(CField cf, void *buffer);
 
@@ -0,0 +1,332 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "asyncio.h"
+#include "funcs.h"
+#include "quant.h"
+#include "debug.h"
+
+/************************/
+/* Forward Declarations */
+/************************/
+
+void compressSegment(void *arg);
+void *writeLoop(void *arg);
+void decodeSegment(void *arg);
+int32_t missingIDs(Seg s, CSeg cs);
+void *readLoop(void *arg);
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
+AsyncWriter *AsyncWriter_New(
+    minnow_Context *ctx, ContainerWriter *out, int32_t depth
+) {
+    DebugAssert(depth > 0) {
+        Panic("AsyncWriter_New given non-positive depth, %"PRId32".", depth);
+    }
+
+    AsyncWriter *w = calloc(1, sizeof(*w));
+    AssertAlloc(w);
+
+    w->Ctx = ctx;
+    w->Out = out;
+    w->Depth = depth;
+    w->Slots = calloc((size_t)depth, sizeof(*w->Slots));
+    AssertAlloc(w->Slots);
+    w->Group = pool_NewGroup();
+
+    pthread_mutex_init(&w->Lock, NULL);
+    pthread_cond_init(&w->Compressed, NULL);
+    pthread_cond_init(&w->Drained, NULL);
+
+    if (pthread_create(&w->IOThread, NULL, writeLoop, w) != 0) {
+        Panic("Could not start AsyncWriter I/O thread.%s", "");
+    }
+
+    return w;
+}
+
+void AsyncWriter_Write(AsyncWriter *w, Seg s, Box box) {
+    pthread_mutex_lock(&w->Lock);
+    while (w->Submitted - w->Written >= w->Depth) {
+        pthread_cond_wait(&w->Drained, &w->Lock);
+    }
+
+    asyncWriteSlot *slot = &w->Slots[w->Submitted % w->Depth];
+    slot->Writer = w;
+    slot->Seg = s;
+    slot->Box = box;
+    slot->Done = false;
+    w->Submitted++;
+    pthread_mutex_unlock(&w->Lock);
+
+    pool_Submit(w->Ctx->Pool, &w->Group, compressSegment, slot);
+}
+
+void AsyncWriter_Flush(AsyncWriter *w) {
+    pthread_mutex_lock(&w->Lock);
+    while (w->Written < w->Submitted) {
+        pthread_cond_wait(&w->Drained, &w->Lock);
+    }
+    pthread_mutex_unlock(&w->Lock);
+}
+
+void AsyncWriter_Close(AsyncWriter *w) {
+    AsyncWriter_Flush(w);
+    /* Compression tasks finish their pool bookkeeping after marking their
+     * slot as done, so the group can still be busy here. */
+    pool_Wait(w->Ctx->Pool, &w->Group);
+
+    pthread_mutex_lock(&w->Lock);
+    w->Closing = true;
+    pthread_cond_broadcast(&w->Compressed);
+    pthread_mutex_unlock(&w->Lock);
+
+    pthread_join(w->IOThread, NULL);
+
+    pthread_mutex_destroy(&w->Lock);
+    pthread_cond_destroy(&w->Compressed);
+    pthread_cond_destroy(&w->Drained);
+    free(w->Slots);
+    free(w);
+}
+
+AsyncReader *AsyncReader_New(
+    minnow_Context *ctx, ContainerReader *in,
+    int64_t *segs, int64_t segLen,
+    int32_t *fields, int32_t fieldLen,
+    int32_t depth
+) {
+    DebugAssert(depth > 0) {
+        Panic("AsyncReader_New given non-positive depth, %"PRId32".", depth);
+    }
+
+    AsyncReader *r = calloc(1, sizeof(*r));
+    AssertAlloc(r);
+
+    r->Ctx = ctx;
+    r->In = in;
+    r->Depth = depth;
+    r->SegLen = segLen;
+    r->Segs = calloc((size_t)segLen + 1, sizeof(*r->Segs));
+    AssertAlloc(r->Segs);
+    if (segLen > 0) {
+        memcpy(r->Segs, segs, (size_t)segLen*sizeof(*segs));
+    }
+
+    if (fields != NULL) {
+        r->FieldLen = fieldLen;
+        r->Fields = calloc((size_t)fieldLen + 1, sizeof(*r->Fields));
+        AssertAlloc(r->Fields);
+        if (fieldLen > 0) {
+            memcpy(r->Fields, fields, (size_t)fieldLen*sizeof(*fields));
+        }
+    }
+
+    r->Slots = calloc((size_t)depth, sizeof(*r->Slots));
+    AssertAlloc(r->Slots);
+    r->Group = pool_NewGroup();
+
+    pthread_mutex_init(&r->Lock, NULL);
+    pthread_cond_init(&r->Decoded, NULL);
+    pthread_cond_init(&r->Consumed, NULL);
+
+    if (pthread_create(&r->IOThread, NULL, readLoop, r) != 0) {
+        Panic("Could not start AsyncReader I/O thread.%s", "");
+    }
+
+    return r;
+}
+
+bool AsyncReader_Next(AsyncReader *r, Seg *s) {
+    pthread_mutex_lock(&r->Lock);
+    if (r->Returned == r->SegLen) {
+        pthread_mutex_unlock(&r->Lock);
+        return false;
+    }
+
+    asyncReadSlot *slot = &r->Slots[r->Returned % r->Depth];
+    while (!(r->Returned < r->Read && slot->Done)) {
+        pthread_cond_wait(&r->Decoded, &r->Lock);
+    }
+
+    *s = slot->Seg;
+    slot->Done = false;
+    r->Returned++;
+    pthread_cond_broadcast(&r->Consumed);
+    pthread_mutex_unlock(&r->Lock);
+
+    return true;
+}
+
+void AsyncReader_Free(AsyncReader *r) {
+    pthread_mutex_lock(&r->Lock);
+    r->Closing = true;
+    pthread_cond_broadcast(&r->Consumed);
+    pthread_mutex_unlock(&r->Lock);
+
+    pthread_join(r->IOThread, NULL);
+    pool_Wait(r->Ctx->Pool, &r->Group);
+
+    /* Free segments which were decoded but never returned. */
+    for (int64_t i = r->Returned; i < r->Read; i++) {
+        Seg_Free(r->Slots[i % r->Depth].Seg);
+    }
+
+    pthread_mutex_destroy(&r->Lock);
+    pthread_cond_destroy(&r->Decoded);
+    pthread_cond_destroy(&r->Consumed);
+    free(r->Slots);
+    free(r->Segs);
+    free(r->Fields);
+    free(r);
+}
+
+/********************/
+/* Helper Functions */
+/********************/
+
+void compressSegment(void *arg) {
+    asyncWriteSlot *slot = arg;
+    AsyncWriter *w = slot->Writer;
+    Seg s = slot->Seg;
+
+    /* minnow_Compress pairs Lagrangian positions with their IDs. Its field
+     * tasks go to this worker's deque, where idle workers can steal them. */
+    CSeg cs = minnow_Compress(w->Ctx, s);
+    Seg_Free(s);
+
+    pthread_mutex_lock(&w->Lock);
+    slot->CSeg = cs;
+    slot->Done = true;
+    pthread_cond_broadcast(&w->Compressed);
+    pthread_mutex_unlock(&w->Lock);
+}
+
+/* writeLoop runs on the I/O thread and writes compressed segments in the
+ * order they were submitted. */
+void *writeLoop(void *arg) {
+    AsyncWriter *w = arg;
+
+    pthread_mutex_lock(&w->Lock);
+    while (true) {
+        asyncWriteSlot *slot = &w->Slots[w->Written % w->Depth];
+        if (w->Written < w->Submitted && slot->Done) {
+            pthread_mutex_unlock(&w->Lock);
+            ContainerWriter_Write(w->Out, slot->CSeg, slot->Box);
+            CSeg_Free(slot->CSeg);
+            pthread_mutex_lock(&w->Lock);
+
+            slot->Done = false;
+            w->Written++;
+            pthread_cond_broadcast(&w->Drained);
+        } else if (w->Closing) {
+            break;
+        } else {
+            pthread_cond_wait(&w->Compressed, &w->Lock);
+        }
+    }
+    pthread_mutex_unlock(&w->Lock);
+
+    return NULL;
+}
+
+void decodeSegment(void *arg) {
+    asyncReadSlot *slot = arg;
+    AsyncReader *r = slot->Reader;
+    CSeg cs = slot->CSeg;
+
+    /* One extra field is left for IDs which weren't requested but are
+     * needed to undo Lagrangian positions. */
+    Seg s;
+    s.FieldLen = r->Fields == NULL ? cs.FieldLen : r->FieldLen;
+    s.Fields = calloc((size_t)s.FieldLen + 1, sizeof(*s.Fields));
+    AssertAlloc(s.Fields);
+
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        int32_t field = r->Fields == NULL ? i : r->Fields[i];
+        if (field < 0 || field >= cs.FieldLen) {
+            Panic("Field %"PRId32" requested from a segment with %"PRId32
+                  " fields.", field, cs.FieldLen);
+        }
+        s.Fields[i] = minnow_DecompressField(r->Ctx, cs.Fields[field]);
+    }
+
+    int32_t id = missingIDs(s, cs);
+    if (id >= 0) {
+        s.Fields[s.FieldLen] = minnow_DecompressField(r->Ctx, cs.Fields[id]);
+        quant_UndoLagrangian(s.Fields, s.FieldLen + 1);
+        quant_FreeField(s.Fields[s.FieldLen]);
+        memset(&s.Fields[s.FieldLen], 0, sizeof(s.Fields[s.FieldLen]));
+    } else {
+        quant_UndoLagrangian(s.Fields, s.FieldLen);
+    }
+    CSeg_Free(cs);
+
+    pthread_mutex_lock(&r->Lock);
+    slot->Seg = s;
+    slot->Done = true;
+    pthread_cond_broadcast(&r->Decoded);
+    pthread_mutex_unlock(&r->Lock);
+}
+
+/* missingIDs returns the index of the ID field in cs if s holds decoded
+ * Lagrangian positions but no IDs, and -1 otherwise. */
+int32_t missingIDs(Seg s, CSeg cs) {
+    bool lagrangian = false;
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        Field f = s.Fields[i];
+        if (f.Hd.FieldCode == field_Ptid) { return -1; }
+        if (f.Hd.FieldCode == field_Posn && f.Acc != NULL &&
+            ((PositionAccuracy*)f.Acc)->Lagrangian) {
+            lagrangian = true;
+        }
+    }
+    if (!lagrangian) { return -1; }
+
+    for (int32_t i = 0; i < cs.FieldLen; i++) {
+        if (cs.Fields[i].Hd.FieldCode == field_Ptid) { return i; }
+    }
+    return -1;
+}
+
+/* readLoop runs on the I/O thread. It reads segments as soon as there is a
+ * free slot and hands them to the pool to be decoded. */
+void *readLoop(void *arg) {
+    AsyncReader *r = arg;
+
+    for (int64_t i = 0; i < r->SegLen && i < r->Depth; i++) {
+        ContainerReader_WillNeed(r->In, r->Segs[i]);
+    }
+
+    for (int64_t i = 0; i < r->SegLen; i++) {
+        pthread_mutex_lock(&r->Lock);
+        while (i - r->Returned >= r->Depth && !r->Closing) {
+            pthread_cond_wait(&r->Consumed, &r->Lock);
+        }
+        bool closing = r->Closing;
+        pthread_mutex_unlock(&r->Lock);
+        if (closing) { break; }
+
+        if (i + r->Depth < r->SegLen) {
+            ContainerReader_WillNeed(r->In, r->Segs[i + r->Depth]);
+        }
+
+        asyncReadSlot *slot = &r->Slots[i % r->Depth];
+        slot->Reader = r;
+        slot->CSeg = ContainerReader_Read(r->In, r->Segs[i]);
+
+        pthread_mutex_lock(&r->Lock);
+        r->Read++;
+        pthread_mutex_unlock(&r->Lock);
+
+        pool_Submit(r->Ctx->Pool, &r->Group, decodeSegment, slot);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,121 @@
+#ifndef MNW_ASYNCIO_H_
+#define MNW_ASYNCIO_H_
+
+/* asyncio.h contains pipelined versions of the container reader and writer.
+ * Compression runs on a context's thread pool while a dedicated I/O thread
+ * moves finished segments to and from disk, so disk and cores stay busy at
+ * the same time. */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "types.h"
+#include "context.h"
+#include "container.h"
+#include "pool.h"
+
+typedef struct AsyncWriter AsyncWriter;
+
+/* asyncWriteSlot holds one segment between submission and being written. */
+typedef struct asyncWriteSlot {
+    AsyncWriter *Writer;
+    Seg Seg;
+    CSeg CSeg;
+    Box Box;
+    bool Done;
+} asyncWriteSlot;
+
+struct AsyncWriter {
+    minnow_Context *Ctx;
+    ContainerWriter *Out;
+
+    /* A ring of Depth slots. Segment n lives in slot n % Depth. */
+    asyncWriteSlot *Slots;
+    int32_t Depth;
+    int64_t Submitted, Written;
+
+    pool_Group Group;
+    pthread_t IOThread;
+    pthread_mutex_t Lock;
+    pthread_cond_t Compressed, Drained;
+    bool Closing;
+};
+
+/* AsyncWriter_New starts a writer which compresses segments on ctx's pool
+ * and writes them to out in submission order. At most depth segments are in
+ * flight at once, which bounds memory use. out must not be used by the caller
+ * until the writer is closed. */
+AsyncWriter *AsyncWriter_New(
+    minnow_Context *ctx, ContainerWriter *out, int32_t depth
+);
+
+/* AsyncWriter_Write submits s for compression and returns as soon as there
+ * is room in the queue. The writer takes ownership of s and frees it with
+ * Seg_Free once it has been compressed. */
+void AsyncWriter_Write(AsyncWriter *w, Seg s, Box box);
+
+/* AsyncWriter_Flush returns once every submitted segment has been written
+ * to the ContainerWriter. */
+void AsyncWriter_Flush(AsyncWriter *w);
+
+/* AsyncWriter_Close flushes w, stops its I/O thread, and frees it. The
+ * ContainerWriter is not closed. */
+void AsyncWriter_Close(AsyncWriter *w);
+
+typedef struct AsyncReader AsyncReader;
+
+/* asyncReadSlot holds one segment between being read and being returned. */
+typedef struct asyncReadSlot {
+    AsyncReader *Reader;
+    CSeg CSeg;
+    Seg Seg;
+    bool Done;
+} asyncReadSlot;
+
+struct AsyncReader {
+    minnow_Context *Ctx;
+    ContainerReader *In;
+
+    int64_t *Segs;
+    int64_t SegLen;
+    int32_t *Fields; /* NULL if every field should be decoded. */
+    int32_t FieldLen;
+
+    /* A ring of Depth slots. The nth segment in Segs lives in slot
+     * n % Depth. */
+    asyncReadSlot *Slots;
+    int32_t Depth;
+    int64_t Read, Returned;
+
+    pool_Group Group;
+    pthread_t IOThread;
+    pthread_mutex_t Lock;
+    pthread_cond_t Decoded, Consumed;
+    bool Closing;
+};
+
+/* AsyncReader_New starts a reader which returns the segments of in listed in
+ * segs, in that order. Only the fields listed in fields are decoded and they
+ * are returned in the order they are listed. If fields is NULL, every field
+ * is decoded. Lagrangian positions are always returned as positions: if
+ * their IDs aren't listed, the IDs are decoded anyway and then dropped. An
+ * I/O thread reads up to depth segments ahead of the caller and decoding is
+ * done on ctx's pool. segs and fields are copied. */
+AsyncReader *AsyncReader_New(
+    minnow_Context *ctx, ContainerReader *in,
+    int64_t *segs, int64_t segLen,
+    int32_t *fields, int32_t fieldLen,
+    int32_t depth
+);
+
+/* AsyncReader_Next writes the next segment to *s and returns true, or
+ * returns false once every segment has been returned. *s should be freed
+ * with Seg_Free. */
+bool AsyncReader_Next(AsyncReader *r, Seg *s);
+
+/* AsyncReader_Free stops r and frees it, even if not every segment has been
+ * returned. The ContainerReader is not freed. */
+void AsyncReader_Free(AsyncReader *r);
+
+#endif /* MNW_ASYNCIO_H_ */
@@ -0,0 +1,600 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "container.h"
+#include "funcs.h"
+#include "stream.h"
+#include "debug.h"
+
+/* containerTAIL_GUESS is the number of bytes read from the end of a file when
+ * looking for the index. Indices smaller than this are read with the
+ * trailer in a single read. */
+#define containerTAIL_GUESS (1 << 16)
+
+/* containerIOV_BATCH is the most iovecs passed to a single writev call. */
+#define containerIOV_BATCH 64
+
+/* containerFIELD_RECORD_BYTES is the size of the record ToBytes writes for
+ * each field: a FieldHeader, a checksum, and a data length. */
+#define containerFIELD_RECORD_BYTES ((uint64_t)sizeof(FieldHeader) + 12)
+
+/* indexedRange is a ByteRange which remembers its position in the list given
+ * to CoalesceRanges. */
+typedef struct indexedRange {
+    ByteRange Range;
+    int64_t Index;
+} indexedRange;
+
+/************************/
+/* Forward Declarations */
+/************************/
+
+void writeBytes(int fd, uint8_t *bytes, int64_t len);
+void readAll(int fd, uint8_t *bytes, size_t len, uint64_t offset);
+void writeEntry(stream_Writer *writer, ContainerEntry *e);
+ContainerReader *openReader(const char *path, bool mapped);
+U8BigSeq fetch(ContainerReader *r, uint64_t offset, uint64_t len, bool *owned);
+void readEntry(stream_Reader *reader, ContainerEntry *e);
+int compareRanges(const void *a, const void *b);
+U8BigSeq *readRanges(
+    ContainerReader *r, ByteRange *ranges, int64_t len, uint64_t maxGap,
+    U8BigSeq *views, int64_t *bufferLen, int64_t *reads
+);
+void freeBuffers(U8BigSeq *buffers, int64_t len);
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
+ContainerWriter *ContainerWriter_New(const char *path) {
+    ContainerWriter *w = calloc(1, sizeof(*w));
+    AssertAlloc(w);
+
+    w->Fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->Fd < 0) {
+        Panic("Could not open %s for writing: %s.", path, strerror(errno));
+    }
+
+    stream_Writer writer = stream_NewWriter();
+    uint32_t hd[2] = { container_MAGIC, container_VERSION };
+    stream_Write(&writer, hd, sizeof(hd), 4);
+    writeBytes(w->Fd, writer.Data, writer.Len);
+    U8BigSeq_Free(writer);
+
+    w->Offset = container_FILE_HEADER_BYTES;
+    return w;
+}
+
+void ContainerWriter_Write(ContainerWriter *w, CSeg cs, Box box) {
+    SegSlices slices = ToSlices(cs);
+
+    IOHeader hd = {
+        .Magic = container_MAGIC, .Version = container_VERSION,
+        .SegmentBytes = (uint64_t)slices.Bytes,
+        .NextIOHeader = w->Offset + container_IO_HEADER_BYTES +
+            (uint64_t)slices.Bytes
+    };
+    for (int dim = 0; dim < 3; dim++) {
+        hd.Origin[dim] = box.X0[dim];
+        hd.Width[dim] = box.X1[dim] - box.X0[dim];
+    }
+
+    stream_Writer writer = stream_NewWriter();
+    stream_Write(&writer, &hd.Magic, 4, 4);
+    stream_Write(&writer, &hd.Version, 4, 4);
+    stream_Write(&writer, hd.Origin, 3*4, 4);
+    stream_Write(&writer, hd.Width, 3*4, 4);
+    stream_Write(&writer, &hd.SegmentBytes, 8, 8);
+    stream_Write(&writer, &hd.NextIOHeader, 8, 8);
+    writeBytes(w->Fd, writer.Data, writer.Len);
+    U8BigSeq_Free(writer);
+
+    if (WriteSlices(w->Fd, slices.Slices, slices.SliceLen) != slices.Bytes) {
+        Panic("Could not write a %"PRId64" byte segment: %s.",
+              slices.Bytes, strerror(errno));
+    }
+
+    if (w->EntryLen == w->EntryCap) {
+        w->EntryCap = w->EntryCap == 0 ? 64 : 2*w->EntryCap;
+        w->Entries = realloc(
+            w->Entries, (size_t)w->EntryCap * sizeof(*w->Entries)
+        );
+        AssertAlloc(w->Entries);
+    }
+
+    ContainerEntry *e = &w->Entries[w->EntryLen++];
+    e->Offset = w->Offset + container_IO_HEADER_BYTES;
+    e->Bytes = (uint64_t)slices.Bytes;
+    e->ParticleLen = cs.FieldLen > 0 ? cs.Fields[0].Hd.ParticleLen : 0;
+    e->Box = box;
+
+    w->Offset = hd.NextIOHeader;
+    SegSlices_Free(slices);
+}
+
+int64_t WriteSlices(int fd, ByteSlice *slices, int32_t len) {
+    long iovMax = sysconf(_SC_IOV_MAX);
+    if (iovMax <= 0 || iovMax > containerIOV_BATCH) {
+        iovMax = containerIOV_BATCH;
+    }
+
+    struct iovec vecs[containerIOV_BATCH];
+    int64_t written = 0;
+    int32_t next = 0; /* The next slice to be added to vecs. */
+    int n = 0;
+
+    while (next < len || n > 0) {
+        /* Top up the batch. Partially written slices stay at the front. */
+        for (; n < iovMax && next < len; next++) {
+            if (slices[next].Len == 0) { continue; }
+            vecs[n].iov_base = slices[next].Data;
+            vecs[n].iov_len = (size_t)slices[next].Len;
+            n++;
+        }
+        if (n == 0) { break; }
+
+        ssize_t res = writev(fd, vecs, n);
+        if (res < 0 && errno == EINTR) { continue; }
+        if (res <= 0) { return -1; }
+        written += res;
+
+        /* Drop fully written vecs and trim a partially written one. */
+        size_t left = (size_t)res;
+        int done = 0;
+        while (done < n && left >= vecs[done].iov_len) {
+            left -= vecs[done].iov_len;
+            done++;
+        }
+        if (done < n) {
+            vecs[done].iov_base = (uint8_t*)vecs[done].iov_base + left;
+            vecs[done].iov_len -= left;
+        }
+        memmove(vecs, vecs + done, (size_t)(n - done)*sizeof(vecs[0]));
+        n -= done;
+    }
+
+    return written;
+}
+
+void ContainerWriter_Close(ContainerWriter *w) {
+    stream_Writer writer = stream_NewWriter();
+
+    for (int64_t i = 0; i < w->EntryLen; i++) {
+        writeEntry(&writer, &w->Entries[i]);
+    }
+
+    uint64_t trailer64[2] = { w->Offset, (uint64_t)w->EntryLen };
+    uint32_t trailer32[2] = { container_VERSION, container_MAGIC };
+    stream_Write(&writer, trailer64, sizeof(trailer64), 8);
+    stream_Write(&writer, trailer32, sizeof(trailer32), 4);
+
+    writeBytes(w->Fd, writer.Data, writer.Len);
+    U8BigSeq_Free(writer);
+
+    if (close(w->Fd) != 0) {
+        Panic("Could not close container file: %s.", strerror(errno));
+    }
+
+    free(w->Entries);
+    free(w);
+}
+
+ContainerReader *ContainerReader_New(const char *path) {
+    return openReader(path, false);
+}
+
+ContainerReader *ContainerReader_NewMapped(const char *path) {
+    return openReader(path, true);
+}
+
+int64_t ContainerReader_Len(ContainerReader *r) {
+    return r->EntryLen;
+}
+
+ContainerEntry ContainerReader_Entry(ContainerReader *r, int64_t i) {
+    DebugAssert(i >= 0 && i < r->EntryLen) {
+        Panic("Segment %"PRId64" requested from a container with %"PRId64
+              " segments.", i, r->EntryLen);
+    }
+    return r->Entries[i];
+}
+
+CSeg ContainerReader_Read(ContainerReader *r, int64_t i) {
+    ContainerEntry e = ContainerReader_Entry(r, i);
+
+    bool owned;
+    U8BigSeq bytes = fetch(r, e.Offset, e.Bytes, &owned);
+    CSeg cs = FromBytes(bytes);
+    if (owned) { U8BigSeq_Free(bytes); }
+
+    return cs;
+}
+
+void ContainerReader_WillNeed(ContainerReader *r, int64_t i) {
+    ContainerEntry e = ContainerReader_Entry(r, i);
+
+    /* These are only hints, so failures are ignored. */
+    if (r->Map != NULL) {
+        /* posix_madvise needs a page aligned address. */
+        uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+        uint64_t start = e.Offset - e.Offset % page;
+        (void) posix_madvise(r->Map + start, (size_t)(e.Offset + e.Bytes -
+                             start), POSIX_MADV_WILLNEED);
+    } else {
+        (void) posix_fadvise(r->Fd, (off_t)e.Offset, (off_t)e.Bytes,
+                             POSIX_FADV_WILLNEED);
+    }
+}
+
+CSeg ContainerReader_View(ContainerReader *r, int64_t i) {
+    DebugAssert(r->Map != NULL) {
+        Panic("ContainerReader_View called on a reader which was not created "
+              "with ContainerReader_NewMapped.%s", "");
+    }
+
+    ContainerEntry e = ContainerReader_Entry(r, i);
+    return FromBytesView(
+        U8BigSeq_WrapArray(r->Map + e.Offset, (int64_t)e.Bytes)
+    );
+}
+
+ContainerBatch ContainerReader_ReadBatch(
+    ContainerReader *r, int64_t *segs, int64_t segLen,
+    int32_t *fields, int32_t fieldLen, uint64_t maxGap
+) {
+    ContainerBatch b = { .Segs = NULL, .SegLen = segLen };
+    if (segLen == 0) { return b; }
+
+    b.Segs = calloc((size_t)segLen, sizeof(*b.Segs));
+    ByteRange *ranges = calloc((size_t)segLen, sizeof(*ranges));
+    U8BigSeq *views = calloc((size_t)segLen, sizeof(*views));
+    AssertAlloc(b.Segs);
+    AssertAlloc(ranges);
+    AssertAlloc(views);
+
+    if (fields == NULL) {
+        /* Every field is needed, so whole segments are read at once. */
+        for (int64_t i = 0; i < segLen; i++) {
+            ContainerEntry e = ContainerReader_Entry(r, segs[i]);
+            ranges[i].Offset = e.Offset;
+            ranges[i].Bytes = e.Bytes;
+        }
+
+        b.Buffers = readRanges(r, ranges, segLen, maxGap, views,
+                               &b.BufferLen, &b.Reads);
+        for (int64_t i = 0; i < segLen; i++) {
+            b.Segs[i] = FromBytesView(views[i]);
+        }
+
+        free(ranges);
+        free(views);
+        return b;
+    }
+
+    /* The headers of the fields up to the last requested one are enough to
+     * locate every requested field, so only that prefix is read. */
+    int32_t maxField = 0;
+    for (int32_t k = 0; k < fieldLen; k++) {
+        if (fields[k] > maxField) { maxField = fields[k]; }
+    }
+    uint64_t prefix = 4 + containerFIELD_RECORD_BYTES*(uint64_t)(maxField + 1);
+
+    for (int64_t i = 0; i < segLen; i++) {
+        ContainerEntry e = ContainerReader_Entry(r, segs[i]);
+        ranges[i].Offset = e.Offset;
+        ranges[i].Bytes = e.Bytes < prefix ? e.Bytes : prefix;
+    }
+
+    int64_t headerBufferLen;
+    U8BigSeq *headerBuffers = readRanges(r, ranges, segLen, maxGap, views,
+                                         &headerBufferLen, &b.Reads);
+
+    int64_t fieldRangeLen = segLen*(int64_t)fieldLen;
+    ByteRange *fieldRanges = calloc((size_t)fieldRangeLen,
+                                    sizeof(*fieldRanges));
+    CField *headers = calloc((size_t)maxField + 1, sizeof(*headers));
+    uint64_t *dataOffsets = calloc((size_t)maxField + 1,
+                                   sizeof(*dataOffsets));
+    AssertAlloc(fieldRanges);
+    AssertAlloc(headers);
+    AssertAlloc(dataOffsets);
+
+    for (int64_t i = 0; i < segLen; i++) {
+        stream_Reader reader = stream_NewReader(views[i]);
+        int32_t n;
+        stream_Read(&reader, &n, 4, 4);
+        if (maxField >= n) {
+            Panic("Field %"PRId32" requested, but segment %"PRId64" only "
+                  "has %"PRId32" fields.", maxField, segs[i], n);
+        }
+
+        uint64_t offset = 4 + containerFIELD_RECORD_BYTES*(uint64_t)n;
+        for (int32_t j = 0; j <= maxField; j++) {
+            stream_Read(&reader, &headers[j].Hd, sizeof(headers[j].Hd), 4);
+            stream_Read(&reader, &headers[j].Checksum, 4, 4);
+            stream_Read(&reader, &headers[j].DataLen, 8, 8);
+            dataOffsets[j] = offset;
+            offset += (uint64_t)headers[j].DataLen;
+        }
+
+        b.Segs[i].FieldLen = fieldLen;
+        b.Segs[i].Fields = calloc((size_t)fieldLen, sizeof(CField));
+        AssertAlloc(b.Segs[i].Fields);
+
+        uint64_t segOffset = ranges[i].Offset;
+        for (int32_t k = 0; k < fieldLen; k++) {
+            b.Segs[i].Fields[k] = headers[fields[k]];
+            ByteRange *fr = &fieldRanges[i*fieldLen + k];
+            fr->Offset = segOffset + dataOffsets[fields[k]];
+            fr->Bytes = (uint64_t)headers[fields[k]].DataLen;
+        }
+    }
+
+    freeBuffers(headerBuffers, headerBufferLen);
+    free(headers);
+    free(dataOffsets);
+
+    U8BigSeq *fieldViews = calloc((size_t)fieldRangeLen + 1,
+                                  sizeof(*fieldViews));
+    AssertAlloc(fieldViews);
+    b.Buffers = readRanges(r, fieldRanges, fieldRangeLen, maxGap, fieldViews,
+                           &b.BufferLen, &b.Reads);
+    for (int64_t i = 0; i < segLen; i++) {
+        for (int32_t k = 0; k < fieldLen; k++) {
+            b.Segs[i].Fields[k].Data = fieldViews[i*fieldLen + k].Data;
+        }
+    }
+
+    free(ranges);
+    free(views);
+    free(fieldRanges);
+    free(fieldViews);
+    return b;
+}
+
+void ContainerBatch_Free(ContainerBatch b) {
+    for (int64_t i = 0; i < b.SegLen; i++) { CSeg_FreeView(b.Segs[i]); }
+    free(b.Segs);
+    freeBuffers(b.Buffers, b.BufferLen);
+}
+
+int64_t CoalesceRanges(
+    ByteRange *ranges, int64_t len, uint64_t maxGap,
+    ByteRange *merged, int64_t *which
+) {
+    if (len == 0) { return 0; }
+
+    indexedRange *order = calloc((size_t)len, sizeof(*order));
+    AssertAlloc(order);
+    for (int64_t i = 0; i < len; i++) {
+        order[i].Range = ranges[i];
+        order[i].Index = i;
+    }
+    qsort(order, (size_t)len, sizeof(*order), compareRanges);
+
+    int64_t n = 0;
+    uint64_t end = 0;
+    for (int64_t i = 0; i < len; i++) {
+        ByteRange rg = order[i].Range;
+        /* Written this way so that huge maxGaps can't overflow. */
+        if (n == 0 || (rg.Offset > end && rg.Offset - end > maxGap)) {
+            merged[n].Offset = rg.Offset;
+            end = rg.Offset;
+            n++;
+        }
+
+        if (rg.Offset + rg.Bytes > end) { end = rg.Offset + rg.Bytes; }
+        merged[n - 1].Bytes = end - merged[n - 1].Offset;
+        which[order[i].Index] = n - 1;
+    }
+
+    free(order);
+    return n;
+}
+
+void ContainerReader_Free(ContainerReader *r) {
+    if (r->Map != NULL) { munmap(r->Map, (size_t)r->FileBytes); }
+    close(r->Fd);
+    free(r->Entries);
+    free(r);
+}
+
+/********************/
+/* Helper Functions */
+/********************/
+
+ContainerReader *openReader(const char *path, bool mapped) {
+    ContainerReader *r = calloc(1, sizeof(*r));
+    AssertAlloc(r);
+
+    r->Fd = open(path, O_RDONLY);
+    if (r->Fd < 0) {
+        Panic("Could not open %s for reading: %s.", path, strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(r->Fd, &st) != 0) {
+        Panic("Could not stat %s: %s.", path, strerror(errno));
+    }
+    r->FileBytes = (uint64_t)st.st_size;
+
+    uint64_t minBytes = container_FILE_HEADER_BYTES + container_TRAILER_BYTES;
+    if (r->FileBytes < minBytes) {
+        Panic("%s is only %"PRIu64" bytes long, too short to be a minnow "
+              "container.", path, r->FileBytes);
+    }
+
+    if (mapped) {
+        void *map = mmap(NULL, (size_t)r->FileBytes, PROT_READ, MAP_SHARED,
+                         r->Fd, 0);
+        if (map == MAP_FAILED) {
+            Panic("Could not map %s: %s.", path, strerror(errno));
+        }
+        r->Map = map;
+    }
+
+    /* Speculatively read enough of the tail to hold most indices. */
+    uint64_t tailBytes = r->FileBytes - container_FILE_HEADER_BYTES;
+    if (tailBytes > containerTAIL_GUESS) { tailBytes = containerTAIL_GUESS; }
+    uint64_t tailStart = r->FileBytes - tailBytes;
+
+    bool owned;
+    U8BigSeq tail = fetch(r, tailStart, tailBytes, &owned);
+
+    stream_Reader reader = stream_NewReader(tail);
+    reader.Offset = (size_t)(tailBytes - container_TRAILER_BYTES);
+    uint64_t trailer64[2];
+    uint32_t trailer32[2];
+    stream_Read(&reader, trailer64, sizeof(trailer64), 8);
+    stream_Read(&reader, trailer32, sizeof(trailer32), 4);
+
+    if (trailer32[1] != container_MAGIC) {
+        Panic("%s is not a minnow container (or was never closed).", path);
+    } else if (trailer32[0] != container_VERSION) {
+        Panic("%s has container version %"PRIx32", but only version %"
+              PRIx32" is supported.", path, trailer32[0],
+              (uint32_t)container_VERSION);
+    }
+
+    uint64_t indexOffset = trailer64[0];
+    r->EntryLen = (int64_t)trailer64[1];
+    uint64_t indexBytes = (uint64_t)r->EntryLen * container_ENTRY_BYTES;
+
+    if (indexOffset < container_FILE_HEADER_BYTES ||
+        indexOffset + indexBytes + container_TRAILER_BYTES != r->FileBytes) {
+        Panic("The index of %s is corrupted.%s", path, "");
+    }
+
+    if (indexOffset < tailStart) {
+        /* The guess was too small: read the whole index. */
+        if (owned) { U8BigSeq_Free(tail); }
+        tail = fetch(r, indexOffset, indexBytes, &owned);
+        reader = stream_NewReader(tail);
+    } else {
+        reader.Offset = (size_t)(indexOffset - tailStart);
+    }
+
+    r->Entries = calloc((size_t)r->EntryLen + 1, sizeof(*r->Entries));
+    AssertAlloc(r->Entries);
+    for (int64_t i = 0; i < r->EntryLen; i++) {
+        readEntry(&reader, &r->Entries[i]);
+    }
+
+    if (owned) { U8BigSeq_Free(tail); }
+    return r;
+}
+
+/* fetch returns len bytes of the file starting at offset. If the file is
+ * mapped, this is a view into the mapping and *owned is set to false.
+ * Otherwise the bytes are read into a new sequence and *owned is true. */
+U8BigSeq fetch(ContainerReader *r, uint64_t offset, uint64_t len, bool *owned) {
+    if (r->Map != NULL) {
+        *owned = false;
+        return U8BigSeq_WrapArray(r->Map + offset, (int64_t)len);
+    }
+
+    *owned = true;
+    U8BigSeq bytes = U8BigSeq_New((int64_t)len);
+    readAll(r->Fd, bytes.Data, (size_t)len, offset);
+    return bytes;
+}
+
+/* writeBytes writes len bytes at the current file position. */
+void writeBytes(int fd, uint8_t *bytes, int64_t len) {
+    ByteSlice slice = { .Data = bytes, .Len = len };
+    if (WriteSlices(fd, &slice, 1) != len) {
+        Panic("Could not write %"PRId64" bytes: %s.", len, strerror(errno));
+    }
+}
+
+/* readAll reads len bytes from the given offset, retrying short reads. */
+void readAll(int fd, uint8_t *bytes, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, bytes, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n < 0) {
+            Panic("Could not read %zu bytes at offset %"PRIu64": %s.",
+                  len, offset, strerror(errno));
+        } else if (n == 0) {
+            Panic("Unexpected end of file reading %zu bytes at offset %"
+                  PRIu64".", len, offset);
+        }
+        bytes += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+}
+
+void writeEntry(stream_Writer *writer, ContainerEntry *e) {
+    stream_Write(writer, &e->Offset, 8, 8);
+    stream_Write(writer, &e->Bytes, 8, 8);
+    stream_Write(writer, &e->ParticleLen, 8, 8);
+    stream_Write(writer, e->Box.X0, 3*4, 4);
+    stream_Write(writer, e->Box.X1, 3*4, 4);
+}
+
+void readEntry(stream_Reader *reader, ContainerEntry *e) {
+    stream_Read(reader, &e->Offset, 8, 8);
+    stream_Read(reader, &e->Bytes, 8, 8);
+    stream_Read(reader, &e->ParticleLen, 8, 8);
+    stream_Read(reader, e->Box.X0, 3*4, 4);
+    stream_Read(reader, e->Box.X1, 3*4, 4);
+}
+
+int compareRanges(const void *a, const void *b) {
+    const ByteRange *ra = &((const indexedRange*)a)->Range;
+    const ByteRange *rb = &((const indexedRange*)b)->Range;
+    if (ra->Offset != rb->Offset) { return ra->Offset < rb->Offset ? -1 : 1; }
+    if (ra->Bytes != rb->Bytes) { return ra->Bytes < rb->Bytes ? -1 : 1; }
+    return 0;
+}
+
+/* readRanges reads each of the len ranges, merging them with CoalesceRanges,
+ * and writes a view of each range to views. The buffers backing the views are
+ * returned, their number is written to bufferLen, and the number of reads is
+ * added to reads. Mapped readers don't need buffers. */
+U8BigSeq *readRanges(
+    ContainerReader *r, ByteRange *ranges, int64_t len, uint64_t maxGap,
+    U8BigSeq *views, int64_t *bufferLen, int64_t *reads
+) {
+    ByteRange *merged = calloc((size_t)len + 1, sizeof(*merged));
+    int64_t *which = calloc((size_t)len + 1, sizeof(*which));
+    AssertAlloc(merged);
+    AssertAlloc(which);
+    int64_t mergedLen = CoalesceRanges(ranges, len, maxGap, merged, which);
+
+    U8BigSeq *buffers = calloc((size_t)mergedLen + 1, sizeof(*buffers));
+    AssertAlloc(buffers);
+    bool owned = false;
+    for (int64_t j = 0; j < mergedLen; j++) {
+        buffers[j] = fetch(r, merged[j].Offset, merged[j].Bytes, &owned);
+    }
+    *bufferLen = owned ? mergedLen : 0;
+    *reads += mergedLen;
+
+    for (int64_t i = 0; i < len; i++) {
+        ByteRange m = merged[which[i]];
+        views[i] = U8BigSeq_WrapArray(
+            buffers[which[i]].Data + (ranges[i].Offset - m.Offset),
+            (int64_t)ranges[i].Bytes
+        );
+    }
+
+    free(merged);
+    free(which);
+    return buffers;
+}
+
+void freeBuffers(U8BigSeq *buffers, int64_t len) {
+    for (int64_t i = 0; i < len; i++) { U8BigSeq_Free(buffers[i]); }
+    free(buffers);
+}
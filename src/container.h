@@ -0,0 +1,156 @@
+#ifndef MNW_CONTAINER_H_
+#define MNW_CONTAINER_H_
+
+/* container.h contains a file format which holds many compressed segments.
+ *
+ * The file starts with an eight byte header (Magic, Version). Each segment is
+ * written as an IOHeader (see the "Suggested I/O Specification" section of
+ * the format document) followed by its ToBytes output, so the file can still
+ * be walked serially through NextIOHeader. The chain ends at the index.
+ *
+ * After the last segment comes an index with one ContainerEntry per segment
+ * and then a fixed size trailer: (IndexOffset, SegmentLen, Version, Magic).
+ * A reader finds the index with a single read of the end of the file and can
+ * then read any segment with a single read. All values are little endian. */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "seq.h"
+
+#define container_MAGIC 0x4d6e6f77 /* "Mnow" */
+#define container_VERSION 0x00000100 /* 0.1.0-dev */
+
+#define container_FILE_HEADER_BYTES 8
+#define container_IO_HEADER_BYTES 48
+#define container_ENTRY_BYTES 48
+#define container_TRAILER_BYTES 24
+
+typedef struct IOHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    float Origin[3];
+    float Width[3];
+    uint64_t SegmentBytes;
+    uint64_t NextIOHeader;
+} IOHeader;
+
+/* ContainerEntry describes one segment. Offset and Bytes give the location of
+ * the segment's ToBytes output, not of its IOHeader. */
+typedef struct ContainerEntry {
+    uint64_t Offset, Bytes;
+    int64_t ParticleLen;
+    Box Box;
+} ContainerEntry;
+
+typedef struct ContainerWriter {
+    int Fd;
+    uint64_t Offset;
+    ContainerEntry *Entries;
+    int64_t EntryLen, EntryCap;
+} ContainerWriter;
+
+/* ByteRange is a contiguous run of bytes within a file. */
+typedef struct ByteRange {
+    uint64_t Offset, Bytes;
+} ByteRange;
+
+/* ContainerBatch holds the segments returned by ContainerReader_ReadBatch.
+ * The fields of every segment point into Buffers, which are shared between
+ * segments. */
+typedef struct ContainerBatch {
+    CSeg *Segs;
+    int64_t SegLen;
+    U8BigSeq *Buffers;
+    int64_t BufferLen;
+    int64_t Reads; /* Reads issued after merging nearby ranges. */
+} ContainerBatch;
+
+typedef struct ContainerReader {
+    int Fd;
+    uint64_t FileBytes;
+    uint8_t *Map; /* NULL unless opened with ContainerReader_NewMapped. */
+    ContainerEntry *Entries;
+    int64_t EntryLen;
+} ContainerReader;
+
+/* ContainerWriter_New creates (or truncates) the file at path. */
+ContainerWriter *ContainerWriter_New(const char *path);
+
+/* ContainerWriter_Write appends cs to the file. box should contain every
+ * particle in the segment and is stored in the index so that readers can
+ * skip segments without reading them. */
+void ContainerWriter_Write(ContainerWriter *w, CSeg cs, Box box);
+
+/* ContainerWriter_Close writes the index and trailer, closes the file, and
+ * frees w. */
+void ContainerWriter_Close(ContainerWriter *w);
+
+/* WriteSlices writes every slice to fd, in order, at the current file
+ * position using writev. Short writes are retried. It returns the number of
+ * bytes written, or -1 if an error occured (in which case errno is set and
+ * an unknown number of bytes have been written). */
+int64_t WriteSlices(int fd, ByteSlice *slices, int32_t len);
+
+/* ContainerReader_New opens the file at path and reads its index. */
+ContainerReader *ContainerReader_New(const char *path);
+
+/* ContainerReader_NewMapped opens the file at path and maps it into memory.
+ * In addition to everything a normal reader supports, a mapped reader can
+ * return segments with ContainerReader_View. */
+ContainerReader *ContainerReader_NewMapped(const char *path);
+
+/* ContainerReader_Len returns the number of segments in the file. */
+int64_t ContainerReader_Len(ContainerReader *r);
+
+/* ContainerReader_Entry returns the index entry for segment i. */
+ContainerEntry ContainerReader_Entry(ContainerReader *r, int64_t i);
+
+/* ContainerReader_Read reads segment i. The result should be freed with
+ * CSeg_Free. It is safe to call from multiple threads at once. */
+CSeg ContainerReader_Read(ContainerReader *r, int64_t i);
+
+/* ContainerReader_WillNeed tells the OS that segment i will be read soon so
+ * that it can start reading it in the background. */
+void ContainerReader_WillNeed(ContainerReader *r, int64_t i);
+
+/* ContainerReader_View returns segment i without copying it: the Data of
+ * each field points into the reader's mapping. r must have been created by
+ * ContainerReader_NewMapped and must outlive the result, which should be freed
+ * with CSeg_FreeView. */
+CSeg ContainerReader_View(ContainerReader *r, int64_t i);
+
+/* ContainerReader_ReadBatch reads the listed fields of the listed segments
+ * with as few reads as possible. The byte ranges of every requested field are
+ * sorted and ranges separated by at most maxGap bytes are merged into a single
+ * large read, so a few hundred kilobytes is a reasonable maxGap on a parallel
+ * filesystem. The segment headers are read the same way beforehand.
+ *
+ * The ith segment of the result holds the fields of segs[i], in the order
+ * they are listed in fields. If fields is NULL, every field is returned. The
+ * Data of each field points into the batch's buffers (or into the mapping
+ * if r is mapped), so the result should be freed with ContainerBatch_Free. */
+ContainerBatch ContainerReader_ReadBatch(
+    ContainerReader *r, int64_t *segs, int64_t segLen,
+    int32_t *fields, int32_t fieldLen, uint64_t maxGap
+);
+
+/* ContainerBatch_Free frees every segment in b and the buffers behind them. */
+void ContainerBatch_Free(ContainerBatch b);
+
+/* CoalesceRanges merges the len ranges in ranges which overlap or are
+ * separated by at most maxGap bytes. The merged ranges are written to merged
+ * in order of increasing offset, and the index of the merged range which
+ * contains ranges[i] is written to which[i]. merged must have room for len
+ * ranges. The number of merged ranges is returned. */
+int64_t CoalesceRanges(
+    ByteRange *ranges, int64_t len, uint64_t maxGap,
+    ByteRange *merged, int64_t *which
+);
+
+/* ContainerReader_Free closes the file. Views returned by the reader are
+ * invalidated. */
+void ContainerReader_Free(ContainerReader *r);
+
+#endif /* MNW_CONTAINER_H_ */
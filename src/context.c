@@ -0,0 +1,457 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "context.h"
+#include "quant.h"
+#include "util.h"
+#include "semver.h"
+#include "debug.h"
+
+#define contextALIGN 16
+#define contextMIN_CHUNK (1 << 16)
+
+/************************/
+/* Forward Declarations */
+/************************/
+
+typedef struct compressTask {
+    minnow_Context *Ctx;
+    Field *In, *ID; /* ID is only set for Lagrangian positions. */
+    CField *Out;
+} compressTask;
+
+typedef struct segmentTask {
+    minnow_Context *Ctx;
+    Seg *In;
+    CSeg *Out;
+    int64_t Size;
+} segmentTask;
+
+typedef struct decompressTask {
+    minnow_Context *Ctx;
+    CField *In;
+    Field *Out;
+} decompressTask;
+
+minnow_Buffers *findBuffers(minnow_Context *ctx, uint32_t algo,
+                            uint32_t version);
+void checkSupport(minnow_Context *ctx, uint32_t algo, uint32_t version);
+CField compressQField(
+    minnow_Context *ctx, Field f, Field *id, pool_Pool *pool
+);
+void compressField(void *arg);
+void compressSegmentTask(void *arg);
+int compareSegmentSize(const void *a, const void *b);
+void decompressField(void *arg);
+void newChunk(minnow_Arena *a, size_t cap);
+void resetArena(minnow_Arena *a);
+void freeArena(minnow_Arena *a);
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
+minnow_Context *minnow_NewContext(int32_t threads) {
+    minnow_Context *ctx = calloc(1, sizeof(*ctx));
+    AssertAlloc(ctx);
+
+    ctx->Reg = Register_New();
+    ctx->Pool = pool_New(threads);
+    ctx->Arenas = PtrSeq_New(0);
+    pthread_mutex_init(&ctx->Lock, NULL);
+
+    return ctx;
+}
+
+void minnow_FreeContext(minnow_Context *ctx) {
+    pool_Free(ctx->Pool);
+
+    for (int32_t i = 0; i < ctx->BufferLen; i++) {
+        minnow_Buffers *b = &ctx->Buffers[i];
+        for (int32_t j = 0; j < b->CompLen; j++) {
+            Compressor *comp = b->Comps.Data[j];
+            Register_FreeCompressor(ctx->Reg, b->Algo, b->Version, *comp);
+            free(comp);
+        }
+        for (int32_t j = 0; j < b->DecompLen; j++) {
+            Decompressor *decomp = b->Decomps.Data[j];
+            Register_FreeDecompressor(ctx->Reg, b->Algo, b->Version, *decomp);
+            free(decomp);
+        }
+        PtrSeq_Free(b->Comps);
+        PtrSeq_Free(b->Decomps);
+    }
+    free(ctx->Buffers);
+
+    for (int32_t i = 0; i < ctx->ArenaLen; i++) {
+        freeArena(ctx->Arenas.Data[i]);
+    }
+    PtrSeq_Free(ctx->Arenas);
+
+    Register_Free(ctx->Reg);
+    pthread_mutex_destroy(&ctx->Lock);
+    free(ctx);
+}
+
+Compressor minnow_GetCompressor(
+    minnow_Context *ctx, uint32_t algo, uint32_t version
+) {
+    pthread_mutex_lock(&ctx->Lock);
+    minnow_Buffers *b = findBuffers(ctx, algo, version);
+    if (b->CompLen > 0) {
+        Compressor comp = *(Compressor*)b->Comps.Data[--b->CompLen];
+        pthread_mutex_unlock(&ctx->Lock);
+        return comp;
+    }
+    pthread_mutex_unlock(&ctx->Lock);
+
+    checkSupport(ctx, algo, version);
+    return Register_GetCompressor(ctx->Reg, algo, version);
+}
+
+void minnow_PutCompressor(
+    minnow_Context *ctx, uint32_t algo, uint32_t version, Compressor comp
+) {
+    pthread_mutex_lock(&ctx->Lock);
+    minnow_Buffers *b = findBuffers(ctx, algo, version);
+
+    if (b->CompLen == b->Comps.Len) {
+        Compressor *slot = malloc(sizeof(*slot));
+        AssertAlloc(slot);
+        b->Comps = PtrSeq_Append(b->Comps, slot);
+    }
+    *(Compressor*)b->Comps.Data[b->CompLen++] = comp;
+
+    pthread_mutex_unlock(&ctx->Lock);
+}
+
+Decompressor minnow_GetDecompressor(
+    minnow_Context *ctx, uint32_t algo, uint32_t version
+) {
+    pthread_mutex_lock(&ctx->Lock);
+    minnow_Buffers *b = findBuffers(ctx, algo, version);
+    if (b->DecompLen > 0) {
+        Decompressor decomp = *(Decompressor*)b->Decomps.Data[--b->DecompLen];
+        pthread_mutex_unlock(&ctx->Lock);
+        return decomp;
+    }
+    pthread_mutex_unlock(&ctx->Lock);
+
+    checkSupport(ctx, algo, version);
+    return Register_GetDecompressor(ctx->Reg, algo, version);
+}
+
+void minnow_PutDecompressor(
+    minnow_Context *ctx, uint32_t algo, uint32_t version, Decompressor decomp
+) {
+    pthread_mutex_lock(&ctx->Lock);
+    minnow_Buffers *b = findBuffers(ctx, algo, version);
+
+    if (b->DecompLen == b->Decomps.Len) {
+        Decompressor *slot = malloc(sizeof(*slot));
+        AssertAlloc(slot);
+        b->Decomps = PtrSeq_Append(b->Decomps, slot);
+    }
+    *(Decompressor*)b->Decomps.Data[b->DecompLen++] = decomp;
+
+    pthread_mutex_unlock(&ctx->Lock);
+}
+
+minnow_Arena *minnow_GetArena(minnow_Context *ctx) {
+    pthread_mutex_lock(&ctx->Lock);
+    if (ctx->ArenaLen > 0) {
+        minnow_Arena *a = ctx->Arenas.Data[--ctx->ArenaLen];
+        pthread_mutex_unlock(&ctx->Lock);
+        resetArena(a);
+        return a;
+    }
+    pthread_mutex_unlock(&ctx->Lock);
+
+    minnow_Arena *a = calloc(1, sizeof(*a));
+    AssertAlloc(a);
+    a->Chunks = PtrSeq_New(0);
+    return a;
+}
+
+void minnow_PutArena(minnow_Context *ctx, minnow_Arena *a) {
+    pthread_mutex_lock(&ctx->Lock);
+    if (ctx->ArenaLen == ctx->Arenas.Len) {
+        ctx->Arenas = PtrSeq_Append(ctx->Arenas, a);
+    } else {
+        ctx->Arenas.Data[ctx->ArenaLen] = a;
+    }
+    ctx->ArenaLen++;
+    pthread_mutex_unlock(&ctx->Lock);
+}
+
+void *minnow_ArenaAlloc(minnow_Arena *a, size_t bytes) {
+    bytes = (bytes + contextALIGN - 1) / contextALIGN * contextALIGN;
+    a->Total += bytes;
+
+    if (a->ChunkLen == 0 || a->Used + bytes > a->Cap) {
+        /* Chunks are never resized, so earlier allocations stay valid. */
+        size_t cap = 2*a->Cap;
+        if (cap < contextMIN_CHUNK) { cap = contextMIN_CHUNK; }
+        if (cap < bytes) { cap = bytes; }
+        newChunk(a, cap);
+    }
+
+    uint8_t *ptr = (uint8_t*)a->Chunks.Data[a->ChunkLen - 1] + a->Used;
+    a->Used += bytes;
+    return ptr;
+}
+
+CSeg minnow_Compress(minnow_Context *ctx, Seg s) {
+    CSeg cs;
+    cs.FieldLen = s.FieldLen;
+    cs.Fields = calloc((size_t)cs.FieldLen, sizeof(*cs.Fields));
+    AssertAlloc(cs.Fields);
+
+    minnow_Arena *a = minnow_GetArena(ctx);
+    compressTask *tasks = minnow_ArenaAlloc(
+        a, (size_t)s.FieldLen * sizeof(*tasks)
+    );
+
+    int32_t id, pos = quant_FindLagrangian(s.Fields, s.FieldLen, &id);
+
+    pool_Group g = pool_NewGroup();
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        tasks[i].Ctx = ctx;
+        tasks[i].In = &s.Fields[i];
+        tasks[i].ID = i == pos ? &s.Fields[id] : NULL;
+        tasks[i].Out = &cs.Fields[i];
+        pool_Submit(ctx->Pool, &g, compressField, &tasks[i]);
+    }
+    pool_Wait(ctx->Pool, &g);
+    minnow_PutArena(ctx, a);
+
+    return cs;
+}
+
+void minnow_CompressMany(minnow_Context *ctx, Seg *segs, int64_t n,
+                         CSeg *out) {
+    minnow_Arena *a = minnow_GetArena(ctx);
+    segmentTask *tasks = minnow_ArenaAlloc(a, (size_t)n * sizeof(*tasks));
+
+    for (int64_t i = 0; i < n; i++) {
+        tasks[i].Ctx = ctx;
+        tasks[i].In = &segs[i];
+        tasks[i].Out = &out[i];
+        tasks[i].Size = 0;
+        for (int32_t j = 0; j < segs[i].FieldLen; j++) {
+            tasks[i].Size += segs[i].Fields[j].Hd.ParticleLen;
+        }
+    }
+
+    /* Starting the largest segments first keeps a single huge segment from
+     * being the only thing left running at the end. */
+    if (n > 1) { qsort(tasks, (size_t)n, sizeof(*tasks), compareSegmentSize); }
+
+    pool_Group g = pool_NewGroup();
+    for (int64_t i = 0; i < n; i++) {
+        pool_Submit(ctx->Pool, &g, compressSegmentTask, &tasks[i]);
+    }
+    pool_Wait(ctx->Pool, &g);
+    minnow_PutArena(ctx, a);
+}
+
+Seg minnow_Decompress(minnow_Context *ctx, CSeg cs) {
+    Seg s;
+    s.FieldLen = cs.FieldLen;
+    s.Fields = calloc((size_t)s.FieldLen, sizeof(*s.Fields));
+    AssertAlloc(s.Fields);
+
+    minnow_Arena *a = minnow_GetArena(ctx);
+    decompressTask *tasks = minnow_ArenaAlloc(
+        a, (size_t)cs.FieldLen * sizeof(*tasks)
+    );
+
+    pool_Group g = pool_NewGroup();
+    for (int32_t i = 0; i < cs.FieldLen; i++) {
+        tasks[i].Ctx = ctx;
+        tasks[i].In = &cs.Fields[i];
+        tasks[i].Out = &s.Fields[i];
+        pool_Submit(ctx->Pool, &g, decompressField, &tasks[i]);
+    }
+    pool_Wait(ctx->Pool, &g);
+    minnow_PutArena(ctx, a);
+    quant_UndoLagrangian(s.Fields, s.FieldLen);
+
+    return s;
+}
+
+CField minnow_CompressField(minnow_Context *ctx, Field f) {
+    return compressQField(ctx, f, NULL, NULL);
+}
+
+Field minnow_DecompressField(minnow_Context *ctx, CField cf) {
+    Field f;
+    memset(&f, 0, sizeof(f));
+    f.Hd = cf.Hd;
+
+    uint32_t checksum = util_Checksum(
+        U8BigSeq_WrapArray(cf.Data, cf.DataLen)
+    );
+    if (checksum != cf.Checksum) { return f; }
+
+    uint32_t algo = cf.Hd.AlgoCode;
+    uint32_t version = cf.Hd.AlgoVersion;
+    Decompressor decomp = minnow_GetDecompressor(ctx, algo, version);
+
+    QField qf = decomp.DFunc(cf, decomp.Buffer);
+    qf.Valid = true;
+    f = quant_Field(qf, ctx->Centered, ctx->Single);
+    f.Valid = true;
+    quant_FreeQField(qf);
+
+    minnow_PutDecompressor(ctx, algo, version, decomp);
+    return f;
+}
+
+bool minnow_DecompressFieldInto(minnow_Context *ctx, CField cf, void *out) {
+    uint32_t checksum = util_Checksum(
+        U8BigSeq_WrapArray(cf.Data, cf.DataLen)
+    );
+    if (checksum != cf.Checksum) { return false; }
+
+    uint32_t algo = cf.Hd.AlgoCode;
+    uint32_t version = cf.Hd.AlgoVersion;
+    Decompressor decomp = minnow_GetDecompressor(ctx, algo, version);
+
+    QField qf = decomp.DFunc(cf, decomp.Buffer);
+    quant_FieldInto(qf, out, ctx->Centered, ctx->Single);
+    quant_FreeQField(qf);
+
+    minnow_PutDecompressor(ctx, algo, version, decomp);
+    return true;
+}
+
+/********************/
+/* Helper Functions */
+/********************/
+
+/* findBuffers must be called while holding ctx->Lock. */
+minnow_Buffers *findBuffers(
+    minnow_Context *ctx, uint32_t algo, uint32_t version
+) {
+    for (int32_t i = 0; i < ctx->BufferLen; i++) {
+        minnow_Buffers *b = &ctx->Buffers[i];
+        if (b->Algo == algo && b->Version == version) { return b; }
+    }
+
+    if (ctx->BufferLen == ctx->BufferCap) {
+        ctx->BufferCap = ctx->BufferCap == 0 ? 4 : 2*ctx->BufferCap;
+        ctx->Buffers = realloc(
+            ctx->Buffers, (size_t)ctx->BufferCap * sizeof(*ctx->Buffers)
+        );
+        AssertAlloc(ctx->Buffers);
+    }
+
+    minnow_Buffers *b = &ctx->Buffers[ctx->BufferLen++];
+    b->Algo = algo;
+    b->Version = version;
+    b->Comps = PtrSeq_New(0);
+    b->Decomps = PtrSeq_New(0);
+    b->CompLen = 0;
+    b->DecompLen = 0;
+    return b;
+}
+
+void checkSupport(minnow_Context *ctx, uint32_t algo, uint32_t version) {
+    if (!Register_Supports(ctx->Reg, algo, version)) {
+        Panic("v%d.%d of algorithm %x is not supported.",
+              semver_Major(version), semver_Minor(version), algo);
+    }
+}
+
+/* compressQField is minnow_CompressField for a field which may be a
+ * Lagrangian position field, in which case id is its segment's ID field. If
+ * pool is non-NULL, the field is quantized in tasks on it. */
+CField compressQField(
+    minnow_Context *ctx, Field f, Field *id, pool_Pool *pool
+) {
+    uint32_t algo = f.Hd.AlgoCode;
+    uint32_t version = f.Hd.AlgoVersion;
+
+    Compressor comp = minnow_GetCompressor(ctx, algo, version);
+
+    QField qf = id == NULL ? quant_QFieldPool(f, pool) :
+        quant_LagrangianQFieldPool(f, *id, pool);
+    qf.Valid = true;
+    CField cf = comp.CFunc(qf, comp.Buffer);
+    cf.Checksum = util_Checksum(U8BigSeq_WrapArray(cf.Data, cf.DataLen));
+    quant_FreeQField(qf);
+
+    minnow_PutCompressor(ctx, algo, version, comp);
+    return cf;
+}
+
+void compressField(void *arg) {
+    compressTask *task = arg;
+    *task->Out = compressQField(
+        task->Ctx, *task->In, task->ID, task->Ctx->Pool
+    );
+}
+
+/* compressSegmentTask runs on a worker, so the field tasks submitted by
+ * minnow_Compress go to that worker's deque, where other workers can steal
+ * them. */
+void compressSegmentTask(void *arg) {
+    segmentTask *task = arg;
+    *task->Out = minnow_Compress(task->Ctx, *task->In);
+}
+
+/* compareSegmentSize orders segmentTasks from largest to smallest. */
+int compareSegmentSize(const void *a, const void *b) {
+    int64_t sa = ((const segmentTask*)a)->Size;
+    int64_t sb = ((const segmentTask*)b)->Size;
+    if (sa == sb) { return 0; }
+    return sa > sb ? -1 : 1;
+}
+
+void decompressField(void *arg) {
+    decompressTask *task = arg;
+    *task->Out = minnow_DecompressField(task->Ctx, *task->In);
+}
+
+/* newChunk adds a chunk of cap bytes to a and allocates from it from now
+ * on. */
+void newChunk(minnow_Arena *a, size_t cap) {
+    void *chunk = NULL;
+    if (posix_memalign(&chunk, contextALIGN, cap) != 0) { chunk = NULL; }
+    AssertAlloc(chunk);
+
+    if (a->ChunkLen == a->Chunks.Len) {
+        a->Chunks = PtrSeq_Append(a->Chunks, chunk);
+    } else {
+        a->Chunks.Data[a->ChunkLen] = chunk;
+    }
+    a->ChunkLen++;
+    a->ChunkAllocs++;
+    a->Used = 0;
+    a->Cap = cap;
+}
+
+/* resetArena releases every allocation made from a. If they needed several
+ * chunks, those are replaced by one chunk large enough to hold all of them
+ * at once. */
+void resetArena(minnow_Arena *a) {
+    if (a->ChunkLen > 1) {
+        for (int32_t i = 0; i < a->ChunkLen; i++) {
+            free(a->Chunks.Data[i]);
+        }
+        a->ChunkLen = 0;
+        newChunk(a, a->Total);
+    }
+    a->Used = 0;
+    a->Total = 0;
+}
+
+void freeArena(minnow_Arena *a) {
+    for (int32_t i = 0; i < a->ChunkLen; i++) { free(a->Chunks.Data[i]); }
+    PtrSeq_Free(a->Chunks);
+    free(a);
+}
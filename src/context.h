@@ -0,0 +1,136 @@
+#ifndef MNW_CONTEXT_H_
+#define MNW_CONTEXT_H_
+
+/* context.h contains minnow_Context, which holds all the state needed to
+ * compress and decompress segments: the algorithm registry, the buffers used
+ * by each algorithm, scratch arenas, and a thread pool. Creating these is
+ * expensive relative to compressing a small segment, so a single context
+ * should be reused across every segment a program writes or reads. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "types.h"
+#include "seq.h"
+#include "register.h"
+#include "pool.h"
+
+/* minnow_Buffers holds the idle compressors and decompressors for one
+ * (algo, version) pair. */
+typedef struct minnow_Buffers {
+    uint32_t Algo, Version;
+    PtrSeq Comps, Decomps;
+    int32_t CompLen, DecompLen;
+} minnow_Buffers;
+
+/* minnow_Arena is a bump allocator owned by one call at a time. Its memory
+ * is released all at once when it's handed out again by minnow_GetArena.
+ * Total counts the bytes allocated since then and ChunkAllocs counts every
+ * chunk the arena has ever allocated. */
+typedef struct minnow_Arena {
+    PtrSeq Chunks;
+    int32_t ChunkLen;
+    size_t Used, Cap, Total;
+    int64_t ChunkAllocs;
+} minnow_Arena;
+
+/* If Centered is set, decoded floats are placed at the centers of their bins
+ * instead of at random points within them (see quant_Field). If Single is
+ * set, fields quantized from doubles are decoded to floats. Both are false
+ * for new contexts and are read by each decompression call, so they can be
+ * changed between calls. They have no effect on compression or on the files
+ * written. */
+typedef struct minnow_Context {
+    Register *Reg;
+    bool Centered, Single;
+
+    minnow_Buffers *Buffers;
+    int32_t BufferLen, BufferCap;
+
+    PtrSeq Arenas; /* Idle arenas. */
+    int32_t ArenaLen;
+
+    pool_Pool *Pool;
+    pthread_mutex_t Lock;
+} minnow_Context;
+
+/* minnow_NewContext creates a context which compresses fields with the
+ * given number of worker threads. If threads is zero, all work is done on
+ * the calling thread. */
+minnow_Context *minnow_NewContext(int32_t threads);
+void minnow_FreeContext(minnow_Context *ctx);
+
+/* minnow_GetCompressor returns an idle compressor for the given algorithm,
+ * creating one only if none are available. It must be returned with
+ * minnow_PutCompressor. */
+Compressor minnow_GetCompressor(
+    minnow_Context *ctx, uint32_t algo, uint32_t version
+);
+void minnow_PutCompressor(
+    minnow_Context *ctx, uint32_t algo, uint32_t version, Compressor comp
+);
+
+/* minnow_GetDecompressor and minnow_PutDecompressor are the decompression
+ * analogues of minnow_GetCompressor and minnow_PutCompressor. */
+Decompressor minnow_GetDecompressor(
+    minnow_Context *ctx, uint32_t algo, uint32_t version
+);
+void minnow_PutDecompressor(
+    minnow_Context *ctx, uint32_t algo, uint32_t version, Decompressor decomp
+);
+
+/* minnow_GetArena returns an idle arena, creating one only if none are
+ * available, and releases everything previously allocated from it. If that
+ * took more than one chunk, the chunks are merged into one, so a call that
+ * needs no more memory than the last one allocates nothing. The arena must be
+ * returned with minnow_PutArena. minnow_Compress and minnow_Decompress take
+ * their task arrays from arenas, so repeated segments of the same shape
+ * reuse the same memory. */
+minnow_Arena *minnow_GetArena(minnow_Context *ctx);
+void minnow_PutArena(minnow_Context *ctx, minnow_Arena *a);
+
+/* minnow_ArenaAlloc returns bytes of 16-byte aligned memory from a which
+ * remains valid until a is next handed out by minnow_GetArena. */
+void *minnow_ArenaAlloc(minnow_Arena *a, size_t bytes);
+
+/* minnow_Compress quantizes and compresses every field in s, in parallel
+ * across fields. The result is identical to Compress(Quantize(s), comps) and
+ * should be freed with CSeg_Free. */
+CSeg minnow_Compress(minnow_Context *ctx, Seg s);
+
+/* minnow_CompressMany compresses the n segments in segs and writes the
+ * results to out in the same order, so that out[i] is identical to
+ * minnow_Compress(ctx, segs[i]). Segments are spread over ctx's pool from
+ * largest to smallest and the fields of each segment are split into separate
+ * tasks, so idle workers can steal the remaining fields of a large segment.
+ * Large fields are quantized a few blocks per task (see quant_QFieldPool),
+ * so even a segment with a single huge field spreads across the pool, but
+ * each field is still run through its codec by one task. The results should
+ * be freed with CSeg_Free. */
+void minnow_CompressMany(minnow_Context *ctx, Seg *segs, int64_t n, CSeg *out);
+
+/* minnow_Decompress decompresses and dequantizes every field in cs, in
+ * parallel across fields. The result is identical to
+ * UndoQuantize(Decompress(cs, decomps)) and should be freed with Seg_Free. */
+Seg minnow_Decompress(minnow_Context *ctx, CSeg cs);
+
+/* minnow_CompressField quantizes and compresses a single field on the
+ * calling thread using ctx's pooled compressors. Lagrangian position fields
+ * need their segment's IDs and must go through minnow_Compress. */
+CField minnow_CompressField(minnow_Context *ctx, Field f);
+
+/* minnow_DecompressField decompresses and dequantizes a single field on the
+ * calling thread. If cf fails its checksum, the result is not Valid. A
+ * Lagrangian position field decodes to displacements, which
+ * quant_UndoLagrangian turns into positions. */
+Field minnow_DecompressField(minnow_Context *ctx, CField cf);
+
+/* minnow_DecompressFieldInto is identical to minnow_DecompressField, except
+ * that the values are written directly to out (see quant_FieldInto) and no
+ * Accuracy is returned. Nothing is written and false is returned if cf fails
+ * its checksum. */
+bool minnow_DecompressFieldInto(minnow_Context *ctx, CField cf, void *out);
+
+#endif /* MNW_CONTEXT_H_ */
@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <math.h>
+#include <string.h>
 
 #include "register.h"
 #include "funcs.h"
@@ -15,8 +17,12 @@ QSeg Quantize(Seg s) {
     qs.FieldLen = s.FieldLen;
     qs.Fields = calloc((size_t)qs.FieldLen, sizeof(qs.Fields[0]));
 
+    int32_t id, pos = quant_FindLagrangian(s.Fields, s.FieldLen, &id);
     for (int32_t i = 0; i < qs.FieldLen; i++) {
-        qs.Fields[i] = quant_QField(s.Fields[i]);
+        qs.Fields[i] = i == pos ?
+            quant_LagrangianQField(s.Fields[i], s.Fields[id]) :
+            quant_QField(s.Fields[i]);
+        qs.Fields[i].Valid = true;
     }
 
     return qs;
@@ -29,14 +35,89 @@ Seg UndoQuantize(QSeg qs) {
 
     for (int32_t i = 0; i < s.FieldLen; i++) {
         if (qs.Fields[i].Valid) {
-            s.Fields[i] = quant_Field(qs.Fields[i]);
+            s.Fields[i] = quant_Field(qs.Fields[i], false, false);
             s.Fields[i].Valid = true;
         }
     }
+    quant_UndoLagrangian(s.Fields, s.FieldLen);
 
     return s;
 }
 
+bool periodicOverlap(float x0, float x1, float q0, float q1, float L);
+CSeg readFieldHeaders(stream_Reader *reader);
+int32_t positionField(QSeg qs);
+
+I32Seq BoxBlocks(QField qf, Box box) {
+    DebugAssert(qf.Hd.FieldCode == field_Posn) {
+        Panic("BoxBlocks given field with code %"PRIx32".", qf.Hd.FieldCode);
+    }
+
+    PositionQuantization *quant = qf.Quant;
+    I32Seq blocks = I32Seq_New(0);
+
+    for (int32_t b = 0; b < quant->Blocks; b++) {
+        bool overlap = true;
+        for (int i = 0; i < 3 && overlap; i++) {
+            overlap = periodicOverlap(
+                quant->BlockX0[3*b + i], quant->BlockX1[3*b + i],
+                box.X0[i], box.X1[i], quant->Width
+            );
+        }
+        if (overlap) { blocks = I32Seq_Append(blocks, b); }
+    }
+
+    return blocks;
+}
+
+Seg UndoQuantizeBox(QSeg qs, Box box, bool exact) {
+    int32_t pi = positionField(qs);
+    PositionQuantization *quant = qs.Fields[pi].Quant;
+    I32Seq blocks = BoxBlocks(qs.Fields[pi], box);
+
+    Seg s;
+    s.FieldLen = qs.FieldLen;
+    s.Fields = calloc((size_t)s.FieldLen, sizeof(s.Fields[0]));
+
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        if (!qs.Fields[i].Valid) { continue; }
+        QField sub = quant_BlockQField(qs.Fields[i], quant->BlockLen, blocks);
+        s.Fields[i] = quant_Field(sub, false, false);
+        s.Fields[i].Valid = true;
+        quant_FreeQField(sub);
+    }
+
+    I32Seq_Free(blocks);
+    quant_UndoLagrangian(s.Fields, s.FieldLen);
+
+    if (!exact || !s.Fields[pi].Valid) { return s; }
+
+    Field *pos = &s.Fields[pi];
+    int32_t len = pos->Hd.ParticleLen;
+    float *x = pos->Data;
+    double *xd = pos->Data;
+    bool *keep = calloc((size_t)len, sizeof(*keep));
+    AssertAlloc(keep);
+
+    for (int32_t j = 0; j < len; j++) {
+        keep[j] = true;
+        for (int i = 0; i < 3 && keep[j]; i++) {
+            size_t k = (size_t)i*(size_t)len + (size_t)j;
+            float xi = pos->Layout.Double ? (float)xd[k] : x[k];
+            keep[j] = periodicOverlap(
+                xi, xi, box.X0[i], box.X1[i], quant->Width
+            );
+        }
+    }
+
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        if (s.Fields[i].Valid) { quant_FilterField(&s.Fields[i], keep); }
+    }
+
+    free(keep);
+    return s;
+}
+
 QSeg Decompress(CSeg cs, Decompressor *decomps) {
     QSeg qs;
     qs.FieldLen = cs.FieldLen;
@@ -76,51 +157,91 @@ CSeg Compress(QSeg qs, Compressor *comps) {
 }
 
 U8BigSeq ToBytes(CSeg cs) {
+    SegSlices slices = ToSlices(cs);
+
+    U8BigSeq bytes = U8BigSeq_New(slices.Bytes);
+    int64_t n = 0;
+    for (int32_t i = 0; i < slices.SliceLen; i++) {
+        ByteSlice slice = slices.Slices[i];
+        if (slice.Len == 0) { continue; }
+        memcpy(bytes.Data + n, slice.Data, (size_t)slice.Len);
+        n += slice.Len;
+    }
+
+    SegSlices_Free(slices);
+    return bytes;
+}
+
+SegSlices ToSlices(CSeg cs) {
     stream_Writer writer = stream_NewWriter();
 
-    stream_Write(writer, &cs.FieldLen, 4, 4);
+    stream_Write(&writer, &cs.FieldLen, 4, 4);
 
     for (int32_t i = 0; i < cs.FieldLen; i++) {
         CField f = cs.Fields[i];
-        stream_Write(writer, &f.Hd, sizeof(f.Hd), 4);
-        stream_Write(writer, &f.Checksum, 4, 4);
-        stream_Write(writer, &f.DataLen, 4, 4);
+        stream_Write(&writer, &f.Hd, sizeof(f.Hd), 4);
+        stream_Write(&writer, &f.Checksum, 4, 4);
+        stream_Write(&writer, &f.DataLen, 8, 8);
     }
 
+    SegSlices slices;
+    slices.SliceLen = cs.FieldLen + 1;
+    slices.Slices = calloc((size_t)slices.SliceLen, sizeof(*slices.Slices));
+    AssertAlloc(slices.Slices);
+
+    slices.Slices[0].Data = writer.Data;
+    slices.Slices[0].Len = writer.Len;
+    slices.Bytes = writer.Len;
+
     for (int32_t i = 0; i < cs.FieldLen; i++) {
-        stream_Write(
-            writer, cs.Fields[i].Data, (size_t)cs.Fields[i].DataLen, 1
-        );
+        slices.Slices[i + 1].Data = cs.Fields[i].Data;
+        slices.Slices[i + 1].Len = cs.Fields[i].DataLen;
+        slices.Bytes += cs.Fields[i].DataLen;
     }
 
-    return writer;
+    return slices;
+}
+
+void SegSlices_Free(SegSlices slices) {
+    /* The header slice is the only one ToSlices allocated. */
+    free(slices.Slices[0].Data);
+    free(slices.Slices);
 }
 
 CSeg FromBytes(U8BigSeq bytes) {
     stream_Reader reader = stream_NewReader(bytes);
-    CSeg cs;
-
-    stream_Read(reader, &cs.FieldLen, 4, 4);
-    cs.Fields = calloc((size_t)cs.FieldLen, sizeof(*cs.Fields));
+    CSeg cs = readFieldHeaders(&reader);
 
     for (int32_t i = 0; i < cs.FieldLen; i++) {
         CField *f = &cs.Fields[i];
-        stream_Read(reader, &f->Hd, sizeof(f->Hd), 4);
-        stream_Read(reader, &f->Checksum, 4, 4);
-        stream_Read(reader, &f->DataLen, 4, 4);
+        f->Data = malloc((size_t)f->DataLen);
+        AssertAlloc(f->Data);
+        stream_Read(&reader, f->Data, (size_t)f->DataLen, 1);
     }
 
+    return cs;
+}
+
+CSeg FromBytesView(U8BigSeq bytes) {
+    stream_Reader reader = stream_NewReader(bytes);
+    CSeg cs = readFieldHeaders(&reader);
+
     for (int32_t i = 0; i < cs.FieldLen; i++) {
-        stream_Read(
-            reader, cs.Fields[i].Data, (size_t)cs.Fields[i].DataLen, 1
-        );
+        CField *f = &cs.Fields[i];
+        DebugAssert(reader.Offset + (size_t)f->DataLen <=
+                    (size_t)bytes.Len) {
+            Panic("Field %"PRId32" of a %"PRId64" byte segment overruns it.",
+                  i, bytes.Len);
+        }
+        f->Data = bytes.Data + reader.Offset;
+        reader.Offset += (size_t)f->DataLen;
     }
 
     return cs;
 }
 
 Decompressor *LoadDecompressors(CSeg cs) {
-    Register reg = Register_New();
+    Register *reg = Register_New();
     Decompressor *decomps = calloc((size_t) cs.FieldLen, sizeof(decomps[0]));
 
     for (int32_t i = 0; i < cs.FieldLen; i++) {
@@ -141,7 +262,7 @@ Decompressor *LoadDecompressors(CSeg cs) {
 }
 
 Compressor *LoadCompressors(Seg s) {
-    Register reg = Register_New();
+    Register *reg = Register_New();
     Compressor *comps = calloc((size_t) s.FieldLen, sizeof(comps[0]));
 
     for (int32_t i = 0; i < s.FieldLen; i++) {
@@ -162,7 +283,7 @@ Compressor *LoadCompressors(Seg s) {
 }
 
 void FreeDecompressors(CSeg cs, Decompressor *decomps) {
-    Register reg = Register_New();
+    Register *reg = Register_New();
 
     for (int32_t i = 0; i < cs.FieldLen; i++) {
         uint32_t algo = cs.Fields[i].Hd.AlgoCode;
@@ -175,7 +296,7 @@ void FreeDecompressors(CSeg cs, Decompressor *decomps) {
 }
 
 void FreeCompressors(Seg s, Compressor *comps) {
-    Register reg = Register_New();
+    Register *reg = Register_New();
 
     for (int32_t i = 0; i < s.FieldLen; i++) {
         uint32_t algo = s.Fields[i].Hd.AlgoCode;
@@ -187,6 +308,44 @@ void FreeCompressors(Seg s, Compressor *comps) {
     Register_Free(reg);
 }
 
+/* periodicOverlap returns true if [x0, x1] overlaps with [q0, q1] or any of
+ * its periodic images. */
+bool periodicOverlap(float x0, float x1, float q0, float q1, float L) {
+    if ((x1 - x0) + (q1 - q0) >= L) { return true; }
+    float d = fmodf(x0 - q0, L);
+    if (d < 0) { d += L; }
+    return d <= q1 - q0 || d + (x1 - x0) >= L;
+}
+
+int32_t positionField(QSeg qs) {
+    for (int32_t i = 0; i < qs.FieldLen; i++) {
+        if (qs.Fields[i].Valid && qs.Fields[i].Hd.FieldCode == field_Posn) {
+            return i;
+        }
+    }
+    Panic("Segment with %"PRId32" fields has no valid position field.",
+          qs.FieldLen);
+}
+
+/* readFieldHeaders reads the field count and field headers written by
+ * ToBytes, leaving the reader at the start of the first field's data. */
+CSeg readFieldHeaders(stream_Reader *reader) {
+    CSeg cs;
+
+    stream_Read(reader, &cs.FieldLen, 4, 4);
+    cs.Fields = calloc((size_t)cs.FieldLen, sizeof(*cs.Fields));
+    AssertAlloc(cs.Fields);
+
+    for (int32_t i = 0; i < cs.FieldLen; i++) {
+        CField *f = &cs.Fields[i];
+        stream_Read(reader, &f->Hd, sizeof(f->Hd), 4);
+        stream_Read(reader, &f->Checksum, 4, 4);
+        stream_Read(reader, &f->DataLen, 8, 8);
+    }
+
+    return cs;
+}
+
 /* Note: this function will not free your data arrays. */
 void Seg_Free(Seg s) {
     for (int32_t i = 0; i < s.FieldLen; i++) {
@@ -202,100 +361,13 @@ void QSeg_Free(QSeg qs) {
     free(qs.Fields);
 }
 
+void CSeg_FreeView(CSeg cs) {
+    free(cs.Fields);
+}
+
 void CSeg_Free(CSeg cs) {
     for (int32_t i = 0; i < cs.FieldLen; i++) {
         free(cs.Fields[i].Data);
     }
     free(cs.Fields);
 }
-
-Seg getSegment(void);
-Seg getSegment(void) {
-    Register reg = Register_New();
-
-    float *x = NULL;
-    float *v = NULL;
-    uint64_t *id = NULL;
-    int32_t len = 0;
-
-    Seg s;
-    s.FieldLen = 3;
-    s.Fields = calloc(3, sizeof(s.Fields[0]));
-
-    /* Position intialization. */
-
-    /* Instead of using Register_Newest(), we could also use
-     * semver_FromString(0.9.0-dev) or something similar if we want a specific
-     * version. */
-    FieldHeader xHd = { .FieldCode = field_Posn, .AlgoCode = algo_Test,
-                        .AlgoVersion = Register_Newest(reg, algo_Test),
-                        .ParticleLen = len };
-    s.Fields[0].Hd = xHd;
-    s.Fields[0].Data = x;
-    PositionAccuracy xAcc = { .Deltas = NULL, .Delta = (float) 1e-3,
-                              .Width = 64, .Len = 0 };
-    s.Fields[0].Acc = calloc(1, sizeof(xAcc));
-    *(PositionAccuracy*)s.Fields[0].Acc = xAcc;
-
-    /* Velocity */
-
-    FieldHeader vHd = { .FieldCode = field_Velc, .AlgoCode = algo_Test,
-                        .AlgoVersion = Register_Newest(reg, algo_Test),
-                        .ParticleLen = len };
-    s.Fields[0].Hd = vHd;
-    s.Fields[0].Data = v;
-    VelocityAccuracy vAcc = { .Deltas = NULL, .Delta = 1,
-                              .Len = 0, .SymLog10Threshold = false };
-    s.Fields[1].Acc = calloc(1, sizeof(vAcc));
-    *(VelocityAccuracy*)s.Fields[1].Acc = vAcc;
-
-    /* ID */
-
-    FieldHeader idHd = { .FieldCode = field_Ptid, .AlgoCode = algo_Test,
-                         .AlgoVersion = Register_Newest(reg, algo_Test),
-                         .ParticleLen = len };
-    s.Fields[2].Hd = idHd;
-    s.Fields[2].Data = id;
-    IDAccuracy idAcc = { .Width = 1024 };
-    s.Fields[2].Acc = calloc(1, sizeof(idAcc));
-    *(IDAccuracy*)s.Fields[2].Acc = idAcc;
-
-    Register_Free(reg);
-
-    return s;
-}
-
-int main() {
-    /* Load data and specify segments. */
-
-    Seg s = getSegment();
-
-    /* Compress */
-
-    Register reg = Register_New();
-
-    QSeg qs = Quantize(s);
-    Compressor *comps = LoadCompressors(s);
-    CSeg cs = Compress(qs, comps);
-    U8BigSeq bytes = ToBytes(cs);
-
-    Seg_Free(s);
-    QSeg_Free(qs);
-
-    /* Decompress */
-    
-    cs = FromBytes(bytes);
-    Decompressor *decomps = LoadDecompressors(cs);
-    qs = Decompress(cs, decomps);
-    s = UndoQuantize(qs);
-
-    CSeg_Free(cs);
-    QSeg_Free(qs);
-    Seg_Free(s);
-
-    /* Shared cleanup */
-
-    FreeCompressors(s, comps);
-    FreeDecompressors(cs, decomps);
-    Register_Free(reg);
-}
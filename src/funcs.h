@@ -1,6 +1,8 @@
 #ifndef FUNCS_H_
 #define FUNCS_H_
 
+#include <stdbool.h>
+
 #include "types.h"
 #include "seq.h"
 
@@ -15,16 +17,40 @@ void FreeCompressors(Seg s, Compressor *comps);
 QSeg Quantize(Seg s);
 Seg UndoQuantize(QSeg qs);
 
+/* BoxBlocks returns the indices of the blocks in a quantized position field
+ * whose bounds overlap box. Overlaps are periodic with the field's Width. */
+I32Seq BoxBlocks(QField qf, Box box);
+
+/* UndoQuantizeBox is identical to UndoQuantize, except that only particles in
+ * blocks that overlap box are decoded. If exact is true, the particles in
+ * those blocks which are outside of box are removed as well. qs must
+ * contain a position field. */
+Seg UndoQuantizeBox(QSeg qs, Box box, bool exact);
+
 QSeg Decompress(CSeg cs, Decompressor *decomps);
 CSeg Compress(QSeg qs, Compressor *comps);
 
 U8BigSeq ToBytes(CSeg cs);
+
+/* ToSlices returns the same bytes as ToBytes without concatenating them: the
+ * first slice holds the segment's headers and each following slice points
+ * directly at a field's Data. Only the headers are copied. cs must outlive
+ * the result, which must be freed with SegSlices_Free. */
+SegSlices ToSlices(CSeg cs);
+void SegSlices_Free(SegSlices slices);
 CSeg FromBytes(U8BigSeq bytes);
 
+/* FromBytesView is identical to FromBytes, except that the Data of each field
+ * points directly into bytes instead of being copied out of it. bytes must
+ * outlive the result, which must be freed with CSeg_FreeView. */
+CSeg FromBytesView(U8BigSeq bytes);
+
 /* Note that Seg_Free will not free your data arrays. */
 void Seg_Free(Seg s);
 void QSeg_Free(QSeg qs);
 void CSeg_Free(CSeg cs);
+/* CSeg_FreeView frees a CSeg returned by FromBytesView. */
+void CSeg_FreeView(CSeg cs);
 
 
 #endif
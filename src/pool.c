@@ -0,0 +1,259 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "pool.h"
+#include "debug.h"
+
+#define poolDEQUE_CAP 64
+
+/************************/
+/* Forward Declarations */
+/************************/
+
+void *poolWorker(void *arg);
+void initDeque(pool_Deque *d, pool_Pool *p);
+void freeDeque(pool_Deque *d);
+void pushTask(pool_Deque *d, pool_Task task);
+bool popFront(pool_Deque *d, pool_Task *task);
+bool popBack(pool_Deque *d, pool_Task *task);
+bool findTask(pool_Pool *p, pool_Deque *self, pool_Task *task);
+void runTask(pool_Pool *p, pool_Deque *self, pool_Task task);
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
+pool_Pool *pool_New(int32_t threads) {
+    DebugAssert(threads >= 0) {
+        Panic("pool_New given negative thread count, %"PRId32".", threads);
+    }
+
+    pool_Pool *p = calloc(1, sizeof(*p));
+    AssertAlloc(p);
+
+    initDeque(&p->Shared, p);
+    if (pthread_key_create(&p->Worker, NULL) != 0) {
+        Panic("Could not create a thread-specific key.%s", "");
+    }
+
+    pthread_mutex_init(&p->Lock, NULL);
+    pthread_cond_init(&p->TaskReady, NULL);
+    pthread_cond_init(&p->TaskDone, NULL);
+
+    p->ThreadLen = threads;
+    if (threads > 0) {
+        p->Threads = calloc((size_t)threads, sizeof(*p->Threads));
+        p->Local = calloc((size_t)threads, sizeof(*p->Local));
+        AssertAlloc(p->Threads);
+        AssertAlloc(p->Local);
+    }
+    for (int32_t i = 0; i < threads; i++) { initDeque(&p->Local[i], p); }
+    for (int32_t i = 0; i < threads; i++) {
+        if (pthread_create(&p->Threads[i], NULL,
+                           poolWorker, &p->Local[i]) != 0) {
+            Panic("Could not start thread %"PRId32" of %"PRId32".",
+                  i, threads);
+        }
+    }
+
+    return p;
+}
+
+void pool_Free(pool_Pool *p) {
+    pthread_mutex_lock(&p->Lock);
+    p->Stop = true;
+    pthread_cond_broadcast(&p->TaskReady);
+    pthread_mutex_unlock(&p->Lock);
+
+    for (int32_t i = 0; i < p->ThreadLen; i++) {
+        pthread_join(p->Threads[i], NULL);
+    }
+
+    for (int32_t i = 0; i < p->ThreadLen; i++) { freeDeque(&p->Local[i]); }
+    freeDeque(&p->Shared);
+    pthread_key_delete(p->Worker);
+    pthread_mutex_destroy(&p->Lock);
+    pthread_cond_destroy(&p->TaskReady);
+    pthread_cond_destroy(&p->TaskDone);
+    free(p->Threads);
+    free(p->Local);
+    free(p);
+}
+
+pool_Group pool_NewGroup(void) {
+    pool_Group g = { .Pending = 0 };
+    return g;
+}
+
+void pool_Submit(pool_Pool *p, pool_Group *g, pool_Func f, void *arg) {
+    if (p->ThreadLen == 0) {
+        f(arg);
+        return;
+    }
+
+    /* The task can't be found by anyone until it's pushed, so counting it
+     * first means Pending can never go negative. */
+    pthread_mutex_lock(&p->Lock);
+    g->Pending++;
+    pthread_mutex_unlock(&p->Lock);
+
+    pool_Deque *self = pthread_getspecific(p->Worker);
+    pool_Task task = { .Func = f, .Arg = arg, .Group = g };
+    pushTask(self == NULL ? &p->Shared : self, task);
+
+    /* Waiters also run tasks, so they're woken up too. */
+    pthread_mutex_lock(&p->Lock);
+    pthread_cond_signal(&p->TaskReady);
+    pthread_cond_broadcast(&p->TaskDone);
+    pthread_mutex_unlock(&p->Lock);
+}
+
+void pool_Wait(pool_Pool *p, pool_Group *g) {
+    if (p->ThreadLen == 0) { return; }
+
+    pool_Deque *self = pthread_getspecific(p->Worker);
+
+    while (true) {
+        pool_Task task;
+        if (findTask(p, self, &task)) {
+            runTask(p, self, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&p->Lock);
+        if (g->Pending == 0) {
+            pthread_mutex_unlock(&p->Lock);
+            return;
+        } else if (findTask(p, self, &task)) {
+            pthread_mutex_unlock(&p->Lock);
+            runTask(p, self, task);
+        } else {
+            pthread_cond_wait(&p->TaskDone, &p->Lock);
+            pthread_mutex_unlock(&p->Lock);
+        }
+    }
+}
+
+/********************/
+/* Helper Functions */
+/********************/
+
+void *poolWorker(void *arg) {
+    pool_Deque *self = arg;
+    pool_Pool *p = self->Pool;
+    pthread_setspecific(p->Worker, self);
+
+    while (true) {
+        pool_Task task;
+        if (findTask(p, self, &task)) {
+            runTask(p, self, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&p->Lock);
+        if (findTask(p, self, &task)) {
+            pthread_mutex_unlock(&p->Lock);
+            runTask(p, self, task);
+        } else if (p->Stop) {
+            pthread_mutex_unlock(&p->Lock);
+            break;
+        } else {
+            pthread_cond_wait(&p->TaskReady, &p->Lock);
+            pthread_mutex_unlock(&p->Lock);
+        }
+    }
+
+    return NULL;
+}
+
+void initDeque(pool_Deque *d, pool_Pool *p) {
+    d->Pool = p;
+    d->Cap = poolDEQUE_CAP;
+    d->Tasks = calloc((size_t)d->Cap, sizeof(*d->Tasks));
+    AssertAlloc(d->Tasks);
+    pthread_mutex_init(&d->Lock, NULL);
+}
+
+void freeDeque(pool_Deque *d) {
+    pthread_mutex_destroy(&d->Lock);
+    free(d->Tasks);
+}
+
+/* pushTask adds task to the back of d. */
+void pushTask(pool_Deque *d, pool_Task task) {
+    pthread_mutex_lock(&d->Lock);
+
+    if (d->Len == d->Cap) {
+        pool_Task *tasks = calloc(2*(size_t)d->Cap, sizeof(*tasks));
+        AssertAlloc(tasks);
+        for (int32_t i = 0; i < d->Len; i++) {
+            tasks[i] = d->Tasks[(d->Start + i) % d->Cap];
+        }
+        free(d->Tasks);
+        d->Tasks = tasks;
+        d->Start = 0;
+        d->Cap *= 2;
+    }
+
+    d->Tasks[(d->Start + d->Len) % d->Cap] = task;
+    d->Len++;
+
+    pthread_mutex_unlock(&d->Lock);
+}
+
+/* popFront removes the oldest task in d. It returns false if d is empty. */
+bool popFront(pool_Deque *d, pool_Task *task) {
+    pthread_mutex_lock(&d->Lock);
+    bool ok = d->Len > 0;
+    if (ok) {
+        *task = d->Tasks[d->Start];
+        d->Start = (d->Start + 1) % d->Cap;
+        d->Len--;
+    }
+    pthread_mutex_unlock(&d->Lock);
+    return ok;
+}
+
+/* popBack removes the newest task in d. It returns false if d is empty. */
+bool popBack(pool_Deque *d, pool_Task *task) {
+    pthread_mutex_lock(&d->Lock);
+    bool ok = d->Len > 0;
+    if (ok) {
+        d->Len--;
+        *task = d->Tasks[(d->Start + d->Len) % d->Cap];
+    }
+    pthread_mutex_unlock(&d->Lock);
+    return ok;
+}
+
+/* findTask looks for a task in the order: the back of the caller's own
+ * deque, the shared queue, and then the fronts of every other worker's deque.
+ * self is NULL if the caller isn't a worker. Before going to sleep, callers
+ * must check again while holding p->Lock so that a task submitted between
+ * finding nothing and waiting can't be missed. */
+bool findTask(pool_Pool *p, pool_Deque *self, pool_Task *task) {
+    if (self != NULL && popBack(self, task)) { return true; }
+    if (popFront(&p->Shared, task)) { return true; }
+
+    int32_t start = self == NULL ? 0 : (int32_t)(self - p->Local) + 1;
+    for (int32_t i = 0; i < p->ThreadLen; i++) {
+        pool_Deque *victim = &p->Local[(start + i) % p->ThreadLen];
+        if (victim != self && popFront(victim, task)) { return true; }
+    }
+
+    return false;
+}
+
+/* runTask must be called without holding p->Lock. self is the caller's
+ * deque, or NULL if the caller isn't a worker. */
+void runTask(pool_Pool *p, pool_Deque *self, pool_Task task) {
+    task.Func(task.Arg);
+
+    pthread_mutex_lock(&p->Lock);
+    if (self != NULL) { self->Ran++; }
+    task.Group->Pending--;
+    pthread_cond_broadcast(&p->TaskDone);
+    pthread_mutex_unlock(&p->Lock);
+}
@@ -0,0 +1,71 @@
+#ifndef MNW_POOL_H_
+#define MNW_POOL_H_
+
+/* pool.h contains a work-stealing thread pool. Tasks are submitted as part
+ * of a group, and a caller can wait until every task in a group has finished.
+ * Threads which are waiting on a group run queued tasks while they wait, so
+ * it is safe to submit and wait from inside of a task.
+ *
+ * Each worker has its own deque. Tasks submitted by a worker are pushed onto
+ * the back of its deque and it runs them newest first, while idle workers
+ * steal the oldest tasks from the front of other workers' deques. Tasks
+ * submitted from outside the pool go to a shared queue. This means that a
+ * large task can split itself into subtasks which spread out over whichever
+ * workers are idle. */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef void (*pool_Func)(void *arg);
+
+typedef struct pool_Task {
+    pool_Func Func;
+    void *Arg;
+    struct pool_Group *Group;
+} pool_Task;
+
+typedef struct pool_Group {
+    int64_t Pending;
+} pool_Group;
+
+typedef struct pool_Deque {
+    struct pool_Pool *Pool;
+    pool_Task *Tasks; /* A ring buffer. */
+    int32_t Start, Len, Cap;
+    int64_t Ran; /* Tasks run by this deque's worker. Guarded by Pool->Lock. */
+    pthread_mutex_t Lock;
+} pool_Deque;
+
+typedef struct pool_Pool {
+    pthread_t *Threads;
+    int32_t ThreadLen;
+
+    pool_Deque Shared; /* Tasks submitted from outside of the pool. */
+    pool_Deque *Local; /* One per worker. */
+    pthread_key_t Worker; /* Maps each worker thread to its deque. */
+
+    /* Lock protects Stop and the Pending count of every group. Deque locks
+     * may be taken while holding it, but not the other way around. */
+    pthread_mutex_t Lock;
+    pthread_cond_t TaskReady, TaskDone;
+    bool Stop;
+} pool_Pool;
+
+/* pool_New starts a pool with the given number of worker threads. If threads
+ * is zero, tasks are run by the threads that submit them. */
+pool_Pool *pool_New(int32_t threads);
+
+/* pool_Free waits for all queued tasks to finish and stops the pool. */
+void pool_Free(pool_Pool *p);
+
+/* pool_NewGroup returns an empty task group. */
+pool_Group pool_NewGroup(void);
+
+/* pool_Submit queues f(arg) as part of group g. */
+void pool_Submit(pool_Pool *p, pool_Group *g, pool_Func f, void *arg);
+
+/* pool_Wait returns once every task submitted to g has finished. */
+void pool_Wait(pool_Pool *p, pool_Group *g);
+
+#endif /* MNW_POOL_H_ */
@@ -1,49 +1,170 @@
 #include <inttypes.h>
 #include <math.h>
 #include <time.h>
+#include <float.h>
 
 #include "quant.h"
 #include "debug.h"
 #include "rand.h"
 #include "seq.h"
 #include "util.h"
+#include "stream.h"
 
 /************************/
 /* forward declarations */
 /************************/
 
-QField position(Field f);
-Field undoPosition(QField qf);
-QField velocity(Field f);
-Field undoVelocity(QField qf);
+/* quantAXIS_BLOCK is the number of particles which are deinterleaved at a
+ * time when reading non-SoA fields. All three components of a block fit in
+ * L1 cache. */
+#define quantAXIS_BLOCK 512
+#define quantLOG10_E 0.43429448f
+/* quantDOUBLE_DEPTH is the largest depth of a field quantized from
+ * doubles: the length of a double's mantissa. */
+#define quantDOUBLE_DEPTH 53
+/* quantTASK_BLOCKS is the number of blocks in each of the tasks that large
+ * fields are quantized in. */
+#define quantTASK_BLOCKS 4
+
+/* rangeFunc does some part of quantizing the particles from start to end,
+ * which always fall on block boundaries. */
+typedef void (*rangeFunc)(void *arg, int32_t start, int32_t end);
+
+typedef struct rangeTask {
+    rangeFunc Func;
+    void *Arg;
+    int32_t Start, End;
+} rangeTask;
+
+/* binTask and doubleBinTask hold the arguments of binRange and
+ * binDoubleRange, which bin every component of a field. */
+typedef struct binTask {
+    FSeq *X;
+    uint8_t Depth, *Depths;
+    float *X0, DX;
+    QField *QF;
+} binTask;
+
+typedef struct doubleBinTask {
+    double **X;
+    uint8_t Depth, *Depths;
+    float *X0;
+    double DX;
+    QField *QF;
+} doubleBinTask;
+
+typedef struct velocityBinTask {
+    Field F;
+    float **Planes;
+    int32_t Flag;
+    bool Fast;
+    uint8_t Depth, *Depths;
+    VelocityQuantization *Quant;
+    QField *QF;
+} velocityBinTask;
+
+typedef struct boundsTask {
+    FSeq *X;
+    double **XDouble;
+    int32_t BlockLen;
+    float Width;
+    PositionQuantization *Quant;
+} boundsTask;
+
+typedef struct localizeTask {
+    QField *QF;
+    int32_t Dims, BlockLen;
+    uint64_t *Offsets, *Spread;
+    uint8_t *Widths, *Data;
+    size_t *Starts, PlaneBytes;
+} localizeTask;
+
+void forBlocks(
+    pool_Pool *pool, int32_t len, int32_t blockLen, rangeFunc f, void *arg
+);
+void runRange(void *arg);
+void binRange(void *arg, int32_t start, int32_t end);
+void binDoubleRange(void *arg, int32_t start, int32_t end);
+void binVelocityRange(void *arg, int32_t start, int32_t end);
+void boundsRange(void *arg, int32_t start, int32_t end);
+void boundsDoubleRange(void *arg, int32_t start, int32_t end);
+void localizeRange(void *arg, int32_t start, int32_t end);
+void packRange(void *arg, int32_t start, int32_t end);
+
+QField position(Field f, uint64_t *ids, uint64_t idWidth, pool_Pool *pool);
+QField positionDouble(Field f, pool_Pool *pool);
+Field undoPosition(QField qf, bool centered, bool single);
+void undoPositionData(QField qf, void *data, bool centered, bool single);
+QField velocity(Field f, pool_Pool *pool);
+Field undoVelocity(QField qf, bool centered);
+void undoVelocityData(QField qf, float *data, bool centered);
 QField id(Field f);
 Field undoID(QField qf);
-QField ufloat(Field f);
-Field undoUfloat(QField qf);
+void undoIDData(QField qf, uint64_t *data);
+QField ufloat(Field f, pool_Pool *pool);
+QField ufloatDouble(Field f, pool_Pool *pool);
+QField ufloatLossless(Field f);
+Field undoUfloat(QField qf, bool centered, bool single);
+void undoUfloatData(QField qf, void *data, bool centered, bool single);
 QField uint(Field f);
 Field undoUint(QField qf);
+void undoUintData(QField qf, uint64_t *data);
 
 void undoLog10Float(
-    float x0, float x1,
+    bool centered, bool fast, float x0, float x1,
     uint8_t depth, uint8_t *depths,
-    uint64_t *qdata, float *buf, int32_t len
+    void *qdata, int32_t elemSize, float *buf, int32_t len
 );
 
 void undoSymLog10Float(
-    float x0, float x1, float symLogThreshold,
+    bool centered, bool fast, float x0, float x1, float symLogThreshold,
     uint8_t depth, uint8_t *depths,
-    uint64_t *qdata, float *buf, int32_t len
+    void *qdata, int32_t elemSize, float *buf, int32_t len
 );
 
 void undoFloat(
-    float x0, float x1,
+    bool centered, float x0, float x1,
     uint8_t depth, uint8_t *depths,
-    uint64_t *qdata, float *buf, int32_t len
+    void *qdata, int32_t elemSize, float *buf, int32_t len
 );
 
-void depthToDelta(
+void undoFloatState(
+    rand_State *state, float x0, float x1,
     uint8_t depth, uint8_t *depths,
-    float x0, float x1,
+    void *qdata, int32_t elemSize, float *buf, int32_t len
+);
+
+void undoPlane(
+    QField qf, int32_t dim, float x0, float x1,
+    uint8_t depth, uint8_t *depths, uint8_t shift,
+    uint64_t *offsets, uint8_t *widths, int32_t blockLen, bool centered,
+    float *out
+);
+
+uint64_t *localize(
+    QField *qf, int32_t dims, int32_t blockLen, uint8_t **widthsPtr,
+    pool_Pool *pool
+);
+
+void binIndex(
+    FSeq x, uint8_t depth, uint8_t *depths,
+    float x0, float dx, void *out, int32_t elemSize
+);
+void binAxis(
+    FSeq x, uint8_t depth, uint8_t *depths, uint8_t shift,
+    float x0, float dx, void *out, int32_t elemSize
+);
+uint8_t axisShift(
+    float delta, bool uniform, uint8_t depth, float range, float maxRange
+);
+void axisDepths(uint8_t *depths, uint8_t shift, uint8_t *out, int32_t len);
+void axisDelta(
+    VelocityQuantization quant, float *deltaPtr, float **deltasPtr,
+    int32_t len
+);
+
+void depthToDelta(
+    uint8_t depth, uint8_t *depths, double range,
     float *deltaPtr, float**deltasPtr,
     int32_t len
 );
@@ -55,24 +176,372 @@ void deltaToDepth(
     int32_t len
 );
 
-FSeq mapFloat(FSeq data, int32_t log10Scaled, float symLog10Threshold);
+int32_t exponentDepth(float delta, float range);
+int32_t slowDepth(float delta, float range);
+int32_t floatDepth(float delta, float range);
+
+FSeq mapFloat(
+    FSeq data, int32_t log10Scaled, float symLog10Threshold, bool fast
+);
 void unmapFloat(FSeq map, int32_t log10Scaled);
+float mapValue(float x, int32_t log10Scaled, float symLog10Threshold);
+float unmapValue(float x, int32_t log10Scaled, float symLog10Threshold);
+float mapErr(int32_t log10Scaled, float x0, float x1);
+bool fastMapFits(
+    float err, float delta, float *deltas, int32_t len, float range
+);
+
+void readAxis(Field f, int32_t dim, int32_t start, int32_t end, float *out);
+void readAxisDouble(Field f, int32_t dim, double *out);
+float floatBelow(double x);
+float floatAbove(double x);
+int32_t doubleDepth(double delta, double range);
+void doubleDeltaToDepth(
+    float delta, float *deltas, double range,
+    uint8_t *depthPtr, uint8_t **depthsPtr, int32_t len
+);
+void binDouble(
+    double *x, int32_t len, uint8_t depth, uint8_t *depths,
+    double x0, double dx, void *out, int32_t elemSize
+);
+void undoDouble(
+    QField qf, int32_t dim, double x0, double dx,
+    uint8_t depth, uint8_t *depths, uint64_t *offsets, uint8_t *widths,
+    int32_t blockLen, float width, bool centered, bool single, void *out
+);
+void blockBoundsDouble(
+    double **xDim, int32_t len, int32_t blockLen, float width,
+    PositionQuantization *quant, pool_Pool *pool
+);
+double maxRange(float *x0, float *x1);
+float *axisPlane(Field f, int32_t dim);
+void blockBounds(
+    FSeq *xDim, int32_t blockLen, float width, PositionQuantization *quant,
+    pool_Pool *pool
+);
+void latticeSites(
+    uint64_t *ids, int32_t start, int32_t end, uint64_t idWidth,
+    float width, float *sites[3]
+);
+uint8_t *quantDepths(QField qf);
+uint8_t quantDepth(QField qf);
+uint64_t *blockOffsets(QField qf, int32_t *blockLen);
+uint8_t *blockWidths(QField qf, int32_t *blockLen);
+size_t *blockStarts(int32_t len, int32_t blockLen, uint8_t *widths);
+size_t planeBytes(int32_t len, int32_t blockLen, uint8_t *widths);
+size_t blockBytes(int32_t n, int32_t width);
+void copyBlockIndex(QField qf, Quantization sub, I32Seq blocks);
+void writeDepths(stream_Writer *writer, uint8_t *depths, int32_t len);
+uint8_t *readDepths(stream_Reader *reader, int32_t len);
+Quantization copyQuant(QField qf, uint8_t *depths, int32_t len);
+void compact(
+    void *data, size_t elemSize, int32_t dims, int32_t len, bool *keep
+);
+
+uint8_t maxDepth(uint8_t depth, uint8_t *depths, int32_t len);
+uint8_t bitLen(uint64_t x);
+void periodicRange(
+    void *q, int32_t elemSize, int32_t len, uint64_t w,
+    uint64_t *x0Ptr, uint64_t *x1Ptr
+);
+void *plane(void *data, int32_t elemSize, int32_t len, int32_t dim);
+static inline uint64_t load(void *data, int32_t elemSize, int32_t i);
+static inline void store(void *data, int32_t elemSize, int32_t i, uint64_t x);
+
+/* divider is a precomputed unsigned division by a constant. Powers of two
+ * become a shift and everything else becomes a multiply-and-shift by a
+ * fixed-point reciprocal, following libdivide. */
+typedef struct divider {
+    uint64_t Magic;
+    int32_t Shift;
+    bool Pow2, Add;
+} divider;
+
+divider newDivider(uint64_t d);
+static inline uint64_t divide(divider div, uint64_t n);
+static inline uint64_t mulHi(uint64_t a, uint64_t b);
 
 /******************************/
 /* dynamic dispatch functions */
 /******************************/
 
+uint8_t quant_ElemSize(uint8_t bits) {
+    if (bits <= 16) { return 2; }
+    if (bits <= 32) { return 4; }
+    return 8;
+}
+
+uint8_t quant_MaxElemSize(Field f) {
+    uint8_t deepest = f.Layout.Double ? quantDOUBLE_DEPTH : 24;
+
+    switch (f.Hd.FieldCode) {
+    case field_Posn: {
+        PositionAccuracy *acc = f.Acc;
+        if (acc->Deltas != NULL) { return quant_ElemSize(deepest); }
+        /* Bounds on doubles are rounded out to floats, so their range can be
+         * slightly wider than the box. */
+        int32_t depth = f.Layout.Double ?
+            doubleDepth(acc->Delta, 2*(double)acc->Width) :
+            floatDepth(acc->Delta, acc->Width);
+        return quant_ElemSize(depth > deepest ? deepest : (uint8_t)depth);
+    }
+    case field_Velc: case field_Unsf:
+        return quant_ElemSize(deepest);
+    case field_Ptid: {
+        uint64_t w = ((IDAccuracy*)f.Acc)->Width;
+        return quant_ElemSize(w == 0 ? 64 : bitLen(w - 1));
+    }
+    case field_Unsi:
+        return 8;
+    default:
+        Panic("Unrecognized field code %"PRIx32".", f.Hd.FieldCode);
+    }
+}
+
+int32_t quant_Dims(uint32_t fieldCode) {
+    switch (fieldCode) {
+    case field_Posn: case field_Velc: return 3;
+    case field_Ptid: case field_Unsf: case field_Unsi: return 1;
+    default: Panic("Unrecognized field code %"PRIx32".", fieldCode);
+    }
+}
+
+size_t quant_RawSize(uint32_t fieldCode) {
+    switch (fieldCode) {
+    case field_Posn: case field_Velc: case field_Unsf: return sizeof(float);
+    case field_Ptid: case field_Unsi: return sizeof(uint64_t);
+    default: Panic("Unrecognized field code %"PRIx32".", fieldCode);
+    }
+}
+
+int32_t quant_QDims(uint32_t fieldCode) {
+    if (fieldCode == field_Ptid) { return 3; }
+    return quant_Dims(fieldCode);
+}
+
+bool quant_NextRun(QField qf, quant_Run *run) {
+    int32_t len = qf.Hd.ParticleLen;
+    int64_t n = (int64_t)quant_QDims(qf.Hd.FieldCode)*(int64_t)len;
+    int64_t start = run->Start + run->Len;
+    if (start >= n) { return false; }
+
+    /* Runs tile Data, so each one starts where the last one ended, after
+     * the padding of its final block. */
+    run->Data = run->Data == NULL ? qf.Data :
+        run->Data + (((size_t)run->Len*(size_t)run->ElemSize + 7) &
+                     ~(size_t)7);
+    run->Start = start;
+
+    int32_t blockLen;
+    uint8_t *widths = blockWidths(qf, &blockLen);
+    if (widths == NULL) {
+        run->Len = n - start;
+        run->ElemSize = qf.ElemSize;
+        return true;
+    }
+
+    /* The last block of one plane is followed by the first block of the
+     * next, so runs can continue across planes, but not past padding. */
+    run->ElemSize = widths[(start % len) / blockLen];
+    int64_t end = start;
+    bool padded = false;
+    while (!padded && end < n &&
+           widths[(end % len) / blockLen] == run->ElemSize) {
+        int32_t j = (int32_t)(end % len);
+        int32_t blockEnd = (j / blockLen + 1)*blockLen;
+        int32_t k = (blockEnd > len ? len : blockEnd) - j;
+        padded = ((size_t)k*(size_t)run->ElemSize) % 8 != 0;
+        end += k;
+    }
+    run->Len = end - start;
+
+    return true;
+}
+
+size_t quant_DataBytes(QField qf) {
+    int32_t len = qf.Hd.ParticleLen, blockLen;
+    size_t dims = (size_t)quant_QDims(qf.Hd.FieldCode);
+    uint8_t *widths = blockWidths(qf, &blockLen);
+    if (widths == NULL) { return dims*(size_t)len*(size_t)qf.ElemSize; }
+    return dims*planeBytes(len, blockLen, widths);
+}
+
+void quant_WriteQuant(stream_Writer *writer, QField qf) {
+    switch (qf.Hd.FieldCode) {
+    case field_Posn:
+        ;
+        PositionQuantization *pq = qf.Quant;
+        stream_Write(writer, &pq->Len, 4, 4);
+        writeDepths(writer, pq->Depths, pq->Len);
+        stream_Write(writer, &pq->Depth, 1, 1);
+        stream_Write(writer, &pq->Lagrangian, 4, 4);
+        stream_Write(writer, &pq->Double, 4, 4);
+        stream_Write(writer, &pq->Width, 4, 4);
+        stream_Write(writer, pq->X0, 3*4, 4);
+        stream_Write(writer, pq->X1, 3*4, 4);
+        stream_Write(writer, &pq->BlockLen, 4, 4);
+        stream_Write(writer, &pq->Blocks, 4, 4);
+        stream_Write(writer, pq->BlockX0, 3*4*(size_t)pq->Blocks, 4);
+        stream_Write(writer, pq->BlockX1, 3*4*(size_t)pq->Blocks, 4);
+        stream_Write(writer, pq->BlockOffsets, 3*8*(size_t)pq->Blocks, 8);
+        stream_Write(writer, pq->BlockWidths, (size_t)pq->Blocks, 1);
+        return;
+    case field_Velc:
+        ;
+        VelocityQuantization *vq = qf.Quant;
+        stream_Write(writer, &vq->Len, 4, 4);
+        writeDepths(writer, vq->Depths, vq->Len);
+        stream_Write(writer, &vq->Depth, 1, 1);
+        stream_Write(writer, vq->Shifts, 3, 1);
+        stream_Write(writer, &vq->SymLog10Scaled, 4, 4);
+        stream_Write(writer, &vq->Fast, 4, 4);
+        stream_Write(writer, &vq->SymLog10Threshold, 4, 4);
+        stream_Write(writer, vq->X0, 3*4, 4);
+        stream_Write(writer, vq->X1, 3*4, 4);
+        stream_Write(writer, &vq->BlockLen, 4, 4);
+        stream_Write(writer, &vq->Blocks, 4, 4);
+        stream_Write(writer, vq->BlockOffsets, 3*8*(size_t)vq->Blocks, 8);
+        stream_Write(writer, vq->BlockWidths, (size_t)vq->Blocks, 1);
+        return;
+    case field_Ptid:
+        ;
+        IDQuantization *iq = qf.Quant;
+        stream_Write(writer, &iq->Width, 8, 8);
+        stream_Write(writer, iq->X0, 3*8, 8);
+        stream_Write(writer, iq->X1, 3*8, 8);
+        return;
+    case field_Unsf:
+        ;
+        FloatQuantization *fq = qf.Quant;
+        stream_Write(writer, &fq->Len, 4, 4);
+        writeDepths(writer, fq->Depths, fq->Len);
+        stream_Write(writer, &fq->Depth, 1, 1);
+        stream_Write(writer, &fq->Log10Scaled, 4, 4);
+        stream_Write(writer, &fq->Double, 4, 4);
+        stream_Write(writer, &fq->Lossless, 4, 4);
+        stream_Write(writer, &fq->Fast, 4, 4);
+        stream_Write(writer, &fq->SymLog10Threshold, 4, 4);
+        stream_Write(writer, &fq->X0, 4, 4);
+        stream_Write(writer, &fq->X1, 4, 4);
+        return;
+    case field_Unsi:
+        ;
+        IntQuantization *uq = qf.Quant;
+        stream_Write(writer, &uq->X0, 8, 8);
+        stream_Write(writer, &uq->X1, 8, 8);
+        return;
+    default: Panic("Unrecognized field code %"PRIx32".", qf.Hd.FieldCode);
+    }
+}
+
+Quantization quant_ReadQuant(stream_Reader *reader, uint32_t fieldCode) {
+    switch (fieldCode) {
+    case field_Posn:
+        ;
+        PositionQuantization *pq = calloc(1, sizeof(*pq));
+        AssertAlloc(pq);
+        stream_Read(reader, &pq->Len, 4, 4);
+        pq->Depths = readDepths(reader, pq->Len);
+        stream_Read(reader, &pq->Depth, 1, 1);
+        stream_Read(reader, &pq->Lagrangian, 4, 4);
+        stream_Read(reader, &pq->Double, 4, 4);
+        stream_Read(reader, &pq->Width, 4, 4);
+        stream_Read(reader, pq->X0, 3*4, 4);
+        stream_Read(reader, pq->X1, 3*4, 4);
+        stream_Read(reader, &pq->BlockLen, 4, 4);
+        stream_Read(reader, &pq->Blocks, 4, 4);
+        if (pq->Blocks > 0) {
+            pq->BlockX0 = calloc(3*(size_t)pq->Blocks, sizeof(float));
+            pq->BlockX1 = calloc(3*(size_t)pq->Blocks, sizeof(float));
+            pq->BlockOffsets = calloc(3*(size_t)pq->Blocks, sizeof(uint64_t));
+            pq->BlockWidths = calloc((size_t)pq->Blocks, sizeof(uint8_t));
+            AssertAlloc(pq->BlockX0);
+            AssertAlloc(pq->BlockX1);
+            AssertAlloc(pq->BlockOffsets);
+            AssertAlloc(pq->BlockWidths);
+            stream_Read(reader, pq->BlockX0, 3*4*(size_t)pq->Blocks, 4);
+            stream_Read(reader, pq->BlockX1, 3*4*(size_t)pq->Blocks, 4);
+            stream_Read(reader, pq->BlockOffsets,
+                        3*8*(size_t)pq->Blocks, 8);
+            stream_Read(reader, pq->BlockWidths, (size_t)pq->Blocks, 1);
+        }
+        return pq;
+    case field_Velc:
+        ;
+        VelocityQuantization *vq = calloc(1, sizeof(*vq));
+        AssertAlloc(vq);
+        stream_Read(reader, &vq->Len, 4, 4);
+        vq->Depths = readDepths(reader, vq->Len);
+        stream_Read(reader, &vq->Depth, 1, 1);
+        stream_Read(reader, vq->Shifts, 3, 1);
+        stream_Read(reader, &vq->SymLog10Scaled, 4, 4);
+        stream_Read(reader, &vq->Fast, 4, 4);
+        stream_Read(reader, &vq->SymLog10Threshold, 4, 4);
+        stream_Read(reader, vq->X0, 3*4, 4);
+        stream_Read(reader, vq->X1, 3*4, 4);
+        stream_Read(reader, &vq->BlockLen, 4, 4);
+        stream_Read(reader, &vq->Blocks, 4, 4);
+        if (vq->Blocks > 0) {
+            vq->BlockOffsets = calloc(3*(size_t)vq->Blocks, sizeof(uint64_t));
+            vq->BlockWidths = calloc((size_t)vq->Blocks, sizeof(uint8_t));
+            AssertAlloc(vq->BlockOffsets);
+            AssertAlloc(vq->BlockWidths);
+            stream_Read(reader, vq->BlockOffsets,
+                        3*8*(size_t)vq->Blocks, 8);
+            stream_Read(reader, vq->BlockWidths, (size_t)vq->Blocks, 1);
+        }
+        return vq;
+    case field_Ptid:
+        ;
+        IDQuantization *iq = calloc(1, sizeof(*iq));
+        AssertAlloc(iq);
+        stream_Read(reader, &iq->Width, 8, 8);
+        stream_Read(reader, iq->X0, 3*8, 8);
+        stream_Read(reader, iq->X1, 3*8, 8);
+        return iq;
+    case field_Unsf:
+        ;
+        FloatQuantization *fq = calloc(1, sizeof(*fq));
+        AssertAlloc(fq);
+        stream_Read(reader, &fq->Len, 4, 4);
+        fq->Depths = readDepths(reader, fq->Len);
+        stream_Read(reader, &fq->Depth, 1, 1);
+        stream_Read(reader, &fq->Log10Scaled, 4, 4);
+        stream_Read(reader, &fq->Double, 4, 4);
+        stream_Read(reader, &fq->Lossless, 4, 4);
+        stream_Read(reader, &fq->Fast, 4, 4);
+        stream_Read(reader, &fq->SymLog10Threshold, 4, 4);
+        stream_Read(reader, &fq->X0, 4, 4);
+        stream_Read(reader, &fq->X1, 4, 4);
+        return fq;
+    case field_Unsi:
+        ;
+        IntQuantization *uq = calloc(1, sizeof(*uq));
+        AssertAlloc(uq);
+        stream_Read(reader, &uq->X0, 8, 8);
+        stream_Read(reader, &uq->X1, 8, 8);
+        return uq;
+    default: Panic("Unrecognized field code %"PRIx32".", fieldCode);
+    }
+}
+
 void quant_FreeQField(QField qf) {
     switch(qf.Hd.FieldCode) {
 
     case field_Posn:
         free(((PositionQuantization*)qf.Quant)->Depths);
+        free(((PositionQuantization*)qf.Quant)->BlockX0);
+        free(((PositionQuantization*)qf.Quant)->BlockX1);
+        free(((PositionQuantization*)qf.Quant)->BlockOffsets);
+        free(((PositionQuantization*)qf.Quant)->BlockWidths);
         free(qf.Quant);
         free(qf.Data);
         return;
 
     case field_Velc:
         free(((VelocityQuantization*)qf.Quant)->Depths);
+        free(((VelocityQuantization*)qf.Quant)->BlockOffsets);
+        free(((VelocityQuantization*)qf.Quant)->BlockWidths);
         free(qf.Quant);
         free(qf.Data);
         return;
@@ -98,6 +567,12 @@ void quant_FreeQField(QField qf) {
 }
 
 void quant_FreeField(Field f) {
+    /* Fields which failed to decompress have no data or accuracy. */
+    if (f.Acc == NULL) {
+        free(f.Data);
+        return;
+    }
+
     switch(f.Hd.FieldCode) {
 
     case field_Posn:
@@ -133,58 +608,363 @@ void quant_FreeField(Field f) {
 }
 
 QField quant_QField(Field f) {
+    return quant_QFieldPool(f, NULL);
+}
+
+QField quant_QFieldPool(Field f, pool_Pool *pool) {
     switch(f.Hd.FieldCode) {
-    case field_Posn: return position(f);
-    case field_Velc: return velocity(f);
+    case field_Posn:
+        if (((PositionAccuracy*)f.Acc)->Lagrangian) {
+            Panic("Lagrangian positions must be quantized with "
+                  "quant_LagrangianQField.%s", "");
+        }
+        if (f.Layout.Double) { return positionDouble(f, pool); }
+        return position(f, NULL, 0, pool);
+    case field_Velc:
+        if (f.Layout.Double) {
+            Panic("Velocities cannot be quantized from doubles.%s", "");
+        }
+        return velocity(f, pool);
     case field_Ptid: return id(f);
-    case field_Unsf: return ufloat(f);
+    case field_Unsf:
+        if (((FloatAccuracy*)f.Acc)->Lossless) { return ufloatLossless(f); }
+        if (f.Layout.Double) { return ufloatDouble(f, pool); }
+        return ufloat(f, pool);
     case field_Unsi: return uint(f);
     default: Panic("Unrecognized field code %"PRIx32".", f.Hd.FieldCode);
     }
 }
 
-Field quant_Field(QField qf) {
+QField quant_LagrangianQField(Field pos, Field id) {
+    return quant_LagrangianQFieldPool(pos, id, NULL);
+}
+
+QField quant_LagrangianQFieldPool(Field pos, Field id, pool_Pool *pool) {
+    if (pos.Hd.FieldCode != field_Posn || id.Hd.FieldCode != field_Ptid) {
+        Panic("quant_LagrangianQField given fields with codes %"PRIx32
+              " and %"PRIx32".", pos.Hd.FieldCode, id.Hd.FieldCode);
+    } else if (pos.Hd.ParticleLen != id.Hd.ParticleLen) {
+        Panic("Lagrangian positions have %"PRId32" particles, but their "
+              "IDs have %"PRId32".", pos.Hd.ParticleLen, id.Hd.ParticleLen);
+    } else if (pos.Layout.Double) {
+        Panic("Lagrangian positions cannot be quantized from doubles.%s", "");
+    }
+
+    return position(pos, id.Data, ((IDAccuracy*)id.Acc)->Width, pool);
+}
+
+int32_t quant_FindLagrangian(Field *fields, int32_t fieldLen, int32_t *idPtr) {
+    int32_t pos = -1, id = -1;
+    for (int32_t i = 0; i < fieldLen; i++) {
+        if (fields[i].Acc == NULL) { continue; }
+        switch (fields[i].Hd.FieldCode) {
+        case field_Posn:
+            if (((PositionAccuracy*)fields[i].Acc)->Lagrangian) { pos = i; }
+            break;
+        case field_Ptid:
+            id = i;
+            break;
+        }
+    }
+
+    if (pos >= 0 && id < 0) {
+        Panic("Lagrangian positions need an ID field in the same "
+              "segment.%s", "");
+    }
+
+    *idPtr = id;
+    return pos;
+}
+
+void quant_UndoLagrangian(Field *fields, int32_t fieldLen) {
+    /* A failed ID field looks the same as a missing one. */
+    int32_t pos = -1, id = -1;
+    for (int32_t i = 0; i < fieldLen; i++) {
+        if (fields[i].Acc == NULL) { continue; }
+        if (fields[i].Hd.FieldCode == field_Posn &&
+            ((PositionAccuracy*)fields[i].Acc)->Lagrangian) {
+            pos = i;
+        } else if (fields[i].Hd.FieldCode == field_Ptid && fields[i].Valid) {
+            id = i;
+        }
+    }
+    if (pos < 0) { return; }
+
+    Field *f = &fields[pos];
+    if (id >= 0 && fields[id].Hd.ParticleLen != f->Hd.ParticleLen) {
+        Panic("Lagrangian positions have %"PRId32" particles, but their "
+              "IDs have %"PRId32".", f->Hd.ParticleLen,
+              fields[id].Hd.ParticleLen);
+    }
+    if (id < 0) {
+        quant_FreeField(*f);
+        f->Data = NULL;
+        f->Acc = NULL;
+        f->Valid = false;
+        return;
+    }
+
+    PositionAccuracy *acc = f->Acc;
+    int32_t len = f->Hd.ParticleLen;
+    float *x = f->Data, site[3][quantAXIS_BLOCK];
+    float *sites[3] = { site[0], site[1], site[2] };
+    uint64_t idWidth = ((IDAccuracy*)fields[id].Acc)->Width;
+
+    for (int32_t start = 0; start < len; start += quantAXIS_BLOCK) {
+        int32_t end = start + quantAXIS_BLOCK > len ?
+            len : start + quantAXIS_BLOCK;
+        latticeSites(fields[id].Data, start, end, idWidth, acc->Width, sites);
+        for (int i = 0; i < 3; i++) {
+            float *xi = x + (size_t)i*(size_t)len + (size_t)start;
+            for (int32_t j = 0; j < end - start; j++) { xi[j] += site[i][j]; }
+            util_Periodic(FSeq_WrapArray(xi, end - start), acc->Width);
+        }
+    }
+}
+
+Field quant_Field(QField qf, bool centered, bool single) {
     switch(qf.Hd.FieldCode) {
-    case field_Posn: return undoPosition(qf);
-    case field_Velc: return undoVelocity(qf);
+    case field_Posn: return undoPosition(qf, centered, single);
+    case field_Velc: return undoVelocity(qf, centered);
     case field_Ptid: return undoID(qf);
-    case field_Unsf: return undoUfloat(qf);
+    case field_Unsf: return undoUfloat(qf, centered, single);
     case field_Unsi: return undoUint(qf);
     default: Panic("Unrecognized field code %"PRIx32".", qf.Hd.FieldCode);
     }
 }
 
+void quant_FieldInto(QField qf, void *out, bool centered, bool single) {
+    switch(qf.Hd.FieldCode) {
+    case field_Posn: undoPositionData(qf, out, centered, single); break;
+    case field_Velc: undoVelocityData(qf, out, centered); break;
+    case field_Ptid: undoIDData(qf, out); break;
+    case field_Unsf: undoUfloatData(qf, out, centered, single); break;
+    case field_Unsi: undoUintData(qf, out); break;
+    default: Panic("Unrecognized field code %"PRIx32".", qf.Hd.FieldCode);
+    }
+}
+
+/*******************/
+/* block functions */
+/*******************/
+
+QField quant_BlockQField(QField qf, int32_t blockLen, I32Seq blocks) {
+    int32_t len = qf.Hd.ParticleLen;
+    int32_t dims = quant_QDims(qf.Hd.FieldCode);
+
+    int32_t subLen = 0;
+    bool aligned = blocks.Len > 0;
+    for (int32_t i = 0; i < blocks.Len; i++) {
+        int32_t start = blocks.Data[i]*blockLen;
+        DebugAssert(blocks.Data[i] >= 0 && start < len) {
+            Panic("Block %"PRId32" requested from a field with only %"PRId32
+                  " particles.", blocks.Data[i], len);
+        }
+        int32_t end = start + blockLen > len ? len : start + blockLen;
+        if (end - start < blockLen && i < blocks.Len - 1) { aligned = false; }
+        subLen += end - start;
+    }
+
+    int32_t offsetBlockLen;
+    uint64_t *offsets = blockOffsets(qf, &offsetBlockLen);
+    uint8_t *widths = blockWidths(qf, &offsetBlockLen);
+    uint8_t *depths = quantDepths(qf), *subDepths = NULL;
+    aligned = aligned && offsets != NULL && offsetBlockLen == blockLen;
+
+    if (depths != NULL) {
+        subDepths = calloc((size_t)subLen + 1, sizeof(*subDepths));
+        AssertAlloc(subDepths);
+        int32_t n = 0;
+        for (int32_t i = 0; i < blocks.Len; i++) {
+            int32_t start = blocks.Data[i]*blockLen;
+            int32_t end = start + blockLen > len ? len : start + blockLen;
+            memcpy(subDepths + n, depths + start, (size_t)(end - start));
+            n += end - start;
+        }
+    }
+
+    QField sub = qf;
+    sub.Hd.ParticleLen = subLen;
+    sub.Quant = copyQuant(qf, subDepths, subLen);
+
+    /* Without a block index, planes are uniform and blocks are copied
+     * directly. */
+    if (offsets == NULL) {
+        size_t elemSize = (size_t)qf.ElemSize;
+        sub.Data = calloc((size_t)dims*(size_t)subLen + 1, elemSize);
+        AssertAlloc(sub.Data);
+        for (int32_t d = 0; d < dims; d++) {
+            uint8_t *from = plane(qf.Data, qf.ElemSize, len, d);
+            uint8_t *to = plane(sub.Data, sub.ElemSize, subLen, d);
+            for (int32_t i = 0; i < blocks.Len; i++) {
+                int32_t start = blocks.Data[i]*blockLen;
+                int32_t end = start + blockLen > len ? len : start + blockLen;
+                size_t bytes = elemSize*(size_t)(end - start);
+                memcpy(to, from + (size_t)start*elemSize, bytes);
+                to += bytes;
+            }
+        }
+        return sub;
+    }
+
+    size_t *starts = blockStarts(len, offsetBlockLen, widths);
+    size_t qfPlane = starts[(len + offsetBlockLen - 1) / offsetBlockLen];
+
+    /* If the sub-field's blocks line up with qf's, each block is copied at
+     * its own width along with its part of the block index. */
+    if (aligned) {
+        size_t subPlane = 0;
+        sub.ElemSize = 2;
+        for (int32_t i = 0; i < blocks.Len; i++) {
+            int32_t b = blocks.Data[i];
+            subPlane += starts[b + 1] - starts[b];
+            if (widths[b] > sub.ElemSize) { sub.ElemSize = widths[b]; }
+        }
+
+        sub.Data = calloc((size_t)dims*subPlane + 1, 1);
+        AssertAlloc(sub.Data);
+        uint8_t *to = sub.Data;
+        for (int32_t d = 0; d < dims; d++) {
+            uint8_t *from = (uint8_t*)qf.Data + (size_t)d*qfPlane;
+            for (int32_t i = 0; i < blocks.Len; i++) {
+                int32_t b = blocks.Data[i];
+                memcpy(to, from + starts[b], starts[b + 1] - starts[b]);
+                to += starts[b + 1] - starts[b];
+            }
+        }
+
+        copyBlockIndex(qf, sub.Quant, blocks);
+        free(starts);
+        return sub;
+    }
+
+    /* Otherwise any block offsets are added back in and the result stores
+     * bin indices directly. */
+    sub.ElemSize = quant_ElemSize(maxDepth(quantDepth(qf), depths, len));
+    sub.Data = calloc((size_t)dims*(size_t)subLen + 1, (size_t)sub.ElemSize);
+    AssertAlloc(sub.Data);
+
+    int32_t n = 0;
+    for (int32_t i = 0; i < blocks.Len; i++) {
+        int32_t start = blocks.Data[i]*blockLen;
+        int32_t end = start + blockLen > len ? len : start + blockLen;
+        for (int32_t d = 0; d < dims; d++) {
+            uint8_t *from = (uint8_t*)qf.Data + (size_t)d*qfPlane;
+            void *to = plane(sub.Data, sub.ElemSize, subLen, d);
+            for (int32_t j = start; j < end; j++) {
+                int32_t b = j / offsetBlockLen;
+                uint64_t x = load(from + starts[b], widths[b],
+                                  j - b*offsetBlockLen);
+                store(to, sub.ElemSize, n + j - start,
+                      x + offsets[dims*b + d]);
+            }
+        }
+        n += end - start;
+    }
+
+    free(starts);
+    return sub;
+}
+
+void quant_FilterField(Field *f, bool *keep) {
+    int32_t len = f->Hd.ParticleLen;
+    int32_t n = 0;
+    for (int32_t i = 0; i < len; i++) {
+        if (keep[i]) { n++; }
+    }
+    size_t floatSize = f->Layout.Double ? sizeof(double) : sizeof(float);
+
+    switch (f->Hd.FieldCode) {
+    case field_Posn:
+        compact(f->Data, floatSize, 3, len, keep);
+        if (((PositionAccuracy*)f->Acc)->Deltas != NULL) {
+            compact(((PositionAccuracy*)f->Acc)->Deltas,
+                    sizeof(float), 1, len, keep);
+            ((PositionAccuracy*)f->Acc)->Len = n;
+        }
+        break;
+    case field_Velc:
+        compact(f->Data, sizeof(float), 3, len, keep);
+        if (((VelocityAccuracy*)f->Acc)->Deltas != NULL) {
+            compact(((VelocityAccuracy*)f->Acc)->Deltas,
+                    sizeof(float), 1, len, keep);
+            ((VelocityAccuracy*)f->Acc)->Len = n;
+        }
+        break;
+    case field_Ptid:
+        compact(f->Data, sizeof(uint64_t), 1, len, keep);
+        break;
+    case field_Unsf:
+        compact(f->Data, floatSize, 1, len, keep);
+        if (((FloatAccuracy*)f->Acc)->Deltas != NULL) {
+            compact(((FloatAccuracy*)f->Acc)->Deltas,
+                    sizeof(float), 1, len, keep);
+            ((FloatAccuracy*)f->Acc)->Len = n;
+        }
+        break;
+    case field_Unsi:
+        compact(f->Data, sizeof(uint64_t), 1, len, keep);
+        break;
+    default: Panic("Unrecognized field code %"PRIx32".", f->Hd.FieldCode);
+    }
+
+    f->Hd.ParticleLen = n;
+}
+
 /**************************/
 /* quantization funcitons */
 /**************************/
 
-QField position(Field f) {
+QField position(Field f, uint64_t *ids, uint64_t idWidth, pool_Pool *pool) {
     /* Set things up. */
     QField qf;
-    memset(&qf, 0, sizeof(f));
+    memset(&qf, 0, sizeof(qf));
     memcpy(&qf.Hd, &f.Hd, sizeof(f.Hd));
 
     int32_t len = f.Hd.ParticleLen;
     PositionAccuracy *acc = f.Acc;
     PositionQuantization *quant = calloc(1, sizeof(*quant));
-    FSeq x = FSeq_WrapArray((float*)f.Data, len);
-    FSeq y = FSeq_WrapArray((float*)f.Data + len, len);
-    FSeq z = FSeq_WrapArray((float*)f.Data + 2*(size_t)len, len);
-    uint64_t *qdata = calloc((size_t)len, sizeof(*qdata));
-    U64Seq qx = U64Seq_WrapArray(qdata, len);
-    U64Seq qy = U64Seq_WrapArray(qdata + len, len);
-    U64Seq qz = U64Seq_WrapArray(qdata + 2*(size_t)len, len);
-    FSeq xDim[3] = { x, y, z };
-    U64Seq qDim[3] = { qx, qy, qz };
+    AssertAlloc(quant);
+    FSeq xDim[3];
 
     /* Quantize */
+    for (int i = 0; i < 3; i++) { xDim[i] = FSeq_New(len); }
+    for (int32_t start = 0; start < len; start += quantAXIS_BLOCK) {
+        int32_t end = start + quantAXIS_BLOCK;
+        if (end > len) { end = len; }
+        for (int i = 0; i < 3; i++) {
+            readAxis(f, i, start, end, xDim[i].Data + start);
+        }
+    }
+
+    for (int i = 0; i < 3; i++) { util_UndoPeriodic(xDim[i], acc->Width); }
+
+    /* Lagrangian fields keep a block index of their positions, but store
+     * displacements from the lattice. */
+    if (ids != NULL) {
+        blockBounds(xDim, quant_BLOCK_LEN, acc->Width, quant, pool);
+
+        float site[3][quantAXIS_BLOCK];
+        float *sites[3] = { site[0], site[1], site[2] };
+        float L = acc->Width;
+        for (int32_t start = 0; start < len; start += quantAXIS_BLOCK) {
+            int32_t end = start + quantAXIS_BLOCK > len ?
+                len : start + quantAXIS_BLOCK;
+            latticeSites(ids, start, end, idWidth, L, sites);
+            for (int i = 0; i < 3; i++) {
+                float *x = xDim[i].Data + start;
+                for (int32_t j = 0; j < end - start; j++) {
+                    float d = x[j] - site[i][j];
+                    x[j] = d - L*floorf(d / L);
+                }
+            }
+        }
+
+        for (int i = 0; i < 3; i++) { util_UndoPeriodic(xDim[i], L); }
+    }
+
     float maxDiff = 0;
     for (int i = 0; i < 3; i++) {
-        FSeq buf = FSeq_New(len);
-        memcpy(buf.Data, xDim[i].Data, sizeof(buf.Data)*(size_t)len);
-        util_UndoPeriodic(buf, acc->Width);
-        xDim[i] = buf;
-
         util_MinMax(xDim[i], &quant->X0[i], &quant->X1[i]);
         if (maxDiff < quant->X1[i] - quant->X0[i]) {
             maxDiff = quant->X1[i] - quant->X0[i];
@@ -195,164 +975,314 @@ QField position(Field f) {
     deltaToDepth(acc->Delta, acc->Deltas, quant->X0[0],
                  quant->X0[0] + maxDiff, &depth, &depths, len);
 
-    for (int i = 0; i < 3; i++) {
-        if (depths == NULL) {
-            qDim[i] = util_UniformBinIndex(
-                xDim[i], depth, quant->X0[i], maxDiff, qDim[i]
-            );
-        } else {
-            U8Seq depthsSeq = U8Seq_WrapArray(depths, len);
-            qDim[i] = util_BinIndex(
-                xDim[i], depthsSeq, quant->X0[i], maxDiff, qDim[i]
-            );
-        }
+    qf.ElemSize = quant_ElemSize(maxDepth(depth, depths, len));
+    qf.Data = calloc(3*(size_t)len, (size_t)qf.ElemSize);
+    AssertAlloc(qf.Data);
+
+    binTask bins = {
+        .X = xDim, .Depth = depth, .Depths = depths,
+        .X0 = quant->X0, .DX = maxDiff, .QF = &qf
+    };
+    forBlocks(pool, len, quant_BLOCK_LEN, binRange, &bins);
+
+    if (ids == NULL) {
+        blockBounds(xDim, quant_BLOCK_LEN, acc->Width, quant, pool);
     }
+    quant->BlockOffsets = localize(
+        &qf, 3, quant_BLOCK_LEN, &quant->BlockWidths, pool
+    );
 
     /* Initialize  */
     quant->Depths = depths;
     quant->Depth = depth;
     quant->Len = acc->Len;
     quant->Width = acc->Width;
+    quant->Lagrangian = ids != NULL;
 
     /* Clean up */
     for (int i = 0; i < 3; i++) {
         FSeq_Free(xDim[i]);
     }
 
-    qf.Data = qdata;
+    qf.Quant = quant;
+    return qf;
+}
+
+/* positionDouble is position for non-Lagrangian fields that hold
+ * doubles. */
+QField positionDouble(Field f, pool_Pool *pool) {
+    /* Set things up. */
+    QField qf;
+    memset(&qf, 0, sizeof(qf));
+    memcpy(&qf.Hd, &f.Hd, sizeof(f.Hd));
+
+    int32_t len = f.Hd.ParticleLen;
+    PositionAccuracy *acc = f.Acc;
+    PositionQuantization *quant = calloc(1, sizeof(*quant));
+    AssertAlloc(quant);
+
+    /* Quantize */
+    double *xDim[3];
+    for (int i = 0; i < 3; i++) {
+        xDim[i] = calloc((size_t)len + 1, sizeof(*xDim[i]));
+        AssertAlloc(xDim[i]);
+        readAxisDouble(f, i, xDim[i]);
+
+        DSeq x = DSeq_WrapArray(xDim[i], len);
+        util_DUndoPeriodic(x, acc->Width);
+        double x0, x1;
+        util_DMinMax(x, &x0, &x1);
+        quant->X0[i] = floatBelow(x0);
+        quant->X1[i] = floatAbove(x1);
+    }
+    double maxDiff = maxRange(quant->X0, quant->X1);
+
+    uint8_t depth, *depths;
+    doubleDeltaToDepth(acc->Delta, acc->Deltas, maxDiff, &depth, &depths, len);
+
+    qf.ElemSize = quant_ElemSize(maxDepth(depth, depths, len));
+    qf.Data = calloc(3*(size_t)len, (size_t)qf.ElemSize);
+    AssertAlloc(qf.Data);
+
+    doubleBinTask bins = {
+        .X = xDim, .Depth = depth, .Depths = depths,
+        .X0 = quant->X0, .DX = maxDiff, .QF = &qf
+    };
+    forBlocks(pool, len, quant_BLOCK_LEN, binDoubleRange, &bins);
+
+    blockBoundsDouble(xDim, len, quant_BLOCK_LEN, acc->Width, quant, pool);
+    quant->BlockOffsets = localize(
+        &qf, 3, quant_BLOCK_LEN, &quant->BlockWidths, pool
+    );
+
+    /* Initialize  */
+    quant->Depths = depths;
+    quant->Depth = depth;
+    quant->Len = acc->Len;
+    quant->Width = acc->Width;
+    quant->Double = 1;
+
+    /* Clean up */
+    for (int i = 0; i < 3; i++) { free(xDim[i]); }
+
+    qf.Quant = quant;
     return qf;
 }
 
-QField velocity(Field f) {
+QField velocity(Field f, pool_Pool *pool) {
     /* Set things up. */
     QField qf;
-    memset(&qf, 0, sizeof(f));
+    memset(&qf, 0, sizeof(qf));
     memcpy(&qf.Hd, &f.Hd, sizeof(f.Hd));
 
     int32_t len = f.Hd.ParticleLen;
     VelocityAccuracy *acc = f.Acc;
     VelocityQuantization *quant = calloc(1, sizeof(*quant));
-    FSeq vx = FSeq_WrapArray((float*)f.Data, len);
-    FSeq vy = FSeq_WrapArray((float*)f.Data + len, len);
-    FSeq vz = FSeq_WrapArray((float*)f.Data + 2*(size_t)len, len);
-    uint64_t *qdata = calloc((size_t)len, sizeof(*qdata));
-    U64Seq qx = U64Seq_WrapArray(qdata, len);
-    U64Seq qy = U64Seq_WrapArray(qdata + len, len);
-    U64Seq qz = U64Seq_WrapArray(qdata + 2*(size_t)len, len);
-    FSeq vDim[3] = { vx, vy, vz };
-    U64Seq qDim[3] = { qx, qy, qz };
+    AssertAlloc(quant);
+
+    /* Interleaved velocities are deinterleaved a block at a time in both
+     * passes below instead of being copied into full-size planes. */
+    float *planes[3], buf[3][quantAXIS_BLOCK];
+    bool contiguous = true;
+    for (int i = 0; i < 3; i++) {
+        planes[i] = axisPlane(f, i);
+        contiguous = contiguous && planes[i] != NULL;
+    }
+    int32_t blockLen = contiguous ? len : quantAXIS_BLOCK;
 
     /* Quantize */
-    float maxDiff = 0;
     int32_t flag = 0;
     if (acc->SymLog10Scaled) { flag = 2; }
     for (int i = 0; i < 3; i++) {
-        vDim[i] = mapFloat(vDim[i], flag, acc->SymLog10Threshold);
+        quant->X0[i] = INFINITY;
+        quant->X1[i] = -INFINITY;
+    }
+    for (int32_t start = 0; start < len; start += blockLen) {
+        int32_t end = start + blockLen > len ? len : start + blockLen;
+        for (int i = 0; i < 3; i++) {
+            float *x = planes[i] + start;
+            if (!contiguous) {
+                readAxis(f, i, start, end, buf[i]);
+                x = buf[i];
+            }
+
+            float x0, x1;
+            util_MinMax(FSeq_WrapArray(x, end - start), &x0, &x1);
+            if (x0 < quant->X0[i]) { quant->X0[i] = x0; }
+            if (x1 > quant->X1[i]) { quant->X1[i] = x1; }
+        }
+    }
 
-        util_MinMax(vDim[i], &quant->X0[i], &quant->X1[i]);
+    float maxDiff = 0, err = 0;
+    for (int i = 0; i < 3; i++) {
+        quant->X0[i] = mapValue(quant->X0[i], flag, acc->SymLog10Threshold);
+        quant->X1[i] = mapValue(quant->X1[i], flag, acc->SymLog10Threshold);
+        float axisErr = mapErr(flag, quant->X0[i], quant->X1[i]);
+        if (axisErr > err) { err = axisErr; }
         if (maxDiff < quant->X1[i] - quant->X0[i]) {
             maxDiff = quant->X1[i] - quant->X0[i];
         }
     }
 
-    uint8_t depth, *depths;
-    deltaToDepth(acc->Delta, acc->Deltas, quant->X0[0],
-                 quant->X0[0] + maxDiff, &depth, &depths, len);
+    bool fast = flag != 0 &&
+        fastMapFits(err, acc->Delta, acc->Deltas, len, maxDiff);
+    if (fast) {
+        for (int i = 0; i < 3; i++) {
+            quant->X0[i] -= err;
+            quant->X1[i] += err;
+        }
+    }
+
+    /* Depths are found for the widest component and every other component
+     * gets fewer bits over its own range. */
+    int widest = 0;
+    for (int i = 1; i < 3; i++) {
+        if (quant->X1[i] - quant->X0[i] >
+            quant->X1[widest] - quant->X0[widest]) { widest = i; }
+    }
+    maxDiff = quant->X1[widest] - quant->X0[widest];
 
+    uint8_t depth, *depths;
+    deltaToDepth(acc->Delta, acc->Deltas, quant->X0[widest],
+                 quant->X1[widest], &depth, &depths, len);
     for (int i = 0; i < 3; i++) {
-        if (depths == NULL) {
-            qDim[i] = util_UniformBinIndex(
-                vDim[i], depth, quant->X0[i], maxDiff, qDim[i]
-            );
-        } else {
-            U8Seq depthsSeq = U8Seq_WrapArray(depths, len);
-            qDim[i] = util_BinIndex(
-                vDim[i], depthsSeq, quant->X0[i], maxDiff, qDim[i]
-            );
-        }
+        quant->Shifts[i] = axisShift(
+            fast ? acc->Delta - err : acc->Delta, depths == NULL,
+            depth, quant->X1[i] - quant->X0[i], maxDiff
+        );
     }
 
+    qf.ElemSize = quant_ElemSize(maxDepth(depth, depths, len));
+    qf.Data = calloc(3*(size_t)len, (size_t)qf.ElemSize);
+    AssertAlloc(qf.Data);
+
+    velocityBinTask bins = {
+        .F = f, .Planes = contiguous ? planes : NULL, .Flag = flag,
+        .Fast = fast, .Depth = depth, .Depths = depths, .Quant = quant,
+        .QF = &qf
+    };
+    forBlocks(pool, len, quant_BLOCK_LEN, binVelocityRange, &bins);
+
     /* Initialize  */
     quant->Depths = depths;
     quant->Depth = depth;
     quant->Len = acc->Len;
     quant->SymLog10Threshold = acc->SymLog10Threshold;
     quant->SymLog10Scaled = acc->SymLog10Scaled;
+    quant->Fast = fast;
+    quant->BlockLen = quant_BLOCK_LEN;
+    quant->Blocks = (len + quant_BLOCK_LEN - 1) / quant_BLOCK_LEN;
+    quant->BlockOffsets = localize(
+        &qf, 3, quant_BLOCK_LEN, &quant->BlockWidths, pool
+    );
 
-    /* Clean up */
-    for (int i = 0; i < 3; i++) {
-        unmapFloat(vDim[i], flag);
-    }
-
-    qf.Data = qdata;
+    qf.Quant = quant;
     return qf;
 }
 
 QField id(Field f) {
     /* Set things up. */
     QField qf;
-    memset(&qf, 0, sizeof(f));
+    memset(&qf, 0, sizeof(qf));
     memcpy(&qf.Hd, &f.Hd, sizeof(f.Hd));
 
     int32_t len = f.Hd.ParticleLen;
     IDAccuracy *acc = f.Acc;
     IDQuantization *quant = calloc(1, sizeof(*quant));
+    AssertAlloc(quant);
     uint64_t *data = f.Data;
-    uint64_t *qdata = calloc(3 * (size_t) len, sizeof(*qdata));
-    U64Seq qx = U64Seq_WrapArray(qdata, len);
-    U64Seq qy = U64Seq_WrapArray(qdata + len, len);
-    U64Seq qz = U64Seq_WrapArray(qdata + 2*(size_t)len, len);
-    U64Seq qDim[3] = { qx, qy, qz };
+    uint64_t w = acc->Width;
+    if (w == 0 || w > UINT32_MAX) {
+        Panic("ID width set to %"PRIu64", but it must be in [1, 2^32).", w);
+    }
+
+    /* Every component is smaller than Width, both before and after the
+     * periodic shift below, so Width alone sets the element size. */
+    qf.ElemSize = quant_ElemSize(bitLen(w - 1));
+    qf.Data = calloc(3*(size_t)len, (size_t)qf.ElemSize);
+    AssertAlloc(qf.Data);
+    void *qx = plane(qf.Data, qf.ElemSize, len, 0);
+    void *qy = plane(qf.Data, qf.ElemSize, len, 1);
+    void *qz = plane(qf.Data, qf.ElemSize, len, 2);
 
     /* Quantize */
-    for (int32_t i = 0; i < len; i++) {
-        qx.Data[i] = data[i] % acc->Width;
-        qy.Data[i] = (data[i] / acc->Width) % acc->Width;
-        qz.Data[i] = data[i] / (acc->Width * acc->Width);
+    divider dw = newDivider(w), dw2 = newDivider(w * w);
+    if (dw.Pow2) {
+        uint64_t mask = w - 1;
+        int32_t shift = dw.Shift;
+        for (int32_t i = 0; i < len; i++) {
+            store(qx, qf.ElemSize, i, data[i] & mask);
+            store(qy, qf.ElemSize, i, (data[i] >> shift) & mask);
+            store(qz, qf.ElemSize, i, data[i] >> 2*shift);
+        }
+    } else {
+        for (int32_t i = 0; i < len; i++) {
+            uint64_t z = divide(dw2, data[i]);
+            uint64_t r = data[i] - z*(w * w);
+            uint64_t y = divide(dw, r);
+            store(qx, qf.ElemSize, i, r - y*w);
+            store(qy, qf.ElemSize, i, y);
+            store(qz, qf.ElemSize, i, z);
+        }
     }
 
     for (int j = 0; j < 3; j++) {
-        util_U64UndoPeriodic(qDim[j], acc->Width);
-        util_U64MinMax(qDim[j], &quant->X0[j], &quant->X1[j]);
+        void *q = plane(qf.Data, qf.ElemSize, len, j);
+        periodicRange(q, qf.ElemSize, len, w, &quant->X0[j], &quant->X1[j]);
         for (int32_t i = 0; i < len; i++) {
-            qDim[j].Data[i] -= quant->X0[j];
+            uint64_t x = load(q, qf.ElemSize, i);
+            store(q, qf.ElemSize, i,
+                  x >= quant->X0[j] ? x - quant->X0[j] : x + w - quant->X0[j]);
         }
     }
 
     /* Initialize  */
     quant->Width = acc->Width;
 
-    qf.Data = qdata;
+    qf.Quant = quant;
     return qf;
 }
 
-QField ufloat(Field f) {
+QField ufloat(Field f, pool_Pool *pool) {
     /* Set things up. */
     QField qf;
-    memset(&qf, 0, sizeof(f));
+    memset(&qf, 0, sizeof(qf));
     memcpy(&qf.Hd, &f.Hd, sizeof(f.Hd));
 
     int32_t len = f.Hd.ParticleLen;
     FloatAccuracy *acc = f.Acc;
     FloatQuantization *quant = calloc(1, sizeof(*quant));
+    AssertAlloc(quant);
     FSeq data = FSeq_WrapArray(f.Data, len);
-    U64Seq qdata = U64Seq_New(len);
-
-    data = mapFloat(data, acc->Log10Scaled, acc->SymLog10Threshold);
 
-    /* Quantize */
+    /* The maps are monotonic, so the mapped range comes from the raw one. */
     float x0, x1;
     util_MinMax(data, &x0, &x1);
+    x0 = mapValue(x0, acc->Log10Scaled, acc->SymLog10Threshold);
+    x1 = mapValue(x1, acc->Log10Scaled, acc->SymLog10Threshold);
+
+    float err = mapErr(acc->Log10Scaled, x0, x1);
+    bool fast = acc->Log10Scaled != 0 &&
+        fastMapFits(err, acc->Delta, acc->Deltas, len, x1 - x0);
+    if (fast) {
+        x0 -= err;
+        x1 += err;
+    }
 
+    data = mapFloat(data, acc->Log10Scaled, acc->SymLog10Threshold, fast);
+
+    /* Quantize */
     uint8_t depth, *depths;
     deltaToDepth(acc->Delta, acc->Deltas, x0, x1, &depth, &depths, len);
 
-    if (depths == NULL) {
-        qdata = util_UniformBinIndex(data, depth, x0, x1 - x0, qdata);
-    } else {
-        U8Seq depthsSeq = U8Seq_WrapArray(depths, len);
-        qdata = util_BinIndex(data, depthsSeq, x0, x1 - x0, qdata);
-    }
+    qf.ElemSize = quant_ElemSize(maxDepth(depth, depths, len));
+    qf.Data = calloc((size_t)len, (size_t)qf.ElemSize);
+    AssertAlloc(qf.Data);
+    binTask bins = {
+        .X = &data, .Depth = depth, .Depths = depths,
+        .X0 = &x0, .DX = x1 - x0, .QF = &qf
+    };
+    forBlocks(pool, len, quant_BLOCK_LEN, binRange, &bins);
 
     /* Initialize  */
     quant->X0 = x0;
@@ -362,38 +1292,116 @@ QField ufloat(Field f) {
     quant->Len = acc->Len;
     quant->SymLog10Threshold = acc->SymLog10Threshold;
     quant->Log10Scaled = acc->Log10Scaled;
+    quant->Fast = fast;
 
     /* Clean up */
     unmapFloat(data, acc->Log10Scaled);
 
-    qf.Data = qdata.Data;
+    qf.Quant = quant;
+    return qf;
+}
+
+/* ufloatDouble is ufloat for fields that hold doubles. */
+QField ufloatDouble(Field f, pool_Pool *pool) {
+    /* Set things up. */
+    QField qf;
+    memset(&qf, 0, sizeof(qf));
+    memcpy(&qf.Hd, &f.Hd, sizeof(f.Hd));
+
+    int32_t len = f.Hd.ParticleLen;
+    FloatAccuracy *acc = f.Acc;
+    if (acc->Log10Scaled != 0) {
+        Panic("Log scaled fields cannot be quantized from doubles.%s", "");
+    }
+    FloatQuantization *quant = calloc(1, sizeof(*quant));
+    AssertAlloc(quant);
+    double *data = f.Data;
+
+    /* Quantize */
+    double x0, x1;
+    util_DMinMax(DSeq_WrapArray(data, len), &x0, &x1);
+    quant->X0 = floatBelow(x0);
+    quant->X1 = floatAbove(x1);
+    double range = (double)quant->X1 - (double)quant->X0;
+
+    uint8_t depth, *depths;
+    doubleDeltaToDepth(acc->Delta, acc->Deltas, range, &depth, &depths, len);
+
+    qf.ElemSize = quant_ElemSize(maxDepth(depth, depths, len));
+    qf.Data = calloc((size_t)len, (size_t)qf.ElemSize);
+    AssertAlloc(qf.Data);
+    doubleBinTask bins = {
+        .X = &data, .Depth = depth, .Depths = depths,
+        .X0 = &quant->X0, .DX = range, .QF = &qf
+    };
+    forBlocks(pool, len, quant_BLOCK_LEN, binDoubleRange, &bins);
+
+    /* Initialize  */
+    quant->Depths = depths;
+    quant->Depth = depth;
+    quant->Len = acc->Len;
+    quant->SymLog10Threshold = acc->SymLog10Threshold;
+    quant->Double = 1;
+
+    qf.Quant = quant;
+    return qf;
+}
+
+/* ufloatLossless stores the bits of f as integers, unchanged. */
+QField ufloatLossless(Field f) {
+    /* Set things up. */
+    QField qf;
+    memset(&qf, 0, sizeof(qf));
+    memcpy(&qf.Hd, &f.Hd, sizeof(f.Hd));
+
+    int32_t len = f.Hd.ParticleLen;
+    FloatQuantization *quant = calloc(1, sizeof(*quant));
+    AssertAlloc(quant);
+
+    /* Quantize */
+    qf.ElemSize = f.Layout.Double ? 8 : 4;
+    qf.Data = malloc((size_t)len*(size_t)qf.ElemSize + 1);
+    AssertAlloc(qf.Data);
+    memcpy(qf.Data, f.Data, (size_t)len*(size_t)qf.ElemSize);
+
+    /* Initialize  */
+    quant->Depth = (uint8_t)(8*qf.ElemSize);
+    quant->Double = f.Layout.Double;
+    quant->Lossless = 1;
+
+    qf.Quant = quant;
     return qf;
 }
 
 QField uint(Field f) {    
     /* Set things up. */
     QField qf;
-    memset(&qf, 0, sizeof(f));
+    memset(&qf, 0, sizeof(qf));
     memcpy(&qf.Hd, &f.Hd, sizeof(f.Hd));
 
     int32_t len = f.Hd.ParticleLen;
     IntAccuracy *acc = f.Acc;
     IntQuantization *quant = calloc(1, sizeof(*quant));
+    AssertAlloc(quant);
     uint64_t *data = f.Data;
-    uint64_t *qdata = calloc((size_t) len, sizeof(*qdata));
 
     /* Quantize */
     uint64_t x0, x1;
     util_U64MinMax(U64Seq_WrapArray(data, len), &x0, &x1);
-    memcpy(qdata, data, sizeof(*data) * (size_t)len);
-    for (int32_t i = 0; i < len; i++) { qdata[i] -= x0; }
+
+    qf.ElemSize = quant_ElemSize(bitLen(x1 - x0));
+    qf.Data = calloc((size_t)len, (size_t)qf.ElemSize);
+    AssertAlloc(qf.Data);
+    for (int32_t i = 0; i < len; i++) {
+        store(qf.Data, qf.ElemSize, i, data[i] - x0);
+    }
 
     /* Initialize  */
     (void) acc;
     quant->X0 = x0;
     quant->X1 = x1;
 
-    qf.Data = qdata;
+    qf.Quant = quant;
     return qf;
 }
 
@@ -402,7 +1410,7 @@ QField uint(Field f) {
 /* dequantization functions */
 /****************************/
 
-Field undoUfloat(QField qf) {
+Field undoUfloat(QField qf, bool centered, bool single) {
     /* Set things up. */
     Field f;
     memset(&f, 0, sizeof(f));
@@ -411,36 +1419,27 @@ Field undoUfloat(QField qf) {
     int32_t len = f.Hd.ParticleLen;
     FloatAccuracy *acc = calloc(1, sizeof(*acc));
     FloatQuantization quant = *(FloatQuantization*)qf.Quant;
-    uint64_t *qdata = (uint64_t*)qf.Data;
-    float *data = calloc((size_t) len, sizeof(*data));
+    f.Layout.Double = quant.Double && !single;
+    size_t size = f.Layout.Double ? sizeof(double) : sizeof(float);
+    void *data = calloc((size_t) len, size);
     
     /* Dequantize data. */
-    if (quant.Log10Scaled == 1) {
-        undoLog10Float(
-            quant.X0, quant.X1, quant.Depth,
-            quant.Depths, qdata, data, len
-        );
-    } else if (quant.Log10Scaled == 2) {
-        undoSymLog10Float(
-            quant.X0, quant.X1, quant.SymLog10Threshold,
-            quant.Depth, quant.Depths, qdata, data, len
-        );
-    } else {
-        undoFloat(
-            quant.X0, quant.X1, quant.Depth, quant.Depths,
-            qdata, data, f.Hd.ParticleLen
-        );
-    }
-
+    undoUfloatData(qf, data, centered, single);
     f.Data = data;
 
     /* Set Acc. */
     acc->SymLog10Threshold = quant.SymLog10Threshold;
     acc->Len = quant.Len;
     acc->Log10Scaled = quant.Log10Scaled;
+    acc->Lossless = quant.Lossless;
+    if (quant.Lossless) {
+        f.Acc = acc;
+        return f;
+    }
+    double range = quant.Double ?
+        (double)quant.X1 - (double)quant.X0 : quant.X1 - quant.X0;
     depthToDelta(
-        quant.Depth, quant.Depths, quant.X0,
-        quant.X1, &acc->Delta, &acc->Deltas, len
+        quant.Depth, quant.Depths, range, &acc->Delta, &acc->Deltas, len
     );
 
     f.Acc = acc;
@@ -448,7 +1447,41 @@ Field undoUfloat(QField qf) {
     return f;
 }
 
-Field undoPosition(QField qf) {
+void undoUfloatData(QField qf, void *data, bool centered, bool single) {
+    int32_t len = qf.Hd.ParticleLen;
+    FloatQuantization quant = *(FloatQuantization*)qf.Quant;
+
+    if (quant.Lossless && quant.Double && single) {
+        double *x = qf.Data;
+        float *out = data;
+        for (int32_t i = 0; i < len; i++) { out[i] = (float)x[i]; }
+    } else if (quant.Lossless) {
+        memcpy(data, qf.Data, (size_t)len*(size_t)qf.ElemSize);
+    } else if (quant.Double) {
+        undoDouble(
+            qf, 0, quant.X0, (double)quant.X1 - (double)quant.X0,
+            quant.Depth, quant.Depths, NULL, NULL, 0, 0, centered, single, data
+        );
+    } else if (quant.Log10Scaled == 1) {
+        undoLog10Float(
+            centered, quant.Fast, quant.X0, quant.X1, quant.Depth,
+            quant.Depths, qf.Data, qf.ElemSize, data, len
+        );
+    } else if (quant.Log10Scaled == 2) {
+        undoSymLog10Float(
+            centered, quant.Fast, quant.X0, quant.X1,
+            quant.SymLog10Threshold, quant.Depth, quant.Depths,
+            qf.Data, qf.ElemSize, data, len
+        );
+    } else {
+        undoFloat(
+            centered, quant.X0, quant.X1, quant.Depth, quant.Depths,
+            qf.Data, qf.ElemSize, data, len
+        );
+    }
+}
+
+Field undoPosition(QField qf, bool centered, bool single) {
     /* Set things up. */
     Field f;
     memset(&f, 0, sizeof(f));
@@ -457,10 +1490,47 @@ Field undoPosition(QField qf) {
     int32_t len = f.Hd.ParticleLen;
     PositionAccuracy *acc = calloc(1, sizeof(*acc));
     PositionQuantization quant = *(PositionQuantization*)qf.Quant;
-    uint64_t *qdata = (uint64_t*)qf.Data;
-    float *data = calloc(3*(size_t)len, sizeof(*data));
+    f.Layout.Double = quant.Double && !single;
+    size_t size = f.Layout.Double ? sizeof(double) : sizeof(float);
+    void *data = calloc(3*(size_t)len, size);
     
     /* Dequantize data. */
+    undoPositionData(qf, data, centered, single);
+    f.Data = data;
+
+    /* Set Acc. */
+    acc->Len = quant.Len;
+    acc->Width = quant.Width;
+    acc->Lagrangian = quant.Lagrangian;
+    double range = quant.X1[0] - quant.X0[0];
+    if (quant.Double) { range = maxRange(quant.X0, quant.X1); }
+    depthToDelta(
+        quant.Depth, quant.Depths, range, &acc->Delta, &acc->Deltas, len
+    );
+    f.Acc = acc;
+
+    return f;
+}
+
+void undoPositionData(QField qf, void *out, bool centered, bool single) {
+    int32_t len = qf.Hd.ParticleLen;
+    PositionQuantization quant = *(PositionQuantization*)qf.Quant;
+
+    if (quant.Double) {
+        double maxDiff = maxRange(quant.X0, quant.X1);
+        size_t size = single ? sizeof(float) : sizeof(double);
+        for (int i = 0; i < 3; i++) {
+            undoDouble(
+                qf, i, quant.X0[i], maxDiff, quant.Depth, quant.Depths,
+                quant.BlockOffsets, quant.BlockWidths, quant.BlockLen,
+                quant.Width, centered, single,
+                (uint8_t*)out + (size_t)i*(size_t)len*size
+            );
+        }
+        return;
+    }
+
+    float *data = out;
     float *xData = data;
     float *yData = data + len;
     float *zData = data + 2 * (size_t) len;
@@ -474,29 +1544,17 @@ Field undoPosition(QField qf) {
     }
 
     for (int i = 0; i < 3; i++) {
-        undoFloat(
-            quant.X0[i], quant.X1[i], quant.Depth,
-            quant.Depths, qdata, dimData[i], len
+        undoPlane(
+            qf, i, quant.X0[i], quant.X0[i] + maxDiff, quant.Depth,
+            quant.Depths, 0, quant.BlockOffsets, quant.BlockWidths,
+            quant.BlockLen, centered, dimData[i]
         );
         FSeq dataSeq = FSeq_WrapArray(dimData[i], len);
         util_Periodic(dataSeq, quant.Width);
     }
-
-    f.Data = data;
-
-    /* Set Acc. */
-    acc->Len = quant.Len;
-    acc->Width = quant.Width;
-    depthToDelta(
-        quant.Depth, quant.Depths, quant.X0[0],
-        quant.X1[0], &acc->Delta, &acc->Deltas, len
-    );
-    f.Acc = acc;
-
-    return f;
 }
 
-Field undoVelocity(QField qf) {
+Field undoVelocity(QField qf, bool centered) {
     /* Set things up. */
     Field f;
     memset(&f, 0, sizeof(f));
@@ -505,51 +1563,50 @@ Field undoVelocity(QField qf) {
     int32_t len = f.Hd.ParticleLen;
     VelocityAccuracy *acc = calloc(1, sizeof(*acc));
     VelocityQuantization quant = *(VelocityQuantization*)qf.Quant;
-    uint64_t *qdata = (uint64_t*)qf.Data;
     float *data = calloc(3 * (size_t)len, sizeof(*data));
     
     /* Dequantize data. */
-    float *xData = data;
-    float *yData = data + len;
-    float *zData = data + 2*(size_t)len;
-    float *dimData[3] = {xData, yData, zData}; 
-
-    float maxDiff = 0;
-    for (int i = 0; i < 3; i++) {
-        if (quant.X1[i] - quant.X0[i] > maxDiff) {
-            maxDiff = quant.X1[i] - quant.X0[i];
-        }
-    }
-
-    for (int i = 0; i < 3; i++) {
-        if (quant.SymLog10Scaled) {
-            undoSymLog10Float(
-                quant.X0[i], quant.X0[i] + maxDiff, quant.SymLog10Threshold,
-                quant.Depth, quant.Depths, qdata, dimData[i], len
-            );
-        } else {
-            undoFloat(
-                quant.X0[i], quant.X0[i] + maxDiff, quant.Depth,
-                quant.Depths, qdata, dimData[i], len
-            );
-        }
-    }
-
+    undoVelocityData(qf, data, centered);
     f.Data = data;
 
     /* Set Acc. */
     acc->SymLog10Threshold = quant.SymLog10Threshold;
     acc->Len = quant.Len;
     acc->SymLog10Scaled = quant.SymLog10Scaled;
-    depthToDelta(
-        quant.Depth, quant.Depths, quant.X0[0],
-        quant.X1[0], &acc->Delta, &acc->Deltas, len
-    );
+    axisDelta(quant, &acc->Delta, &acc->Deltas, len);
     f.Acc = acc;
 
     return f;
 }
 
+void undoVelocityData(QField qf, float *data, bool centered) {
+    int32_t len = qf.Hd.ParticleLen;
+    VelocityQuantization quant = *(VelocityQuantization*)qf.Quant;
+
+    float *xData = data;
+    float *yData = data + len;
+    float *zData = data + 2*(size_t)len;
+    float *dimData[3] = {xData, yData, zData}; 
+
+    for (int i = 0; i < 3; i++) {
+        undoPlane(
+            qf, i, quant.X0[i], quant.X1[i], quant.Depth, quant.Depths,
+            quant.Shifts[i], quant.BlockOffsets, quant.BlockWidths,
+            quant.BlockLen, centered, dimData[i]
+        );
+        if (quant.SymLog10Scaled && quant.Fast) {
+            FSeq v = FSeq_WrapArray(dimData[i], len);
+            util_UndoSymLog10(v, quant.SymLog10Threshold, v);
+        } else if (quant.SymLog10Scaled) {
+            for (int32_t j = 0; j < len; j++) {
+                dimData[i][j] = unmapValue(
+                    dimData[i][j], 2, quant.SymLog10Threshold
+                );
+            }
+        }
+    }
+}
+
 Field undoID(QField qf) {
     /* Set things up. */
     Field f;
@@ -560,23 +1617,9 @@ Field undoID(QField qf) {
     IDQuantization quant = *(IDQuantization*)qf.Quant;
     IDAccuracy *acc = calloc(1, sizeof(IDAccuracy));
     uint64_t *data = malloc(sizeof(*data)*(size_t)len);
-    uint64_t *qdata = (uint64_t*)qf.Data;
     
     /* Dequantize data. */
-    uint64_t *qdata0 = qdata;
-    uint64_t *qdata1 = qdata0 + f.Hd.ParticleLen;
-    uint64_t *qdata2 = qdata1 + f.Hd.ParticleLen;
-
-    uint64_t w = quant.Width;
-    for (int32_t i = 0; i < len; i++) {
-        uint64_t x = qdata0[i] + quant.X0[0];
-        if (x >= quant.Width) x -= quant.Width;
-        uint64_t y = qdata1[i] + quant.X0[1];
-        if (y >= quant.Width) y -= quant.Width;
-        uint64_t z = qdata2[i] + quant.X0[2];
-        if (z >= quant.Width) z -= quant.Width;
-        data[i] = x + w*y + w*w*z;
-    }
+    undoIDData(qf, data);
 
     /* Set Acc. */
     acc->Width = quant.Width;
@@ -586,6 +1629,28 @@ Field undoID(QField qf) {
     return f;
 }
 
+void undoIDData(QField qf, uint64_t *data) {
+    int32_t len = qf.Hd.ParticleLen;
+    IDQuantization quant = *(IDQuantization*)qf.Quant;
+
+    void *qdata0 = plane(qf.Data, qf.ElemSize, len, 0);
+    void *qdata1 = plane(qf.Data, qf.ElemSize, len, 1);
+    void *qdata2 = plane(qf.Data, qf.ElemSize, len, 2);
+
+    uint64_t w = quant.Width;
+    divider dw = newDivider(w);
+    int32_t shift = dw.Shift;
+    for (int32_t i = 0; i < len; i++) {
+        uint64_t x = load(qdata0, qf.ElemSize, i) + quant.X0[0];
+        if (x >= quant.Width) x -= quant.Width;
+        uint64_t y = load(qdata1, qf.ElemSize, i) + quant.X0[1];
+        if (y >= quant.Width) y -= quant.Width;
+        uint64_t z = load(qdata2, qf.ElemSize, i) + quant.X0[2];
+        if (z >= quant.Width) z -= quant.Width;
+        data[i] = dw.Pow2 ? x | y << shift | z << 2*shift : x + w*y + w*w*z;
+    }
+}
+
 Field undoUint(QField qf) {
     /* Set things up. */
     Field f;
@@ -593,13 +1658,10 @@ Field undoUint(QField qf) {
     memcpy(&f.Hd, &qf.Hd, sizeof(f.Hd));
 
     int32_t len = f.Hd.ParticleLen;
-    IntQuantization quant = *(IntQuantization*)qf.Quant;
-    uint64_t *qdata = (uint64_t*)qf.Data;
     uint64_t *data = malloc(sizeof(*data)*(size_t)len);
     
     /* Dequantize data. */
-    memcpy(data, qdata, sizeof(*data)*(size_t)len);
-    for (int32_t i = 0; i < len; i++) { data[i] += quant.X0; }
+    undoUintData(qf, data);
     f.Data = data;
 
     /* No need to set Acc. */
@@ -607,151 +1669,1422 @@ Field undoUint(QField qf) {
     return f;
 }
 
+void undoUintData(QField qf, uint64_t *data) {
+    int32_t len = qf.Hd.ParticleLen;
+    IntQuantization quant = *(IntQuantization*)qf.Quant;
+    for (int32_t i = 0; i < len; i++) {
+        data[i] = load(qf.Data, qf.ElemSize, i) + quant.X0;
+    }
+}
+
 /********************/
 /* Helper Functions */
 /********************/
 
+/* undoLog10Float and undoSymLog10Float are undoFloat followed by the
+ * inverse of the map the field was quantized with: the fast approximations
+ * if fast is set and libm otherwise. */
 void undoLog10Float(
-    float x0, float x1,
+    bool centered, bool fast, float x0, float x1,
     uint8_t depth, uint8_t *depths,
-    uint64_t *qdata, float *buf, int32_t len
+    void *qdata, int32_t elemSize, float *buf, int32_t len
 ) {
-    undoFloat(x0, x1, depth, depths, qdata, buf, len);
-    for (int32_t i = 0; i < len; i++) { buf[i] = powf(10, buf[i]); }
+    undoFloat(centered, x0, x1, depth, depths, qdata, elemSize, buf, len);
+    if (fast) {
+        FSeq x = FSeq_WrapArray(buf, len);
+        util_Exp10(x, x);
+        return;
+    }
+    for (int32_t i = 0; i < len; i++) { buf[i] = unmapValue(buf[i], 1, 0); }
 }
 
 void undoSymLog10Float(
-    float x0, float x1, float symLog10Threshold,
+    bool centered, bool fast, float x0, float x1, float symLog10Threshold,
     uint8_t depth, uint8_t *depths,
-    uint64_t *qdata, float *buf, int32_t len
+    void *qdata, int32_t elemSize, float *buf, int32_t len
 ) {
-    (void) symLog10Threshold;
-    undoFloat(x0, x1, depth, depths, qdata, buf, len);
-     
-    Panic("SymLog10 not yet implemented.%s", "");
+    undoFloat(centered, x0, x1, depth, depths, qdata, elemSize, buf, len);
+    if (fast) {
+        FSeq x = FSeq_WrapArray(buf, len);
+        util_UndoSymLog10(x, symLog10Threshold, x);
+        return;
+    }
+    for (int32_t i = 0; i < len; i++) {
+        buf[i] = unmapValue(buf[i], 2, symLog10Threshold);
+    }
 }
 
 void undoFloat(
-    float x0, float x1,
+    bool centered, float x0, float x1,
     uint8_t depth, uint8_t *depths,
-    uint64_t *qdata, float *buf, int32_t len
+    void *qdata, int32_t elemSize, float *buf, int32_t len
 ) {
-    rand_State *state = rand_Seed(clock(), 1);
+    if (centered) {
+        undoFloatState(
+            NULL, x0, x1, depth, depths, qdata, elemSize, buf, len
+        );
+        return;
+    }
 
-    if (!depths) {
-        float dx = (x1 - x0) / (float) (1<<depth);
-        for (int32_t i = 0; i < len; i++) {
-            buf[i] = x0 + dx*((float)qdata[i] + rand_Float(state));
+    /* Seeded in place so that decoding into caller-owned arrays doesn't
+     * allocate. */
+    rand_State state[1];
+    rand_SeedInto(state, (uint64_t) clock(), 1);
+    undoFloatState(state, x0, x1, depth, depths, qdata, elemSize, buf, len);
+}
+
+/* undoFloatState is undoFloat with a caller-supplied RNG state, so that a
+ * plane can be undone in pieces without reusing random numbers. A NULL state
+ * decodes bin centers. */
+void undoFloatState(
+    rand_State *state, float x0, float x1,
+    uint8_t depth, uint8_t *depths,
+    void *qdata, int32_t elemSize, float *buf, int32_t len
+) {
+    if (len == 0) { return; }
+
+    FSeq out = FSeq_WrapArray(buf, len);
+
+    switch (elemSize) {
+    case 2:
+        ;
+        U16Seq q16 = U16Seq_WrapArray(qdata, len);
+        if (depths == NULL) {
+            util_U16UndoUniformBinIndex(q16, depth, x0, x1 - x0, state, out);
+        } else {
+            util_U16UndoBinIndex(
+                q16, U8Seq_WrapArray(depths, len), x0, x1 - x0, state, out
+            );
         }
-    } else {
-        for (int32_t i = 0; i < len; i++) {
-            float dx = (x1 - x0) / (float) (1 << depths[i]);
-            buf[i] = x0 + dx*((float)qdata[i] + rand_Float(state));
+        break;
+    case 4:
+        ;
+        U32Seq q32 = U32Seq_WrapArray(qdata, len);
+        if (depths == NULL) {
+            util_UndoUniformBinIndex(q32, depth, x0, x1 - x0, state, out);
+        } else {
+            util_UndoBinIndex(
+                q32, U8Seq_WrapArray(depths, len), x0, x1 - x0, state, out
+            );
         }
+        break;
+    default:
+        Panic("Float fields cannot be stored in %"PRId32"-byte elements.",
+              elemSize);
     }
 }
 
-void depthToDelta(
-    uint8_t depth, uint8_t *depths,
-    float x0, float x1,
-    float *deltaPtr, float**deltasPtr,
-    int32_t len
+/* undoPlane runs undoFloat on plane dim of qf with every depth lowered by
+ * shift. If offsets is non-NULL, the plane is split into blocks packed at
+ * the given widths and its values are relative to per-block offsets. They
+ * are converted back to bin indices a piece at a time on the stack. Shifted
+ * depths are found the same way. */
+void undoPlane(
+    QField qf, int32_t dim, float x0, float x1,
+    uint8_t depth, uint8_t *depths, uint8_t shift,
+    uint64_t *offsets, uint8_t *widths, int32_t blockLen, bool centered,
+    float *out
 ) {
-    if (!depths) {
-        *deltaPtr = (x1 - x0) / (float) (1 << depth);
-        *deltasPtr = NULL;
+    int32_t len = qf.Hd.ParticleLen;
+    depth = depth > shift ? (uint8_t)(depth - shift) : 0;
+    if (offsets == NULL && (depths == NULL || shift == 0)) {
+        void *q = plane(qf.Data, qf.ElemSize, len, dim);
+        undoFloat(centered, x0, x1, depth, depths, q, qf.ElemSize, out, len);
         return;
     }
 
-    float *deltas = calloc((size_t) len, sizeof(*deltas));
-    for (int32_t i = 0; i < len; i++) {
-        deltas[i] = (x1 - x0) / (float) (1 << depths[i]);
+    rand_State seeded[1], *state = NULL;
+    if (!centered) {
+        state = seeded;
+        rand_SeedInto(state, (uint64_t) clock(), 1);
     }
 
-    *deltasPtr = deltas;
-    *deltaPtr = 0;
+    uint8_t *q = offsets == NULL ? plane(qf.Data, qf.ElemSize, len, dim) :
+        (uint8_t*)qf.Data + (size_t)dim*planeBytes(len, blockLen, widths);
+
+    uint32_t idx[quantAXIS_BLOCK];
+    uint8_t buf[quantAXIS_BLOCK];
+    for (int32_t start = 0, end; start < len; start = end) {
+        end = start + quantAXIS_BLOCK > len ? len : start + quantAXIS_BLOCK;
+
+        /* Pieces never straddle blocks, so each has a single width. */
+        void *chunk = q;
+        int32_t elemSize = qf.ElemSize;
+        if (offsets != NULL) {
+            int32_t b = start / blockLen, k = start - b*blockLen;
+            if (end > (b + 1)*blockLen) { end = (b + 1)*blockLen; }
+            if (k == 0 && b > 0) { q += blockBytes(blockLen, widths[b - 1]); }
+            uint64_t off = offsets[3*b + dim];
+            for (int32_t j = start; j < end; j++) {
+                idx[j - start] = (uint32_t)(load(q, widths[b], j - b*blockLen)
+                                            + off);
+            }
+            chunk = idx;
+            elemSize = 4;
+        } else {
+            q += (size_t)(end - start)*(size_t)elemSize;
+        }
+
+        uint8_t *chunkDepths = depths == NULL ? NULL : depths + start;
+        if (chunkDepths != NULL && shift > 0) {
+            axisDepths(chunkDepths, shift, buf, end - start);
+            chunkDepths = buf;
+        }
+
+        undoFloatState(
+            state, x0, x1, depth, chunkDepths,
+            chunk, elemSize, out + start, end - start
+        );
+    }
 }
 
-void deltaToDepth(
-    float delta, float *deltas,
-    float x0, float x1,
-    uint8_t *depthPtr, uint8_t **depthsPtr,
-    int32_t len
+/* localize rewrites the dims planes of qf->Data relative to the smallest
+ * value of each component in each block of blockLen particles and returns
+ * those minima, with component d of block b at index dims*b + d. Each block
+ * is then packed into the narrowest type that holds its local values, and
+ * those widths are written to widthsPtr. NULL is returned for both in empty
+ * fields. */
+uint64_t *localize(
+    QField *qf, int32_t dims, int32_t blockLen, uint8_t **widthsPtr,
+    pool_Pool *pool
 ) {
-    if (deltas == NULL) {
+    int32_t len = qf->Hd.ParticleLen;
+    int32_t blocks = (len + blockLen - 1) / blockLen;
+    *widthsPtr = NULL;
+    if (blocks == 0) { return NULL; }
+
+    uint64_t *offsets = calloc((size_t)dims*(size_t)blocks,
+                               sizeof(*offsets));
+    uint64_t *spread = calloc((size_t)blocks, sizeof(*spread));
+    uint8_t *widths = calloc((size_t)blocks, sizeof(*widths));
+    AssertAlloc(offsets);
+    AssertAlloc(spread);
+    AssertAlloc(widths);
+
+    localizeTask task = {
+        .QF = qf, .Dims = dims, .BlockLen = blockLen,
+        .Offsets = offsets, .Spread = spread
+    };
+    forBlocks(pool, len, blockLen, localizeRange, &task);
+
+    int32_t elemSize = 2;
+    bool repack = false;
+    for (int32_t b = 0; b < blocks; b++) {
+        widths[b] = quant_ElemSize(bitLen(spread[b]));
+        if (widths[b] > elemSize) { elemSize = widths[b]; }
+        repack = repack || widths[b] != qf->ElemSize;
+    }
 
-        uint8_t depth;
-        for (depth = 0; depth <= 24; depth++) {
-            if ((delta*(float)(1 << depth) > x1 - x0)) { break; }
-        }
+    /* Writing in place is safe when no width changes and no block is
+     * padded, since each value then stays where it is. */
+    size_t bytes = planeBytes(len, blockLen, widths);
+    repack = repack || bytes != (size_t)len*(size_t)qf->ElemSize;
+    uint8_t *data = qf->Data;
+    if (repack) {
+        data = calloc((size_t)dims*bytes + 1, 1);
+        AssertAlloc(data);
+    }
 
-        if (depth > 24) {
-            Panic("An accuracy of %g was requested for a variable with a range "
-                  "of [%g, %g], but this exceeds the granularity of single "
-                  "precision floats, which only support "
-                  "24 bits of mantissa precision.", delta, x0, x1);
-        }
+    task.Widths = widths;
+    task.Data = data;
+    task.Starts = blockStarts(len, blockLen, widths);
+    task.PlaneBytes = bytes;
+    forBlocks(pool, len, blockLen, packRange, &task);
 
-        *depthPtr = depth;
-        *depthsPtr = NULL;
+    if (data != qf->Data) { free(qf->Data); }
+    free(task.Starts);
+    free(spread);
+    qf->Data = data;
+    qf->ElemSize = elemSize;
+    *widthsPtr = widths;
 
-    } else {
-        /* These are tracked for the common case where subseqeunt values have
-         * the same depth, as an optimization. */
-        float prevDelta = -1;
-        uint8_t prevDepth = (uint8_t)256;
-        uint8_t *depths = calloc((size_t)len, sizeof(*depths));
+    return offsets;
+}
 
-        for (int32_t i = 0; i < len; i++) {
-            if (prevDelta == deltas[i]) {
-                depths[i] = prevDepth;
-                continue;
+/* localizeRange finds the offsets and spreads of the blocks from start to
+ * end. */
+void localizeRange(void *arg, int32_t start, int32_t end) {
+    localizeTask *task = arg;
+    QField *qf = task->QF;
+    int32_t len = qf->Hd.ParticleLen, blockLen = task->BlockLen;
+
+    for (int32_t d = 0; d < task->Dims; d++) {
+        void *q = plane(qf->Data, qf->ElemSize, len, d);
+        for (int32_t b = start / blockLen; b*blockLen < end; b++) {
+            int32_t lo = b*blockLen;
+            int32_t hi = lo + blockLen > end ? end : lo + blockLen;
+
+            uint64_t min = load(q, qf->ElemSize, lo), max = min;
+            for (int32_t j = lo + 1; j < hi; j++) {
+                uint64_t x = load(q, qf->ElemSize, j);
+                if (x < min) { min = x; }
+                if (x > max) { max = x; }
             }
 
-            uint8_t depth;
-            for (depth = 0; depth <= 24; depth++) {
-                float width = deltas[i] * (float) (1 << depth);
-                if (width > x1 - x0) {
-                    depths[i] = depth;
-                    prevDepth = depth;
-                    break;
-                }
-            }
+            task->Offsets[task->Dims*b + d] = min;
+            if (max - min > task->Spread[b]) { task->Spread[b] = max - min; }
+        }
+    }
+}
 
-            DebugAssert(depth <= 24) {
-                Panic("An accuracy of %g was requested for variables with "
-                      "a range of [%g, %g], but this "
-                      "exceeds the granularity of single precision "
-                      "floats, which only support 24 bits of mantissa "
-                      "precision.", delta, x0, x1);
+/* packRange writes the blocks from start to end to task->Data at their own
+ * widths. */
+void packRange(void *arg, int32_t start, int32_t end) {
+    localizeTask *task = arg;
+    QField *qf = task->QF;
+    int32_t len = qf->Hd.ParticleLen, blockLen = task->BlockLen;
+
+    for (int32_t d = 0; d < task->Dims; d++) {
+        void *from = plane(qf->Data, qf->ElemSize, len, d);
+        uint8_t *to = task->Data + (size_t)d*task->PlaneBytes;
+        for (int32_t b = start / blockLen; b*blockLen < end; b++) {
+            int32_t lo = b*blockLen;
+            int32_t hi = lo + blockLen > end ? end : lo + blockLen;
+            uint64_t off = task->Offsets[task->Dims*b + d];
+            for (int32_t j = lo; j < hi; j++) {
+                store(to + task->Starts[b], task->Widths[b], j - lo,
+                      load(from, qf->ElemSize, j) - off);
             }
         }
-
-        *depthPtr = 0;
-        *depthsPtr = depths;
     }
 }
 
-FSeq mapFloat(FSeq data, int32_t log10Scaled, float symLog10Threshold) {
-    switch (log10Scaled) {
-    case 0:
-        return data;
-    case 1:
-        ;
-        FSeq map = FSeq_New(data.Len);
-        for (int32_t i = 0; i < map.Len; i++) {
-            map.Data[i] = log10f(data.Data[i]);
-        }
+/* forBlocks calls f on consecutive ranges of particles which cover the
+ * first len, each quantTASK_BLOCKS blocks long except for the last. If pool
+ * is non-NULL, the ranges are run as tasks on it, so that idle workers can
+ * pick them up and a single field can use the whole pool. Otherwise, or if
+ * there is only one range, f is called once on the calling thread. */
+void forBlocks(
+    pool_Pool *pool, int32_t len, int32_t blockLen, rangeFunc f, void *arg
+) {
+    int32_t step = quantTASK_BLOCKS*blockLen;
+    if (pool == NULL || len <= step) {
+        f(arg, 0, len);
+        return;
+    }
 
-        return map;
-    case 2:
-        (void) symLog10Threshold;
-        Panic("symLog10 not supported.%s", "");
-    default:
-        Panic("log10Scaled not set to 0, 1, or 2.%s", "");
+    int32_t n = (len - 1) / step + 1;
+    rangeTask *tasks = calloc((size_t)n, sizeof(*tasks));
+    AssertAlloc(tasks);
+
+    pool_Group g = pool_NewGroup();
+    for (int32_t i = 0; i < n; i++) {
+        tasks[i].Func = f;
+        tasks[i].Arg = arg;
+        tasks[i].Start = i*step;
+        tasks[i].End = len - i*step > step ? i*step + step : len;
+        pool_Submit(pool, &g, runRange, &tasks[i]);
     }
+    pool_Wait(pool, &g);
+
+    free(tasks);
 }
 
-void unmapFloat(FSeq map, int32_t log10Scaled) {
-    if (log10Scaled) { FSeq_Free(map); }
+void runRange(void *arg) {
+    rangeTask *task = arg;
+    task->Func(task->Arg, task->Start, task->End);
+}
+
+void binRange(void *arg, int32_t start, int32_t end) {
+    binTask *task = arg;
+    QField *qf = task->QF;
+    int32_t len = qf->Hd.ParticleLen;
+    size_t elemSize = (size_t)qf->ElemSize;
+
+    for (int32_t i = 0; i < quant_QDims(qf->Hd.FieldCode); i++) {
+        uint8_t *q = plane(qf->Data, qf->ElemSize, len, i);
+        binIndex(
+            FSeq_WrapArray(task->X[i].Data + start, end - start),
+            task->Depth, task->Depths == NULL ? NULL : task->Depths + start,
+            task->X0[i], task->DX, q + (size_t)start*elemSize, qf->ElemSize
+        );
+    }
+}
+
+void binDoubleRange(void *arg, int32_t start, int32_t end) {
+    doubleBinTask *task = arg;
+    QField *qf = task->QF;
+    int32_t len = qf->Hd.ParticleLen;
+    size_t elemSize = (size_t)qf->ElemSize;
+
+    for (int32_t i = 0; i < quant_QDims(qf->Hd.FieldCode); i++) {
+        uint8_t *q = plane(qf->Data, qf->ElemSize, len, i);
+        binDouble(
+            task->X[i] + start, end - start, task->Depth,
+            task->Depths == NULL ? NULL : task->Depths + start,
+            task->X0[i], task->DX, q + (size_t)start*elemSize, qf->ElemSize
+        );
+    }
+}
+
+/* binVelocityRange maps and bins the velocities from start to end. If
+ * task->Planes is NULL, the field isn't stored in planes, and it's
+ * deinterleaved a piece at a time. */
+void binVelocityRange(void *arg, int32_t start, int32_t end) {
+    velocityBinTask *task = arg;
+    QField *qf = task->QF;
+    VelocityQuantization *quant = task->Quant;
+    int32_t len = qf->Hd.ParticleLen;
+    size_t elemSize = (size_t)qf->ElemSize;
+    int32_t step = task->Planes == NULL ? quantAXIS_BLOCK : end - start;
+
+    float buf[quantAXIS_BLOCK];
+    for (int32_t lo = start, hi; lo < end; lo = hi) {
+        hi = end - lo > step ? lo + step : end;
+        for (int i = 0; i < 3; i++) {
+            float *x = buf;
+            if (task->Planes == NULL) {
+                readAxis(task->F, i, lo, hi, buf);
+            } else {
+                x = task->Planes[i] + lo;
+            }
+
+            FSeq v = mapFloat(
+                FSeq_WrapArray(x, hi - lo), task->Flag,
+                ((VelocityAccuracy*)task->F.Acc)->SymLog10Threshold,
+                task->Fast
+            );
+            uint8_t *q = plane(qf->Data, qf->ElemSize, len, i);
+            binAxis(
+                v, task->Depth,
+                task->Depths == NULL ? NULL : task->Depths + lo,
+                quant->Shifts[i], quant->X0[i], quant->X1[i] - quant->X0[i],
+                q + (size_t)lo*elemSize, qf->ElemSize
+            );
+            unmapFloat(v, task->Flag);
+        }
+    }
+}
+
+/* depthToDelta finds the bin widths of depth or depths over range. Depths of
+ * fields quantized from doubles can be larger than 31, so the powers of two
+ * are applied to the exponent directly. */
+void depthToDelta(
+    uint8_t depth, uint8_t *depths, double range,
+    float *deltaPtr, float**deltasPtr,
+    int32_t len
+) {
+    if (!depths) {
+        *deltaPtr = (float)ldexp(range, -depth);
+        *deltasPtr = NULL;
+        return;
+    }
+
+    float *deltas = calloc((size_t) len, sizeof(*deltas));
+    AssertAlloc(deltas);
+    for (int32_t i = 0; i < len; i++) {
+        deltas[i] = (float)ldexp(range, -depths[i]);
+    }
+
+    *deltasPtr = deltas;
+    *deltaPtr = 0;
+}
+
+void deltaToDepth(
+    float delta, float *deltas,
+    float x0, float x1,
+    uint8_t *depthPtr, uint8_t **depthsPtr,
+    int32_t len
+) {
+    float range = x1 - x0;
+
+    if (deltas == NULL) {
+        int32_t depth = floatDepth(delta, range);
+
+        if (depth > 24) {
+            Panic("An accuracy of %g was requested for a variable with a range "
+                  "of [%g, %g], but this exceeds the granularity of single "
+                  "precision floats, which only support "
+                  "24 bits of mantissa precision.", delta, x0, x1);
+        }
+
+        *depthPtr = (uint8_t)depth;
+        *depthsPtr = NULL;
+        return;
+    }
+
+    uint8_t *depths = calloc((size_t)len + 1, sizeof(*depths));
+    AssertAlloc(depths);
+
+    /* The range's exponent and mantissa bits are fixed, so every depth is
+     * a few integer operations with no branches, which vectorizes. */
+    uint32_t rangeBits;
+    memcpy(&rangeBits, &range, sizeof(rangeBits));
+    int32_t eRange = (int32_t)((rangeBits >> 23) & 0xff);
+    uint32_t mRange = rangeBits & 0x7fffff;
+    bool rangeNormal = eRange != 0 && eRange != 0xff && (rangeBits >> 31) == 0;
+
+    int32_t maxDepth = 0;
+    bool special = !rangeNormal;
+    for (int32_t i = 0; i < len && rangeNormal; i++) {
+        uint32_t bits;
+        memcpy(&bits, &deltas[i], sizeof(bits));
+        int32_t e = (int32_t)((bits >> 23) & 0xff);
+        uint32_t m = bits & 0x7fffff;
+
+        int32_t depth = eRange - e + (m > mRange ? 0 : 1);
+        depth = depth < 0 ? 0 : depth;
+        special = special || e == 0 || e == 0xff || (bits >> 31) != 0;
+        maxDepth = depth > maxDepth ? depth : maxDepth;
+        depths[i] = (uint8_t)(depth > 0xff ? 0xff : depth);
+    }
+
+    /* Zeros, subnormals, negatives, infinities, and NaNs go through the old
+     * search. */
+    if (special) {
+        maxDepth = 0;
+        for (int32_t i = 0; i < len; i++) {
+            int32_t depth = floatDepth(deltas[i], range);
+            maxDepth = depth > maxDepth ? depth : maxDepth;
+            depths[i] = (uint8_t)(depth > 0xff ? 0xff : depth);
+        }
+    }
+
+    DebugAssert(maxDepth <= 24) {
+        Panic("An accuracy of %g was requested for variables with "
+              "a range of [%g, %g], but this "
+              "exceeds the granularity of single precision "
+              "floats, which only support 24 bits of mantissa "
+              "precision.", delta, x0, x1);
+    }
+
+    *depthPtr = 0;
+    *depthsPtr = depths;
+}
+
+/* exponentDepth returns the smallest depth, d >= 0, for which
+ * delta*2^d > range, computed from the exponent and mantissa bits of the two
+ * numbers: if delta = md*2^ed and range = mr*2^er, then d = er - ed when
+ * md > mr and er - ed + 1 otherwise. -1 is returned if either value isn't a
+ * positive normal float. */
+int32_t exponentDepth(float delta, float range) {
+    uint32_t db, rb;
+    memcpy(&db, &delta, sizeof(db));
+    memcpy(&rb, &range, sizeof(rb));
+    if ((db >> 31) != 0 || (rb >> 31) != 0) { return -1; }
+    int32_t ed = (int32_t)(db >> 23), er = (int32_t)(rb >> 23);
+    if (ed == 0 || ed == 0xff || er == 0 || er == 0xff) { return -1; }
+
+    int32_t depth = er - ed + ((db & 0x7fffff) > (rb & 0x7fffff) ? 0 : 1);
+    return depth < 0 ? 0 : depth;
+}
+
+/* slowDepth is exponentDepth for arbitrary floats. It returns 25 if no depth
+ * up to 24 works. */
+int32_t slowDepth(float delta, float range) {
+    int32_t depth;
+    for (depth = 0; depth <= 24; depth++) {
+        if (delta*(float)(1 << depth) > range) { break; }
+    }
+    return depth;
+}
+
+/* floatDepth returns the depth needed to reach an accuracy of delta over
+ * range, or 25 if that's more than a float can store. */
+int32_t floatDepth(float delta, float range) {
+    int32_t depth = exponentDepth(delta, range);
+    return depth < 0 ? slowDepth(delta, range) : depth;
+}
+
+/* mapFloat applies a field's log scaling to data. If fast is true, the
+ * vectorized approximations in util are used instead of libm. */
+FSeq mapFloat(
+    FSeq data, int32_t log10Scaled, float symLog10Threshold, bool fast
+) {
+    FSeq map;
+    switch (log10Scaled) {
+    case 0:
+        return data;
+    case 1:
+        map = FSeq_New(data.Len);
+        if (fast) { return util_Log10(data, map); }
+        for (int32_t i = 0; i < map.Len; i++) {
+            map.Data[i] = log10f(data.Data[i]);
+        }
+        return map;
+    case 2:
+        if (symLog10Threshold <= 0) {
+            Panic("symLog10 threshold set to %g, but it must be positive.",
+                  symLog10Threshold);
+        }
+        map = FSeq_New(data.Len);
+        if (fast) { return util_SymLog10(data, symLog10Threshold, map); }
+        for (int32_t i = 0; i < map.Len; i++) {
+            map.Data[i] = mapValue(data.Data[i], 2, symLog10Threshold);
+        }
+        return map;
+    default:
+        Panic("log10Scaled not set to 0, 1, or 2.%s", "");
+    }
+}
+
+void unmapFloat(FSeq map, int32_t log10Scaled) {
+    if (log10Scaled) { FSeq_Free(map); }
+}
+
+/* mapValue is the libm version of mapFloat for a single value. */
+float mapValue(float x, int32_t log10Scaled, float symLog10Threshold) {
+    switch (log10Scaled) {
+    case 1:
+        return log10f(x);
+    case 2:
+        return copysignf(log10f(1 + fabsf(x) / symLog10Threshold), x);
+    default:
+        return x;
+    }
+}
+
+/* unmapValue is the libm inverse of mapValue. */
+float unmapValue(float x, int32_t log10Scaled, float symLog10Threshold) {
+    switch (log10Scaled) {
+    case 1:
+        return powf(10, x);
+    case 2:
+        return copysignf(symLog10Threshold*(powf(10, fabsf(x)) - 1), x);
+    default:
+        return x;
+    }
+}
+
+/* mapErr bounds the total error, in mapped units, that the fast maps and
+ * their inverses can add to values in [x0, x1]. One extra ulp covers the
+ * rounding of libm's bounds. */
+float mapErr(int32_t log10Scaled, float x0, float x1) {
+    if (log10Scaled == 0) { return 0; }
+
+    float y = fabsf(x0) > fabsf(x1) ? fabsf(x0) : fabsf(x1);
+    float err = util_LOG10_ABS_ERR + (util_LOG10_REL_ERR + FLT_EPSILON)*y +
+        util_EXP10_REL_ERR*quantLOG10_E;
+    if (log10Scaled == 2) {
+        err += util_SYMLOG10_ABS_ERR + util_SYMLOG10_REL_ERR*quantLOG10_E;
+    }
+
+    return err;
+}
+
+/* fastMapFits returns true if every particle still gets the depth that it
+ * would have gotten from the exact map after both its accuracy is tightened
+ * by err and the range is widened by err on each side. In that case the fast
+ * maps cost no bits and can't push any value outside its requested
+ * accuracy. */
+bool fastMapFits(
+    float err, float delta, float *deltas, int32_t len, float range
+) {
+    if (!isfinite(err) || !isfinite(range)) { return false; }
+    float padded = range + 2*err;
+
+    if (deltas == NULL) {
+        return delta - err > 0 &&
+            floatDepth(delta - err, padded) == floatDepth(delta, range);
+    }
+
+    for (int32_t i = 0; i < len; i++) {
+        if (deltas[i] - err <= 0 ||
+            floatDepth(deltas[i] - err, padded) !=
+            floatDepth(deltas[i], range)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* readAxis copies component dim of particles start through end - 1 of the
+ * three-component field f into out, whatever f's layout. */
+void readAxis(Field f, int32_t dim, int32_t start, int32_t end, float *out) {
+    float *x = axisPlane(f, dim);
+    if (x != NULL) {
+        memcpy(out, x + start, sizeof(*out)*(size_t)(end - start));
+        return;
+    }
+
+    DebugAssert(f.Layout.Kind == layout_AoS) {
+        Panic("Unrecognized field layout %"PRId32".", f.Layout.Kind);
+    }
+
+    size_t stride = f.Layout.Stride == 0 ? 3 : (size_t)f.Layout.Stride;
+    const float *in = (float*)f.Data + (size_t)start*stride + (size_t)dim;
+    int32_t n = end - start;
+    if (stride == 3) {
+        /* A constant stride lets the compiler vectorize the gather. */
+        for (int32_t i = 0; i < n; i++) { out[i] = in[3*i]; }
+    } else {
+        for (int32_t i = 0; i < n; i++) { out[i] = in[(size_t)i*stride]; }
+    }
+}
+
+/* axisPlane returns a pointer to the contiguous plane holding component dim
+ * of f, or NULL if f's components are interleaved. */
+float *axisPlane(Field f, int32_t dim) {
+    switch (f.Layout.Kind) {
+    case layout_SoA:
+        return (float*)f.Data + (size_t)dim*(size_t)f.Hd.ParticleLen;
+    case layout_Axes: return f.Layout.Axes[dim];
+    default: return NULL;
+    }
+}
+
+void blockBounds(
+    FSeq *xDim, int32_t blockLen, float width, PositionQuantization *quant,
+    pool_Pool *pool
+) {
+    int32_t len = xDim[0].Len;
+    int32_t blocks = (len + blockLen - 1) / blockLen;
+
+    quant->BlockLen = blockLen;
+    quant->Blocks = blocks;
+    quant->BlockX0 = calloc(3*(size_t)blocks, sizeof(*quant->BlockX0));
+    quant->BlockX1 = calloc(3*(size_t)blocks, sizeof(*quant->BlockX1));
+    AssertAlloc(quant->BlockX0);
+    AssertAlloc(quant->BlockX1);
+
+    boundsTask task = {
+        .X = xDim, .BlockLen = blockLen, .Width = width, .Quant = quant
+    };
+    forBlocks(pool, len, blockLen, boundsRange, &task);
+}
+
+/* boundsRange finds the bounds of the blocks from start to end. xDim was
+ * only unwrapped around the field's first particle, so a block on the far
+ * side of the box can still be split across two images. Each block is
+ * unwrapped again around its own first particle. */
+void boundsRange(void *arg, int32_t start, int32_t end) {
+    boundsTask *task = arg;
+    int32_t blockLen = task->BlockLen;
+    PositionQuantization *quant = task->Quant;
+
+    FSeq x = FSeq_New(blockLen);
+    for (int32_t b = start / blockLen; b*blockLen < end; b++) {
+        int32_t lo = b*blockLen, hi = lo + blockLen > end ? end : lo + blockLen;
+        x = FSeq_Sub(x, 0, hi - lo);
+        for (int i = 0; i < 3; i++) {
+            memcpy(x.Data, task->X[i].Data + lo, sizeof(*x.Data)*(size_t)x.Len);
+            util_UndoPeriodic(x, task->Width);
+            util_MinMax(x, &quant->BlockX0[3*b + i], &quant->BlockX1[3*b + i]);
+        }
+    }
+    FSeq_Free(x);
+}
+
+/* readAxisDouble copies component dim of the three-component double field f
+ * into out, whatever f's layout. */
+void readAxisDouble(Field f, int32_t dim, double *out) {
+    int32_t len = f.Hd.ParticleLen;
+    const double *in = NULL;
+    size_t stride = 1;
+    switch (f.Layout.Kind) {
+    case layout_SoA:
+        in = (double*)f.Data + (size_t)dim*(size_t)len;
+        break;
+    case layout_Axes:
+        in = (double*)(void*)f.Layout.Axes[dim];
+        break;
+    case layout_AoS:
+        stride = f.Layout.Stride == 0 ? 3 : (size_t)f.Layout.Stride;
+        in = (double*)f.Data + (size_t)dim;
+        break;
+    default: Panic("Unrecognized field layout %"PRId32".", f.Layout.Kind);
+    }
+
+    for (int32_t i = 0; i < len; i++) { out[i] = in[(size_t)i*stride]; }
+}
+
+/* floatBelow and floatAbove round x down and up to the nearest float. */
+float floatBelow(double x) {
+    float f = (float)x;
+    return (double)f > x ? nextafterf(f, -INFINITY) : f;
+}
+
+float floatAbove(double x) {
+    float f = (float)x;
+    return (double)f < x ? nextafterf(f, INFINITY) : f;
+}
+
+/* maxRange returns the largest x1[i] - x0[i] of a three-component field,
+ * found in double precision. */
+double maxRange(float *x0, float *x1) {
+    double max = 0;
+    for (int i = 0; i < 3; i++) {
+        double diff = (double)x1[i] - (double)x0[i];
+        if (diff > max) { max = diff; }
+    }
+    return max;
+}
+
+/* doubleDepth is floatDepth in double precision: it returns the smallest
+ * depth for which delta*2^depth > range, or quantDOUBLE_DEPTH + 1 if no depth
+ * up to quantDOUBLE_DEPTH works. The exponent of range/delta is a guess
+ * that's corrected for rounding. */
+int32_t doubleDepth(double delta, double range) {
+    if (!(delta > 0)) { return quantDOUBLE_DEPTH + 1; }
+
+    int32_t depth = 0;
+    if (range >= delta) { frexp(range / delta, &depth); }
+    while (depth > 0 && ldexp(delta, depth - 1) > range) { depth--; }
+    while (depth <= quantDOUBLE_DEPTH && ldexp(delta, depth) <= range) {
+        depth++;
+    }
+    return depth;
+}
+
+/* doubleDeltaToDepth is deltaToDepth for fields quantized from doubles. */
+void doubleDeltaToDepth(
+    float delta, float *deltas, double range,
+    uint8_t *depthPtr, uint8_t **depthsPtr, int32_t len
+) {
+    if (deltas == NULL) {
+        int32_t depth = doubleDepth(delta, range);
+        if (depth > quantDOUBLE_DEPTH) {
+            Panic("An accuracy of %g was requested for a variable with a "
+                  "range of %g, but this exceeds the granularity of double "
+                  "precision floats, which only support %d bits of mantissa "
+                  "precision.", delta, range, quantDOUBLE_DEPTH);
+        }
+        *depthPtr = (uint8_t)depth;
+        *depthsPtr = NULL;
+        return;
+    }
+
+    uint8_t *depths = calloc((size_t)len + 1, sizeof(*depths));
+    AssertAlloc(depths);
+    for (int32_t i = 0; i < len; i++) {
+        int32_t depth = doubleDepth(deltas[i], range);
+        if (depth > quantDOUBLE_DEPTH) {
+            Panic("An accuracy of %g was requested for a variable with a "
+                  "range of %g, but this exceeds the granularity of double "
+                  "precision floats, which only support %d bits of mantissa "
+                  "precision.", deltas[i], range, quantDOUBLE_DEPTH);
+        }
+        depths[i] = (uint8_t)depth;
+    }
+
+    *depthPtr = 0;
+    *depthsPtr = depths;
+}
+
+/* binDouble is binIndex for doubles. The indices can be up to
+ * quantDOUBLE_DEPTH bits long and are written at any element size. */
+void binDouble(
+    double *x, int32_t len, uint8_t depth, uint8_t *depths,
+    double x0, double dx, void *out, int32_t elemSize
+) {
+    for (int32_t i = 0; i < len; i++) {
+        uint8_t d = depths == NULL ? depth : depths[i];
+        double u = (x[i] - x0) / dx;
+        uint64_t idx = 0;
+        if (u >= 1) { /* must be floating point error */
+            idx = ((uint64_t)1 << d) - 1;
+        } else if (u > 0) {
+            idx = (uint64_t)(u*ldexp(1, d));
+        }
+        store(out, elemSize, i, idx);
+    }
+}
+
+/* undoDouble is undoPlane for fields quantized from doubles. Component dim
+ * of qf spans x0 to x0 + dx, and is written to out as doubles, or as floats
+ * if single is set. offsets and widths are indexed like a three-component
+ * field's. If width is positive, values are wrapped into [0, width). */
+void undoDouble(
+    QField qf, int32_t dim, double x0, double dx,
+    uint8_t depth, uint8_t *depths, uint64_t *offsets, uint8_t *widths,
+    int32_t blockLen, float width, bool centered, bool single, void *out
+) {
+    int32_t len = qf.Hd.ParticleLen;
+    uint8_t *q = offsets == NULL ? plane(qf.Data, qf.ElemSize, len, dim) :
+        (uint8_t*)qf.Data + (size_t)dim*planeBytes(len, blockLen, widths);
+
+    rand_State state[1];
+    if (!centered) { rand_SeedInto(state, (uint64_t) clock(), 1); }
+
+    double L = width;
+    int32_t elemSize = qf.ElemSize, k = 0;
+    uint64_t off = 0;
+    for (int32_t j = 0; j < len; j++, k++) {
+        /* q points at the start of the current block. */
+        if (offsets != NULL && j % blockLen == 0) {
+            q += j == 0 ? 0 : blockBytes(k, elemSize);
+            elemSize = widths[j / blockLen];
+            off = offsets[3*(j / blockLen) + dim];
+            k = 0;
+        }
+        uint64_t idx = load(q, elemSize, k) + off;
+        double w = ldexp(dx, -(depths == NULL ? depth : depths[j]));
+        double u = centered ? 0.5 : (double)rand_Float(state);
+
+        double x = x0 + w*((double)idx + u);
+        if (L > 0) {
+            if (x >= L) {
+                x -= L;
+            } else if (x < 0) {
+                x += L;
+            }
+        }
+
+        if (single) {
+            ((float*)out)[j] = (float)x;
+        } else {
+            ((double*)out)[j] = x;
+        }
+    }
+}
+
+/* blockBoundsDouble is blockBounds for doubles, with the bounds rounded
+ * outwards to floats. */
+void blockBoundsDouble(
+    double **xDim, int32_t len, int32_t blockLen, float width,
+    PositionQuantization *quant, pool_Pool *pool
+) {
+    int32_t blocks = (len + blockLen - 1) / blockLen;
+
+    quant->BlockLen = blockLen;
+    quant->Blocks = blocks;
+    quant->BlockX0 = calloc(3*(size_t)blocks, sizeof(*quant->BlockX0));
+    quant->BlockX1 = calloc(3*(size_t)blocks, sizeof(*quant->BlockX1));
+    AssertAlloc(quant->BlockX0);
+    AssertAlloc(quant->BlockX1);
+
+    boundsTask task = {
+        .XDouble = xDim, .BlockLen = blockLen, .Width = width, .Quant = quant
+    };
+    forBlocks(pool, len, blockLen, boundsDoubleRange, &task);
+}
+
+void boundsDoubleRange(void *arg, int32_t start, int32_t end) {
+    boundsTask *task = arg;
+    int32_t blockLen = task->BlockLen;
+    PositionQuantization *quant = task->Quant;
+
+    DSeq x = DSeq_New(blockLen);
+    for (int32_t b = start / blockLen; b*blockLen < end; b++) {
+        int32_t lo = b*blockLen, hi = lo + blockLen > end ? end : lo + blockLen;
+        x = DSeq_Sub(x, 0, hi - lo);
+        for (int i = 0; i < 3; i++) {
+            memcpy(x.Data, task->XDouble[i] + lo,
+                   sizeof(*x.Data)*(size_t)x.Len);
+            util_DUndoPeriodic(x, task->Width);
+            double x0, x1;
+            util_DMinMax(x, &x0, &x1);
+            quant->BlockX0[3*b + i] = floatBelow(x0);
+            quant->BlockX1[3*b + i] = floatAbove(x1);
+        }
+    }
+    DSeq_Free(x);
+}
+
+/* latticeSites writes the lattice site of particles start through end - 1
+ * to sites[dim][0] through sites[dim][end - start - 1]. */
+void latticeSites(
+    uint64_t *ids, int32_t start, int32_t end, uint64_t idWidth,
+    float width, float *sites[3]
+) {
+    divider dw = newDivider(idWidth), dw2 = newDivider(idWidth*idWidth);
+    float spacing = width / (float)idWidth;
+    for (int32_t j = 0; j < end - start; j++) {
+        uint64_t z = divide(dw2, ids[start + j]);
+        uint64_t r = ids[start + j] - z*(idWidth*idWidth);
+        uint64_t y = divide(dw, r);
+        sites[0][j] = (float)(r - y*idWidth) * spacing;
+        sites[1][j] = (float)y * spacing;
+        sites[2][j] = (float)z * spacing;
+    }
+}
+
+uint8_t *quantDepths(QField qf) {
+    switch (qf.Hd.FieldCode) {
+    case field_Posn: return ((PositionQuantization*)qf.Quant)->Depths;
+    case field_Velc: return ((VelocityQuantization*)qf.Quant)->Depths;
+    case field_Unsf: return ((FloatQuantization*)qf.Quant)->Depths;
+    case field_Ptid: case field_Unsi: return NULL;
+    default: Panic("Unrecognized field code %"PRIx32".", qf.Hd.FieldCode);
+    }
+}
+
+/* writeDepths writes per-particle depths as a run-length table: the number
+ * of runs followed by a (length, depth) pair for each run. Variable accuracy
+ * fields usually come from a handful of refinement levels, so runs are
+ * long. */
+void writeDepths(stream_Writer *writer, uint8_t *depths, int32_t len) {
+    int32_t runs = 0;
+    for (int32_t i = 0; i < len; i++) {
+        if (i == 0 || depths[i] != depths[i - 1]) { runs++; }
+    }
+    stream_Write(writer, &runs, 4, 4);
+
+    for (int32_t start = 0; start < len; ) {
+        int32_t end = start + 1;
+        while (end < len && depths[end] == depths[start]) { end++; }
+        int32_t runLen = end - start;
+        stream_Write(writer, &runLen, 4, 4);
+        stream_Write(writer, &depths[start], 1, 1);
+        start = end;
+    }
+}
+
+uint8_t *readDepths(stream_Reader *reader, int32_t len) {
+    int32_t runs;
+    stream_Read(reader, &runs, 4, 4);
+    if (len == 0) { return NULL; }
+
+    uint8_t *depths = calloc((size_t)len, 1);
+    AssertAlloc(depths);
+
+    int32_t n = 0;
+    for (int32_t r = 0; r < runs; r++) {
+        int32_t runLen;
+        uint8_t depth;
+        stream_Read(reader, &runLen, 4, 4);
+        stream_Read(reader, &depth, 1, 1);
+        if (runLen < 0 || runLen > len - n) {
+            Panic("Depth run of length %"PRId32" overruns a field with %"
+                  PRId32" particles.", runLen, len);
+        }
+        memset(depths + n, depth, (size_t)runLen);
+        n += runLen;
+    }
+
+    return depths;
+}
+
+uint8_t quantDepth(QField qf) {
+    switch (qf.Hd.FieldCode) {
+    case field_Posn: return ((PositionQuantization*)qf.Quant)->Depth;
+    case field_Velc: return ((VelocityQuantization*)qf.Quant)->Depth;
+    case field_Unsf: return ((FloatQuantization*)qf.Quant)->Depth;
+    default: Panic("Field code %"PRIx32" has no depth.", qf.Hd.FieldCode);
+    }
+}
+
+/* blockOffsets returns qf's per-block offsets and writes the length of its
+ * blocks to blockLen, or returns NULL if qf stores bin indices directly. */
+uint64_t *blockOffsets(QField qf, int32_t *blockLen) {
+    *blockLen = 0;
+    switch (qf.Hd.FieldCode) {
+    case field_Posn:
+        ;
+        PositionQuantization *pq = qf.Quant;
+        *blockLen = pq->BlockLen;
+        return pq->BlockOffsets;
+    case field_Velc:
+        ;
+        VelocityQuantization *vq = qf.Quant;
+        *blockLen = vq->BlockLen;
+        return vq->BlockOffsets;
+    default: return NULL;
+    }
+}
+
+/* blockWidths is blockOffsets for the widths of qf's blocks. */
+uint8_t *blockWidths(QField qf, int32_t *blockLen) {
+    *blockLen = 0;
+    switch (qf.Hd.FieldCode) {
+    case field_Posn:
+        ;
+        PositionQuantization *pq = qf.Quant;
+        *blockLen = pq->BlockLen;
+        return pq->BlockWidths;
+    case field_Velc:
+        ;
+        VelocityQuantization *vq = qf.Quant;
+        *blockLen = vq->BlockLen;
+        return vq->BlockWidths;
+    default: return NULL;
+    }
+}
+
+/* blockStarts returns the byte offset of each block within a plane of len
+ * particles packed at the given widths, followed by the size of the plane. */
+size_t *blockStarts(int32_t len, int32_t blockLen, uint8_t *widths) {
+    int32_t blocks = (len + blockLen - 1) / blockLen;
+    size_t *starts = calloc((size_t)blocks + 1, sizeof(*starts));
+    AssertAlloc(starts);
+    for (int32_t b = 0; b < blocks; b++) {
+        int32_t n = b == blocks - 1 ? len - b*blockLen : blockLen;
+        starts[b + 1] = starts[b] + blockBytes(n, widths[b]);
+    }
+    return starts;
+}
+
+size_t planeBytes(int32_t len, int32_t blockLen, uint8_t *widths) {
+    size_t bytes = 0;
+    for (int32_t start = 0; start < len; start += blockLen) {
+        int32_t n = start + blockLen > len ? len - start : blockLen;
+        bytes += blockBytes(n, widths[start / blockLen]);
+    }
+    return bytes;
+}
+
+/* blockBytes is the size of a block of n values of the given width. Blocks
+ * are padded to a multiple of eight bytes so that every block is aligned. */
+size_t blockBytes(int32_t n, int32_t width) {
+    return ((size_t)n*(size_t)width + 7) & ~(size_t)7;
+}
+
+/* copyBlockIndex gives sub, the quantization of a sub-field made of the
+ * listed blocks of qf, those blocks' part of qf's block index. */
+void copyBlockIndex(QField qf, Quantization sub, I32Seq blocks) {
+    int32_t n = blocks.Len, blockLen;
+    uint64_t *offsets = blockOffsets(qf, &blockLen);
+    uint8_t *widths = blockWidths(qf, &blockLen);
+
+    uint64_t *subOffsets = calloc(3*(size_t)n, sizeof(*subOffsets));
+    uint8_t *subWidths = calloc((size_t)n, sizeof(*subWidths));
+    AssertAlloc(subOffsets);
+    AssertAlloc(subWidths);
+    for (int32_t i = 0; i < n; i++) {
+        int32_t b = blocks.Data[i];
+        memcpy(subOffsets + 3*i, offsets + 3*b, 3*sizeof(*subOffsets));
+        subWidths[i] = widths[b];
+    }
+
+    if (qf.Hd.FieldCode == field_Velc) {
+        VelocityQuantization *vq = sub;
+        vq->BlockOffsets = subOffsets;
+        vq->BlockWidths = subWidths;
+        vq->BlockLen = blockLen;
+        vq->Blocks = n;
+        return;
+    }
+
+    PositionQuantization *pq = sub, *full = qf.Quant;
+    pq->BlockX0 = calloc(3*(size_t)n, sizeof(*pq->BlockX0));
+    pq->BlockX1 = calloc(3*(size_t)n, sizeof(*pq->BlockX1));
+    AssertAlloc(pq->BlockX0);
+    AssertAlloc(pq->BlockX1);
+    for (int32_t i = 0; i < n; i++) {
+        int32_t b = blocks.Data[i];
+        memcpy(pq->BlockX0 + 3*i, full->BlockX0 + 3*b, 3*sizeof(float));
+        memcpy(pq->BlockX1 + 3*i, full->BlockX1 + 3*b, 3*sizeof(float));
+    }
+    pq->BlockOffsets = subOffsets;
+    pq->BlockWidths = subWidths;
+    pq->BlockLen = blockLen;
+    pq->Blocks = n;
+}
+
+Quantization copyQuant(QField qf, uint8_t *depths, int32_t len) {
+    switch (qf.Hd.FieldCode) {
+    case field_Posn:
+        ;
+        PositionQuantization *pq = calloc(1, sizeof(*pq));
+        AssertAlloc(pq);
+        *pq = *(PositionQuantization*)qf.Quant;
+        pq->Depths = depths;
+        if (depths != NULL) { pq->Len = len; }
+        pq->BlockX0 = NULL;
+        pq->BlockX1 = NULL;
+        pq->BlockOffsets = NULL;
+        pq->BlockWidths = NULL;
+        pq->Blocks = 0;
+        return pq;
+    case field_Velc:
+        ;
+        VelocityQuantization *vq = calloc(1, sizeof(*vq));
+        AssertAlloc(vq);
+        *vq = *(VelocityQuantization*)qf.Quant;
+        vq->Depths = depths;
+        if (depths != NULL) { vq->Len = len; }
+        vq->BlockOffsets = NULL;
+        vq->BlockWidths = NULL;
+        vq->Blocks = 0;
+        return vq;
+    case field_Ptid:
+        ;
+        IDQuantization *iq = calloc(1, sizeof(*iq));
+        AssertAlloc(iq);
+        *iq = *(IDQuantization*)qf.Quant;
+        return iq;
+    case field_Unsf:
+        ;
+        FloatQuantization *fq = calloc(1, sizeof(*fq));
+        AssertAlloc(fq);
+        *fq = *(FloatQuantization*)qf.Quant;
+        fq->Depths = depths;
+        if (depths != NULL) { fq->Len = len; }
+        return fq;
+    case field_Unsi:
+        ;
+        IntQuantization *uq = calloc(1, sizeof(*uq));
+        AssertAlloc(uq);
+        *uq = *(IntQuantization*)qf.Quant;
+        return uq;
+    default: Panic("Unrecognized field code %"PRIx32".", qf.Hd.FieldCode);
+    }
+}
+
+void compact(
+    void *data, size_t elemSize, int32_t dims, int32_t len, bool *keep
+) {
+    /* Writes never overtake reads, so this can be done in place. */
+    uint8_t *bytes = data;
+    size_t n = 0;
+    for (int32_t d = 0; d < dims; d++) {
+        for (int32_t i = 0; i < len; i++) {
+            if (!keep[i]) { continue; }
+            size_t src = (size_t)d*(size_t)len + (size_t)i;
+            if (src != n) {
+                memcpy(bytes + n*elemSize, bytes + src*elemSize, elemSize);
+            }
+            n++;
+        }
+    }
+}
+
+void binIndex(
+    FSeq x, uint8_t depth, uint8_t *depths,
+    float x0, float dx, void *out, int32_t elemSize
+) {
+    int32_t len = x.Len;
+    if (len == 0) { return; }
+
+    switch (elemSize) {
+    case 2:
+        ;
+        U16Seq q16 = U16Seq_WrapArray(out, len);
+        if (depths == NULL) {
+            util_U16UniformBinIndex(x, depth, x0, dx, q16);
+        } else {
+            util_U16BinIndex(x, U8Seq_WrapArray(depths, len), x0, dx, q16);
+        }
+        return;
+    case 4:
+        ;
+        U32Seq q32 = U32Seq_WrapArray(out, len);
+        if (depths == NULL) {
+            util_UniformBinIndex(x, depth, x0, dx, q32);
+        } else {
+            util_BinIndex(x, U8Seq_WrapArray(depths, len), x0, dx, q32);
+        }
+        return;
+    default:
+        Panic("Float fields cannot be stored in %"PRId32"-byte elements.",
+              elemSize);
+    }
+}
+
+/* binAxis is binIndex with every depth lowered by shift. Components with no
+ * spread are stored entirely in bin zero. */
+void binAxis(
+    FSeq x, uint8_t depth, uint8_t *depths, uint8_t shift,
+    float x0, float dx, void *out, int32_t elemSize
+) {
+    int32_t len = x.Len;
+    if (!(dx > 0)) {
+        memset(out, 0, (size_t)len*(size_t)elemSize);
+        return;
+    }
+
+    if (depths == NULL || shift == 0) {
+        depth = depth > shift ? (uint8_t)(depth - shift) : 0;
+        binIndex(x, depth, depths, x0, dx, out, elemSize);
+        return;
+    }
+
+    uint8_t buf[quantAXIS_BLOCK];
+    for (int32_t start = 0; start < len; start += quantAXIS_BLOCK) {
+        int32_t end = start + quantAXIS_BLOCK > len ?
+            len : start + quantAXIS_BLOCK;
+        axisDepths(depths + start, shift, buf, end - start);
+        binIndex(
+            FSeq_WrapArray(x.Data + start, end - start), 0, buf, x0, dx,
+            (uint8_t*)out + (size_t)start*(size_t)elemSize, elemSize
+        );
+    }
+}
+
+/* axisShift returns how many fewer bits than the widest component, which
+ * spans maxRange with the given depth, a component spanning range needs.
+ * Uniform accuracies get exactly the depth needed for delta. Per-particle
+ * depths share one shift, so it's the number of times range can be doubled
+ * without passing maxRange: no particle's bins get wider than they are in
+ * the widest component. */
+uint8_t axisShift(
+    float delta, bool uniform, uint8_t depth, float range, float maxRange
+) {
+    if (uniform) {
+        int32_t axisDepth = floatDepth(delta, range);
+        return axisDepth < depth ? (uint8_t)(depth - axisDepth) : 0;
+    }
+
+    uint8_t shift = 0;
+    while (shift < 24 && range*(float)(1 << (shift + 1)) <= maxRange) {
+        shift++;
+    }
+    return shift;
+}
+
+/* axisDepths writes depths lowered by shift, floored at zero, to out. */
+void axisDepths(uint8_t *depths, uint8_t shift, uint8_t *out, int32_t len) {
+    for (int32_t i = 0; i < len; i++) {
+        out[i] = depths[i] > shift ? (uint8_t)(depths[i] - shift) : 0;
+    }
+}
+
+/* axisDelta is depthToDelta for velocities: each particle's accuracy is the
+ * widest of its three bins. */
+void axisDelta(
+    VelocityQuantization quant, float *deltaPtr, float **deltasPtr,
+    int32_t len
+) {
+    if (quant.Depths == NULL) {
+        float delta = 0;
+        for (int i = 0; i < 3; i++) {
+            uint8_t depth = quant.Depth > quant.Shifts[i] ?
+                (uint8_t)(quant.Depth - quant.Shifts[i]) : 0;
+            float width = (quant.X1[i] - quant.X0[i]) / (float)(1 << depth);
+            if (width > delta) { delta = width; }
+        }
+        *deltaPtr = delta;
+        *deltasPtr = NULL;
+        return;
+    }
+
+    float *deltas = calloc((size_t)len, sizeof(*deltas));
+    AssertAlloc(deltas);
+    for (int32_t j = 0; j < len; j++) {
+        for (int i = 0; i < 3; i++) {
+            uint8_t depth = quant.Depths[j] > quant.Shifts[i] ?
+                (uint8_t)(quant.Depths[j] - quant.Shifts[i]) : 0;
+            float width = (quant.X1[i] - quant.X0[i]) / (float)(1 << depth);
+            if (width > deltas[j]) { deltas[j] = width; }
+        }
+    }
+
+    *deltaPtr = 0;
+    *deltasPtr = deltas;
+}
+
+uint8_t maxDepth(uint8_t depth, uint8_t *depths, int32_t len) {
+    if (depths == NULL) { return depth; }
+    uint8_t max = 0;
+    for (int32_t i = 0; i < len; i++) {
+        if (depths[i] > max) { max = depths[i]; }
+    }
+    return max;
+}
+
+/* bitLen returns the number of bits needed to represent x. */
+uint8_t bitLen(uint64_t x) {
+    uint8_t n = 0;
+    for (; x > 0; x >>= 1) { n++; }
+    return n;
+}
+
+/* periodicRange finds the smallest periodic interval, [x0, x1], which
+ * contains every element of q. Elements must be in [0, w). x1 may be larger
+ * than w if the interval wraps around. This gives the same range as
+ * util_U64UndoPeriodic followed by util_U64MinMax without modifying q. */
+void periodicRange(
+    void *q, int32_t elemSize, int32_t len, uint64_t w,
+    uint64_t *x0Ptr, uint64_t *x1Ptr
+) {
+    if (len == 0) {
+        *x0Ptr = 0;
+        *x1Ptr = 0;
+        return;
+    }
+
+    int64_t iw = (int64_t) w;
+    int64_t v0 = (int64_t) load(q, elemSize, 0);
+    int64_t min = v0, max = v0;
+    for (int32_t i = 1; i < len; i++) {
+        int64_t v = (int64_t) load(q, elemSize, i);
+        if (v - v0 >= iw/2) {
+            v -= iw;
+        } else if (v - v0 < -iw/2) {
+            v += iw;
+        }
+        if (v < min) { min = v; }
+        if (v > max) { max = v; }
+    }
+
+    if (min < 0) {
+        min += iw;
+        max += iw;
+    }
+
+    *x0Ptr = (uint64_t) min;
+    *x1Ptr = (uint64_t) max;
+}
+
+void *plane(void *data, int32_t elemSize, int32_t len, int32_t dim) {
+    return (uint8_t*)data + (size_t)dim*(size_t)len*(size_t)elemSize;
+}
+
+/* newDivider precomputes division by d. For d that isn't a power of two,
+ * Magic is 2^(64 + l)/d rounded up, where l = floor(log2(d)). If that needs
+ * 65 bits, its top bit is handled by the Add step in divide. */
+divider newDivider(uint64_t d) {
+    if (d == 0) { Panic("Cannot divide by zero.%s", ""); }
+
+    divider div;
+    memset(&div, 0, sizeof(div));
+    div.Shift = bitLen(d) - 1;
+    if ((d & (d - 1)) == 0) {
+        div.Pow2 = true;
+        return div;
+    }
+
+    /* Long division of 2^(64 + l) by d, one bit at a time. */
+    uint64_t q = 0, r = 0;
+    for (int32_t bit = 64 + div.Shift; bit >= 0; bit--) {
+        bool carry = (r >> 63) != 0;
+        r = (r << 1) | (bit == 64 + div.Shift ? 1 : 0);
+        q <<= 1;
+        if (carry || r >= d) {
+            r -= d;
+            q |= 1;
+        }
+    }
+
+    uint64_t l = (uint64_t)1 << div.Shift;
+    if (d - r < l) {
+        div.Magic = q + 1;
+    } else {
+        uint64_t r2 = r + r;
+        q += q;
+        if (r2 >= d || r2 < r) { q++; }
+        div.Magic = q + 1;
+        div.Add = true;
+    }
+
+    return div;
+}
+
+static inline uint64_t divide(divider div, uint64_t n) {
+    if (div.Pow2) { return n >> div.Shift; }
+    uint64_t q = mulHi(n, div.Magic);
+    if (div.Add) { q += (n - q) >> 1; }
+    return q >> div.Shift;
+}
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 quantU128;
+
+static inline uint64_t mulHi(uint64_t a, uint64_t b) {
+    return (uint64_t)(((quantU128)a * b) >> 64);
+}
+#else
+static inline uint64_t mulHi(uint64_t a, uint64_t b) {
+    uint64_t aLo = a & 0xffffffff, aHi = a >> 32;
+    uint64_t bLo = b & 0xffffffff, bHi = b >> 32;
+    uint64_t lo = aLo*bLo, mid1 = aHi*bLo, mid2 = aLo*bHi;
+    uint64_t mid = (lo >> 32) + (mid1 & 0xffffffff) + (mid2 & 0xffffffff);
+    return aHi*bHi + (mid1 >> 32) + (mid2 >> 32) + (mid >> 32);
+}
+#endif
+
+static inline uint64_t load(void *data, int32_t elemSize, int32_t i) {
+    switch (elemSize) {
+    case 2: return ((uint16_t*)data)[i];
+    case 4: return ((uint32_t*)data)[i];
+    default: return ((uint64_t*)data)[i];
+    }
+}
+
+static inline void store(void *data, int32_t elemSize, int32_t i, uint64_t x) {
+    switch (elemSize) {
+    case 2: ((uint16_t*)data)[i] = (uint16_t) x; return;
+    case 4: ((uint32_t*)data)[i] = (uint32_t) x; return;
+    default: ((uint64_t*)data)[i] = x; return;
+    }
 }
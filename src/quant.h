@@ -1,11 +1,133 @@
 #ifndef MNW_QUANT_H_
 #define MNW_QUANT_H_
 
+#include <stdbool.h>
+
 #include "types.h"
+#include "seq.h"
+#include "stream.h"
+#include "pool.h"
+
+/* quant_BLOCK_LEN is the number of particles in each block of a position
+ * field's block index. */
+#define quant_BLOCK_LEN 4096
+
+/* quant_ElemSize returns the size in bytes of the narrowest storage class
+ * (uint16_t, uint32_t, or uint64_t) which can hold a bits-bit integer. */
+uint8_t quant_ElemSize(uint8_t bits);
+
+/* quant_MaxElemSize returns the largest ElemSize quant_QField can give f. Only
+ * f's header, accuracy, and layout are read, so it can be called before f
+ * has any data. Positions and IDs are bounded by their box widths, and every
+ * other field by the deepest quantization its values' type allows. */
+uint8_t quant_MaxElemSize(Field f);
+
+/* quant_Dims returns the number of components each particle has in
+ * Field.Data for a field of the given type (e.g. 3 for positions). Each
+ * component is stored in its own contiguous plane. */
+int32_t quant_Dims(uint32_t fieldCode);
+
+/* quant_RawSize returns the size in bytes of a single component of
+ * Field.Data for a field of the given type. */
+size_t quant_RawSize(uint32_t fieldCode);
+
+/* quant_QDims returns the number of planes in QField.Data for a field of the
+ * given type. This differs from quant_Dims for IDs, which are split into three
+ * lattice components. */
+int32_t quant_QDims(uint32_t fieldCode);
+
+/* quant_Run is a stretch of QField.Data whose elements all have the same
+ * width. Start is the index of its first element, counting through every
+ * plane in turn, and Data points at that element. A run ends at any padding
+ * between blocks, so its elements are contiguous. */
+typedef struct quant_Run {
+    int64_t Start, Len;
+    int32_t ElemSize;
+    uint8_t *Data;
+} quant_Run;
+
+/* quant_NextRun advances run to the next run of qf.Data and returns false
+ * once there are none left. run must be zeroed before the first call. Fields
+ * without a block index are a single run of ElemSize-byte elements, and
+ * neighbouring blocks with the same width share a run. Codecs which depend on
+ * the width of elements code Data a run at a time. */
+bool quant_NextRun(QField qf, quant_Run *run);
+
+/* quant_DataBytes returns the size of qf.Data in bytes. Only qf's header,
+ * ElemSize, and quantization are read, so decoders can call it before
+ * allocating Data. */
+size_t quant_DataBytes(QField qf);
+
+/* quant_WriteQuant appends qf.Quant to writer in a little endian format
+ * which can be read back by quant_ReadQuant. */
+void quant_WriteQuant(stream_Writer *writer, QField qf);
+Quantization quant_ReadQuant(stream_Reader *reader, uint32_t fieldCode);
+
+/* quant_Field dequantizes qf. Floats are normally placed uniformly at random
+ * within their bins. If centered is true, they are placed at the centers of
+ * their bins instead, which is deterministic and faster. Fields quantized
+ * from doubles decode to doubles, and set Layout.Double, unless single is
+ * true. These choices belong to the reader and are not stored with the
+ * field. */
+Field quant_Field(QField qf, bool centered, bool single);
+
+/* quant_FieldInto dequantizes qf into out instead of a newly allocated
+ * array, and does not allocate at all. out must have room for
+ * quant_Dims(qf.Hd.FieldCode)*qf.Hd.ParticleLen components of type float
+ * for floating point fields (double for fields quantized from doubles when
+ * single is false) and uint64_t for IDs and integers, laid out the same way
+ * as Field.Data. No Accuracy is computed. */
+void quant_FieldInto(QField qf, void *out, bool centered, bool single);
 
-Field quant_Field(QField qf);
 QField quant_QField(Field f);
 void quant_FreeQField(QField qf);
+
+/* quant_QFieldPool is identical to quant_QField, except that binning,
+ * finding block bounds, and localizing blocks are split into tasks of a few
+ * blocks each which run on pool. This lets idle workers share the work of a
+ * single large field. If pool is NULL, everything runs on the calling
+ * thread. */
+QField quant_QFieldPool(Field f, pool_Pool *pool);
+
+/* quant_LagrangianQField quantizes a position field whose Acc has Lagrangian
+ * set. id is a field_Ptid field for the same particles. A particle whose ID
+ * splits into the lattice index (i, j, k), with i = ID % W, j = (ID / W) % W,
+ * and k = ID / W^2 for the ID width W, has the lattice site (i, j, k)*L/W in
+ * a box of width L. Each particle is stored as its periodic displacement from
+ * that site. quant_QField Panics if it's given a Lagrangian field. */
+QField quant_LagrangianQField(Field pos, Field id);
+
+/* quant_LagrangianQFieldPool is quant_LagrangianQField split into tasks on
+ * pool, in the same way as quant_QFieldPool. */
+QField quant_LagrangianQFieldPool(Field pos, Field id, pool_Pool *pool);
+
+/* quant_FindLagrangian returns the index of the Lagrangian position field in
+ * fields and writes the index of the ID field it needs to idPtr. It returns
+ * -1 if there is no Lagrangian position field, and Panics if there is one
+ * but no ID field. Fields without an Acc are skipped. */
+int32_t quant_FindLagrangian(Field *fields, int32_t fieldLen, int32_t *idPtr);
+
+/* quant_UndoLagrangian converts a decoded Lagrangian position field in
+ * fields from displacements back to positions, using the decoded ID field.
+ * Fields decoded on their own, e.g. by quant_Field or quant_FieldInto, hold
+ * displacements until this is called, and it must only be called once. If
+ * the ID field is not Valid, the position field is freed and marked as not
+ * Valid. */
+void quant_UndoLagrangian(Field *fields, int32_t fieldLen);
 void quant_FreeField(Field f);
 
+/* quant_BlockQField returns a new QField which only contains the particles in
+ * the given blocks of qf, in the order that the blocks are listed. Blocks are
+ * contiguous runs of blockLen particles. The result must be freed with
+ * quant_FreeQField. If blockLen is qf's own block length and only the last
+ * listed block is short, the result keeps the listed blocks' part of qf's
+ * block index, so each stays at its own width. Otherwise it stores bin
+ * indices directly. */
+QField quant_BlockQField(QField qf, int32_t blockLen, I32Seq blocks);
+
+/* quant_FilterField removes every particle i with keep[i] == false from f.
+ * This is done in place and the new particle count is written to
+ * f->Hd.ParticleLen. */
+void quant_FilterField(Field *f, bool *keep);
+
 #endif
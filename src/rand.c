@@ -26,6 +26,11 @@ rand_State *rand_Seed(uint64_t seed, int32_t n) {
 
     rand_State *state = calloc((size_t)n, sizeof(*state));
     AssertAlloc(state);
+    rand_SeedInto(state, seed, n);
+    return state;
+}
+
+void rand_SeedInto(rand_State *state, uint64_t seed, int32_t n) {
     state[0][0]= splitmixNext(&seed);
     state[0][1]= splitmixNext(&seed);
 
@@ -34,8 +39,6 @@ rand_State *rand_Seed(uint64_t seed, int32_t n) {
         state[i][1] = state[i-1][1];
         xorshiftJump(state + i);
     }
-
-    return state;
 }
 
 uint64_t rand_Uint64(rand_State *state) {
@@ -59,7 +62,7 @@ uint64_t rand_Uint63Lim(rand_State *state, uint64_t lim) {
 
 float rand_Float(rand_State *state) {
     uint64_t x = rand_Uint64(state);
-    const uint64_t mask = ~((~0) << 24);
+    const uint64_t mask = ~(~(uint64_t)0 << 24);
     return (float) (x & mask) / (float) (mask + 1) ;
 }
 
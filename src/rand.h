@@ -18,6 +18,10 @@ typedef uint64_t rand_State[2];
  * seed. */
 rand_State *rand_Seed(uint64_t seed, int32_t n);
 
+/* rand_SeedInto is identical to rand_Seed, except that the n states are
+ * written to the caller's array instead of a newly allocated one. */
+void rand_SeedInto(rand_State *state, uint64_t seed, int32_t n);
+
 /* rand_Uint64 returns a random integer and updates the given RNG state. */
 uint64_t rand_Uint64(rand_State *state);
 float rand_Float(rand_State *state);
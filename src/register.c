@@ -1,84 +1,220 @@
+#include <stdlib.h>
+#include <inttypes.h>
+
 #include "register.h"
+#include "debug.h"
+#include "semver.h"
+#include "algo_Test_v0_9.h"
+#include "algo_Gorl_v0_9.h"
+#include "algo_Pfor_v0_9.h"
+#include "algo_Svby_v0_9.h"
+
+#define registerMIN_CAP 16
+
+/************************/
+/* Forward Declarations */
+/************************/
+
+typedef struct builtinAlgo {
+    uint32_t Algo, Version;
+    RegisterFuncs Funcs;
+} builtinAlgo;
+
+uint32_t registerHash(uint32_t algo, uint32_t version);
+void registerGrow(Register *reg);
+void registerInsert(
+    Register *reg, uint32_t algo, uint32_t version, RegisterFuncs funcs
+);
+void registerUpdateNewest(Register *reg, uint32_t algo, uint32_t version);
+const RegisterFuncs *mustFind(Register *reg, uint32_t algo, uint32_t version);
 
+/* builtins lists every algorithm which ships with minnow. Register_New adds
+ * all of them. */
+static const builtinAlgo builtins[] = {
+    { algo_Test, TestVersion_v0_9,
+      { TestCompress_v0_9, TestCAlloc_v0_9, TestCFree_v0_9,
+        TestDecompress_v0_9, TestDAlloc_v0_9, TestDFree_v0_9 } },
+    { algo_Gorl, GorlVersion_v0_9,
+      { GorlCompress_v0_9, GorlCAlloc_v0_9, GorlCFree_v0_9,
+        GorlDecompress_v0_9, GorlDAlloc_v0_9, GorlDFree_v0_9 } },
+    { algo_Pfor, PforVersion_v0_9,
+      { PforCompress_v0_9, PforCAlloc_v0_9, PforCFree_v0_9,
+        PforDecompress_v0_9, PforDAlloc_v0_9, PforDFree_v0_9 } },
+    { algo_Svby, SvbyVersion_v0_9,
+      { SvbyCompress_v0_9, SvbyCAlloc_v0_9, SvbyCFree_v0_9,
+        SvbyDecompress_v0_9, SvbyDAlloc_v0_9, SvbyDFree_v0_9 } },
+};
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
+Register *Register_New(void) {
+    Register *reg = calloc(1, sizeof(*reg));
+    AssertAlloc(reg);
+
+    size_t n = sizeof(builtins) / sizeof(builtins[0]);
+    for (size_t i = 0; i < n; i++) {
+        Register_Add(reg, builtins[i].Algo, builtins[i].Version,
+                     builtins[i].Funcs);
+    }
 
-Register Register_New(void) {
-    Register reg;
-    memset(&reg, 0, sizeof(reg));
     return reg;
 }
 
-void Register_Free(Register reg) {
-    U32Seq_Free(reg.Algo);
-    for (int32_t i = 0; i < reg.Version.Len; i++) {
-        int32_t len = reg.Funcs.Data[i].Len;
-        void **ptrs = reg.Funcs.Data[i].Data;
-        for (int32_t j = 0; j < len; j++) free(ptrs[j]);
-        PtrSeq_Free(reg.Funcs.Data[i]);
-    }
-    U32SeqSeq_Free(reg.Version);
-    PtrSeqSeq_Free(reg.Funcs);
+void Register_Free(Register *reg) {
+    free(reg->Entries);
+    free(reg->Newest);
+    free(reg);
 }
 
 void Register_Add(
-    Register reg, uint32_t algo, uint32_t version, RegisterFuncs funcs
+    Register *reg, uint32_t algo, uint32_t version, RegisterFuncs funcs
 ) {
-    (void) reg;
-    (void) algo;
-    (void) version;
-    (void) funcs;
+    if (2*(reg->EntryLen + 1) > reg->Cap) { registerGrow(reg); }
+    registerInsert(reg, algo, version, funcs);
+    registerUpdateNewest(reg, algo, version);
 }
 
-Decompressor Register_GetDecompressor(
-    Register reg, uint32_t algo, uint32_t version
+const RegisterFuncs *Register_Find(
+    Register *reg, uint32_t algo, uint32_t version
 ) {
-    (void) reg;
-    (void) algo;
-    (void) version;
+    if (reg->Cap == 0) { return NULL; }
 
-    Decompressor dummy;
-    return dummy;
+    uint32_t mask = (uint32_t)reg->Cap - 1;
+    for (uint32_t i = registerHash(algo, version) & mask; ; i = (i+1) & mask) {
+        RegisterEntry *e = &reg->Entries[i];
+        if (!e->Used) { return NULL; }
+        if (e->Algo == algo && e->Version == version) { return &e->Funcs; }
+    }
 }
 
-Compressor Register_GetCompressor(
-    Register reg, uint32_t algo, uint32_t version
+Decompressor Register_GetDecompressor(
+    Register *reg, uint32_t algo, uint32_t version
 ) {
-    (void) reg;
-    (void) algo;
-    (void) version;
+    const RegisterFuncs *funcs = mustFind(reg, algo, version);
+    Decompressor decomp = { .Buffer = funcs->DAlloc(),
+                            .DFunc = funcs->DFunc };
+    return decomp;
+}
 
-    Compressor dummy;
-    return dummy;
+Compressor Register_GetCompressor(
+    Register *reg, uint32_t algo, uint32_t version
+) {
+    const RegisterFuncs *funcs = mustFind(reg, algo, version);
+    Compressor comp = { .Buffer = funcs->CAlloc(), .CFunc = funcs->CFunc };
+    return comp;
 }
 
 void Register_FreeDecompressor(
-    Register reg, uint32_t algo, uint32_t version, Decompressor decomp
+    Register *reg, uint32_t algo, uint32_t version, Decompressor decomp
 ) {
-    (void) reg;
-    (void) algo;
-    (void) version;
-    (void) decomp;
+    mustFind(reg, algo, version)->DFree(decomp.Buffer);
 }
 
 void Register_FreeCompressor(
-    Register reg, uint32_t algo, uint32_t version, Compressor comp
+    Register *reg, uint32_t algo, uint32_t version, Compressor comp
 ) {
-    (void) reg;
-    (void) algo;
-    (void) version;
-    (void) comp;
+    mustFind(reg, algo, version)->CFree(comp.Buffer);
 }
 
-bool Register_Supports(Register reg, uint32_t algo, uint32_t version) {
-    (void) reg;
-    (void) algo;
-    (void) version;
+bool Register_Supports(Register *reg, uint32_t algo, uint32_t version) {
+    return Register_Find(reg, algo, version) != NULL;
+}
 
-    return false;
+uint32_t Register_Newest(Register *reg, uint32_t algo) {
+    if (reg->Cap > 0) {
+        uint32_t mask = (uint32_t)reg->Cap - 1;
+        for (uint32_t i = registerHash(algo, 0) & mask; ; i = (i+1) & mask) {
+            RegisterNewest *n = &reg->Newest[i];
+            if (!n->Used) { break; }
+            if (n->Algo == algo) { return n->Version; }
+        }
+    }
+
+    Panic("No version of algorithm %"PRIx32" has been registered.", algo);
+}
+
+/********************/
+/* Helper Functions */
+/********************/
+
+/* registerHash is a multiplicative hash. Algorithm codes are four ASCII
+ * characters, so their low bits alone are poorly distributed. */
+uint32_t registerHash(uint32_t algo, uint32_t version) {
+    uint32_t h = (algo ^ (version * 0x85ebca6bu)) * 0x9e3779b1u;
+    return h ^ (h >> 16);
+}
+
+void registerGrow(Register *reg) {
+    RegisterEntry *entries = reg->Entries;
+    RegisterNewest *newest = reg->Newest;
+    int32_t cap = reg->Cap;
+
+    reg->Cap = cap == 0 ? registerMIN_CAP : 2*cap;
+    reg->Entries = calloc((size_t)reg->Cap, sizeof(*reg->Entries));
+    reg->Newest = calloc((size_t)reg->Cap, sizeof(*reg->Newest));
+    AssertAlloc(reg->Entries);
+    AssertAlloc(reg->Newest);
+    reg->EntryLen = 0;
+    reg->NewestLen = 0;
+
+    for (int32_t i = 0; i < cap; i++) {
+        if (entries[i].Used) {
+            registerInsert(reg, entries[i].Algo, entries[i].Version,
+                           entries[i].Funcs);
+        }
+        if (newest[i].Used) {
+            registerUpdateNewest(reg, newest[i].Algo, newest[i].Version);
+        }
+    }
+
+    free(entries);
+    free(newest);
+}
+
+void registerInsert(
+    Register *reg, uint32_t algo, uint32_t version, RegisterFuncs funcs
+) {
+    uint32_t mask = (uint32_t)reg->Cap - 1;
+    for (uint32_t i = registerHash(algo, version) & mask; ; i = (i+1) & mask) {
+        RegisterEntry *e = &reg->Entries[i];
+        if (!e->Used) {
+            e->Used = true;
+            e->Algo = algo;
+            e->Version = version;
+            e->Funcs = funcs;
+            reg->EntryLen++;
+            return;
+        } else if (e->Algo == algo && e->Version == version) {
+            e->Funcs = funcs;
+            return;
+        }
+    }
 }
 
-uint32_t Register_Newest(Register reg, uint32_t algo) {
-    (void) reg;
-    (void) algo;
-    
-    return 0;
+void registerUpdateNewest(Register *reg, uint32_t algo, uint32_t version) {
+    uint32_t mask = (uint32_t)reg->Cap - 1;
+    for (uint32_t i = registerHash(algo, 0) & mask; ; i = (i+1) & mask) {
+        RegisterNewest *n = &reg->Newest[i];
+        if (!n->Used) {
+            n->Used = true;
+            n->Algo = algo;
+            n->Version = version;
+            reg->NewestLen++;
+            return;
+        } else if (n->Algo == algo) {
+            if (semver_Greater(version, n->Version)) { n->Version = version; }
+            return;
+        }
+    }
+}
+
+const RegisterFuncs *mustFind(Register *reg, uint32_t algo, uint32_t version) {
+    const RegisterFuncs *funcs = Register_Find(reg, algo, version);
+    if (funcs == NULL) {
+        Panic("v%d.%d of algorithm %"PRIx32" is not supported.",
+              semver_Major(version), semver_Minor(version), algo);
+    }
+    return funcs;
 }
@@ -6,11 +6,9 @@
 #include "types.h"
 #include "seq.h"
 
-typedef struct Register {
-    U32Seq Algo;
-    U32SeqSeq Version;
-    PtrSeqSeq Funcs;
-} Register;
+/* register.h contains the table which maps (algorithm, version) pairs to the
+ * functions that implement them. Lookups are a hash and a short probe, so
+ * they are cheap enough to be done once per block. */
 
 typedef struct RegisterFuncs {
     CFunc CFunc;
@@ -21,31 +19,63 @@ typedef struct RegisterFuncs {
     void (*DFree)(void *);
 } RegisterFuncs;
 
-Register Register_New(void);
+typedef struct RegisterEntry {
+    uint32_t Algo, Version;
+    bool Used;
+    RegisterFuncs Funcs;
+} RegisterEntry;
+
+/* RegisterNewest caches the highest registered version of each algorithm. */
+typedef struct RegisterNewest {
+    uint32_t Algo, Version;
+    bool Used;
+} RegisterNewest;
+
+typedef struct Register {
+    /* Both tables use open addressing with linear probing. Cap is always a
+     * power of two and the tables are kept at most half full. */
+    RegisterEntry *Entries;
+    RegisterNewest *Newest;
+    int32_t EntryLen, NewestLen, Cap;
+} Register;
+
+/* Register_New returns a register containing every built-in algorithm. */
+Register *Register_New(void);
 
-void Register_Free(Register reg);
+void Register_Free(Register *reg);
 
+/* Register_Add adds an algorithm to reg, replacing any functions previously
+ * registered for the same (algo, version) pair. */
 void Register_Add(
-    Register reg, uint32_t algo, uint32_t version, RegisterFuncs funcs
+    Register *reg, uint32_t algo, uint32_t version, RegisterFuncs funcs
+);
+
+/* Register_Find returns the functions for the given algorithm, or NULL if it
+ * has not been registered. The pointer is invalidated by Register_Add. */
+const RegisterFuncs *Register_Find(
+    Register *reg, uint32_t algo, uint32_t version
 );
 
 Compressor Register_GetCompressor(
-    Register reg, uint32_t algo, uint32_t version
+    Register *reg, uint32_t algo, uint32_t version
 );
 
 Decompressor Register_GetDecompressor(
-    Register reg, uint32_t algo, uint32_t version
+    Register *reg, uint32_t algo, uint32_t version
 );
 
 void Register_FreeDecompressor(
-    Register reg, uint32_t algo, uint32_t version, Decompressor decomp
+    Register *reg, uint32_t algo, uint32_t version, Decompressor decomp
 );
 
 void Register_FreeCompressor(
-    Register reg, uint32_t algo, uint32_t version, Compressor comp
+    Register *reg, uint32_t algo, uint32_t version, Compressor comp
 );
 
-bool Register_Supports(Register reg, uint32_t algo, uint32_t version);
-uint32_t Register_Newest(Register reg, uint32_t algo);
+bool Register_Supports(Register *reg, uint32_t algo, uint32_t version);
+
+/* Register_Newest returns the highest registered version of algo. It Panics
+ * if no version of algo has been registered. */
+uint32_t Register_Newest(Register *reg, uint32_t algo);
 
 #endif
@@ -0,0 +1,267 @@
+#include <inttypes.h>
+#include <string.h>
+
+#include "segstream.h"
+#include "funcs.h"
+#include "quant.h"
+#include "debug.h"
+#include "util.h"
+#include "stream.h"
+
+/************************/
+/* Forward Declarations */
+/************************/
+
+int64_t particleBytes(FieldHeader hd, Accuracy acc);
+void writeBlock(SegWriter *w, int32_t n);
+int64_t readFull(SegReader *r, uint8_t *bytes, int64_t len);
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
+SegWriter *SegWriter_New(
+    FieldHeader *hds, Accuracy *accs, int32_t fieldLen,
+    int64_t maxBytes, WriteFunc write, void *ctx
+) {
+    SegWriter *w = calloc(1, sizeof(*w));
+    AssertAlloc(w);
+
+    int64_t bytes = 0;
+    for (int32_t i = 0; i < fieldLen; i++) {
+        bytes += particleBytes(hds[i], accs[i]);
+    }
+
+    int64_t blockLen = bytes == 0 ? INT32_MAX : maxBytes / bytes;
+    if (blockLen > INT32_MAX) { blockLen = INT32_MAX; }
+    /* Keeping blocks aligned with the block index makes box queries over
+     * concatenated streams behave the same as over whole segments. */
+    if (blockLen >= quant_BLOCK_LEN) {
+        blockLen -= blockLen % quant_BLOCK_LEN;
+    }
+    if (blockLen < 1) {
+        Panic("A SegWriter needs at least %"PRId64" bytes, but was given "
+              "%"PRId64".", bytes, maxBytes);
+    }
+
+    w->BlockLen = (int32_t) blockLen;
+    w->Write = write;
+    w->Ctx = ctx;
+    w->Buffered = calloc((size_t)fieldLen, sizeof(*w->Buffered));
+    AssertAlloc(w->Buffered);
+
+    w->Block.FieldLen = fieldLen;
+    w->Block.Fields = calloc((size_t)fieldLen, sizeof(*w->Block.Fields));
+    AssertAlloc(w->Block.Fields);
+
+    for (int32_t i = 0; i < fieldLen; i++) {
+        Field *f = &w->Block.Fields[i];
+        f->Hd = hds[i];
+        f->Hd.ParticleLen = w->BlockLen;
+        f->Acc = accs[i];
+        f->Valid = true;
+
+        uint32_t code = f->Hd.FieldCode;
+        float *deltas = NULL;
+        if (code == field_Posn) {
+            deltas = ((PositionAccuracy*)f->Acc)->Deltas;
+        } else if (code == field_Velc) {
+            deltas = ((VelocityAccuracy*)f->Acc)->Deltas;
+        } else if (code == field_Unsf) {
+            deltas = ((FloatAccuracy*)f->Acc)->Deltas;
+        }
+        if (deltas != NULL) {
+            Panic("Field %"PRId32" has per-particle accuracies, which "
+                  "cannot be streamed.", i);
+        }
+
+        f->Data = calloc(
+            (size_t)quant_Dims(code)*(size_t)w->BlockLen,
+            quant_RawSize(code)
+        );
+        AssertAlloc(f->Data);
+    }
+
+    w->Comps = LoadCompressors(w->Block);
+
+    return w;
+}
+
+int32_t SegWriter_BlockLen(SegWriter *w) {
+    return w->BlockLen;
+}
+
+int32_t SegWriter_Push(
+    SegWriter *w, int32_t field, void *data, int32_t len, int32_t start
+) {
+    DebugAssert(field >= 0 && field < w->Block.FieldLen) {
+        Panic("Field %"PRId32" pushed to a SegWriter with %"PRId32
+              " fields.", field, w->Block.FieldLen);
+    }
+
+    Field *f = &w->Block.Fields[field];
+    int32_t buffered = w->Buffered[field];
+    int32_t n = len - start;
+    if (n > w->BlockLen - buffered) { n = w->BlockLen - buffered; }
+    if (n <= 0) { return 0; }
+
+    uint32_t code = f->Hd.FieldCode;
+    size_t size = quant_RawSize(code);
+    for (int32_t d = 0; d < quant_Dims(code); d++) {
+        memcpy((uint8_t*)f->Data +
+               ((size_t)d*(size_t)w->BlockLen + (size_t)buffered)*size,
+               (uint8_t*)data + ((size_t)d*(size_t)len + (size_t)start)*size,
+               (size_t)n*size);
+    }
+    w->Buffered[field] += n;
+
+    for (int32_t i = 0; i < w->Block.FieldLen; i++) {
+        if (w->Buffered[i] < w->BlockLen) { return n; }
+    }
+    writeBlock(w, w->BlockLen);
+
+    return n;
+}
+
+void SegWriter_Close(SegWriter *w) {
+    int32_t n = w->Block.FieldLen > 0 ? w->Buffered[0] : 0;
+    for (int32_t i = 1; i < w->Block.FieldLen; i++) {
+        if (w->Buffered[i] != n) {
+            Panic("SegWriter closed with %"PRId32" particles in field 0, "
+                  "but %"PRId32" in field %"PRId32".",
+                  n, w->Buffered[i], i);
+        }
+    }
+    if (n > 0) { writeBlock(w, n); }
+
+    FreeCompressors(w->Block, w->Comps);
+    for (int32_t i = 0; i < w->Block.FieldLen; i++) {
+        free(w->Block.Fields[i].Data);
+    }
+    free(w->Block.Fields);
+    free(w->Buffered);
+    free(w);
+}
+
+SegReader *SegReader_New(ReadFunc read, void *ctx) {
+    SegReader *r = calloc(1, sizeof(*r));
+    AssertAlloc(r);
+    r->Bytes = U8BigSeq_Empty();
+    r->Read = read;
+    r->Ctx = ctx;
+    return r;
+}
+
+bool SegReader_Next(SegReader *r, Seg *s) {
+    uint8_t lenBytes[8];
+    int64_t read = readFull(r, lenBytes, 8);
+    if (read == 0) { return false; }
+    if (read != 8) {
+        Panic("Stream ended %"PRId64" bytes into a block header.", read);
+    }
+
+    int64_t len;
+    stream_Reader lenReader = stream_NewReader(
+        U8BigSeq_WrapArray(lenBytes, 8)
+    );
+    stream_Read(&lenReader, &len, 8, 8);
+
+    if (r->Bytes.Cap < len) {
+        U8BigSeq_Free(r->Bytes);
+        r->Bytes = U8BigSeq_New(len);
+    }
+    read = readFull(r, r->Bytes.Data, len);
+    if (read != len) {
+        Panic("Stream ended %"PRId64" bytes into a %"PRId64" byte block.",
+              read, len);
+    }
+
+    CSeg cs = FromBytes(U8BigSeq_Sub(r->Bytes, 0, len));
+    Decompressor *decomps = LoadDecompressors(cs);
+    QSeg qs = Decompress(cs, decomps);
+    *s = UndoQuantize(qs);
+
+    FreeDecompressors(cs, decomps);
+    QSeg_Free(qs);
+    CSeg_Free(cs);
+
+    return true;
+}
+
+void SegReader_Free(SegReader *r) {
+    U8BigSeq_Free(r->Bytes);
+    free(r);
+}
+
+/********************/
+/* Helper Functions */
+/********************/
+
+/* particleBytes is an upper bound on the number of bytes a single particle
+ * of the given field needs while a block is in flight: the buffered input,
+ * its quantized form, the compressed field, and the serialized block. The
+ * quantized size uses the widest element the field's accuracy allows. */
+int64_t particleBytes(FieldHeader hd, Accuracy acc) {
+    Field f;
+    memset(&f, 0, sizeof(f));
+    f.Hd = hd;
+    f.Acc = acc;
+
+    uint32_t code = hd.FieldCode;
+    int64_t raw = quant_Dims(code) * (int64_t) quant_RawSize(code);
+    int64_t quantized = quant_QDims(code) * (int64_t) quant_MaxElemSize(f);
+    return raw + 3*quantized;
+}
+
+void writeBlock(SegWriter *w, int32_t n) {
+    /* Partial blocks need their planes moved next to each other so that the
+     * buffers match the Field.Data layout for n particles. */
+    for (int32_t i = 0; i < w->Block.FieldLen; i++) {
+        Field *f = &w->Block.Fields[i];
+        uint32_t code = f->Hd.FieldCode;
+        size_t size = quant_RawSize(code);
+        for (int32_t d = 1; d < quant_Dims(code) && n < w->BlockLen; d++) {
+            memmove((uint8_t*)f->Data + (size_t)d*(size_t)n*size,
+                    (uint8_t*)f->Data + (size_t)d*(size_t)w->BlockLen*size,
+                    (size_t)n*size);
+        }
+        f->Hd.ParticleLen = n;
+        w->Buffered[i] = 0;
+    }
+
+    QSeg qs = Quantize(w->Block);
+    CSeg cs = Compress(qs, w->Comps);
+    SegSlices slices = ToSlices(cs);
+
+    uint64_t len = util_U64LittleEndian((uint64_t) slices.Bytes);
+    uint8_t lenBytes[8];
+    memcpy(lenBytes, &len, 8);
+
+    if (w->Write(w->Ctx, lenBytes, 8) != 8) {
+        Panic("Could not write a %"PRId64" byte block.", slices.Bytes);
+    }
+    for (int32_t i = 0; i < slices.SliceLen; i++) {
+        ByteSlice slice = slices.Slices[i];
+        if (w->Write(w->Ctx, slice.Data, slice.Len) != slice.Len) {
+            Panic("Could not write a %"PRId64" byte block.", slices.Bytes);
+        }
+    }
+
+    SegSlices_Free(slices);
+    CSeg_Free(cs);
+    QSeg_Free(qs);
+
+    for (int32_t i = 0; i < w->Block.FieldLen; i++) {
+        w->Block.Fields[i].Hd.ParticleLen = w->BlockLen;
+    }
+}
+
+int64_t readFull(SegReader *r, uint8_t *bytes, int64_t len) {
+    int64_t total = 0;
+    while (total < len) {
+        int64_t n = r->Read(r->Ctx, bytes + total, len - total);
+        if (n <= 0) { break; }
+        total += n;
+    }
+    return total;
+}
@@ -0,0 +1,79 @@
+#ifndef MNW_SEGSTREAM_H_
+#define MNW_SEGSTREAM_H_
+
+/* segstream.h contains a streaming segment compressor, SegWriter, and its
+ * matching decompressor, SegReader. A SegWriter accepts particles in chunks
+ * of any size and emits compressed blocks as soon as every field has a full
+ * block buffered, so the memory it uses is capped no matter how many
+ * particles pass through it.
+ *
+ * The stream is a sequence of blocks. Each block is an eight byte little
+ * endian length followed by that many bytes of ToBytes output. */
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "seq.h"
+
+/* WriteFunc writes len bytes to some destination and returns the number of
+ * bytes written. ctx is passed through unchanged. */
+typedef int64_t (*WriteFunc)(void *ctx, uint8_t *bytes, int64_t len);
+
+/* ReadFunc reads up to len bytes from some source and returns the number of
+ * bytes read, or zero at the end of the source. ctx is passed through
+ * unchanged. */
+typedef int64_t (*ReadFunc)(void *ctx, uint8_t *bytes, int64_t len);
+
+typedef struct SegWriter {
+    Seg Block; /* Field data points to buffers of BlockLen particles. */
+    Compressor *Comps;
+    int32_t *Buffered;
+    int32_t BlockLen;
+    WriteFunc Write;
+    void *Ctx;
+} SegWriter;
+
+typedef struct SegReader {
+    U8BigSeq Bytes;
+    ReadFunc Read;
+    void *Ctx;
+} SegReader;
+
+/* SegWriter_New creates a streaming compressor for segments with the given
+ * field headers and accuracies. The ParticleLen values of the headers are
+ * ignored. The writer will use roughly maxBytes bytes of memory. Per-particle
+ * accuracies (non-NULL Deltas) are not supported. */
+SegWriter *SegWriter_New(
+    FieldHeader *hds, Accuracy *accs, int32_t fieldLen,
+    int64_t maxBytes, WriteFunc write, void *ctx
+);
+
+/* SegWriter_BlockLen returns the number of particles in each block written
+ * by w. */
+int32_t SegWriter_BlockLen(SegWriter *w);
+
+/* SegWriter_Push copies particles [start, len) of a chunk of the given field
+ * into w and returns the number copied. data has the same layout as
+ * Field.Data for a field of length len. If fewer than len - start particles
+ * are copied, the other fields must be pushed before this one can continue,
+ * so chunks are usually pushed round-robin until every field is done. */
+int32_t SegWriter_Push(
+    SegWriter *w, int32_t field, void *data, int32_t len, int32_t start
+);
+
+/* SegWriter_Close writes any partially filled block and frees w. Every field
+ * must have been given the same number of particles. */
+void SegWriter_Close(SegWriter *w);
+
+/* SegReader_New creates a decompressor for a stream written by a
+ * SegWriter. */
+SegReader *SegReader_New(ReadFunc read, void *ctx);
+
+/* SegReader_Next decompresses the next block of the stream into *s and
+ * returns true, or returns false if the stream has ended. *s should be freed
+ * with Seg_Free. */
+bool SegReader_Next(SegReader *r, Seg *s);
+
+void SegReader_Free(SegReader *r);
+
+#endif /* MNW_SEGSTREAM_H_ */
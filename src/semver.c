@@ -2,10 +2,6 @@
 #include "debug.h"
 #include <string.h>
 
-typedef struct {
-    uint8_t stage, major, minor, patch;
-} semver;
-
 bool semver_Greater(uint32_t v1, uint32_t v2) {
     return (v1 & 0xffffff) > (v2 & 0xffffff);
 }
@@ -58,7 +54,7 @@ uint32_t semver_FromString(char *s) {
               "than three digits in the version numbers).", s);
     }
 
-    memcpy(numBuf, s, n);
+    memcpy(numBuf, s, (size_t)i);
     numBuf[i] = '\0';
 
     int major, minor, patch;
@@ -77,13 +73,13 @@ uint32_t semver_FromString(char *s) {
     if (i == n) {        
         stage = 4;
     } else {
-        if (!strcmp(s + i, "dev")) {
+        if (!strcmp(s + i + 1, "dev")) {
             stage = 0;
-        } else if (!strcmp(s + i, "alpha")) {
+        } else if (!strcmp(s + i + 1, "alpha")) {
             stage = 1;
-        } else if (!strcmp(s + i, "beta")) {
+        } else if (!strcmp(s + i + 1, "beta")) {
             stage = 2;
-        } else if (!strcmp(s + i, "rc")) {
+        } else if (!strcmp(s + i + 1, "rc")) {
             stage = 3;
         } else {
             Panic("Did not recognize stage string in %s.", s);
@@ -95,7 +91,7 @@ uint32_t semver_FromString(char *s) {
 }
 
 enum semver_Stage semver_Stage(uint32_t version) {
-    switch (((semver*)&version)->stage) {
+    switch (version >> 24) {
     case 0:
         return semver_DEV;
     case 1:
@@ -112,13 +108,13 @@ enum semver_Stage semver_Stage(uint32_t version) {
 }
 
 uint8_t semver_Patch(uint32_t version) {
-    return ((semver*)&version)->patch;
+    return (uint8_t) version;
 }
 
 uint8_t semver_Minor(uint32_t version) {
-    return ((semver*)&version)->minor;
+    return (uint8_t) (version >> 8);
 }
 
 uint8_t semver_Major(uint32_t version) {
-    return ((semver*)&version)->major;
+    return (uint8_t) (version >> 16);
 }
@@ -10,6 +10,7 @@ GENERATE_SEQ_BODY(int32_t, I32Seq, I32BigSeq)
 
 GENERATE_SEQ_BODY(uint64_t, U64Seq, U64BigSeq)
 GENERATE_SEQ_BODY(uint32_t, U32Seq, U32BigSeq)
+GENERATE_SEQ_BODY(uint16_t, U16Seq, U16BigSeq)
 GENERATE_SEQ_BODY(uint8_t, U8Seq, U8BigSeq)
 
 GENERATE_SEQ_BODY(FSeq, FSeqSeq, FBigSeqSeq)
@@ -11,6 +11,7 @@ GENERATE_SEQ_HEADER(int32_t, I32Seq, I32BigSeq)
 
 GENERATE_SEQ_HEADER(uint64_t, U64Seq, U64BigSeq)
 GENERATE_SEQ_HEADER(uint32_t, U32Seq, U32BigSeq)
+GENERATE_SEQ_HEADER(uint16_t, U16Seq, U16BigSeq)
 GENERATE_SEQ_HEADER(uint8_t, U8Seq, U8BigSeq)
 
 GENERATE_SEQ_HEADER(FSeq, FSeqSeq, FBigSeqSeq)
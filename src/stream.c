@@ -3,6 +3,16 @@
 #include "util.h"
 #include "string.h"
 
+/************************/
+/* Forward Declarations */
+/************************/
+
+void toLittleEndian(uint8_t *bytes, size_t n, size_t elemSize);
+
+/**********************/
+/* Exported Functions */
+/**********************/
+
 stream_Writer stream_NewWriter() {
     return U8BigSeq_New(0);
 }
@@ -10,101 +20,88 @@ stream_Writer stream_NewWriter() {
 stream_Reader stream_NewReader(U8BigSeq bytes) {
     stream_Reader reader = {
         .Bytes = bytes,
-        .offset = 0,
+        .Offset = 0,
     };
 
     return reader;
 }
 
 void stream_Read(
-    stream_Reader reader, void *ptr, size_t bytes, size_t elemSize
+    stream_Reader *reader, void *ptr, size_t bytes, size_t elemSize
 ) {
-    DebugAssert(bytes % elemSize) {
+    DebugAssert(bytes % elemSize == 0) {
         Panic("elemSize %zu does not evenly divide byte number %zu.",
               elemSize, bytes);
     }
+    DebugAssert(reader->Offset + bytes <= (size_t)reader->Bytes.Len) {
+        Panic("Reading %zu bytes at offset %zu would overrun a stream of "
+              "%zu bytes.", bytes, reader->Offset,
+              (size_t)reader->Bytes.Len);
+    }
 
-    memcpy(ptr, reader.Bytes.Data + reader.offset, bytes);
-    reader.offset += bytes;
+    if (bytes == 0) { return; }
 
-    size_t dataLen = bytes / elemSize;
+    memcpy(ptr, reader->Bytes.Data + reader->Offset, bytes);
+    reader->Offset += bytes;
 
-    switch (bytes) {
-    case 1:
-        break;
-    case 4:
-        ;
-        uint32_t *data32 = (uint32_t*)ptr;
-        for (int64_t i = 0; i < (int64_t)dataLen; i++) {
-            util_U32LittleEndian(data32[i]);
-        }
-        break;
-    case 8:
-        ;
-        uint64_t *data64 = (uint64_t*)ptr;
-        for (int64_t i = 0; i < (int64_t)dataLen; i++) {
-            util_U64LittleEndian(data64[i]);
-        }
-        break;
-    default:
-        Panic("Unsupported elemSize, %zu.", elemSize);
-    }
+    toLittleEndian(ptr, bytes, elemSize);
 }
 
 void stream_Write(
-    stream_Writer writer, void *ptr, size_t bytes, size_t elemSize
+    stream_Writer *writer, void *ptr, size_t bytes, size_t elemSize
 ) {
-    DebugAssert(bytes % elemSize) {
+    DebugAssert(bytes % elemSize == 0) {
         Panic("elemSize %zu does not evenly divide byte number %zu.",
               elemSize, bytes);
     }
 
-    size_t dataLen = bytes / elemSize;
+    if (bytes == 0) { return; }
 
-    /* We can't do this within the stream itself because the current point
-     * in the stream might not be aligned correctly. */
-    switch (bytes) {
-    case 1:
-        break;
-    case 4:
-        ;
-        uint32_t *data32 = (uint32_t*)ptr;
-        for (int64_t i = 0; i < (int64_t)dataLen; i++) {
-            util_U32LittleEndian(data32[i]);
-        }
-        break;
-    case 8:
-        ;
-        uint64_t *data64 = (uint64_t*)ptr;
-        for (int64_t i = 0; i < (int64_t)dataLen; i++) {
-            util_U64LittleEndian(data64[i]);
-        }
-        break;
-    default:
-        Panic("Unsupported elemSize, %zu.", elemSize);
-    }
+    int64_t start = writer->Len;
+    *writer = U8BigSeq_Join(
+        *writer, U8BigSeq_WrapArray(ptr, (int64_t)bytes)
+    );
 
-    writer = U8BigSeq_Join(writer, U8BigSeq_WrapArray(ptr, (int64_t)bytes));
+    /* The conversion is done on the copy so that ptr is left alone. */
+    toLittleEndian(writer->Data + start, bytes, elemSize);
+}
 
-    switch (bytes) {
+/********************/
+/* Helper Functions */
+/********************/
+
+/* toLittleEndian converts n bytes of elemSize-byte elements between native
+ * and little endian order in place. memcpy is used because the elements might
+ * not be aligned. */
+void toLittleEndian(uint8_t *bytes, size_t n, size_t elemSize) {
+    switch (elemSize) {
     case 1:
         break;
+    case 2:
+        for (size_t i = 0; i < n; i += 2) {
+            uint16_t x;
+            memcpy(&x, bytes + i, 2);
+            x = util_U16LittleEndian(x);
+            memcpy(bytes + i, &x, 2);
+        }
+        break;
     case 4:
-        ;
-        uint32_t *data32 = (uint32_t*)ptr;
-        for (int64_t i = 0; i < (int64_t)dataLen; i++) {
-            util_U32UndoLittleEndian(data32[i]);
+        for (size_t i = 0; i < n; i += 4) {
+            uint32_t x;
+            memcpy(&x, bytes + i, 4);
+            x = util_U32LittleEndian(x);
+            memcpy(bytes + i, &x, 4);
         }
         break;
     case 8:
-        ;
-        uint64_t *data64 = (uint64_t*)ptr;
-        for (int64_t i = 0; i < (int64_t)dataLen; i++) {
-            util_U64UndoLittleEndian(data64[i]);
+        for (size_t i = 0; i < n; i += 8) {
+            uint64_t x;
+            memcpy(&x, bytes + i, 8);
+            x = util_U64LittleEndian(x);
+            memcpy(bytes + i, &x, 8);
         }
         break;
     default:
         Panic("Unsupported elemSize, %zu.", elemSize);
     }
-    return;
 }
@@ -1,11 +1,14 @@
-#ifndef _MNW_STREAM_H
-#define _MIN_STREAM_H
+#ifndef MNW_STREAM_H_
+#define MNW_STREAM_H_
 
 #include "seq.h"
 
+/* stream.h contains simple byte streams which convert multi-byte values to
+ * and from little endian ordering as they are read and written. */
+
 typedef struct stream_Reader {
     U8BigSeq Bytes;
-    size_t offset;
+    size_t Offset;
 } stream_Reader;
 
 typedef U8BigSeq stream_Writer;
@@ -13,12 +16,18 @@ typedef U8BigSeq stream_Writer;
 stream_Writer stream_NewWriter();
 stream_Reader stream_NewReader(U8BigSeq bytes);
 
+/* stream_Read reads bytes bytes from the reader into ptr, treating them as
+ * elements of size elemSize when converting from little endian, and advances
+ * the reader. */
 void stream_Read(
-    stream_Reader reader, void *ptr, size_t bytes, size_t elemSize
+    stream_Reader *reader, void *ptr, size_t bytes, size_t elemSize
 );
 
+/* stream_Write appends bytes bytes from ptr to the writer, treating them as
+ * elements of size elemSize when converting to little endian. ptr is not
+ * modified. */
 void stream_Write(
-    stream_Writer writer, void *ptr, size_t bytes, size_t elemSize
+    stream_Writer *writer, void *ptr, size_t bytes, size_t elemSize
 );
 
 #endif
@@ -18,6 +18,9 @@
 #define algo_Octo 0x4f63746f
 #define algo_Sort 0x536f7274
 #define alog_Cart 0x43617274
+#define algo_Gorl 0x476f726c
+#define algo_Pfor 0x50666f72
+#define algo_Svby 0x53766279
 
 /* YOLO strats: redo everything. */
 
@@ -35,6 +38,10 @@ typedef struct FloatAccuracy {
     int32_t Log10Scaled; /* 0 = not log scaled
                           1 = log10 scaled
                           2 = symlog10 scaled */
+    /* If Lossless is set, the field's bits are stored exactly and Delta,
+     * Deltas, and the log scaling are ignored. Decoded fields have a Delta of
+     * zero. */
+    int32_t Lossless;
 } FloatAccuracy;
 
 typedef uint8_t IntAccuracy; /* Does nothing. */
@@ -43,6 +50,9 @@ typedef struct PositionAccuracy {
     float *Deltas; /* NULL, if Len = 0. */
     float Delta, Width;
     int32_t Len;
+    int32_t Lagrangian; /* 1 = store each particle's displacement from the
+                           lattice site given by its ID. The segment must
+                           also have a field_Ptid field. */
 } PositionAccuracy;
 
 typedef struct VelocityAccuracy {
@@ -67,10 +77,12 @@ typedef void *Quantization;
 
 /* struct field meanings are the same as in FloatAccuracy. However, minnow
  * has the freedom to change Acc.Delta and Acc.Deltas to smaller values (e.g.
- * to help with alignment). */
+ * to help with alignment). If Fast is set, the field was log scaled with the
+ * fast approximations in util.h and is decoded with their inverses. Otherwise
+ * libm's log10f and powf are used in both directions. */
 typedef struct FloatQuantization {
     uint8_t *Depths;
-    int32_t Len, Log10Scaled;
+    int32_t Len, Log10Scaled, Double, Lossless, Fast;
     float SymLog10Threshold, X0, X1;
     uint8_t Depth;
 } FloatQuantization;
@@ -79,25 +91,65 @@ typedef struct IntQuantization {
     uint64_t X0, X1;
 } IntQuantization;
 
+/* In addition to the usual quantization information, PositionQuantization
+ * keeps a block index: the bounding box of each contiguous run of BlockLen
+ * particles. Block b spans BlockX0[3*b + dim] to BlockX1[3*b + dim], in the
+ * same (unwrapped) coordinates as X0 and X1. The last block may be short.
+ *
+ * Positions and velocities are both stored relative to their block: the
+ * bin index of component dim of a particle in block b is its stored value
+ * plus BlockOffsets[3*b + dim]. Bins are the same size everywhere, but the
+ * stored values only need to span each block's local spread, and each
+ * block is packed at its own width: BlockWidths[b] is the size in bytes (2,
+ * 4, or 8) of block b's stored values. Each plane of QField.Data is then its
+ * blocks one after another, each padded to a multiple of eight bytes, and
+ * ElemSize is the largest of the widths (see quant_NextRun). BlockOffsets and
+ * BlockWidths are NULL if Blocks is 0, in which case indices are stored
+ * directly in ElemSize-byte elements.
+ *
+ * If Lagrangian is set, the quantized values are displacements from each
+ * particle's lattice site and X0 and X1 bound those displacements. The block
+ * bounds are still in position space so that boxes can be found.
+ *
+ * If Double is set (here or in FloatQuantization), the field was quantized
+ * from doubles: bins are found in double precision, depths can be as large
+ * as 53, and X0, X1, and the block bounds are rounded outwards to floats. */
 typedef struct PositionQuantization {
     uint8_t *Depths;
-    int32_t Len;
+    int32_t Len, Lagrangian, Double;
     float Width, X0[3], X1[3];
     uint8_t Depth;
+    float *BlockX0, *BlockX1;
+    uint64_t *BlockOffsets;
+    uint8_t *BlockWidths;
+    int32_t BlockLen, Blocks;
 } PositionQuantization;
 
+/* Each velocity component is binned over its own range, X0[dim] to
+ * X1[dim], with Shifts[dim] fewer bits than Depth (or Depths[i]), floored at
+ * zero. Depth and Depths are the depths of the widest component. Fast means
+ * the same thing as in FloatQuantization. */
 typedef struct VelocityQuantization {
     uint8_t *Depths;
-    int32_t Len, SymLog10Scaled;
+    int32_t Len, SymLog10Scaled, Fast;
     float X0[3], X1[3];
     float SymLog10Threshold;
-    uint8_t Depth;
+    uint8_t Depth, Shifts[3];
+    uint64_t *BlockOffsets;
+    uint8_t *BlockWidths;
+    int32_t BlockLen, Blocks;
 } VelocityQuantization;
 
 typedef struct IDQuantization {
     uint64_t Width, X0[3], X1[3];
 } IDQuantization;
 
+/* Box is an axis-aligned region of space running from X0 to X1. */
+
+typedef struct Box {
+    float X0[3], X1[3];
+} Box;
+
 /* Fields */
 
 typedef struct FieldHeader {
@@ -107,17 +159,44 @@ typedef struct FieldHeader {
     int32_t ParticleLen;
 } FieldHeader;
 
+/* Layouts of Field.Data for three-component fields (positions and
+ * velocities). Only the quantizer reads Field.Layout.Kind: decoded fields are
+ * always layout_SoA. */
+#define layout_SoA 0 /* Every x, then every y, then every z. */
+#define layout_AoS 1 /* Each particle's x, y, and z in turn, i.e. x[N][3]. */
+#define layout_Axes 2 /* A separate array for each component. */
+
+typedef struct FieldLayout {
+    int32_t Kind;
+    /* For layout_AoS, the number of values between the x components of
+     * consecutive particles. 0 is treated as 3, but larger values let Data
+     * point into an array of structs. */
+    int32_t Stride;
+    float *Axes[3]; /* For layout_Axes, in place of Data. */
+    /* If Double is set, Data (or Axes) holds doubles instead of floats and
+     * the field may be stored with more than 24 bits per component. Only
+     * non-Lagrangian field_Posn fields and field_Unsf fields without log
+     * scaling support this. Decoded fields set it if they hold doubles. */
+    int32_t Double;
+} FieldLayout;
+
 typedef struct Field {
     FieldHeader Hd;
     int64_t Valid;
     void *Data;
     Accuracy Acc;
+    FieldLayout Layout; /* Zeroed fields are layout_SoA. */
 } Field;
 
+/* QField.Data is stored in the narrowest of uint16_t, uint32_t, and uint64_t
+ * that can hold the field's quantized values. ElemSize is the width of that
+ * type in bytes. Fields with a block index pack each block at its own width
+ * instead, and ElemSize is the widest of those. */
 typedef struct QField {
     FieldHeader Hd;
     int64_t Valid;
-    uint64_t *Data;
+    void *Data;
+    int32_t ElemSize;
     Quantization Quant;
 } QField;
 
@@ -162,4 +241,19 @@ typedef struct CSeg {
     int32_t FieldLen;
 } CSeg;
 
+/* Serialized segments */
+
+typedef struct ByteSlice {
+    uint8_t *Data;
+    int64_t Len;
+} ByteSlice;
+
+/* SegSlices is a serialized segment split into pieces which are written out
+ * back-to-back. Bytes is the sum of the slice lengths. */
+typedef struct SegSlices {
+    ByteSlice *Slices;
+    int32_t SliceLen;
+    int64_t Bytes;
+} SegSlices;
+
 #endif
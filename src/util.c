@@ -2,9 +2,67 @@
 #include "debug.h"
 #include "lz4.h"
 #include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
 #include <inttypes.h>
 #include <math.h>
 #include <float.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+/* log10(2) split so that multiplying the high part by an exponent is exact. */
+#define utilLOG10_2_HI 0.301025390625f
+#define utilLOG10_2_LO 4.6050389e-6f
+#define utilLOG10_E 0.43429448f
+#define utilLN10 2.3025851f
+#define utilLOG2_10 3.3219281f
+#define utilSQRT2 1.4142135f
+/* Adding and subtracting this rounds a float to the nearest integer. */
+#define utilROUND_MAGIC 12582912.0f
+/* util_UndoSymLog10 works through blocks of this size on the stack. */
+#define utilEXP10_BLOCK 256
+
+/* utilSVB_LEN is the byte length of value j in a StreamVByte control byte, c.
+ * Codes 0, 1, 2, and 3 mean 0, 1, 2, and 4 bytes. */
+#define utilSVB_CODE(c, j) (((c) >> (2*(j))) & 3)
+#define utilSVB_LEN(c, j) \
+    (utilSVB_CODE(c, j) == 3 ? 4 : utilSVB_CODE(c, j))
+
+#if defined(__SSSE3__)
+/* utilSVB_OFF is the offset of value j within control byte c's data. */
+#define utilSVB_OFF(c, j) \
+    (((j) > 0 ? utilSVB_LEN(c, 0) : 0) + ((j) > 1 ? utilSVB_LEN(c, 1) : 0) + \
+     ((j) > 2 ? utilSVB_LEN(c, 2) : 0) + ((j) > 3 ? utilSVB_LEN(c, 3) : 0))
+/* utilSVB_SHUFFLE gives the byte of the data which goes to byte k of lane j
+ * when decoding, with 0x80 meaning zero. */
+#define utilSVB_SHUFFLE(c, j, k) \
+    ((k) < utilSVB_LEN(c, j) ? utilSVB_OFF(c, j) + (k) : 0x80)
+#define utilSVB_LANE(c, j) \
+    utilSVB_SHUFFLE(c, j, 0), utilSVB_SHUFFLE(c, j, 1), \
+    utilSVB_SHUFFLE(c, j, 2), utilSVB_SHUFFLE(c, j, 3)
+#define utilSVB_ROW(c) \
+    { utilSVB_LANE(c, 0), utilSVB_LANE(c, 1), \
+      utilSVB_LANE(c, 2), utilSVB_LANE(c, 3) }
+#define utilSVB_BYTES(c) utilSVB_OFF(c, 4)
+#define utilSVB_REP4(f, c) f(c), f(c + 1), f(c + 2), f(c + 3)
+#define utilSVB_REP16(f, c) \
+    utilSVB_REP4(f, c), utilSVB_REP4(f, c + 4), \
+    utilSVB_REP4(f, c + 8), utilSVB_REP4(f, c + 12)
+#define utilSVB_REP64(f, c) \
+    utilSVB_REP16(f, c), utilSVB_REP16(f, c + 16), \
+    utilSVB_REP16(f, c + 32), utilSVB_REP16(f, c + 48)
+#define utilSVB_REP256(f) \
+    utilSVB_REP64(f, 0), utilSVB_REP64(f, 64), \
+    utilSVB_REP64(f, 128), utilSVB_REP64(f, 192)
+
+/* utilSvbShuffle and utilSvbBytes are the shuffle masks and data lengths of
+ * every control byte. */
+static const uint8_t utilSvbShuffle[256][16] = {
+    utilSVB_REP256(utilSVB_ROW)
+};
+static const uint8_t utilSvbBytes[256] = { utilSVB_REP256(utilSVB_BYTES) };
+#endif
 
 /************************/
 /* Forward Declarations */
@@ -12,11 +70,17 @@
 
 void checkBinIndexRange(FSeq x, float x0, float dx);
 U8Seq U8SeqSetLen(U8Seq buf, int32_t len);
+U16Seq U16SeqSetLen(U16Seq buf, int32_t len);
 U32Seq U32SeqSetLen(U32Seq buf, int32_t len);
 U64Seq U64SeqSetLen(U64Seq buf, int32_t len);
 FSeq FSeqSetLen(FSeq buf, int32_t len);
 bool littleEndian();
 
+float fastLog10(float x);
+bool fastLog10Ok(float x);
+float fastExp10(float x);
+bool fastExp10Ok(float x);
+
 void U32EndianSwap(U32Seq x);
 void U64EndianSwap(U64Seq x);
 
@@ -45,6 +109,25 @@ void util_MinMax(FSeq x, float *minPtr, float *maxPtr) {
     *minPtr = min;
 }
 
+void util_DMinMax(DSeq x, double *minPtr, double *maxPtr) {
+    int32_t n = x.Len;
+    double *xs = x.Data;
+
+    DebugAssert(n > 0) {
+        Panic("Empty sequence given to util_DMinMax.%s", "");
+    }
+
+    double min = xs[0];
+    double max = xs[0];
+    for (int32_t i = 1; i < n; i++) {
+        if (xs[i] > max) { max = xs[i]; }
+        if (xs[i] < min) { min = xs[i]; }
+    }
+
+    *maxPtr = max;
+    *minPtr = min;
+}
+
 void util_U64MinMax(U64Seq x, uint64_t *minPtr, uint64_t *maxPtr) {
     int64_t n = x.Len;
     uint64_t *xs = x.Data;
@@ -112,6 +195,52 @@ void util_UndoPeriodic(FSeq x, float L) {
     }
 }
 
+void util_DUndoPeriodic(DSeq x, double L) {
+    if (x.Len == 0) { return; }
+
+    int32_t n = x.Len;
+    double *xs = x.Data;
+    double x0 = xs[0];
+
+    for (int32_t i = 0; i < n; i++) {
+        if (xs[i] - x0 >= L/2) {
+            xs[i] -= L;
+        } else if (xs[i] - x0  < -L/2) {
+            xs[i] += L;
+        }
+    }
+}
+
+void util_U32UndoPeriodic(U32Seq x, uint32_t L) {
+    DebugAssert(INT32_MAX/2 > L) {
+        Panic("L range of %"PRIu32" not supported by util_U32UndoPeriodic.", L);
+    }
+
+    if (x.Len == 0) { return; }
+
+    int32_t n = x.Len;
+    int32_t *xs = (int32_t*)x.Data;
+    int32_t x0 = xs[0];
+    int32_t iL = (int32_t) L;
+
+    for (int32_t i = 1; i < n; i++) {
+        if (xs[i] - x0 >= iL/2) {
+            xs[i] -= iL;
+        } else if (xs[i] - x0  < -iL/2) {
+            xs[i] += iL;
+        }
+    }
+
+    int32_t min = x0;
+    for (int32_t i = 1; i < n; i++) {
+        if (xs[i] < min) { min = xs[i]; }
+    }
+
+    if (min < 0) {
+        for (int32_t i = 0; i < n; i++) { xs[i] += iL; }
+    }
+}
+
 void util_U64UndoPeriodic(U64Seq x, uint64_t L) {
     DebugAssert(INT64_MAX/2 > L) {
         Panic("L range of %"PRIu64" not supported by util_U32UndoPeriodic.", L);
@@ -142,100 +271,198 @@ void util_U64UndoPeriodic(U64Seq x, uint64_t L) {
     }
 }
 
-U64Seq util_BinIndex(FSeq x, U8Seq level, float x0, float dx, U64Seq buf) {
-    DebugAssert(x.Len == level.Len) {
-        Panic("BinIndex given x with length %"PRId32", but level with length %"
-              PRId32".", x.Len, level.Len);
-    }
-
-    buf = U64SeqSetLen(buf, x.Len);
-    
+/* The BinIndex functions are identical for every output width, so they are
+ * generated by a macro in the same way that the sequence types are. */
+#define GENERATE_BIN_INDEX(type, seqType, prefix) \
+    seqType prefix##BinIndex( \
+        FSeq x, U8Seq level, float x0, float dx, seqType buf \
+    ) { \
+        DebugAssert(x.Len == level.Len) { \
+            Panic("BinIndex given x with length %"PRId32", but level with " \
+                  "length %"PRId32".", x.Len, level.Len); \
+        } \
+        buf = seqType##SetLen(buf, x.Len); \
+        for (int32_t i = 0; i < x.Len; i++) { \
+            DebugAssert(level.Data[i] <= 8*sizeof(type)) { \
+                Panic("level[%"PRId32"] set to %"PRIu8", which is above " \
+                      "the limit of %d.", i, level.Data[i], \
+                      (int) (8*sizeof(type))); \
+            } \
+            float delta = (x.Data[i] - x0) / dx; \
+            if (delta < 0) { /* must be floating point error */ \
+                buf.Data[i] = 0; \
+            } else if (delta >= 1) { /* must be floating point error */ \
+                buf.Data[i] = (type) ((1<<(uint32_t)level.Data[i]) - 1); \
+            } else { \
+                buf.Data[i] = (type) (delta * (float) (1 << level.Data[i])); \
+            } \
+        } \
+        return buf; \
+    } \
+    seqType prefix##UniformBinIndex( \
+        FSeq x, uint8_t level, float x0, float dx, seqType buf \
+    ) { \
+        DebugAssert(level <= 8*sizeof(type)) { \
+            Panic("level set to %"PRIu8", which is above the limit of %d.", \
+                  level, (int) (8*sizeof(type))); \
+        } \
+        buf = seqType##SetLen(buf, x.Len); \
+        float numBins = (float) (1 << level); \
+        for (int32_t i = 0; i < x.Len; i++) { \
+            float delta = (x.Data[i] - x0) / dx; \
+            if (delta < 0) { /* must be floating point error */ \
+                buf.Data[i] = 0; \
+            } else if (delta >= 1) { /* must be floating point error */ \
+                buf.Data[i] = (type) ((1<<(uint32_t)level) - 1); \
+            } else { \
+                buf.Data[i] = (type) (delta * numBins); \
+            } \
+        } \
+        return buf; \
+    } \
+    FSeq prefix##UndoBinIndex( \
+        seqType idx, U8Seq level, float x0, float dx, \
+        rand_State *state, FSeq buf \
+    ) { \
+        DebugAssert(idx.Len == level.Len) { \
+            Panic("UndoBinIndex given idx with length %"PRId32", but level " \
+                  "with length %"PRId32".", idx.Len, level.Len); \
+        } \
+        buf = FSeqSetLen(buf, idx.Len); \
+        for (int32_t i = 0; i < idx.Len; i++) { \
+            uint64_t bins = ((uint64_t) 1 << (uint64_t) level.Data[i]); \
+            DebugAssert(idx.Data[i] < bins) { \
+                Panic("At index %"PRId32", idx = %"PRIu64", which is >= to " \
+                      "the level, 2^%"PRIu8".", i, (uint64_t) idx.Data[i], \
+                      level.Data[i]); \
+            } \
+        } \
+        if (state == NULL) { \
+            for (int32_t i = 0; i < idx.Len; i++) { \
+                uint64_t bins = ((uint64_t) 1 << (uint64_t) level.Data[i]); \
+                float binWidth = dx / ((float) bins); \
+                buf.Data[i] = x0 + binWidth*((float)idx.Data[i] + 0.5f); \
+            } \
+            return buf; \
+        } \
+        for (int32_t i = 0; i < idx.Len; i++) { \
+            uint64_t bins = ((uint64_t) 1 << (uint64_t) level.Data[i]); \
+            float binWidth = dx / ((float) bins); \
+            float offset = x0 + binWidth*((float)idx.Data[i]); \
+            buf.Data[i] = offset + rand_Float(state)*binWidth; \
+        } \
+        return buf; \
+    } \
+    FSeq prefix##UndoUniformBinIndex( \
+        seqType idx, uint8_t level, float x0, float dx, \
+        rand_State *state, FSeq buf \
+    ) { \
+        buf = FSeqSetLen(buf, idx.Len); \
+        uint64_t bins = (uint64_t) 1 << (uint64_t) level; \
+        float binWidth = dx / ((float) bins); \
+        for (int32_t i = 0; i < idx.Len; i++) { \
+            DebugAssert(idx.Data[i] < bins) { \
+                Panic("At index %"PRId32", idx = %"PRIu64", which is >= to " \
+                      "the level, 2^%"PRIu8".", i, (uint64_t) idx.Data[i], \
+                      level); \
+            } \
+        } \
+        if (state == NULL) { \
+            /* A single multiply-add per element, which vectorizes. */ \
+            float center = x0 + 0.5f*binWidth; \
+            for (int32_t i = 0; i < idx.Len; i++) { \
+                buf.Data[i] = center + binWidth*(float)idx.Data[i]; \
+            } \
+            return buf; \
+        } \
+        for (int32_t i = 0; i < idx.Len; i++) { \
+            float offset = x0 + binWidth*((float)idx.Data[i]); \
+            buf.Data[i] = offset + rand_Float(state)*binWidth; \
+        } \
+        return buf; \
+    }
+
+GENERATE_BIN_INDEX(uint32_t, U32Seq, util_)
+GENERATE_BIN_INDEX(uint16_t, U16Seq, util_U16)
+
+FSeq util_Log10(FSeq x, FSeq buf) {
+    buf = FSeqSetLen(buf, x.Len);
+
+    /* The polynomial is only valid for positive normal floats, so any other
+     * inputs are flagged and redone afterwards. This keeps the main loop free
+     * of branches. */
+    bool special = false;
     for (int32_t i = 0; i < x.Len; i++) {
-        DebugAssert(level.Data[i] <= 64) {
-            Panic("level[%"PRId32"] set to %"PRIu8", which is above the "
-                  "limit of 64.", i, level.Data[i]);
-        }
+        special = special || !fastLog10Ok(x.Data[i]);
+        buf.Data[i] = fastLog10(x.Data[i]);
+    }
 
-        float delta = (x.Data[i] - x0) / dx;
-        if (delta < 0) { // must be floating point error
-            buf.Data[i] = 0;
-        } else if (delta >= 1) { // must be floating point error
-            buf.Data[i] = (1<<(uint32_t)level.Data[i]) - 1;
-        } else {
-            buf.Data[i] = (uint32_t) (delta * (float) (1 << level.Data[i]));
+    if (special) {
+        for (int32_t i = 0; i < x.Len; i++) {
+            if (!fastLog10Ok(x.Data[i])) { buf.Data[i] = log10f(x.Data[i]); }
         }
     }
 
     return buf;
 }
 
+FSeq util_Exp10(FSeq x, FSeq buf) {
+    buf = FSeqSetLen(buf, x.Len);
 
-U64Seq util_UniformBinIndex(
-    FSeq x, uint8_t level, float x0, float dx, U64Seq buf
-) {
-    DebugAssert(level <= 64) {
-        Panic("level set to %"PRIu8", which is above the "
-              "limit of 64.", level);
+    bool special = false;
+    for (int32_t i = 0; i < x.Len; i++) {
+        special = special || !fastExp10Ok(x.Data[i]);
+        buf.Data[i] = fastExp10(x.Data[i]);
     }
 
-    buf = U64SeqSetLen(buf, x.Len);
-    
-    float numBins = (float) (1 << level);
-    for (int32_t i = 0; i < x.Len; i++) {
-        float delta = (x.Data[i] - x0) / dx;
-        if (delta < 0) { // must be floating point error
-            buf.Data[i] = 0;
-        } else if (delta >= 1) { // must be floating point error
-            buf.Data[i] = (1<<(uint32_t)level) - 1;
-        } else {
-            buf.Data[i] = (uint32_t) (delta * numBins);
+    if (special) {
+        for (int32_t i = 0; i < x.Len; i++) {
+            if (!fastExp10Ok(x.Data[i])) { buf.Data[i] = powf(10, x.Data[i]); }
         }
     }
 
     return buf;
 }
 
-FSeq util_UndoBinIndex(
-    U64Seq idx, U8Seq level, float x0, float dx, rand_State *state, FSeq buf
-) {
-    DebugAssert(idx.Len == level.Len) {
-        Panic("UndoBinIndex given idx with length %"PRId32", but level with "
-              "length %"PRId32".", idx.Len, level.Len);
+FSeq util_SymLog10(FSeq x, float threshold, FSeq buf) {
+    DebugAssert(threshold > 0) {
+        Panic("util_SymLog10 given a threshold of %g.", threshold);
     }
 
-    buf = FSeqSetLen(buf, idx.Len);
-
-    for (int32_t i = 0; i < idx.Len; i++) {
-        uint64_t bins = (1 << (uint64_t) level.Data[i]);
-        DebugAssert(idx.Data[i] < bins) {
-            Panic("At index %"PRId32", idx = %"PRIu64", which is >= to "
-                  "the level, 2^%"PRIu8".", i, idx.Data[i], level.Data[i]);
-        }
+    buf = FSeqSetLen(buf, x.Len);
 
-        float binWidth = dx / ((float) bins);
-        float offset = x0 + binWidth*((float)idx.Data[i]);
-        buf.Data[i] = offset + rand_Float(state)*binWidth;
+    for (int32_t i = 0; i < x.Len; i++) {
+        buf.Data[i] = 1 + fabsf(x.Data[i]) / threshold;
+    }
+    util_Log10(buf, buf);
+    for (int32_t i = 0; i < x.Len; i++) {
+        buf.Data[i] = copysignf(buf.Data[i], x.Data[i]);
     }
 
     return buf;
 }
 
-FSeq util_UndoUniformBinIndex(
-    U64Seq idx, uint8_t level, float x0, float dx, rand_State *state, FSeq buf
-) {
+FSeq util_UndoSymLog10(FSeq x, float threshold, FSeq buf) {
+    DebugAssert(threshold > 0) {
+        Panic("util_UndoSymLog10 given a threshold of %g.", threshold);
+    }
 
-    buf = FSeqSetLen(buf, idx.Len);
-    uint64_t bins = 1 << (uint64_t) level;
-    float binWidth = dx / ((float) bins);
+    buf = FSeqSetLen(buf, x.Len);
 
-    for (int32_t i = 0; i < idx.Len; i++) {
-        DebugAssert(idx.Data[i] < bins) {
-            Panic("At index %"PRId32", idx = %"PRIu64", which is >= to "
-                  "the level, 2^%"PRIu8".", i, idx.Data[i], level);
+    /* Work through a stack buffer so that x and buf can be the same
+     * sequence. */
+    float a[utilEXP10_BLOCK];
+    for (int32_t start = 0; start < x.Len; start += utilEXP10_BLOCK) {
+        int32_t n = x.Len - start < utilEXP10_BLOCK ?
+            x.Len - start : utilEXP10_BLOCK;
+        for (int32_t i = 0; i < n; i++) { a[i] = fabsf(x.Data[start + i]); }
+        FSeq seq = FSeq_WrapArray(a, n);
+        util_Exp10(seq, seq);
+        for (int32_t i = 0; i < n; i++) {
+            buf.Data[start + i] = copysignf(
+                threshold*(a[i] - 1), x.Data[start + i]
+            );
         }
-
-        float offset = x0 + binWidth*((float)idx.Data[i]);
-        buf.Data[i] = offset + rand_Float(state)*binWidth;
     }
 
     return buf;
@@ -435,6 +662,71 @@ U8Seq util_UndoEntropyEncode(
     return buf;
 }
 
+U8Seq util_U32StreamVByte(U32Seq x, U8Seq buf) {
+    DebugAssert(x.Len <= INT32_MAX/5) {
+        Panic("%"PRId32" values given to util_U32StreamVByte.", x.Len);
+    }
+
+    int32_t ctrlLen = (x.Len + 3) / 4;
+    buf = U8SeqSetLen(buf, ctrlLen + 4*x.Len);
+    if (buf.Len == 0) { return buf; }
+
+    uint8_t *ctrl = buf.Data, *data = buf.Data + ctrlLen;
+    memset(ctrl, 0, (size_t)ctrlLen);
+    for (int32_t i = 0; i < x.Len; i++) {
+        uint32_t v = x.Data[i];
+        uint8_t code = v == 0 ? 0 : v < (1 << 8) ? 1 : v < (1 << 16) ? 2 : 3;
+        ctrl[i / 4] |= (uint8_t)(code << 2*(i % 4));
+        for (int32_t k = 0; k < utilSVB_LEN(code, 0); k++) {
+            *data++ = (uint8_t)(v >> 8*k);
+        }
+    }
+
+    return U8Seq_Sub(buf, 0, (int32_t)(data - buf.Data));
+}
+
+U32Seq util_U32UndoStreamVByte(U8Seq x, int32_t len, U32Seq buf) {
+    buf = U32SeqSetLen(buf, len);
+    if (len == 0) { return buf; }
+
+    int32_t ctrlLen = (len + 3) / 4;
+    const uint8_t *ctrl = x.Data, *data = x.Data + ctrlLen;
+    const uint8_t *end = x.Data + x.Len;
+    int32_t i = 0;
+
+#if defined(__SSSE3__)
+    /* Each group of four values is one unaligned load and one shuffle. The
+     * load may read past the group, so the last few groups are left to the
+     * scalar loop. */
+    for (; i + 4 <= len && end - data >= 16; i += 4) {
+        uint8_t c = ctrl[i / 4];
+        __m128i in = _mm_loadu_si128((const __m128i*)(const void*)data);
+        __m128i mask = _mm_loadu_si128(
+            (const __m128i*)(const void*)utilSvbShuffle[c]
+        );
+        _mm_storeu_si128(
+            (__m128i*)(void*)(buf.Data + i), _mm_shuffle_epi8(in, mask)
+        );
+        data += utilSvbBytes[c];
+    }
+#endif
+
+    for (; i < len; i++) {
+        int32_t n = utilSVB_LEN(ctrl[i / 4], i % 4);
+        uint32_t v = 0;
+        for (int32_t k = 0; k < n; k++) { v |= (uint32_t)data[k] << 8*k; }
+        buf.Data[i] = v;
+        data += n;
+    }
+
+    DebugAssert(data <= end) {
+        Panic("util_U32UndoStreamVByte read past the end of its input.%s",
+              "");
+    }
+
+    return buf;
+}
+
 uint32_t util_Checksum(U8BigSeq bytes) {
     uint32_t checksum = 1;
     for (int64_t i = 0; i < bytes.Len; i++) {
@@ -444,6 +736,15 @@ uint32_t util_Checksum(U8BigSeq bytes) {
     return checksum;
 }
 
+uint16_t util_U16LittleEndian(uint16_t x) {
+    if (littleEndian()) { return x; }
+    return (uint16_t) ((x << 8) | (x >> 8));
+}
+
+uint16_t util_U16UndoLittleEndian(uint16_t x) {
+    return util_U16LittleEndian(x);
+}
+
 uint32_t util_U32LittleEndian(uint32_t x) {
     if (littleEndian()) { return x; }
 
@@ -517,12 +818,70 @@ float util_FUndoLittleEndian(float x)  {
 /* Helper Functions */
 /********************/
 
+/* fastLog10 computes log10 of a positive normal float. It splits
+ * x = m*2^e with m in [sqrt(1/2), sqrt(2)) and evaluates
+ * ln(m) = 2 atanh(t), t = (m - 1)/(m + 1), as an odd series in t. |t| < 0.172,
+ * so the truncated terms are below 1e-9. */
+float fastLog10(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int32_t e = (int32_t)((bits >> 23) & 0xff) - 127;
+    bits = (bits & 0x7fffff) | 0x3f800000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+
+    int32_t big = m > utilSQRT2;
+    m = big ? 0.5f*m : m;
+    e += big;
+
+    float t = (m - 1) / (m + 1), t2 = t*t;
+    float lnM = 2*t*(1 + t2*(1.0f/3 + t2*(1.0f/5 + t2*(1.0f/7 + t2*(1.0f/9)))));
+    float fe = (float)e;
+    return fe*utilLOG10_2_HI + (fe*utilLOG10_2_LO + lnM*utilLOG10_E);
+}
+
+bool fastLog10Ok(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    uint32_t e = bits >> 23;
+    return e != 0 && e < 0xff;
+}
+
+/* fastExp10 computes 10^x by splitting x = n*log10(2) + r with |r| below
+ * log10(2)/2, evaluating 10^r = e^(r ln(10)) as a Taylor series, and
+ * scaling by 2^n through the exponent bits. */
+float fastExp10(float x) {
+    float n = (x*utilLOG2_10 + utilROUND_MAGIC) - utilROUND_MAGIC;
+    float r = (x - n*utilLOG10_2_HI) - n*utilLOG10_2_LO;
+    float z = r*utilLN10;
+    float p = 1 + z*(1 + z*(1.0f/2 + z*(1.0f/6 + z*(1.0f/24 + z*(1.0f/120 +
+              z*(1.0f/720 + z*(1.0f/5040 + z*(1.0f/40320))))))));
+
+    int32_t e = (int32_t)n + 127;
+    e = e < 1 ? 1 : (e > 254 ? 254 : e);
+    uint32_t bits = (uint32_t)e << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p*scale;
+}
+
+bool fastExp10Ok(float x) {
+    /* 10^x stays normal after scaling by 2^n with some margin. */
+    return x > -37.5f && x < 38.2f;
+}
+
 U8Seq U8SeqSetLen(U8Seq buf, int32_t len) {
     buf = U8Seq_Extend(buf, len);
     buf = U8Seq_Sub(buf, 0, len);
     return buf;
 }
 
+U16Seq U16SeqSetLen(U16Seq buf, int32_t len) {
+    buf = U16Seq_Extend(buf, len);
+    buf = U16Seq_Sub(buf, 0, len);
+    return buf;
+}
+
 U32Seq U32SeqSetLen(U32Seq buf, int32_t len) {
     buf = U32Seq_Extend(buf, len);
     buf = U32Seq_Sub(buf, 0, len);
@@ -12,6 +12,7 @@
 
 /* util_MinMax computes the minimum and maximum of a sequence. */
 void util_MinMax(FSeq x, float *minPtr, float *maxPtr);
+void util_DMinMax(DSeq x, double *minPtr, double *maxPtr);
 void util_U64MinMax(U64Seq x, uint64_t *minPtr, uint64_t *maxPtr);
 
 /* util_Periodic applies periodic boundary conditions of length L to a
@@ -23,6 +24,8 @@ void util_U64Periodic(U64Seq x, uint64_t L);
 /* util_UndoPeriodic reverses a call to Periodic so that all all values are 
  * within a contiguous range. */
 void util_UndoPeriodic(FSeq x, float L);
+void util_DUndoPeriodic(DSeq x, double L);
+void util_U32UndoPeriodic(U32Seq x, uint32_t L);
 void util_U64UndoPeriodic(U64Seq x, uint64_t L);
 
 /* util_BinIndex returns the bin indices of a sequence of floats, x, 
@@ -36,28 +39,73 @@ void util_U64UndoPeriodic(U64Seq x, uint64_t L);
  *
  * The BinIndex functions are the only steps in any Minnow encoding algorithm
  * which lose information. */
-U64Seq util_BinIndex(FSeq x, U8Seq level, float x0, float dx, U64Seq buf);
+U32Seq util_BinIndex(FSeq x, U8Seq level, float x0, float dx, U32Seq buf);
 /* util_UniformBinIndex is identical to util_BinIndex, but uses the same value
  * of level for every element of x. */
-U64Seq util_UniformBinIndex(
-    FSeq x, uint8_t level, float x0, float dx, U64Seq buf
+U32Seq util_UniformBinIndex(
+    FSeq x, uint8_t level, float x0, float dx, U32Seq buf
+);
+/* util_U16BinIndex and util_U16UniformBinIndex are identical to their 32-bit
+ * counterparts, but write to 16-bit indices. level may not exceed 16. */
+U16Seq util_U16BinIndex(FSeq x, U8Seq level, float x0, float dx, U16Seq buf);
+U16Seq util_U16UniformBinIndex(
+    FSeq x, uint8_t level, float x0, float dx, U16Seq buf
 );
 
 /* util_UndoBinIndex reverses the results of a call to util_BinIndex. The
  * resultant floats will be uniformly distributed within their respective bins.
- * A buffer sequence may be passed to this function to prevent unneeded heap
- * allocations. You may not assume that a reference to this buffer continues
- * to exist after the end of this function call.
+ * If state is NULL, the center of each bin is returned instead, which is
+ * deterministic and much faster. A buffer sequence may be passed to this
+ * function to prevent unneeded heap allocations. You may not assume that a
+ * reference to this buffer continues to exist after the end of this function
+ * call.
  *
  * The UndoBinIndex functions are the only steps in any Minnow decoding
  * algorithm which lose information. */
 FSeq util_UndoBinIndex(
-    U64Seq idx, U8Seq level, float x0, float dx, rand_State *state, FSeq buf
+    U32Seq idx, U8Seq level, float x0, float dx, rand_State *state, FSeq buf
 );
 FSeq util_UndoUniformBinIndex(
-    U64Seq idx, uint8_t level, float x0, float dx, rand_State *state, FSeq buf
+    U32Seq idx, uint8_t level, float x0, float dx, rand_State *state, FSeq buf
+);
+FSeq util_U16UndoBinIndex(
+    U16Seq idx, U8Seq level, float x0, float dx, rand_State *state, FSeq buf
+);
+FSeq util_U16UndoUniformBinIndex(
+    U16Seq idx, uint8_t level, float x0, float dx, rand_State *state, FSeq buf
 );
 
+/* util_Log10 computes log10 of every element of x with a polynomial that the
+ * compiler can vectorize. For positive normal floats, the absolute error is no
+ * more than util_LOG10_ABS_ERR + util_LOG10_REL_ERR*|log10(x)|. Other inputs
+ * are passed to log10f. A buffer sequence may be passed to this function to
+ * prevent unneeded heap allocations. You may not assume that a reference to
+ * this buffer continues to exist after the end of this function call. Passing
+ * the same sequence to both arguments will result in the calculation being
+ * done in place. */
+FSeq util_Log10(FSeq x, FSeq buf);
+#define util_LOG10_ABS_ERR 4e-8f
+#define util_LOG10_REL_ERR 1.2e-7f
+
+/* util_Exp10 computes 10^x for every element of x with a relative error of no
+ * more than util_EXP10_REL_ERR, a few ulp. Results which would overflow or be
+ * subnormal are passed to powf. The buffer works like it does for
+ * util_Log10. */
+FSeq util_Exp10(FSeq x, FSeq buf);
+#define util_EXP10_REL_ERR 3e-7f
+
+/* util_SymLog10 computes the symmetric log, sign(x)*log10(1 + |x|/threshold),
+ * of every element of x, and util_UndoSymLog10 reverses it. threshold must be
+ * positive. The error of util_SymLog10 is bounded by util_Log10's bound plus
+ * util_SYMLOG10_ABS_ERR, and the error of util_UndoSymLog10, after it has
+ * been converted back to log units, is bounded by
+ * (util_EXP10_REL_ERR + util_SYMLOG10_REL_ERR)/ln(10). The buffer works like
+ * it does for util_Log10. */
+FSeq util_SymLog10(FSeq x, float threshold, FSeq buf);
+FSeq util_UndoSymLog10(FSeq x, float threshold, FSeq buf);
+#define util_SYMLOG10_ABS_ERR 6e-8f
+#define util_SYMLOG10_REL_ERR 1.2e-7f
+
 /* utilU32TransposeBytes transforms an integer seqeunce into a byte sequence
  * where the 0th byte is the 0th byte of the 0th integer, the 1st byte is the
  * 0th byte of the 1st int, and so on. A buffer sequence may be passed to this
@@ -104,6 +152,23 @@ U32Seq util_U32UndoUniformPack(
     U32Seq x, uint8_t width, int32_t len, U32Seq buf
 );
 
+/* util_U32StreamVByte encodes a sequence of integers in a StreamVByte-style
+ * varint format. Each value gets a two-bit code giving its length, 0, 1, 2,
+ * or 4 bytes, and the codes are packed four to a control byte. The control
+ * bytes come first, followed by the significant bytes of each value in little
+ * endian order. A buffer may be supplied to this function to prevent
+ * unneccessary heap allocations. You may not assume that a reference to this
+ * buffer continues to exist after the end of this function call. */
+U8Seq util_U32StreamVByte(U32Seq x, U8Seq buf);
+
+/* util_U32UndoStreamVByte reverses the results of a call to
+ * util_U32StreamVByte. The number of elements in the original seqeunce is
+ * given by len. When compiled with SSSE3 support, four values are decoded
+ * per byte shuffle. A buffer may be supplied to this function to prevent
+ * unneccessary heap allocations. You may not assume that a reference to this
+ * buffer continues to exist after the end of this function call. */
+U32Seq util_U32UndoStreamVByte(U8Seq x, int32_t len, U32Seq buf);
+
 /* util_EntropyEncode will apply an (unspecified) entropy encoding scheme to
  * stream of data.  */
 U8Seq util_EntropyEncode(U8Seq data, U8Seq buf);
@@ -119,6 +184,7 @@ uint32_t util_Checksum(U8BigSeq bytes);
 
 /* util_*LittleEndian converts a sequence from native byte ordering into a
  * little endian format and util_*UndoLittleEndian converts back. */
+uint16_t util_U16LittleEndian(uint16_t x);
 uint32_t util_U32LittleEndian(uint32_t x);
 int32_t util_I32LittleEndian(int32_t x);
 
@@ -127,6 +193,7 @@ int64_t util_I64LittleEndian(int64_t x);
 
 float util_FLittleEndian(float x);
 
+uint16_t util_U16UndoLittleEndian(uint16_t x);
 uint32_t util_U32UndoLittleEndian(uint32_t x);
 int32_t util_I32UndoLittleEndian(int32_t x);
 
@@ -0,0 +1,369 @@
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "asyncio.h"
+#include "container.h"
+#include "context.h"
+#include "funcs.h"
+#include "rand.h"
+#include "algo_Test_v0_9.h"
+
+#define LEN(x) (int) (sizeof(x) / sizeof(x[0]))
+
+#define TEST_FILE "test/asyncio_test.min"
+
+bool testAsyncWriter();
+bool testAsyncReader();
+bool testAsyncLagrangian();
+
+Seg testSegment(int32_t len, uint64_t seed);
+bool checkSegment(Seg s, int32_t len, uint64_t seed);
+Seg lagrangianSegment(uint64_t seed);
+bool checkPositions(Field f, Seg expected);
+
+int main() {
+    bool res = true;
+
+    res = res && testAsyncWriter();
+    res = res && testAsyncReader();
+    res = res && testAsyncLagrangian();
+
+    remove(TEST_FILE);
+
+    return !res;
+}
+
+bool testAsyncWriter() {
+    bool res = true;
+
+    struct { int32_t threads, depth, segs; } tests[] = {
+        { 0, 1, 10 },
+        { 1, 1, 10 },
+        { 4, 1, 50 },
+        { 4, 8, 50 },
+        { 4, 8, 0 },
+    };
+
+    for (int i = 0; i < LEN(tests); i++) {
+        minnow_Context *ctx = minnow_NewContext(tests[i].threads);
+
+        ContainerWriter *out = ContainerWriter_New(TEST_FILE);
+        AsyncWriter *w = AsyncWriter_New(ctx, out, tests[i].depth);
+        for (int32_t j = 0; j < tests[i].segs; j++) {
+            Box box = {{(float)j, 0, 0}, {(float)j + 1, 1, 1}};
+            AsyncWriter_Write(w, testSegment(100 + j, (uint64_t)j), box);
+            if (j == tests[i].segs / 2) { AsyncWriter_Flush(w); }
+        }
+        AsyncWriter_Close(w);
+        ContainerWriter_Close(out);
+
+        ContainerReader *r = ContainerReader_New(TEST_FILE);
+        if (ContainerReader_Len(r) != tests[i].segs) {
+            fprintf(stderr, "In test %d of testAsyncWriter, wrote %"PRId32
+                    " segments, but read %"PRId64".\n",
+                    i, tests[i].segs, ContainerReader_Len(r));
+            res = false;
+        }
+
+        for (int32_t j = 0; res && j < tests[i].segs; j++) {
+            ContainerEntry e = ContainerReader_Entry(r, j);
+            CSeg cs = ContainerReader_Read(r, j);
+            Seg s = minnow_Decompress(ctx, cs);
+
+            if (e.Box.X0[0] != (float)j ||
+                !checkSegment(s, 100 + j, (uint64_t)j)) {
+                fprintf(stderr, "In test %d of testAsyncWriter, segment %"
+                        PRId32" was written out of order or corrupted.\n",
+                        i, j);
+                res = false;
+            }
+
+            Seg_Free(s);
+            CSeg_Free(cs);
+        }
+
+        ContainerReader_Free(r);
+        minnow_FreeContext(ctx);
+    }
+
+    return res;
+}
+
+bool testAsyncReader() {
+    bool res = true;
+
+    int32_t segLen = 40;
+    minnow_Context *ctx = minnow_NewContext(0);
+    ContainerWriter *out = ContainerWriter_New(TEST_FILE);
+    for (int32_t j = 0; j < segLen; j++) {
+        Seg s = testSegment(100 + j, (uint64_t)j);
+        CSeg cs = minnow_Compress(ctx, s);
+        Box box = {{0, 0, 0}, {1, 1, 1}};
+        ContainerWriter_Write(out, cs, box);
+        CSeg_Free(cs);
+        Seg_Free(s);
+    }
+    ContainerWriter_Close(out);
+    minnow_FreeContext(ctx);
+
+    int64_t segs[] = { 39, 0, 5, 6, 7, 5, 20, 21, 1, 38, 2, 3 };
+    int32_t allFields[] = { 0, 1 }, idField[] = { 1 };
+
+    struct {
+        int32_t threads, depth, fieldLen, stop;
+        int32_t *fields;
+        bool mapped;
+    } tests[] = {
+        { 0, 1, 2, LEN(segs), NULL, false },
+        { 1, 1, 2, LEN(segs), allFields, false },
+        { 4, 3, 1, LEN(segs), idField, false },
+        { 4, 16, 2, LEN(segs), NULL, true },
+        { 4, 4, 2, 2, NULL, false }, /* Freed before it finishes. */
+    };
+
+    for (int i = 0; i < LEN(tests); i++) {
+        ctx = minnow_NewContext(tests[i].threads);
+        ContainerReader *in = tests[i].mapped ?
+            ContainerReader_NewMapped(TEST_FILE) :
+            ContainerReader_New(TEST_FILE);
+        AsyncReader *r = AsyncReader_New(
+            ctx, in, segs, LEN(segs), tests[i].fields, tests[i].fieldLen,
+            tests[i].depth
+        );
+
+        int32_t n = 0;
+        Seg s;
+        while (n < tests[i].stop && AsyncReader_Next(r, &s)) {
+            int32_t len = 100 + (int32_t)segs[n];
+            Seg expected = testSegment(len, (uint64_t)segs[n]);
+
+            bool ok;
+            if (tests[i].fields == idField) {
+                ok = s.FieldLen == 1 && s.Fields[0].Valid &&
+                    s.Fields[0].Hd.FieldCode == field_Unsi &&
+                    memcmp(s.Fields[0].Data, expected.Fields[1].Data,
+                           sizeof(uint64_t)*(size_t)len) == 0;
+            } else {
+                ok = checkSegment(s, len, (uint64_t)segs[n]);
+            }
+
+            if (!ok) {
+                fprintf(stderr, "In test %d of testAsyncReader, segment %"
+                        PRId32" was returned out of order or corrupted.\n",
+                        i, n);
+                res = false;
+            }
+
+            Seg_Free(expected);
+            Seg_Free(s);
+            n++;
+        }
+
+        if (n != tests[i].stop) {
+            fprintf(stderr, "In test %d of testAsyncReader, read %"PRId32
+                    " segments, but expected %"PRId32".\n",
+                    i, n, tests[i].stop);
+            res = false;
+        }
+
+        AsyncReader_Free(r);
+        ContainerReader_Free(in);
+        minnow_FreeContext(ctx);
+    }
+
+    return res;
+}
+
+bool testAsyncLagrangian() {
+    bool res = true;
+
+    int32_t segLen = 6;
+    minnow_Context *ctx = minnow_NewContext(4);
+    ContainerWriter *out = ContainerWriter_New(TEST_FILE);
+    AsyncWriter *w = AsyncWriter_New(ctx, out, 2);
+    for (int32_t j = 0; j < segLen; j++) {
+        Box box = {{0, 0, 0}, {1, 1, 1}};
+        AsyncWriter_Write(w, lagrangianSegment((uint64_t)j), box);
+    }
+    AsyncWriter_Close(w);
+    ContainerWriter_Close(out);
+
+    ContainerReader *in = ContainerReader_New(TEST_FILE);
+    for (int32_t j = 0; j < segLen; j++) {
+        CSeg cs = ContainerReader_Read(in, j);
+        Seg s = minnow_Decompress(ctx, cs);
+        Seg expected = lagrangianSegment((uint64_t)j);
+        if (!checkPositions(s.Fields[0], expected)) {
+            fprintf(stderr, "In testAsyncLagrangian, AsyncWriter corrupted "
+                    "segment %"PRId32".\n", j);
+            res = false;
+        }
+        Seg_Free(expected);
+        Seg_Free(s);
+        CSeg_Free(cs);
+    }
+
+    /* The IDs are needed to decode the positions whether or not they are
+     * requested. */
+    int64_t segs[] = { 5, 0, 3, 1, 4, 2 };
+    int32_t posField[] = { 0 }, bothFields[] = { 1, 0 };
+    struct { int32_t fieldLen, posIndex; int32_t *fields; } tests[] = {
+        { 2, 0, NULL },
+        { 1, 0, posField },
+        { 2, 1, bothFields },
+    };
+
+    for (int i = 0; i < LEN(tests); i++) {
+        AsyncReader *r = AsyncReader_New(
+            ctx, in, segs, LEN(segs), tests[i].fields, tests[i].fieldLen, 3
+        );
+
+        int32_t n = 0;
+        Seg s;
+        while (AsyncReader_Next(r, &s)) {
+            Seg expected = lagrangianSegment((uint64_t)segs[n]);
+            if (s.FieldLen != tests[i].fieldLen ||
+                !checkPositions(s.Fields[tests[i].posIndex], expected)) {
+                fprintf(stderr, "In test %d of testAsyncLagrangian, AsyncReader"
+                        " corrupted segment %"PRId64".\n", i, segs[n]);
+                res = false;
+            }
+            Seg_Free(expected);
+            Seg_Free(s);
+            n++;
+        }
+
+        AsyncReader_Free(r);
+    }
+
+    ContainerReader_Free(in);
+    minnow_FreeContext(ctx);
+
+    return res;
+}
+
+/* testSegment returns a segment with a position and an integer field whose
+ * values are determined by seed. */
+Seg testSegment(int32_t len, uint64_t seed) {
+    rand_State *state = rand_Seed(seed, 1);
+
+    Seg s;
+    s.FieldLen = 2;
+    s.Fields = calloc(2, sizeof(*s.Fields));
+
+    FieldHeader xHd = { .FieldCode = field_Posn, .AlgoCode = algo_Test,
+                        .AlgoVersion = TestVersion_v0_9, .ParticleLen = len };
+    float *x = malloc(3*sizeof(*x)*(size_t)len);
+    for (int32_t i = 0; i < 3*len; i++) { x[i] = 100*rand_Float(state); }
+    PositionAccuracy *xAcc = calloc(1, sizeof(*xAcc));
+    xAcc->Delta = 1e-2f;
+    xAcc->Width = 100;
+    s.Fields[0].Hd = xHd;
+    s.Fields[0].Data = x;
+    s.Fields[0].Acc = xAcc;
+    s.Fields[0].Valid = true;
+
+    FieldHeader uHd = { .FieldCode = field_Unsi, .AlgoCode = algo_Test,
+                        .AlgoVersion = TestVersion_v0_9, .ParticleLen = len };
+    uint64_t *u = malloc(sizeof(*u)*(size_t)len);
+    for (int32_t i = 0; i < len; i++) { u[i] = seed*1000 + (uint64_t)i; }
+    s.Fields[1].Hd = uHd;
+    s.Fields[1].Data = u;
+    s.Fields[1].Acc = calloc(1, sizeof(IntAccuracy));
+    s.Fields[1].Valid = true;
+
+    free(state);
+    return s;
+}
+
+/* checkSegment returns true if s is a decompressed copy of
+ * testSegment(len, seed). */
+bool checkSegment(Seg s, int32_t len, uint64_t seed) {
+    Seg expected = testSegment(len, seed);
+    bool res = s.FieldLen == 2 && s.Fields[0].Valid && s.Fields[1].Valid &&
+        s.Fields[0].Hd.ParticleLen == len && s.Fields[1].Hd.ParticleLen == len;
+
+    for (int32_t i = 0; res && i < 3*len; i++) {
+        float d = fabsf(((float*)s.Fields[0].Data)[i] -
+                        ((float*)expected.Fields[0].Data)[i]);
+        if (d > 50) { d = 100 - d; }
+        res = d <= 1e-2f;
+    }
+    res = res && memcmp(s.Fields[1].Data, expected.Fields[1].Data,
+                        sizeof(uint64_t)*(size_t)len) == 0;
+
+    Seg_Free(expected);
+    return res;
+}
+
+/* lagrangianSegment returns a segment with Lagrangian positions within half
+ * a unit of their lattice sites and the IDs which give those sites. Some
+ * particles wrap around the box. */
+Seg lagrangianSegment(uint64_t seed) {
+    rand_State *state = rand_Seed(seed, 1);
+    uint64_t w = 8;
+    float L = 100;
+    int32_t len = (int32_t)(w*w*w);
+
+    Seg s;
+    s.FieldLen = 2;
+    s.Fields = calloc(2, sizeof(*s.Fields));
+
+    FieldHeader xHd = { .FieldCode = field_Posn, .AlgoCode = algo_Test,
+                        .AlgoVersion = TestVersion_v0_9, .ParticleLen = len };
+    FieldHeader idHd = { .FieldCode = field_Ptid, .AlgoCode = algo_Test,
+                         .AlgoVersion = TestVersion_v0_9, .ParticleLen = len };
+
+    uint64_t *id = malloc(sizeof(*id)*(size_t)len);
+    float *x = malloc(3*sizeof(*x)*(size_t)len);
+    for (int32_t j = 0; j < len; j++) {
+        id[j] = ((uint64_t)j*7 + seed) % (uint64_t)len;
+        uint64_t idx[3] = { id[j] % w, (id[j] / w) % w, id[j] / (w*w) };
+        for (int i = 0; i < 3; i++) {
+            float xi = (float)idx[i]*(L / (float)w) + rand_Float(state) - 0.5f;
+            if (xi < 0) { xi += L; }
+            x[(size_t)i*(size_t)len + (size_t)j] = xi;
+        }
+    }
+
+    PositionAccuracy *xAcc = calloc(1, sizeof(*xAcc));
+    xAcc->Delta = 1e-2f;
+    xAcc->Width = L;
+    xAcc->Lagrangian = 1;
+    s.Fields[0].Hd = xHd;
+    s.Fields[0].Data = x;
+    s.Fields[0].Acc = xAcc;
+    s.Fields[0].Valid = true;
+
+    IDAccuracy *idAcc = calloc(1, sizeof(*idAcc));
+    idAcc->Width = w;
+    s.Fields[1].Hd = idHd;
+    s.Fields[1].Data = id;
+    s.Fields[1].Acc = idAcc;
+    s.Fields[1].Valid = true;
+
+    free(state);
+    return s;
+}
+
+/* checkPositions returns true if f holds the positions of expected to within
+ * their accuracy. */
+bool checkPositions(Field f, Seg expected) {
+    Field e = expected.Fields[0];
+    float L = ((PositionAccuracy*)e.Acc)->Width;
+    bool res = f.Valid && f.Hd.FieldCode == field_Posn &&
+        f.Hd.ParticleLen == e.Hd.ParticleLen;
+
+    for (int32_t i = 0; res && i < 3*e.Hd.ParticleLen; i++) {
+        float d = fabsf(((float*)f.Data)[i] - ((float*)e.Data)[i]);
+        if (d > L/2) { d = L - d; }
+        res = d <= 1e-2f;
+    }
+
+    return res;
+}
@@ -9,6 +9,7 @@
 
 void FShuffle(FSeq x);
 void U32Shuffle(U32Seq x, uint32_t lim);
+void U32HeavyShuffle(U32Seq x);
 
 uint64_t MinMaxTrial_100MB(Benchmark *b) {
     FSeq x = FSeq_New((int32_t) 25e6);
@@ -231,6 +232,45 @@ uint64_t UndoUniformPackTrial_Unaligned_100MB(Benchmark *b) {
     return 0;
 }
 
+uint64_t StreamVByteTrial_100MB(Benchmark *b) {
+    U32Seq x = U32Seq_New((int32_t) 25e6);
+    U8Seq buf = U8Seq_Empty();
+    U32HeavyShuffle(x);
+
+    Benchmark_Start(b);
+
+    for (uint64_t i = 0; i < b->N; i++) {
+        buf = util_U32StreamVByte(x, buf);
+    }
+
+    Benchmark_End(b);
+
+    U32Seq_Free(x);
+    U8Seq_Free(buf);
+
+    return 0;
+}
+
+uint64_t UndoStreamVByteTrial_100MB(Benchmark *b) {
+    U32Seq x = U32Seq_New((int32_t) 25e6);
+    U8Seq buf = U8Seq_Empty();
+    U32HeavyShuffle(x);
+    buf = util_U32StreamVByte(x, buf);
+
+    Benchmark_Start(b);
+
+    for (uint64_t i = 0; i < b->N; i++) {
+        x = util_U32UndoStreamVByte(buf, (int32_t) 25e6, x);
+    }
+
+    Benchmark_End(b);
+
+    U32Seq_Free(x);
+    U8Seq_Free(buf);
+
+    return 0;
+}
+
 uint64_t FastCompressTrial_100MB(Benchmark *b) {
     FSeq x = FSeq_New((int32_t) 25e6);
     U32Seq buf = U32Seq_New(x.Len);
@@ -313,6 +353,17 @@ void U32Shuffle(U32Seq x, uint32_t lim) {
     free(s);
 }
 
+/* U32HeavyShuffle fills x with values whose bit lengths are uniform, so every
+ * StreamVByte length is common. */
+void U32HeavyShuffle(U32Seq x) {
+    rand_State *s =rand_Seed(0, 1);
+    for (int32_t i = 0; i < x.Len; i++) {
+        uint64_t lim = (uint64_t) 1 << rand_Uint63Lim(s, 33);
+        x.Data[i] = (uint32_t) rand_Uint63Lim(s, lim);
+    }
+    free(s);
+}
+
 int main() {
     
     Benchmark_Run("util_MinMax, 100 MB", &MinMaxTrial_100MB, (uint64_t) 100e6);
@@ -339,6 +390,11 @@ int main() {
                   &UndoUniformPackTrial_Unaligned_100MB, (uint64_t) 1e8);
     */
 
+    Benchmark_Run("util_U32StreamVByte, 100 MB",
+                  &StreamVByteTrial_100MB, (uint64_t) 1e8);
+    Benchmark_Run("util_U32UndoStreamVByte, 100 MB",
+                  &UndoStreamVByteTrial_100MB, (uint64_t) 1e8);
+
     Benchmark_Run("(mock) fast compress, 100 MB",
                   &FastCompressTrial_100MB, (uint64_t) 1e8);
     Benchmark_Run("(mock) undo fast compress, 100 MB",
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 
 #include "util.h"
 #include "seq.h"
@@ -21,9 +22,11 @@ bool testUniformBinIndex();
 bool testUndoUniformBinIndex();
 bool testU32UniformPack();
 bool testU32UndoPeriodic();
+bool testU32StreamVByte();
 bool testEntropyEncode();
 bool testFastUniformCompress();
 bool testLittleEndian();
+bool testLog10();
 
 bool U8SeqEqual(U8Seq s1, U8Seq s2);
 bool U32SeqEqual(U32Seq s1, U32Seq s2);
@@ -48,9 +51,11 @@ int main() {
     res = res && testUndoUniformBinIndex();
     res = res && testU32UniformPack();
     res = res && testU32UndoPeriodic();
+    res = res && testU32StreamVByte();
     res = res && testEntropyEncode();
     res = res && testFastUniformCompress();
     res = res && testLittleEndian();
+    res = res && testLog10();
 
     return !res;
 }
@@ -329,6 +334,23 @@ bool testUndoBinIndex() {
             res = false;            
         }
 
+        /* A NULL state gives bin centers. */
+        FSeq c = util_UndoBinIndex(
+            idx, level, tests[i].x0, tests[i].dx, NULL, FSeq_Empty()
+        );
+        for (int32_t j = 0; j < c.Len; j++) {
+            float width = tests[i].dx / (float)(1 << tests[i].level[j]);
+            float center = tests[i].x0 +
+                width*((float)tests[i].idx[j] + 0.5f);
+            if (c.Data[j] != center) {
+                fprintf(stderr, "In test %d of testUndoBinIndex(), element "
+                        "%"PRId32" was centered at %g, not %g.\n",
+                        i, j, c.Data[j], center);
+                res = false;
+            }
+        }
+
+        FSeq_Free(c);
         FSeq_Free(x);
         U32Seq_Free(idx2);
         U32Seq_Free(idx);
@@ -424,6 +446,22 @@ bool testUndoUniformBinIndex() {
             res = false;            
         }
 
+        FSeq c = util_UndoUniformBinIndex(
+            idx, tests[i].level, tests[i].x0, tests[i].dx, NULL, FSeq_Empty()
+        );
+        float width = tests[i].dx / (float)(1 << tests[i].level);
+        for (int32_t j = 0; j < c.Len; j++) {
+            float center = tests[i].x0 +
+                width*((float)tests[i].idx[j] + 0.5f);
+            if (c.Data[j] != center) {
+                fprintf(stderr, "In test %d of testUndoUniformBinIndex(), "
+                        "element %"PRId32" was centered at %g, not %g.\n",
+                        i, j, c.Data[j], center);
+                res = false;
+            }
+        }
+
+        FSeq_Free(c);
         FSeq_Free(x);
         U32Seq_Free(idx2);
         U32Seq_Free(idx);
@@ -585,6 +623,88 @@ bool testU32UndoPeriodic() {
     return res;
 }
 
+bool testU32StreamVByte() {
+    bool res = true;
+
+    struct {
+        uint32_t x[5];
+        int32_t xlen;
+        uint8_t coded[10];
+        int32_t clen;
+    } tests[] = {
+        {{0}, 0, {0}, 0},
+        {{0}, 1, {0}, 1},
+        {{0x12345678}, 1, {0x03, 0x78, 0x56, 0x34, 0x12}, 5},
+        {{0, 0xaa, 0xbbcc, 0x1000000}, 4,
+         {0xe4, 0xaa, 0xcc, 0xbb, 0x00, 0x00, 0x00, 0x01}, 8},
+        {{1, 1, 1, 1, 0x100}, 5,
+         {0x55, 0x02, 0x01, 0x01, 0x01, 0x01, 0x00, 0x01}, 8}
+    };
+
+    for (int i = 0; i < LEN(tests); i++) {
+        U32Seq x = U32Seq_FromArray(tests[i].x, tests[i].xlen);
+        U8Seq expected = U8Seq_FromArray(tests[i].coded, tests[i].clen);
+
+        U8Seq coded = util_U32StreamVByte(x, U8Seq_Empty());
+        U32Seq decoded = util_U32UndoStreamVByte(
+            coded, x.Len, U32Seq_Empty()
+        );
+
+        if (!U8SeqEqual(coded, expected)) {
+            fprintf(stderr, "In test %d of testU32StreamVByte, expected "
+                    "coding:\n", i);
+            U8SeqPrint(expected);
+            fprintf(stderr, "\nbut got:\n");
+            U8SeqPrint(coded);
+            fprintf(stderr, "\n");
+            res = false;
+        }
+        if (!U32SeqEqual(x, decoded)) {
+            fprintf(stderr, "In test %d of testU32StreamVByte, decoding "
+                    "didn't reverse coding.\n", i);
+            res = false;
+        }
+
+        U32Seq_Free(x);
+        U8Seq_Free(expected);
+        U8Seq_Free(coded);
+        U32Seq_Free(decoded);
+    }
+
+    /* Values with every byte length, decoded from an exactly sized copy so
+     * that reads past the end are caught. */
+    int32_t lens[] = { 3, 4, 7, 64, 1001 };
+    rand_State *state = rand_Seed(3, 1);
+    for (int i = 0; i < LEN(lens); i++) {
+        U32Seq x = U32Seq_New(lens[i]);
+        for (int32_t j = 0; j < x.Len; j++) {
+            uint64_t lim = (uint64_t)1 << rand_Uint63Lim(state, 33);
+            x.Data[j] = (uint32_t)rand_Uint63Lim(state, lim);
+        }
+
+        U8Seq coded = util_U32StreamVByte(x, U8Seq_Empty());
+        uint8_t *exact = malloc((size_t)coded.Len);
+        memcpy(exact, coded.Data, (size_t)coded.Len);
+        U32Seq decoded = util_U32UndoStreamVByte(
+            U8Seq_WrapArray(exact, coded.Len), x.Len, U32Seq_Empty()
+        );
+
+        if (!U32SeqEqual(x, decoded)) {
+            fprintf(stderr, "In random test %d of testU32StreamVByte, "
+                    "decoding didn't reverse coding.\n", i);
+            res = false;
+        }
+
+        free(exact);
+        U32Seq_Free(x);
+        U8Seq_Free(coded);
+        U32Seq_Free(decoded);
+    }
+    free(state);
+
+    return res;
+}
+
 bool testEntropyEncode() {
     char *source = "The Hitchhiker's Guide to the Galaxy has a few things to say on the subject of towels. A towel, it says, is about the most massively useful thing an interstellar hitch hiker can have.";
     U8Seq sourceSeq = U8Seq_FromArray(
@@ -732,6 +852,111 @@ bool testLittleEndian() {
 /* Helper Functions */
 /********************/
 
+bool testLog10() {
+    bool res = true;
+
+    /* Values which the polynomials don't handle. */
+    float special[] = { 0, -1, INFINITY, NAN, 1e-40f };
+    for (int i = 0; i < LEN(special); i++) {
+        FSeq x = FSeq_FromArray(&special[i], 1);
+        FSeq y = util_Log10(x, FSeq_Empty());
+        float want = log10f(special[i]);
+        if (!(y.Data[0] == want || (isnan(y.Data[0]) && isnan(want)))) {
+            fprintf(stderr, "In test %d of testLog10, log10(%g) = %g, but "
+                    "expected %g.\n", i, special[i], y.Data[0], want);
+            res = false;
+        }
+        FSeq_Free(x);
+        FSeq_Free(y);
+    }
+
+    float bigExp[] = { -45, -38, 38.5f, 40 };
+    for (int i = 0; i < LEN(bigExp); i++) {
+        FSeq x = FSeq_FromArray(&bigExp[i], 1);
+        FSeq y = util_Exp10(x, FSeq_Empty());
+        if (y.Data[0] != powf(10, bigExp[i])) {
+            fprintf(stderr, "In test %d of testLog10, 10^%g = %g, but "
+                    "expected %g.\n", i, bigExp[i], y.Data[0],
+                    powf(10, bigExp[i]));
+            res = false;
+        }
+        FSeq_Free(x);
+        FSeq_Free(y);
+    }
+
+    /* Every binade, both ends of it, and random values inside it. */
+    rand_State *state = rand_Seed(5, 1);
+    int32_t n = 100000;
+    FSeq x = FSeq_New(n);
+    for (int32_t i = 0; i < n; i++) {
+        float e = (float)((i % 252) - 126);
+        float m = (i / 252) % 3 == 0 ? 1 : 1 + rand_Float(state);
+        x.Data[i] = ldexpf(m, (int)e);
+    }
+    x.Data[0] = nextafterf(1.4142135f, 0);
+    x.Data[1] = 1.4142135f;
+    x.Data[2] = FLT_MAX;
+
+    FSeq y = util_Log10(x, FSeq_Empty());
+    for (int32_t i = 0; i < n; i++) {
+        double want = log10((double)x.Data[i]);
+        double bound = util_LOG10_ABS_ERR + util_LOG10_REL_ERR*fabs(want);
+        if (fabs(y.Data[i] - want) > bound) {
+            fprintf(stderr, "In testLog10, log10(%g) = %.9g, but expected "
+                    "%.9g.\n", x.Data[i], y.Data[i], want);
+            res = false;
+            break;
+        }
+    }
+
+    for (int32_t i = 0; i < n; i++) { y.Data[i] = 75*rand_Float(state) - 37; }
+    FSeq z = util_Exp10(y, FSeq_Empty());
+    for (int32_t i = 0; i < n; i++) {
+        double want = pow(10, (double)y.Data[i]);
+        if (fabs(z.Data[i] - want) > util_EXP10_REL_ERR*want) {
+            fprintf(stderr, "In testLog10, 10^%.9g = %.9g, but expected "
+                    "%.9g.\n", y.Data[i], z.Data[i], want);
+            res = false;
+            break;
+        }
+    }
+
+    /* The symmetric log is checked in log units, where the bounds apply. */
+    float threshold = 0.25f;
+    for (int32_t i = 0; i < n; i++) {
+        x.Data[i] = (rand_Float(state) - 0.5f)*powf(10, 8*rand_Float(state));
+    }
+    x.Data[0] = 0;
+    FSeq s = util_SymLog10(x, threshold, FSeq_Empty());
+    z = util_UndoSymLog10(s, threshold, z);
+    for (int32_t i = 0; i < n; i++) {
+        double want = log10(1 + fabs((double)x.Data[i]) / threshold);
+        want = x.Data[i] < 0 ? -want : want;
+        double got = log10(1 + fabs((double)z.Data[i]) / threshold);
+        got = z.Data[i] < 0 ? -got : got;
+
+        double mapBound = util_LOG10_ABS_ERR + util_SYMLOG10_ABS_ERR +
+            util_LOG10_REL_ERR*fabs(want);
+        double undoBound = mapBound +
+            (util_EXP10_REL_ERR + util_SYMLOG10_REL_ERR) / log(10);
+        if (fabs(s.Data[i] - want) > mapBound || fabs(got - want) > undoBound) {
+            fprintf(stderr, "In testLog10, symlog10(%g) = %.9g and was "
+                    "undone to %.9g, but expected %.9g.\n",
+                    x.Data[i], s.Data[i], z.Data[i], want);
+            res = false;
+            break;
+        }
+    }
+
+    FSeq_Free(x);
+    FSeq_Free(y);
+    FSeq_Free(z);
+    FSeq_Free(s);
+    free(state);
+
+    return res;
+}
+
 bool U8SeqEqual(U8Seq s1, U8Seq s2) {
     if (s1.Len != s2.Len) {
         return false;
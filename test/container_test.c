@@ -0,0 +1,321 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "container.h"
+#include "funcs.h"
+#include "seq.h"
+
+#define LEN(x) (int) (sizeof(x) / sizeof(x[0]))
+
+#define TEST_FILE "test/container_test.min"
+
+bool testContainer();
+bool testMappedContainer();
+bool testWriteSlices();
+bool testCoalesceRanges();
+bool testReadBatch();
+
+void writeTestFile(int32_t segLen);
+bool checkReader(ContainerReader *r, int32_t segLen, bool view,
+                 const char *name, int test);
+CSeg fakeSegment(int32_t len, uint8_t fill);
+bool cfieldEqual(CField f1, CField f2);
+
+int main() {
+    bool res = true;
+
+    res = res && testContainer();
+    res = res && testMappedContainer();
+    res = res && testWriteSlices();
+    res = res && testCoalesceRanges();
+    res = res && testReadBatch();
+
+    remove(TEST_FILE);
+
+    return !res;
+}
+
+/* 2000 segments is enough to overflow the reader's speculative tail read
+ * and exercise the second read of the index. */
+static int32_t segLens[] = { 0, 1, 3, 2000 };
+
+bool testContainer() {
+    bool res = true;
+
+    for (int i = 0; i < LEN(segLens); i++) {
+        writeTestFile(segLens[i]);
+        ContainerReader *r = ContainerReader_New(TEST_FILE);
+        res = checkReader(r, segLens[i], false, "testContainer", i) && res;
+        ContainerReader_Free(r);
+    }
+
+    return res;
+}
+
+bool testMappedContainer() {
+    bool res = true;
+
+    for (int i = 0; i < LEN(segLens); i++) {
+        writeTestFile(segLens[i]);
+        ContainerReader *r = ContainerReader_NewMapped(TEST_FILE);
+        res = checkReader(r, segLens[i], false, "testMappedContainer", i) &&
+            res;
+        res = checkReader(r, segLens[i], true, "testMappedContainer", i) &&
+            res;
+        ContainerReader_Free(r);
+    }
+
+    return res;
+}
+
+bool testWriteSlices() {
+    bool res = true;
+
+    /* More slices than fit in a single writev batch, with some empty. */
+    int32_t sliceLens[] = { 0, 1, 10, 63, 64, 65, 500 };
+
+    for (int i = 0; i < LEN(sliceLens); i++) {
+        int32_t n = sliceLens[i];
+        ByteSlice *slices = calloc((size_t)n + 1, sizeof(*slices));
+        U8BigSeq expected = U8BigSeq_New(0);
+
+        for (int32_t j = 0; j < n; j++) {
+            slices[j].Len = (j % 7 == 3) ? 0 : (j * 13) % 1000 + 1;
+            slices[j].Data = malloc((size_t)slices[j].Len + 1);
+            for (int64_t k = 0; k < slices[j].Len; k++) {
+                slices[j].Data[k] = (uint8_t)(j + k);
+            }
+            for (int64_t k = 0; k < slices[j].Len; k++) {
+                expected = U8BigSeq_Append(expected, slices[j].Data[k]);
+            }
+        }
+
+        int fd = open(TEST_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int64_t written = WriteSlices(fd, slices, n);
+        close(fd);
+
+        U8BigSeq got = U8BigSeq_New(expected.Len + 1);
+        fd = open(TEST_FILE, O_RDONLY);
+        int64_t readLen = (int64_t)read(fd, got.Data, (size_t)got.Len);
+        close(fd);
+
+        if (written != expected.Len || readLen != expected.Len ||
+            (expected.Len > 0 &&
+             memcmp(got.Data, expected.Data, (size_t)expected.Len) != 0)) {
+            fprintf(stderr, "In test %d of testWriteSlices, wrote %"PRId64
+                    " bytes and read back %"PRId64", but expected %"PRId64
+                    ".\n", i, written, readLen, expected.Len);
+            res = false;
+        }
+
+        for (int32_t j = 0; j < n; j++) { free(slices[j].Data); }
+        free(slices);
+        U8BigSeq_Free(expected);
+        U8BigSeq_Free(got);
+    }
+
+    return res;
+}
+
+bool testCoalesceRanges() {
+    bool res = true;
+
+    ByteRange ranges[] = {
+        {100, 10}, {0, 10}, {10, 5}, {20, 0}, {105, 2}, {50, 10}, {0, 10}
+    };
+
+    struct {
+        uint64_t maxGap;
+        int64_t mergedLen;
+        ByteRange merged[LEN(ranges)];
+        int64_t which[LEN(ranges)];
+    } tests[] = {
+        {0, 4, {{0, 15}, {20, 0}, {50, 10}, {100, 10}},
+         {3, 0, 0, 1, 3, 2, 0}},
+        {5, 3, {{0, 20}, {50, 10}, {100, 10}}, {2, 0, 0, 0, 2, 1, 0}},
+        {39, 2, {{0, 60}, {100, 10}}, {1, 0, 0, 0, 1, 0, 0}},
+        {UINT64_MAX, 1, {{0, 110}}, {0, 0, 0, 0, 0, 0, 0}},
+    };
+
+    for (int i = 0; i < LEN(tests); i++) {
+        ByteRange merged[LEN(ranges)];
+        int64_t which[LEN(ranges)];
+        int64_t n = CoalesceRanges(ranges, LEN(ranges), tests[i].maxGap,
+                                   merged, which);
+
+        bool ok = n == tests[i].mergedLen;
+        for (int64_t j = 0; ok && j < n; j++) {
+            ok = merged[j].Offset == tests[i].merged[j].Offset &&
+                merged[j].Bytes == tests[i].merged[j].Bytes;
+        }
+        for (int j = 0; ok && j < LEN(ranges); j++) {
+            ok = which[j] == tests[i].which[j];
+        }
+
+        if (!ok) {
+            fprintf(stderr, "In test %d of testCoalesceRanges, ranges were "
+                    "merged incorrectly.\n", i);
+            res = false;
+        }
+    }
+
+    return res;
+}
+
+bool testReadBatch() {
+    bool res = true;
+
+    int32_t segLen = 100;
+    writeTestFile(segLen);
+
+    int64_t segs[] = { 99, 0, 1, 2, 50, 2, 3, 98, 40, 41, 42, 43, 17 };
+    int32_t all[] = { 0, 1 }, swapped[] = { 1, 0 }, second[] = { 1 };
+
+    struct {
+        bool mapped;
+        int32_t *fields;
+        int32_t fieldLen;
+        uint64_t maxGap;
+        int64_t reads; /* -1 if the number of reads isn't checked. */
+    } tests[] = {
+        {false, NULL, 2, 0, -1},
+        {false, NULL, 2, UINT64_MAX, 1},
+        {false, all, 2, 1 << 10, -1},
+        {false, swapped, 2, UINT64_MAX, 2},
+        {false, second, 1, 0, -1},
+        {false, second, 1, 1 << 20, 2},
+        {true, second, 1, 0, -1},
+        {true, NULL, 2, 1 << 10, -1},
+    };
+
+    for (int i = 0; i < LEN(tests); i++) {
+        ContainerReader *r = tests[i].mapped ?
+            ContainerReader_NewMapped(TEST_FILE) :
+            ContainerReader_New(TEST_FILE);
+        ContainerBatch b = ContainerReader_ReadBatch(
+            r, segs, LEN(segs), tests[i].fields, tests[i].fieldLen,
+            tests[i].maxGap
+        );
+
+        bool ok = b.SegLen == LEN(segs);
+        if (tests[i].reads >= 0) { ok = ok && b.Reads == tests[i].reads; }
+        for (int j = 0; ok && j < LEN(segs); j++) {
+            int32_t seg = (int32_t)segs[j];
+            CSeg expected = fakeSegment(seg % 37, (uint8_t)seg);
+
+            ok = b.Segs[j].FieldLen == tests[i].fieldLen;
+            for (int32_t k = 0; ok && k < tests[i].fieldLen; k++) {
+                int32_t field = tests[i].fields == NULL ?
+                    k : tests[i].fields[k];
+                ok = cfieldEqual(b.Segs[j].Fields[k], expected.Fields[field]);
+            }
+
+            CSeg_Free(expected);
+        }
+
+        if (!ok) {
+            fprintf(stderr, "In test %d of testReadBatch, the batch was not "
+                    "read correctly.\n", i);
+            res = false;
+        }
+
+        ContainerBatch_Free(b);
+        ContainerReader_Free(r);
+    }
+
+    return res;
+}
+
+void writeTestFile(int32_t segLen) {
+    ContainerWriter *w = ContainerWriter_New(TEST_FILE);
+    for (int32_t j = 0; j < segLen; j++) {
+        CSeg cs = fakeSegment(j % 37, (uint8_t)j);
+        Box box = {{(float)j, 0, 0}, {(float)j + 1, 1, 1}};
+        ContainerWriter_Write(w, cs, box);
+        CSeg_Free(cs);
+    }
+    ContainerWriter_Close(w);
+}
+
+/* checkReader checks that r contains the segments written by writeTestFile.
+ * If view is true, segments are read with ContainerReader_View. */
+bool checkReader(ContainerReader *r, int32_t segLen, bool view,
+                 const char *name, int test) {
+    if (ContainerReader_Len(r) != segLen) {
+        fprintf(stderr, "In test %d of %s, expected %"PRId32" segments, got %"
+                PRId64".\n", test, name, segLen, ContainerReader_Len(r));
+        return false;
+    }
+
+    /* Read backwards to check that no reads depend on earlier ones. */
+    for (int32_t j = segLen - 1; j >= 0; j--) {
+        ContainerEntry e = ContainerReader_Entry(r, j);
+        if (e.ParticleLen != j % 37 || e.Box.X0[0] != (float)j ||
+            e.Box.X1[0] != (float)j + 1) {
+            fprintf(stderr, "In test %d of %s, index entry %"PRId32
+                    " is wrong.\n", test, name, j);
+            return false;
+        }
+
+        CSeg expected = fakeSegment(j % 37, (uint8_t)j);
+        CSeg cs = view ? ContainerReader_View(r, j) :
+            ContainerReader_Read(r, j);
+
+        bool equal = cs.FieldLen == expected.FieldLen;
+        for (int32_t k = 0; equal && k < cs.FieldLen; k++) {
+            equal = cfieldEqual(cs.Fields[k], expected.Fields[k]);
+        }
+
+        if (view) {
+            CSeg_FreeView(cs);
+        } else {
+            CSeg_Free(cs);
+        }
+        CSeg_Free(expected);
+
+        if (!equal) {
+            fprintf(stderr, "In test %d of %s, segment %"PRId32" was not "
+                    "read back correctly.\n", test, name, j);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* fakeSegment returns a segment with two fields whose data are filled with
+ * a byte pattern. The contents do not need to be decompressible. */
+CSeg fakeSegment(int32_t len, uint8_t fill) {
+    CSeg cs;
+    cs.FieldLen = 2;
+    cs.Fields = calloc(2, sizeof(*cs.Fields));
+
+    for (int32_t i = 0; i < cs.FieldLen; i++) {
+        CField *f = &cs.Fields[i];
+        f->Hd.FieldCode = i == 0 ? field_Posn : field_Velc;
+        f->Hd.AlgoCode = algo_Test;
+        f->Hd.ParticleLen = len;
+        f->DataLen = 3*len + i;
+        f->Data = malloc((size_t)f->DataLen + 1);
+        for (int64_t j = 0; j < f->DataLen; j++) {
+            f->Data[j] = (uint8_t)(fill + j);
+        }
+        f->Checksum = (uint32_t)fill;
+    }
+
+    return cs;
+}
+
+bool cfieldEqual(CField f1, CField f2) {
+    return memcmp(&f1.Hd, &f2.Hd, sizeof(f1.Hd)) == 0 &&
+        f1.DataLen == f2.DataLen && f1.Checksum == f2.Checksum &&
+        memcmp(f1.Data, f2.Data, (size_t)f1.DataLen) == 0;
+}
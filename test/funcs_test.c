@@ -0,0 +1,2045 @@
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "funcs.h"
+#include "register.h"
+#include "context.h"
+#include "quant.h"
+#include "segstream.h"
+#include "semver.h"
+#include "rand.h"
+#include "algo_Test_v0_9.h"
+#include "algo_Gorl_v0_9.h"
+#include "algo_Pfor_v0_9.h"
+#include "algo_Svby_v0_9.h"
+
+#define LEN(x) (int) (sizeof(x) / sizeof(x[0]))
+
+bool testRegister();
+bool testRoundTrip();
+bool testContext();
+bool testCompressMany();
+bool testDecompressInto();
+bool testCentered();
+bool testLayouts();
+bool testLocalBlocks();
+bool testVariableDepths();
+bool testLogScaled();
+bool testVelocityAxes();
+bool testIDWidths();
+bool testElemSizes();
+bool testLagrangian();
+bool testDoubles();
+bool testLossless();
+bool testPfor();
+bool testSvby();
+bool testSegStream();
+bool testBoxQuery();
+
+Seg randomSegment(int32_t len, rand_State *state);
+bool segAlmostEqual(Seg s1, Seg s2, const char *name);
+Seg sliceSegment(Seg s, int32_t start, int32_t len);
+void freeSlice(Seg s);
+int32_t boxSide(float *x, int32_t len, int32_t j, Box box, float L,
+                float margin);
+double symLog10(double x, double threshold);
+bool checkLogDecode(Field f, bool fast, int test);
+
+int main() {
+    bool res = true;
+
+    res = res && testRegister();
+    res = res && testRoundTrip();
+    res = res && testContext();
+    res = res && testCompressMany();
+    res = res && testDecompressInto();
+    res = res && testCentered();
+    res = res && testLayouts();
+    res = res && testLocalBlocks();
+    res = res && testVariableDepths();
+    res = res && testLogScaled();
+    res = res && testVelocityAxes();
+    res = res && testIDWidths();
+    res = res && testElemSizes();
+    res = res && testLagrangian();
+    res = res && testDoubles();
+    res = res && testLossless();
+    res = res && testPfor();
+    res = res && testSvby();
+    res = res && testSegStream();
+    res = res && testBoxQuery();
+
+    return !res;
+}
+
+CField dummyCompress(QField qf, void *buffer);
+QField dummyDecompress(CField cf, void *buffer);
+void *dummyAlloc(void);
+void dummyFree(void *buffer);
+
+bool testRegister() {
+    bool res = true;
+
+    Register *reg = Register_New();
+
+    if (!Register_Supports(reg, algo_Test, TestVersion_v0_9)) {
+        fprintf(stderr, "In testRegister, algo_Test v0.9 was not built in.\n");
+        res = false;
+    }
+    if (Register_Newest(reg, algo_Test) != TestVersion_v0_9) {
+        fprintf(stderr, "In testRegister, newest algo_Test is %"PRIx32".\n",
+                Register_Newest(reg, algo_Test));
+        res = false;
+    }
+
+    /* Enough entries to force several resizes. */
+    RegisterFuncs funcs = { dummyCompress, dummyAlloc, dummyFree,
+                            dummyDecompress, dummyAlloc, dummyFree };
+    char version[semver_BUF_SIZE];
+    for (uint32_t algo = 0; algo < 50; algo++) {
+        for (int32_t minor = 0; minor < 10; minor++) {
+            sprintf(version, "1.%d.0", (minor * 7) % 10);
+            Register_Add(reg, algo, semver_FromString(version), funcs);
+        }
+    }
+
+    for (uint32_t algo = 0; algo < 50; algo++) {
+        for (int32_t minor = 0; minor < 12; minor++) {
+            sprintf(version, "1.%d.0", minor);
+            bool supported = Register_Supports(
+                reg, algo, semver_FromString(version)
+            );
+            if (supported != (minor < 10)) {
+                fprintf(stderr, "In testRegister, Register_Supports(%"
+                        PRIu32", %s) = %d.\n", algo, version, supported);
+                res = false;
+            }
+        }
+
+        uint32_t newest = Register_Newest(reg, algo);
+        if (semver_Major(newest) != 1 || semver_Minor(newest) != 9) {
+            semver_ToString(newest, version);
+            fprintf(stderr, "In testRegister, Register_Newest(%"PRIu32") = "
+                    "%s, but expected 1.9.0.\n", algo, version);
+            res = false;
+        }
+    }
+
+    if (!Register_Supports(reg, algo_Test, TestVersion_v0_9)) {
+        fprintf(stderr, "In testRegister, algo_Test v0.9 was lost while "
+                "resizing.\n");
+        res = false;
+    }
+
+    Register_Free(reg);
+
+    return res;
+}
+
+bool testRoundTrip() {
+    bool res = true;
+
+    int32_t lens[] = { 1, 10, 5000 };
+    rand_State *state = rand_Seed(1, 1);
+
+    for (int i = 0; i < LEN(lens); i++) {
+        Seg s = randomSegment(lens[i], state);
+
+        QSeg qs = Quantize(s);
+        Compressor *comps = LoadCompressors(s);
+        CSeg cs = Compress(qs, comps);
+        U8BigSeq bytes = ToBytes(cs);
+        FreeCompressors(s, comps);
+        QSeg_Free(qs);
+        CSeg_Free(cs);
+
+        cs = FromBytes(bytes);
+        Decompressor *decomps = LoadDecompressors(cs);
+        qs = Decompress(cs, decomps);
+        Seg out = UndoQuantize(qs);
+        FreeDecompressors(cs, decomps);
+        QSeg_Free(qs);
+        CSeg_Free(cs);
+        U8BigSeq_Free(bytes);
+
+        if (!segAlmostEqual(s, out, "testRoundTrip")) {
+            fprintf(stderr, "  (in test %d)\n", i);
+            res = false;
+        }
+
+        Seg_Free(s);
+        Seg_Free(out);
+    }
+
+    free(state);
+
+    return res;
+}
+
+bool testContext() {
+    bool res = true;
+
+    int32_t threads[] = { 0, 1, 4 };
+    rand_State *state = rand_Seed(2, 1);
+
+    for (int i = 0; i < LEN(threads); i++) {
+        minnow_Context *ctx = minnow_NewContext(threads[i]);
+
+        for (int32_t seg = 0; seg < 20; seg++) {
+            Seg s = randomSegment(1000 + seg, state);
+
+            CSeg cs = minnow_Compress(ctx, s);
+
+            QSeg qs = Quantize(s);
+            Compressor *comps = LoadCompressors(s);
+            CSeg expected = Compress(qs, comps);
+            FreeCompressors(s, comps);
+            QSeg_Free(qs);
+
+            U8BigSeq b1 = ToBytes(cs), b2 = ToBytes(expected);
+            if (b1.Len != b2.Len ||
+                memcmp(b1.Data, b2.Data, (size_t)b1.Len) != 0) {
+                fprintf(stderr, "In test %d of testContext, segment %"PRId32
+                        " compressed differently from Compress.\n", i, seg);
+                res = false;
+            }
+            U8BigSeq_Free(b1);
+            U8BigSeq_Free(b2);
+            CSeg_Free(expected);
+
+            Seg out = minnow_Decompress(ctx, cs);
+            if (!segAlmostEqual(s, out, "testContext")) {
+                fprintf(stderr, "  (in test %d, segment %"PRId32")\n",
+                        i, seg);
+                res = false;
+            }
+
+            CSeg_Free(cs);
+            Seg_Free(s);
+            Seg_Free(out);
+        }
+
+        /* Once the arenas have grown to fit one segment, later segments of
+         * the same shape reuse them without allocating. */
+        int64_t allocs[2];
+        for (int32_t k = 0; k < 2; k++) {
+            Seg s = randomSegment(5000, state);
+            CSeg cs = minnow_Compress(ctx, s);
+            Seg out = minnow_Decompress(ctx, cs);
+            allocs[k] = 0;
+            for (int32_t j = 0; j < ctx->ArenaLen; j++) {
+                allocs[k] += ((minnow_Arena*)ctx->Arenas.Data[j])->ChunkAllocs;
+            }
+            Seg_Free(out);
+            CSeg_Free(cs);
+            Seg_Free(s);
+        }
+        if (allocs[1] != allocs[0] || ctx->ArenaLen == 0) {
+            fprintf(stderr, "In test %d of testContext, a repeated segment "
+                    "allocated %"PRId64" arena chunks across %"PRId32
+                    " arenas.\n", i, allocs[1] - allocs[0], ctx->ArenaLen);
+            res = false;
+        }
+
+        /* Allocations which spill over into several chunks are merged into
+         * one on the next reset, after which the same allocations fit. */
+        for (int32_t k = 0; k < 3; k++) {
+            minnow_Arena *a = minnow_GetArena(ctx);
+            int64_t before = a->ChunkAllocs;
+            for (int32_t j = 0; j < 3; j++) {
+                memset(minnow_ArenaAlloc(a, 40000), 0xff, 40000);
+            }
+            int64_t expected = k == 0 ? 1 : 0;
+            if (a->ChunkAllocs - before != expected ||
+                a->ChunkLen != 1 + expected) {
+                fprintf(stderr, "In test %d of testContext, pass %"PRId32
+                        " over the arena allocated %"PRId64" chunks.\n",
+                        i, k, a->ChunkAllocs - before);
+                res = false;
+            }
+            minnow_PutArena(ctx, a);
+        }
+
+        minnow_FreeContext(ctx);
+    }
+
+    free(state);
+
+    return res;
+}
+
+bool testCompressMany() {
+    bool res = true;
+
+    int32_t threads[] = { 0, 1, 4 };
+    /* Wildly different sizes, like void and halo segments. */
+    int32_t lens[] = { 10, 20000, 5, 3000, 1, 50000, 200, 7, 7, 12000 };
+    rand_State *state = rand_Seed(3, 1);
+
+    Seg segs[LEN(lens)];
+    CSeg expected[LEN(lens)];
+    minnow_Context *serial = minnow_NewContext(0);
+    for (int j = 0; j < LEN(lens); j++) {
+        segs[j] = randomSegment(lens[j], state);
+        expected[j] = minnow_Compress(serial, segs[j]);
+    }
+    minnow_FreeContext(serial);
+
+    for (int i = 0; i < LEN(threads); i++) {
+        minnow_Context *ctx = minnow_NewContext(threads[i]);
+        CSeg out[LEN(lens)];
+        minnow_CompressMany(ctx, segs, LEN(lens), out);
+
+        for (int j = 0; j < LEN(lens); j++) {
+            U8BigSeq b1 = ToBytes(out[j]), b2 = ToBytes(expected[j]);
+            if (b1.Len != b2.Len ||
+                memcmp(b1.Data, b2.Data, (size_t)b1.Len) != 0) {
+                fprintf(stderr, "In test %d of testCompressMany, segment %d "
+                        "was compressed incorrectly.\n", i, j);
+                res = false;
+            }
+            U8BigSeq_Free(b1);
+            U8BigSeq_Free(b2);
+            CSeg_Free(out[j]);
+        }
+
+        minnow_FreeContext(ctx);
+    }
+
+    /* A segment with a single large field still spreads across the pool,
+     * since the field is quantized a few blocks per task. Without that, at
+     * most two workers could run anything: one for the segment and one for
+     * its field. Which workers pick up tasks is up to the scheduler, so a
+     * few attempts are allowed. */
+    Seg big = randomSegment(64*quant_BLOCK_LEN, state);
+    Seg one = { .Fields = big.Fields, .FieldLen = 1 };
+    serial = minnow_NewContext(0);
+    CSeg oneExpected = minnow_Compress(serial, one);
+    minnow_FreeContext(serial);
+    U8BigSeq b2 = ToBytes(oneExpected);
+
+    int32_t busy = 0;
+    for (int attempt = 0; attempt < 20 && busy < 3; attempt++) {
+        minnow_Context *ctx = minnow_NewContext(4);
+        CSeg out;
+        minnow_CompressMany(ctx, &one, 1, &out);
+
+        busy = 0;
+        for (int32_t w = 0; w < ctx->Pool->ThreadLen; w++) {
+            if (ctx->Pool->Local[w].Ran > 0) { busy++; }
+        }
+
+        U8BigSeq b1 = ToBytes(out);
+        if (b1.Len != b2.Len ||
+            memcmp(b1.Data, b2.Data, (size_t)b1.Len) != 0) {
+            fprintf(stderr, "In testCompressMany, a segment with one large "
+                    "field was compressed incorrectly.\n");
+            res = false;
+        }
+        U8BigSeq_Free(b1);
+        CSeg_Free(out);
+        minnow_FreeContext(ctx);
+    }
+    if (busy < 3) {
+        fprintf(stderr, "In testCompressMany, a segment with one large field "
+                "only ran on %"PRId32" workers.\n", busy);
+        res = false;
+    }
+
+    U8BigSeq_Free(b2);
+    CSeg_Free(oneExpected);
+    Seg_Free(big);
+    for (int j = 0; j < LEN(lens); j++) {
+        Seg_Free(segs[j]);
+        CSeg_Free(expected[j]);
+    }
+    free(state);
+
+    return res;
+}
+
+bool testDecompressInto() {
+    bool res = true;
+
+    int32_t lens[] = { 1, 10, 5000 };
+    rand_State *state = rand_Seed(4, 1);
+    minnow_Context *ctx = minnow_NewContext(0);
+
+    for (int i = 0; i < LEN(lens); i++) {
+        Seg s = randomSegment(lens[i], state);
+        CSeg cs = minnow_Compress(ctx, s);
+
+        /* Swap the library's arrays for caller-owned ones so the result can
+         * be checked against s with the same accuracies. */
+        Seg out = minnow_Decompress(ctx, cs);
+        for (int32_t j = 0; j < cs.FieldLen; j++) {
+            uint32_t code = cs.Fields[j].Hd.FieldCode;
+            size_t bytes = (size_t)quant_Dims(code)*quant_RawSize(code)*
+                (size_t)lens[i];
+            void *data = malloc(bytes);
+            if (!minnow_DecompressFieldInto(ctx, cs.Fields[j], data)) {
+                fprintf(stderr, "In test %d of testDecompressInto, field %"
+                        PRId32" failed its checksum.\n", i, j);
+                res = false;
+            }
+            free(out.Fields[j].Data);
+            out.Fields[j].Data = data;
+        }
+
+        if (!segAlmostEqual(s, out, "testDecompressInto")) {
+            fprintf(stderr, "  (in test %d)\n", i);
+            res = false;
+        }
+
+        /* Corrupted fields must leave the output alone. */
+        cs.Fields[0].Data[0] ^= 0xff;
+        float sentinel = -1;
+        if (minnow_DecompressFieldInto(ctx, cs.Fields[0], &sentinel) ||
+            sentinel != -1) {
+            fprintf(stderr, "In test %d of testDecompressInto, a corrupted "
+                    "field was decoded.\n", i);
+            res = false;
+        }
+
+        CSeg_Free(cs);
+        Seg_Free(s);
+        Seg_Free(out);
+    }
+
+    minnow_FreeContext(ctx);
+    free(state);
+
+    return res;
+}
+
+bool testCentered() {
+    bool res = true;
+
+    int32_t len = 5000;
+    rand_State *state = rand_Seed(10, 1);
+    minnow_Context *ctx = minnow_NewContext(2);
+    ctx->Centered = true;
+
+    Seg s = randomSegment(len, state);
+    CSeg cs = minnow_Compress(ctx, s);
+    Seg out1 = minnow_Decompress(ctx, cs);
+    Seg out2 = minnow_Decompress(ctx, cs);
+
+    /* Bin centers are deterministic and within half a bin of the input. */
+    int32_t dims[] = { 3, 3, 0, 1 };
+    for (int32_t i = 0; i < LEN(dims); i++) {
+        size_t bytes = sizeof(float)*(size_t)dims[i]*(size_t)len;
+        if (memcmp(out1.Fields[i].Data, out2.Fields[i].Data, bytes)) {
+            fprintf(stderr, "In testCentered, field %"PRId32" was decoded "
+                    "differently twice.\n", i);
+            res = false;
+        }
+    }
+
+    ((PositionAccuracy*)s.Fields[0].Acc)->Delta /= 2;
+    ((VelocityAccuracy*)s.Fields[1].Acc)->Delta /= 2;
+    ((FloatAccuracy*)s.Fields[3].Acc)->Delta /= 2;
+    res = segAlmostEqual(s, out1, "testCentered") && res;
+
+    float *data = calloc(3*(size_t)len, sizeof(*data));
+    if (!minnow_DecompressFieldInto(ctx, cs.Fields[1], data) ||
+        memcmp(data, out1.Fields[1].Data, 3*sizeof(float)*(size_t)len)) {
+        fprintf(stderr, "In testCentered, minnow_DecompressFieldInto didn't "
+                "match minnow_Decompress.\n");
+        res = false;
+    }
+
+    free(data);
+    Seg_Free(out1);
+    Seg_Free(out2);
+    CSeg_Free(cs);
+    Seg_Free(s);
+    minnow_FreeContext(ctx);
+    free(state);
+
+    return res;
+}
+
+bool testLayouts() {
+    bool res = true;
+
+    /* Long enough for several deinterleaving blocks and a partial one. */
+    int32_t lens[] = { 1, 1000, 5000 };
+    int32_t strides[] = { 0, 3, 7 };
+    rand_State *state = rand_Seed(5, 1);
+
+    for (int i = 0; i < LEN(lens); i++) {
+        int32_t len = lens[i];
+        Seg s = randomSegment(len, state);
+
+        /* Positions and velocities are the only three-component fields. */
+        for (int32_t j = 0; j < 2; j++) {
+            Field soa = s.Fields[j];
+            float *x = soa.Data;
+            QField expected = quant_QField(soa);
+            size_t bytes = quant_DataBytes(expected);
+
+            Field layouts[LEN(strides) + 1];
+            float *aos[LEN(strides)];
+            for (int k = 0; k < LEN(strides); k++) {
+                size_t stride = strides[k] == 0 ? 3 : (size_t)strides[k];
+                aos[k] = calloc(stride*(size_t)len, sizeof(*aos[k]));
+                for (int32_t p = 0; p < len; p++) {
+                    for (int dim = 0; dim < 3; dim++) {
+                        aos[k][stride*(size_t)p + (size_t)dim] =
+                            x[(size_t)dim*(size_t)len + (size_t)p];
+                    }
+                }
+
+                layouts[k] = soa;
+                layouts[k].Data = aos[k];
+                layouts[k].Layout.Kind = layout_AoS;
+                layouts[k].Layout.Stride = strides[k];
+            }
+
+            Field *axes = &layouts[LEN(strides)];
+            *axes = soa;
+            axes->Data = NULL;
+            axes->Layout.Kind = layout_Axes;
+            for (int dim = 0; dim < 3; dim++) {
+                axes->Layout.Axes[dim] = x + (size_t)dim*(size_t)len;
+            }
+
+            for (int k = 0; k < LEN(layouts); k++) {
+                QField qf = quant_QField(layouts[k]);
+                if (qf.ElemSize != expected.ElemSize ||
+                    memcmp(qf.Data, expected.Data, bytes) != 0) {
+                    fprintf(stderr, "In test %d of testLayouts, layout %d of "
+                            "field %"PRId32" was quantized differently.\n",
+                            i, k, j);
+                    res = false;
+                }
+                quant_FreeQField(qf);
+            }
+
+            for (int k = 0; k < LEN(strides); k++) { free(aos[k]); }
+            quant_FreeQField(expected);
+        }
+
+        Seg_Free(s);
+    }
+
+    free(state);
+
+    return res;
+}
+
+bool testLocalBlocks() {
+    bool res = true;
+
+    /* Each block of particles sits in its own small cluster, so the global
+     * range needs 32-bit indices but each block only needs 16 bits, except
+     * for block 2, which has one stray particle and needs 32. */
+    int32_t blocks = 4, len = 4*quant_BLOCK_LEN - 101, wide = 2;
+    rand_State *state = rand_Seed(6, 1);
+    Seg s = randomSegment(len, state);
+
+    for (int32_t j = 0; j < 2; j++) {
+        float *x = s.Fields[j].Data;
+        for (int32_t d = 0; d < 3; d++) {
+            for (int32_t p = 0; p < len; p++) {
+                float center = (float)(15*(p / quant_BLOCK_LEN));
+                x[(size_t)d*(size_t)len + (size_t)p] =
+                    center + rand_Float(state);
+            }
+        }
+        x[wide*quant_BLOCK_LEN + 7] += 10;
+    }
+    ((PositionAccuracy*)s.Fields[0].Acc)->Delta = 1e-4f;
+    ((VelocityAccuracy*)s.Fields[1].Acc)->Delta = 1e-4f;
+
+    QSeg qs = Quantize(s);
+    for (int32_t j = 0; j < 2; j++) {
+        QField qf = qs.Fields[j];
+        uint8_t *widths = j == 0 ?
+            ((PositionQuantization*)qf.Quant)->BlockWidths :
+            ((VelocityQuantization*)qf.Quant)->BlockWidths;
+        for (int32_t b = 0; b < blocks; b++) {
+            if (widths[b] != (b == wide ? 4 : 2)) {
+                fprintf(stderr, "In testLocalBlocks, block %"PRId32" of "
+                        "field %"PRId32" was stored in %"PRIu8"-byte "
+                        "elements.\n", b, j, widths[b]);
+                res = false;
+            }
+        }
+
+        size_t uniform = 3*(size_t)len*4;
+        if (qf.ElemSize != 4 || quant_DataBytes(qf) >= uniform) {
+            fprintf(stderr, "In testLocalBlocks, field %"PRId32" has "
+                    "ElemSize = %"PRId32" and takes %zu bytes.\n",
+                    j, qf.ElemSize, quant_DataBytes(qf));
+            res = false;
+        }
+    }
+
+    Seg out = UndoQuantize(qs);
+    if (!segAlmostEqual(s, out, "testLocalBlocks")) { res = false; }
+    Seg_Free(out);
+
+    /* Every codec has to carry blocks of mixed widths, including the
+     * padding after the odd-length last block of each plane. */
+    struct {
+        CFunc c;
+        DFunc d;
+        void *(*alloc)(void);
+        void (*free)(void*);
+    } codecs[] = {
+        { TestCompress_v0_9, TestDecompress_v0_9,
+          TestCAlloc_v0_9, TestCFree_v0_9 },
+        { GorlCompress_v0_9, GorlDecompress_v0_9,
+          GorlCAlloc_v0_9, GorlCFree_v0_9 },
+        { PforCompress_v0_9, PforDecompress_v0_9,
+          PforCAlloc_v0_9, PforCFree_v0_9 },
+        { SvbyCompress_v0_9, SvbyDecompress_v0_9,
+          SvbyCAlloc_v0_9, SvbyCFree_v0_9 },
+    };
+    for (int32_t i = 0; i < LEN(codecs); i++) {
+        void *buf = codecs[i].alloc();
+        for (int32_t j = 0; j < 2; j++) {
+            CField cf = codecs[i].c(qs.Fields[j], buf);
+            QField qf = codecs[i].d(cf, buf);
+            if (qf.ElemSize != qs.Fields[j].ElemSize ||
+                memcmp(qf.Data, qs.Fields[j].Data,
+                       quant_DataBytes(qs.Fields[j])) != 0) {
+                fprintf(stderr, "In testLocalBlocks, codec %"PRId32" "
+                        "changed field %"PRId32".\n", i, j);
+                res = false;
+            }
+            quant_FreeQField(qf);
+            free(cf.Data);
+        }
+        codecs[i].free(buf);
+    }
+
+    /* Blocks pulled out on their own need the offsets of the right blocks. */
+    for (int32_t b = 0; b < blocks; b++) {
+        float center = (float)(15*b), hi = center + (b == wide ? 12 : 2);
+        Box box = {{center - 1, center - 1, center - 1}, {hi, hi, hi}};
+        int32_t start = b*quant_BLOCK_LEN;
+        int32_t n = start + quant_BLOCK_LEN > len ?
+            len - start : quant_BLOCK_LEN;
+
+        Seg expected = sliceSegment(s, start, n);
+        out = UndoQuantizeBox(qs, box, true);
+        if (!segAlmostEqual(expected, out, "testLocalBlocks")) {
+            fprintf(stderr, "  (in block %"PRId32")\n", b);
+            res = false;
+        }
+        Seg_Free(out);
+        freeSlice(expected);
+    }
+
+    QSeg_Free(qs);
+    Seg_Free(s);
+    free(state);
+
+    return res;
+}
+
+bool testVariableDepths() {
+    bool res = true;
+
+    /* Runs of repeated accuracies, followed by deltas that divide the range
+     * exactly and deltas just above and below those. */
+    int32_t len = 3000;
+    rand_State *state = rand_Seed(7, 1);
+    Seg s = randomSegment(len, state);
+    float *f = s.Fields[3].Data;
+    for (int32_t i = 0; i < len; i++) { f[i] *= 0.5f; }
+    f[0] = 0;
+    f[1] = 64;
+
+    float *deltas = malloc(sizeof(*deltas)*(size_t)len);
+    for (int32_t i = 0; i < len; i++) {
+        if (i < 1000) {
+            deltas[i] = 0.01f;
+        } else if (i < 2000) {
+            deltas[i] = 0.5f;
+        } else {
+            float exact = 64 / (float)(1 << (i % 20));
+            switch (i % 3) {
+            case 0: deltas[i] = exact; break;
+            case 1: deltas[i] = nextafterf(exact, 0); break;
+            case 2: deltas[i] = nextafterf(exact, 1e9f); break;
+            }
+        }
+    }
+    FloatAccuracy *acc = s.Fields[3].Acc;
+    acc->Deltas = deltas;
+    acc->Len = len;
+
+    QSeg qs = Quantize(s);
+    FloatQuantization *fq = qs.Fields[3].Quant;
+    float range = fq->X1 - fq->X0;
+    for (int32_t i = 0; i < len; i++) {
+        int32_t depth;
+        for (depth = 0; depth <= 24; depth++) {
+            if (deltas[i]*(float)(1 << depth) > range) { break; }
+        }
+        if (fq->Depths[i] != depth) {
+            fprintf(stderr, "In testVariableDepths, particle %"PRId32" with "
+                    "delta %g has depth %"PRIu8", but expected %"PRId32".\n",
+                    i, deltas[i], fq->Depths[i], depth);
+            res = false;
+            break;
+        }
+    }
+    QSeg_Free(qs);
+
+    minnow_Context *ctx = minnow_NewContext(0);
+    CSeg cs = minnow_Compress(ctx, s);
+    U8BigSeq bytes = ToBytes(cs);
+    CSeg read = FromBytes(bytes);
+    Seg out = minnow_Decompress(ctx, read);
+
+    float *g = out.Fields[3].Data;
+    for (int32_t i = 0; i < len; i++) {
+        if (fabsf(f[i] - g[i]) > deltas[i]) {
+            fprintf(stderr, "In testVariableDepths, particle %"PRId32" was "
+                    "decoded as %g, but expected %g +/- %g.\n",
+                    i, g[i], f[i], deltas[i]);
+            res = false;
+            break;
+        }
+    }
+
+    Seg_Free(out);
+    CSeg_Free(read);
+    U8BigSeq_Free(bytes);
+    CSeg_Free(cs);
+    minnow_FreeContext(ctx);
+    Seg_Free(s);
+    free(state);
+
+    return res;
+}
+
+bool testLogScaled() {
+    bool res = true;
+
+    /* The second delta leaves almost no slack over the log10 field's bin
+     * width, so that field should go through libm. The last test gives one
+     * particle of each field an accuracy finer than the fast maps' error, so
+     * every field should go through libm. Everything else should use the
+     * fast path. */
+    float deltas[] = { 1e-3f, 0, 0.05f, 1e-3f };
+    int32_t len = 4000;
+    rand_State *state = rand_Seed(8, 1);
+    minnow_Context *ctx = minnow_NewContext(0);
+
+    for (int i = 0; i < LEN(deltas); i++) {
+        Seg s = randomSegment(len, state);
+        float *v = s.Fields[1].Data, *f = s.Fields[3].Data;
+        for (int32_t j = 0; j < len; j++) {
+            f[j] = powf(10, 6*rand_Float(state) - 2);
+        }
+        f[0] = 0.01f;
+        f[1] = 1e4f;
+
+        float delta = deltas[i];
+        if (delta == 0) { delta = nextafterf(6.0f / 1024, 1); }
+
+        FloatAccuracy *fAcc = s.Fields[3].Acc;
+        fAcc->Log10Scaled = 1;
+        fAcc->Delta = delta;
+        VelocityAccuracy *vAcc = s.Fields[1].Acc;
+        vAcc->SymLog10Scaled = 1;
+        vAcc->SymLog10Threshold = 10;
+        vAcc->Delta = delta;
+
+        bool exact = i == LEN(deltas) - 1;
+        if (exact) {
+            fAcc->Deltas = malloc(sizeof(*fAcc->Deltas)*(size_t)len);
+            vAcc->Deltas = malloc(sizeof(*vAcc->Deltas)*(size_t)len);
+            for (int32_t j = 0; j < len; j++) {
+                fAcc->Deltas[j] = j == len/2 ? 1e-6f : delta;
+                vAcc->Deltas[j] = j == len/2 ? 1e-6f : delta;
+            }
+            fAcc->Len = len;
+            vAcc->Len = len;
+        }
+
+        CSeg cs = minnow_Compress(ctx, s);
+        Seg out = minnow_Decompress(ctx, cs);
+
+        float *v2 = out.Fields[1].Data, *f2 = out.Fields[3].Data;
+        for (int32_t j = 0; j < len; j++) {
+            double err = fabs(log10((double)f2[j]) - log10((double)f[j]));
+            if (err > delta) {
+                fprintf(stderr, "In test %d of testLogScaled, particle %"
+                        PRId32" was decoded as %g, but expected %g.\n",
+                        i, j, f2[j], f[j]);
+                res = false;
+                break;
+            }
+        }
+        for (int32_t j = 0; j < 3*len; j++) {
+            double err = fabs(symLog10(v2[j], 10) - symLog10(v[j], 10));
+            if (err > delta) {
+                fprintf(stderr, "In test %d of testLogScaled, velocity "
+                        "component %"PRId32" was decoded as %g, but expected "
+                        "%g.\n", i, j, v2[j], v[j]);
+                res = false;
+                break;
+            }
+        }
+
+        res = checkLogDecode(s.Fields[3], i != 1 && !exact, i) && res;
+        res = checkLogDecode(s.Fields[1], !exact, i) && res;
+
+        /* Symmetric log scaling of a signed float field. */
+        for (int32_t j = 0; j < len; j++) { f[j] = v[j]; }
+        fAcc->Log10Scaled = 2;
+        fAcc->SymLog10Threshold = 0.5f;
+        Seg_Free(out);
+        CSeg_Free(cs);
+
+        cs = minnow_Compress(ctx, s);
+        out = minnow_Decompress(ctx, cs);
+        f2 = out.Fields[3].Data;
+        for (int32_t j = 0; j < len; j++) {
+            double err = fabs(symLog10(f2[j], 0.5) - symLog10(f[j], 0.5));
+            if (err > delta) {
+                fprintf(stderr, "In test %d of testLogScaled, symlog "
+                        "particle %"PRId32" was decoded as %g, but expected "
+                        "%g.\n", i, j, f2[j], f[j]);
+                res = false;
+                break;
+            }
+        }
+        res = checkLogDecode(s.Fields[3], !exact, i) && res;
+
+        Seg_Free(out);
+        CSeg_Free(cs);
+        Seg_Free(s);
+    }
+
+    minnow_FreeContext(ctx);
+    free(state);
+
+    return res;
+}
+
+double symLog10(double x, double threshold) {
+    double y = log10(1 + fabs(x) / threshold);
+    return x < 0 ? -y : y;
+}
+
+/* checkLogDecode checks that the log scaled field f uses the fast maps only
+ * if fast is set, and that otherwise it's decoded with libm: every value is
+ * exactly powf applied to the bin center found without log scaling. */
+bool checkLogDecode(Field f, bool fast, int test) {
+    bool res = true;
+    QField qf = quant_QField(f);
+    int32_t n = quant_Dims(f.Hd.FieldCode)*f.Hd.ParticleLen;
+
+    int32_t *scaled, mode, isFast;
+    float threshold;
+    if (f.Hd.FieldCode == field_Velc) {
+        VelocityQuantization *quant = qf.Quant;
+        scaled = &quant->SymLog10Scaled;
+        mode = 2;
+        isFast = quant->Fast;
+        threshold = quant->SymLog10Threshold;
+    } else {
+        FloatQuantization *quant = qf.Quant;
+        scaled = &quant->Log10Scaled;
+        mode = quant->Log10Scaled;
+        isFast = quant->Fast;
+        threshold = quant->SymLog10Threshold;
+    }
+
+    if (isFast != fast) {
+        fprintf(stderr, "In test %d of testLogScaled, field %"PRIx32" has "
+                "Fast = %"PRId32".\n", test, f.Hd.FieldCode, isFast);
+        res = false;
+    }
+
+    Field out = quant_Field(qf, true, false);
+    int32_t saved = *scaled;
+    *scaled = 0;
+    Field centers = quant_Field(qf, true, false);
+    *scaled = saved;
+
+    float *x = out.Data, *c = centers.Data;
+    for (int32_t j = 0; j < n && !isFast; j++) {
+        float expected = mode == 1 ? powf(10, c[j]) :
+            copysignf(threshold*(powf(10, fabsf(c[j])) - 1), c[j]);
+        if (x[j] != expected) {
+            fprintf(stderr, "In test %d of testLogScaled, value %"PRId32
+                    " of field %"PRIx32" was decoded as %.9g instead of "
+                    "%.9g.\n", test, j, f.Hd.FieldCode, x[j], expected);
+            res = false;
+            break;
+        }
+    }
+
+    quant_FreeField(out);
+    quant_FreeField(centers);
+    quant_FreeQField(qf);
+    return res;
+}
+
+bool testVelocityAxes() {
+    bool res = true;
+
+    /* Components with very different spreads, including one with none, at
+     * uniform and per-particle accuracies. */
+    int32_t len = 3000;
+    rand_State *state = rand_Seed(9, 1);
+    minnow_Context *ctx = minnow_NewContext(0);
+
+    for (int test = 0; test < 2; test++) {
+        Seg s = randomSegment(len, state);
+        float *v = s.Fields[1].Data;
+        for (int32_t j = 0; j < len; j++) {
+            v[len + j] /= 100;
+            v[2*len + j] = 3;
+        }
+
+        VelocityAccuracy *acc = s.Fields[1].Acc;
+        acc->Delta = 0.05f;
+        float *deltas = NULL;
+        if (test == 1) {
+            deltas = malloc(sizeof(*deltas)*(size_t)len);
+            for (int32_t j = 0; j < len; j++) {
+                deltas[j] = j < len/2 ? 0.05f : 1.0f;
+            }
+            acc->Deltas = deltas;
+            acc->Len = len;
+        }
+
+        QSeg qs = Quantize(s);
+        VelocityQuantization *vq = qs.Fields[1].Quant;
+        for (int i = 0; i < 2 && deltas == NULL; i++) {
+            uint8_t depth = (uint8_t)(vq->Depth - vq->Shifts[i]);
+            float width = (vq->X1[i] - vq->X0[i]) / (float)(1 << depth);
+            if (width > acc->Delta || 2*width <= acc->Delta) {
+                fprintf(stderr, "In test %d of testVelocityAxes, component "
+                        "%d has bins of width %g for an accuracy of %g.\n",
+                        test, i, width, acc->Delta);
+                res = false;
+            }
+        }
+        if (vq->Shifts[0] != 0 || vq->Shifts[1] < 6) {
+            fprintf(stderr, "In test %d of testVelocityAxes, shifts are "
+                    "%"PRIu8" and %"PRIu8".\n", test,
+                    vq->Shifts[0], vq->Shifts[1]);
+            res = false;
+        }
+        QSeg_Free(qs);
+
+        CSeg cs = minnow_Compress(ctx, s);
+        U8BigSeq bytes = ToBytes(cs);
+        CSeg read = FromBytes(bytes);
+        Seg out = minnow_Decompress(ctx, read);
+
+        float *v2 = out.Fields[1].Data;
+        for (int32_t j = 0; j < 3*len; j++) {
+            float delta = deltas == NULL ? acc->Delta : deltas[j % len];
+            if (fabsf(v2[j] - v[j]) > delta) {
+                fprintf(stderr, "In test %d of testVelocityAxes, component "
+                        "%"PRId32" was decoded as %g, but expected %g.\n",
+                        test, j, v2[j], v[j]);
+                res = false;
+                break;
+            }
+        }
+
+        VelocityAccuracy *acc2 = out.Fields[1].Acc;
+        for (int32_t j = 0; j < len; j++) {
+            float delta = deltas == NULL ? acc->Delta : deltas[j];
+            float delta2 = deltas == NULL ? acc2->Delta : acc2->Deltas[j];
+            if (delta2 > delta) {
+                fprintf(stderr, "In test %d of testVelocityAxes, particle %"
+                        PRId32" was decoded with accuracy %g, but %g was "
+                        "requested.\n", test, j, delta2, delta);
+                res = false;
+                break;
+            }
+        }
+
+        Seg_Free(out);
+        CSeg_Free(read);
+        U8BigSeq_Free(bytes);
+        CSeg_Free(cs);
+        Seg_Free(s);
+    }
+
+    minnow_FreeContext(ctx);
+    free(state);
+
+    return res;
+}
+
+bool testIDWidths() {
+    bool res = true;
+
+    /* Powers of two take the shift path and the rest use reciprocals. The
+     * last width is the largest whose cube fits in 64 bits. */
+    uint64_t widths[] = { 1, 2, 3, 7, 1000, 1024, 1 << 20, 2097151, 2642245 };
+    int32_t len = 1000;
+    rand_State *state = rand_Seed(9, 1);
+
+    for (int i = 0; i < LEN(widths); i++) {
+        Seg s = randomSegment(len, state);
+        uint64_t w = widths[i], *id = s.Fields[2].Data;
+        ((IDAccuracy*)s.Fields[2].Acc)->Width = w;
+
+        uint64_t cube = w*w*w;
+        for (int32_t j = 0; j < len; j++) {
+            id[j] = rand_Uint64(state) % cube;
+        }
+        id[0] = cube - 1;
+        id[1] = 0;
+
+        QSeg qs = Quantize(s);
+        Seg out = UndoQuantize(qs);
+        if (!segAlmostEqual(s, out, "testIDWidths")) {
+            fprintf(stderr, "  (in test %d)\n", i);
+            res = false;
+        }
+
+        Seg_Free(out);
+        QSeg_Free(qs);
+        Seg_Free(s);
+    }
+
+    free(state);
+
+    return res;
+}
+
+bool testElemSizes() {
+    bool res = true;
+
+    uint8_t bits[] = { 0, 1, 16, 17, 32, 33, 64 };
+    uint8_t sizes[] = { 2, 2, 2, 4, 4, 8, 8 };
+    for (int i = 0; i < LEN(bits); i++) {
+        if (quant_ElemSize(bits[i]) != sizes[i]) {
+            fprintf(stderr, "In testElemSizes, quant_ElemSize(%"PRIu8") = %"
+                    PRIu8", but expected %"PRIu8".\n",
+                    bits[i], quant_ElemSize(bits[i]), sizes[i]);
+            res = false;
+        }
+    }
+
+    /* Floats span [0, 1], so a delta of 1.5*2^-depth needs exactly depth
+     * bits, and integers span exactly span. Each pair of tests sits on
+     * either side of a change in element size. Depths above 24 need
+     * doubles. The last test gives one float a finer delta than the rest. */
+    struct {
+        int32_t depth;
+        bool isDouble, mixed;
+        uint64_t span;
+        int32_t floatSize, intSize;
+    } tests[] = {
+        { 16, false, false, 0xffff, 2, 2 },
+        { 17, false, false, 0x10000, 4, 4 },
+        { 24, false, false, 0xffffffff, 4, 4 },
+        { 32, true, false, 0x100000000, 4, 8 },
+        { 33, true, false, UINT64_MAX, 8, 8 },
+        { 16, false, true, 1, 4, 2 },
+    };
+
+    int32_t len = 1000;
+    rand_State *state = rand_Seed(13, 1);
+    minnow_Context *ctx = minnow_NewContext(0);
+
+    for (int i = 0; i < LEN(tests); i++) {
+        Seg s = randomSegment(len, state);
+
+        FloatAccuracy *fAcc = s.Fields[3].Acc;
+        fAcc->Delta = ldexpf(1.5f, -tests[i].depth);
+        if (tests[i].mixed) {
+            fAcc->Deltas = malloc(sizeof(*fAcc->Deltas)*(size_t)len);
+            for (int32_t j = 0; j < len; j++) {
+                fAcc->Deltas[j] = j == len/2 ? fAcc->Delta/2 : fAcc->Delta;
+            }
+            fAcc->Len = len;
+        }
+        double *f = malloc(sizeof(*f)*(size_t)len + 1);
+        for (int32_t j = 0; j < len; j++) {
+            f[j] = rand_Float(state) + ldexp(rand_Float(state), -24);
+        }
+        f[0] = 0;
+        f[1] = 1;
+        free(s.Fields[3].Data);
+        if (tests[i].isDouble) {
+            s.Fields[3].Data = f;
+            s.Fields[3].Layout.Double = 1;
+        } else {
+            float *f32 = malloc(sizeof(*f32)*(size_t)len + 1);
+            for (int32_t j = 0; j < len; j++) { f32[j] = (float)f[j]; }
+            free(f);
+            s.Fields[3].Data = f32;
+        }
+
+        uint64_t x0 = UINT64_MAX - tests[i].span, *u = s.Fields[4].Data;
+        for (int32_t j = 0; j < len; j++) {
+            u[j] = x0 + rand_Uint64(state) % tests[i].span;
+        }
+        u[0] = x0;
+        u[1] = UINT64_MAX;
+
+        QSeg qs = Quantize(s);
+        FloatQuantization *fq = qs.Fields[3].Quant;
+        uint8_t depth = fq->Depth;
+        if (tests[i].mixed) { depth = fq->Depths[len/2]; }
+        if (depth != tests[i].depth + (tests[i].mixed ? 1 : 0) ||
+            qs.Fields[3].ElemSize != tests[i].floatSize ||
+            qs.Fields[4].ElemSize != tests[i].intSize) {
+            fprintf(stderr, "In test %d of testElemSizes, floats were "
+                    "quantized to depth %"PRIu8" in %"PRId32"-byte elements "
+                    "and integers to %"PRId32"-byte elements.\n",
+                    i, depth, qs.Fields[3].ElemSize, qs.Fields[4].ElemSize);
+            res = false;
+        }
+        QSeg_Free(qs);
+
+        CSeg cs = minnow_Compress(ctx, s);
+        Seg out = minnow_Decompress(ctx, cs);
+
+        if (memcmp(out.Fields[4].Data, u, sizeof(*u)*(size_t)len)) {
+            fprintf(stderr, "In test %d of testElemSizes, integers were not "
+                    "recovered exactly.\n", i);
+            res = false;
+        }
+        for (int32_t j = 0; j < len; j++) {
+            double x1, x2;
+            if (tests[i].isDouble) {
+                x1 = ((double*)s.Fields[3].Data)[j];
+                x2 = ((double*)out.Fields[3].Data)[j];
+            } else {
+                x1 = ((float*)s.Fields[3].Data)[j];
+                x2 = ((float*)out.Fields[3].Data)[j];
+            }
+            double delta = fAcc->Deltas == NULL ?
+                fAcc->Delta : fAcc->Deltas[j];
+            if (fabs(x2 - x1) > delta) {
+                fprintf(stderr, "In test %d of testElemSizes, float %"PRId32
+                        " was decoded as %.17g, but expected %.17g.\n",
+                        i, j, x2, x1);
+                res = false;
+                break;
+            }
+        }
+
+        Seg_Free(out);
+        CSeg_Free(cs);
+        Seg_Free(s);
+    }
+
+    minnow_FreeContext(ctx);
+    free(state);
+
+    return res;
+}
+
+bool testLagrangian() {
+    bool res = true;
+
+    /* Particles a short distance from their lattice sites, including sites
+     * on the box edge whose particles have wrapped around. */
+    uint64_t w = 20;
+    float L = 64;
+    int32_t len = (int32_t)(w*w*w);
+    rand_State *state = rand_Seed(10, 1);
+    Seg s = randomSegment(len, state);
+    uint64_t *id = s.Fields[2].Data;
+    float *x = s.Fields[0].Data;
+    ((IDAccuracy*)s.Fields[2].Acc)->Width = w;
+
+    for (int32_t j = 0; j < len; j++) {
+        id[j] = (uint64_t)j;
+    }
+    for (int32_t j = 0; j < len; j++) {
+        int32_t k = (int32_t)rand_Uint63Lim(state, (uint64_t)(len - j)) + j;
+        uint64_t tmp = id[j];
+        id[j] = id[k];
+        id[k] = tmp;
+    }
+    for (int32_t j = 0; j < len; j++) {
+        uint64_t idx[3] = { id[j] % w, (id[j] / w) % w, id[j] / (w*w) };
+        for (int i = 0; i < 3; i++) {
+            float xi = (float)idx[i]*(L / (float)w) + rand_Float(state) - 0.5f;
+            if (xi < 0) { xi += L; }
+            x[(size_t)i*(size_t)len + (size_t)j] = xi;
+        }
+    }
+
+    QSeg plain = Quantize(s);
+    PositionAccuracy *acc = s.Fields[0].Acc;
+    acc->Lagrangian = 1;
+    QSeg qs = Quantize(s);
+
+    uint8_t depth0 = ((PositionQuantization*)plain.Fields[0].Quant)->Depth;
+    uint8_t depth1 = ((PositionQuantization*)qs.Fields[0].Quant)->Depth;
+    if (depth1 + 5 > depth0) {
+        fprintf(stderr, "In testLagrangian, Lagrangian positions needed "
+                "depth %"PRIu8", but regular positions only needed %"PRIu8
+                ".\n", depth1, depth0);
+        res = false;
+    }
+
+    Seg out = UndoQuantize(qs);
+    if (!segAlmostEqual(s, out, "testLagrangian")) { res = false; }
+    Seg_Free(out);
+
+    /* Block bounds are in position space, so boxes still work. Particles
+     * within Delta of the box's faces may land on either side. */
+    Box box = {{10, 20, 5}, {30, 40, 60}};
+    out = UndoQuantizeBox(qs, box, true);
+    int32_t inside = 0;
+    for (int32_t j = 0; j < len; j++) {
+        bool in = true;
+        for (int i = 0; i < 3; i++) {
+            float xi = x[(size_t)i*(size_t)len + (size_t)j];
+            in = in && xi >= box.X0[i] && xi <= box.X1[i];
+        }
+        if (in) { inside++; }
+    }
+    if (abs(out.Fields[0].Hd.ParticleLen - inside) > 10) {
+        fprintf(stderr, "In testLagrangian, the box held %"PRId32
+                " particles, but expected %"PRId32".\n",
+                out.Fields[0].Hd.ParticleLen, inside);
+        res = false;
+    }
+    Seg_Free(out);
+
+    /* The context path, and positions whose IDs fail their checksum. */
+    minnow_Context *ctx = minnow_NewContext(2);
+    CSeg cs = minnow_Compress(ctx, s);
+    out = minnow_Decompress(ctx, cs);
+    if (!segAlmostEqual(s, out, "testLagrangian")) { res = false; }
+    Seg_Free(out);
+
+    cs.Fields[2].Data[0] ^= 0xff;
+    out = minnow_Decompress(ctx, cs);
+    if (out.Fields[0].Valid) {
+        fprintf(stderr, "In testLagrangian, positions were decoded without "
+                "their IDs.\n");
+        res = false;
+    }
+    Seg_Free(out);
+
+    CSeg_Free(cs);
+    minnow_FreeContext(ctx);
+    QSeg_Free(qs);
+    QSeg_Free(plain);
+    Seg_Free(s);
+    free(state);
+
+    return res;
+}
+
+typedef struct memStream {
+    U8BigSeq Bytes;
+    int64_t Offset;
+} memStream;
+
+int64_t memWrite(void *ctx, uint8_t *bytes, int64_t len) {
+    memStream *m = ctx;
+    if (len > 0) {
+        m->Bytes = U8BigSeq_Join(m->Bytes, U8BigSeq_WrapArray(bytes, len));
+    }
+    return len;
+}
+
+int64_t memRead(void *ctx, uint8_t *bytes, int64_t len) {
+    memStream *m = ctx;
+    if (len > m->Bytes.Len - m->Offset) { len = m->Bytes.Len - m->Offset; }
+    if (len > 0) { memcpy(bytes, m->Bytes.Data + m->Offset, (size_t)len); }
+    m->Offset += len;
+    return len;
+}
+
+bool testDoubles() {
+    bool res = true;
+
+    /* Both accuracies need more than 24 bits, and some positions sit just
+     * inside the box edges. */
+    int32_t len = 3000;
+    double L = 1e4;
+    rand_State *state = rand_Seed(12, 1);
+    minnow_Context *ctx = minnow_NewContext(0);
+
+    Seg s = randomSegment(len, state);
+    double *x = malloc(3*sizeof(*x)*(size_t)len + 1);
+    for (int32_t j = 0; j < 3*len; j++) {
+        double u = rand_Float(state) + ldexp(rand_Float(state), -24);
+        x[j] = j % 7 == 0 ? L*(1 - u*1e-9) : L*u;
+    }
+    free(s.Fields[0].Data);
+    s.Fields[0].Data = x;
+    s.Fields[0].Layout.Double = 1;
+    PositionAccuracy *xAcc = s.Fields[0].Acc;
+    xAcc->Width = (float)L;
+    xAcc->Delta = 1e-6f;
+
+    double *f = malloc(sizeof(*f)*(size_t)len + 1);
+    for (int32_t j = 0; j < len; j++) { f[j] = 1000*(double)rand_Float(state); }
+    free(s.Fields[3].Data);
+    s.Fields[3].Data = f;
+    s.Fields[3].Layout.Double = 1;
+    FloatAccuracy *fAcc = s.Fields[3].Acc;
+    fAcc->Delta = 1e-5f;
+
+    QSeg qs = Quantize(s);
+    if (qs.Fields[0].ElemSize != 8 || qs.Fields[3].ElemSize != 4) {
+        fprintf(stderr, "In testDoubles, element sizes are %"PRId32" and %"
+                PRId32".\n", qs.Fields[0].ElemSize, qs.Fields[3].ElemSize);
+        res = false;
+    }
+    QSeg_Free(qs);
+
+    CSeg cs = minnow_Compress(ctx, s);
+    U8BigSeq bytes = ToBytes(cs);
+    CSeg read = FromBytes(bytes);
+    Seg out = minnow_Decompress(ctx, read);
+
+    int32_t fields[] = { 0, 3 };
+    for (int i = 0; i < LEN(fields); i++) {
+        Field f1 = s.Fields[fields[i]], f2 = out.Fields[fields[i]];
+        int32_t n = fields[i] == 0 ? 3*len : len;
+        double delta = fields[i] == 0 ? xAcc->Delta : fAcc->Delta;
+        double *x1 = f1.Data, *x2 = f2.Data;
+        if (!f2.Layout.Double) {
+            fprintf(stderr, "In testDoubles, field %d wasn't decoded as "
+                    "doubles.\n", fields[i]);
+            res = false;
+            continue;
+        }
+        for (int32_t j = 0; j < n; j++) {
+            double diff = fabs(x2[j] - x1[j]);
+            if (fields[i] == 0 && diff > L/2) { diff = L - diff; }
+            if (diff > delta || (fields[i] == 0 && x2[j] >= L)) {
+                fprintf(stderr, "In testDoubles, value %"PRId32" of field "
+                        "%d was decoded as %.17g, but expected %.17g.\n",
+                        j, fields[i], x2[j], x1[j]);
+                res = false;
+                break;
+            }
+        }
+    }
+
+    /* Single decoding rounds the same values to floats. */
+    ctx->Centered = true;
+    ctx->Single = true;
+    float *single = calloc(3*(size_t)len, sizeof(*single));
+    if (!minnow_DecompressFieldInto(ctx, read.Fields[0], single)) {
+        fprintf(stderr, "In testDoubles, minnow_DecompressFieldInto "
+                "failed.\n");
+        res = false;
+    }
+    for (int32_t j = 0; j < 3*len; j++) {
+        double diff = fabs((double)single[j] - x[j]);
+        if (diff > L/2) { diff = L - diff; }
+        if (diff > xAcc->Delta + 1e-3) {
+            fprintf(stderr, "In testDoubles, value %"PRId32" was decoded "
+                    "to a float as %g, but expected %.17g.\n",
+                    j, single[j], x[j]);
+            res = false;
+            break;
+        }
+    }
+
+    free(single);
+    Seg_Free(out);
+    CSeg_Free(read);
+    U8BigSeq_Free(bytes);
+    CSeg_Free(cs);
+    Seg_Free(s);
+    minnow_FreeContext(ctx);
+    free(state);
+
+    return res;
+}
+
+bool testLossless() {
+    bool res = true;
+
+    /* Long enough for several Gorl chunks. The first half of the lossless
+     * field is a few long runs of masses and the second half is noise with
+     * some special values mixed in. */
+    int32_t len = 100000;
+    rand_State *state = rand_Seed(13, 1);
+    minnow_Context *ctx = minnow_NewContext(0);
+    ctx->Centered = true;
+
+    float masses[] = { 1.5e10f, 3e9f, 7.2e8f };
+    float special[] = { NAN, -0.0f, INFINITY, 1e-40f };
+
+    for (int test = 0; test < 2; test++) {
+        Seg s = randomSegment(len, state);
+        int32_t size = test == 0 ? 4 : 8;
+        uint8_t *bits = malloc((size_t)len*(size_t)size + 1);
+        for (int32_t j = 0; j < len; j++) {
+            double x = j < len/2 ? masses[6*j / len] :
+                1e5*(double)rand_Float(state) - 5e4;
+            if (j % 1001 == 0) { x = special[(j / 1001) % LEN(special)]; }
+
+            float xf = (float)x;
+            if (test == 0) {
+                memcpy(bits + 4*(size_t)j, &xf, 4);
+            } else {
+                memcpy(bits + 8*(size_t)j, &x, 8);
+            }
+        }
+        free(s.Fields[3].Data);
+        s.Fields[3].Data = bits;
+        s.Fields[3].Layout.Double = test;
+        ((FloatAccuracy*)s.Fields[3].Acc)->Lossless = 1;
+
+        CSeg expected = minnow_Compress(ctx, s);
+        for (int32_t i = 0; i < s.FieldLen; i++) {
+            s.Fields[i].Hd.AlgoCode = algo_Gorl;
+            s.Fields[i].Hd.AlgoVersion = GorlVersion_v0_9;
+        }
+        CSeg cs = minnow_Compress(ctx, s);
+        U8BigSeq bytes = ToBytes(cs);
+        CSeg read = FromBytes(bytes);
+
+        /* Gorl is lossless for every field, so it must decode exactly as
+         * algo_Test does. */
+        Seg out = minnow_Decompress(ctx, read);
+        Seg out2 = minnow_Decompress(ctx, expected);
+        int32_t sizes[] = { 4, 4, 8, size, 8 };
+        for (int32_t i = 0; i < s.FieldLen; i++) {
+            size_t n = (size_t)quant_Dims(s.Fields[i].Hd.FieldCode) *
+                (size_t)len*(size_t)sizes[i];
+            if (!out.Fields[i].Valid ||
+                memcmp(out.Fields[i].Data, out2.Fields[i].Data, n)) {
+                fprintf(stderr, "In test %d of testLossless, field %"PRId32
+                        " doesn't match algo_Test.\n", test, i);
+                res = false;
+            }
+        }
+        if (memcmp(out.Fields[3].Data, bits, (size_t)len*(size_t)size)) {
+            fprintf(stderr, "In test %d of testLossless, the lossless field "
+                    "wasn't decoded exactly.\n", test);
+            res = false;
+        }
+
+        if (4*cs.Fields[3].DataLen > 3*expected.Fields[3].DataLen) {
+            fprintf(stderr, "In test %d of testLossless, Gorl used %"PRId64
+                    " bytes for a field stored in %"PRId64" bytes without "
+                    "compression.\n", test, cs.Fields[3].DataLen,
+                    expected.Fields[3].DataLen);
+            res = false;
+        }
+
+        Seg_Free(out);
+        Seg_Free(out2);
+        CSeg_Free(read);
+        U8BigSeq_Free(bytes);
+        CSeg_Free(cs);
+        CSeg_Free(expected);
+        Seg_Free(s);
+    }
+
+    minnow_FreeContext(ctx);
+    free(state);
+
+    return res;
+}
+
+bool testPfor() {
+    bool res = true;
+
+    /* Small flags with rare huge outliers, a constant run, and a length which
+     * leaves a partial block. */
+    int32_t len = 10000;
+    rand_State *state = rand_Seed(14, 1);
+    minnow_Context *ctx = minnow_NewContext(0);
+    ctx->Centered = true;
+
+    Seg s = randomSegment(len, state);
+    uint64_t *u = s.Fields[4].Data;
+    for (int32_t j = 0; j < len; j++) {
+        u[j] = rand_Uint63Lim(state, 8);
+        if (j % 997 == 0) { u[j] = 1000000000000 + (uint64_t)j; }
+        if (j >= 2000 && j < 3000) { u[j] = 5; }
+    }
+
+    CSeg expected = minnow_Compress(ctx, s);
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        s.Fields[i].Hd.AlgoCode = algo_Pfor;
+        s.Fields[i].Hd.AlgoVersion = PforVersion_v0_9;
+    }
+    CSeg cs = minnow_Compress(ctx, s);
+    U8BigSeq bytes = ToBytes(cs);
+    CSeg read = FromBytes(bytes);
+
+    /* Pfor is lossless for every field, so it must decode exactly as
+     * algo_Test does. */
+    Seg out = minnow_Decompress(ctx, read);
+    Seg out2 = minnow_Decompress(ctx, expected);
+    int32_t sizes[] = { 4, 4, 8, 4, 8 };
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        size_t n = (size_t)quant_Dims(s.Fields[i].Hd.FieldCode) *
+            (size_t)len*(size_t)sizes[i];
+        if (!out.Fields[i].Valid ||
+            memcmp(out.Fields[i].Data, out2.Fields[i].Data, n)) {
+            fprintf(stderr, "In testPfor, field %"PRId32" doesn't match "
+                    "algo_Test.\n", i);
+            res = false;
+        }
+    }
+    if (memcmp(out.Fields[4].Data, u, sizeof(*u)*(size_t)len)) {
+        fprintf(stderr, "In testPfor, the integer field wasn't decoded "
+                "exactly.\n");
+        res = false;
+    }
+
+    if (8*cs.Fields[4].DataLen > expected.Fields[4].DataLen) {
+        fprintf(stderr, "In testPfor, Pfor used %"PRId64" bytes for a field "
+                "stored in %"PRId64" bytes without compression.\n",
+                cs.Fields[4].DataLen, expected.Fields[4].DataLen);
+        res = false;
+    }
+
+    /* Every block of the integer field spans exactly width bits, so each
+     * width is unpacked by whichever path handles it. */
+    int32_t widths[] = { 7, 8, 16, 24, 31, 32, 40, 48, 56, 57, 64 };
+    for (int i = 0; i < LEN(widths); i++) {
+        uint64_t max = widths[i] == 64 ? ~(uint64_t)0 :
+            ((uint64_t)1 << widths[i]) - 1;
+        for (int32_t j = 0; j < len; j++) {
+            u[j] = rand_Uint64(state) & max;
+            if (j % 128 == 0) { u[j] = 0; }
+            if (j % 128 == 1) { u[j] = max; }
+        }
+
+        CSeg wcs = minnow_Compress(ctx, s);
+        Seg wout = minnow_Decompress(ctx, wcs);
+        if (memcmp(wout.Fields[4].Data, u, sizeof(*u)*(size_t)len)) {
+            fprintf(stderr, "In testPfor, the integer field wasn't decoded "
+                    "exactly at width %"PRId32".\n", widths[i]);
+            res = false;
+        }
+        Seg_Free(wout);
+        CSeg_Free(wcs);
+    }
+
+    Seg_Free(out);
+    Seg_Free(out2);
+    CSeg_Free(read);
+    U8BigSeq_Free(bytes);
+    CSeg_Free(cs);
+    CSeg_Free(expected);
+    Seg_Free(s);
+    minnow_FreeContext(ctx);
+    free(state);
+
+    return res;
+}
+
+bool testSvby() {
+    bool res = true;
+
+    /* Integers spread evenly over many orders of magnitude. */
+    int32_t len = 10000;
+    rand_State *state = rand_Seed(15, 1);
+    minnow_Context *ctx = minnow_NewContext(0);
+    ctx->Centered = true;
+
+    Seg s = randomSegment(len, state);
+    uint64_t *u = s.Fields[4].Data;
+    for (int32_t j = 0; j < len; j++) {
+        uint64_t lim = (uint64_t)1 << rand_Uint63Lim(state, 41);
+        u[j] = rand_Uint63Lim(state, lim);
+    }
+
+    CSeg expected = minnow_Compress(ctx, s);
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        s.Fields[i].Hd.AlgoCode = algo_Svby;
+        s.Fields[i].Hd.AlgoVersion = SvbyVersion_v0_9;
+    }
+    CSeg cs = minnow_Compress(ctx, s);
+    U8BigSeq bytes = ToBytes(cs);
+    CSeg read = FromBytes(bytes);
+
+    /* Svby is lossless for every field, so it must decode exactly as
+     * algo_Test does. */
+    Seg out = minnow_Decompress(ctx, read);
+    Seg out2 = minnow_Decompress(ctx, expected);
+    int32_t sizes[] = { 4, 4, 8, 4, 8 };
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        size_t n = (size_t)quant_Dims(s.Fields[i].Hd.FieldCode) *
+            (size_t)len*(size_t)sizes[i];
+        if (!out.Fields[i].Valid ||
+            memcmp(out.Fields[i].Data, out2.Fields[i].Data, n)) {
+            fprintf(stderr, "In testSvby, field %"PRId32" doesn't match "
+                    "algo_Test.\n", i);
+            res = false;
+        }
+    }
+    if (memcmp(out.Fields[4].Data, u, sizeof(*u)*(size_t)len)) {
+        fprintf(stderr, "In testSvby, the integer field wasn't decoded "
+                "exactly.\n");
+        res = false;
+    }
+
+    if (2*cs.Fields[4].DataLen > expected.Fields[4].DataLen) {
+        fprintf(stderr, "In testSvby, Svby used %"PRId64" bytes for a field "
+                "stored in %"PRId64" bytes without compression.\n",
+                cs.Fields[4].DataLen, expected.Fields[4].DataLen);
+        res = false;
+    }
+
+    Seg_Free(out);
+    Seg_Free(out2);
+    CSeg_Free(read);
+    U8BigSeq_Free(bytes);
+    CSeg_Free(cs);
+    CSeg_Free(expected);
+    Seg_Free(s);
+    minnow_FreeContext(ctx);
+    free(state);
+
+    return res;
+}
+
+bool testSegStream() {
+    bool res = true;
+
+    int32_t chunk = 3000;
+    rand_State *state = rand_Seed(3, 1);
+
+    /* The block length only depends on the fields' types and accuracies.
+     * Small positions and IDs are quantized to two bytes, so coarser fields
+     * fit more particles into the same memory. */
+    FieldHeader hds[5];
+    Accuracy accs[5];
+    Seg probe = randomSegment(1, state);
+    for (int32_t j = 0; j < probe.FieldLen; j++) {
+        hds[j] = probe.Fields[j].Hd;
+        accs[j] = probe.Fields[j].Acc;
+    }
+    memStream empty = { .Bytes = U8BigSeq_New(0), .Offset = 0 };
+    PositionAccuracy *xAcc = probe.Fields[0].Acc;
+    float deltas[] = { 1e-5f, 1, xAcc->Delta };
+    int32_t blockLens[LEN(deltas)];
+    for (int i = 0; i < LEN(deltas); i++) {
+        xAcc->Delta = deltas[i];
+        SegWriter *w = SegWriter_New(hds, accs, probe.FieldLen, 1 << 18,
+                                     memWrite, &empty);
+        blockLens[i] = SegWriter_BlockLen(w);
+        SegWriter_Close(w);
+    }
+    if (blockLens[1] <= blockLens[0] || empty.Bytes.Len != 0) {
+        fprintf(stderr, "In testSegStream, blocks held %"PRId32" coarse "
+                "positions, but %"PRId32" fine ones.\n",
+                blockLens[1], blockLens[0]);
+        res = false;
+    }
+    int32_t blockLen = blockLens[2];
+    U8BigSeq_Free(empty.Bytes);
+    Seg_Free(probe);
+
+    /* Ending exactly on a block boundary flushes every block when the last
+     * field fills it and leaves nothing for SegWriter_Close. */
+    int32_t lens[] = { 1, blockLen - 1, blockLen, 3*blockLen,
+                       3*blockLen + 777 };
+
+    for (int i = 0; i < LEN(lens); i++) {
+        Seg s = randomSegment(lens[i], state);
+        for (int32_t j = 0; j < s.FieldLen; j++) {
+            hds[j] = s.Fields[j].Hd;
+            accs[j] = s.Fields[j].Acc;
+        }
+
+        /* Small enough that the larger segments span several blocks. */
+        memStream m = { .Bytes = U8BigSeq_New(0), .Offset = 0 };
+        SegWriter *w = SegWriter_New(hds, accs, s.FieldLen, 1 << 18,
+                                     memWrite, &m);
+
+        /* Push particles one chunk at a time so that the stream's input
+         * buffers are smaller than the segment. */
+        for (int32_t start = 0; start < lens[i]; start += chunk) {
+            int32_t n = start + chunk < lens[i] ? chunk : lens[i] - start;
+            Seg c = sliceSegment(s, start, n);
+            int32_t *pos = calloc((size_t)s.FieldLen, sizeof(*pos));
+            bool done = false;
+            while (!done) {
+                done = true;
+                for (int32_t j = 0; j < s.FieldLen; j++) {
+                    pos[j] += SegWriter_Push(w, j, c.Fields[j].Data,
+                                             n, pos[j]);
+                    if (pos[j] < n) { done = false; }
+                }
+            }
+            free(pos);
+            freeSlice(c);
+        }
+        SegWriter_Close(w);
+
+        SegReader *r = SegReader_New(memRead, &m);
+        Seg block;
+        int32_t read = 0;
+        while (SegReader_Next(r, &block)) {
+            int32_t n = block.Fields[0].Hd.ParticleLen;
+            int32_t want = lens[i] - read < blockLen ?
+                lens[i] - read : blockLen;
+            if (n != want) {
+                fprintf(stderr, "In test %d of testSegStream, a block at "
+                        "particle %"PRId32" held %"PRId32" particles, but "
+                        "expected %"PRId32".\n", i, read, n, want);
+                res = false;
+                Seg_Free(block);
+                break;
+            }
+            Seg expected = sliceSegment(s, read, n);
+            if (!segAlmostEqual(expected, block, "testSegStream")) {
+                fprintf(stderr, "  (in test %d, particles %"PRId32"+)\n",
+                        i, read);
+                res = false;
+            }
+            read += n;
+            freeSlice(expected);
+            Seg_Free(block);
+        }
+        SegReader_Free(r);
+
+        if (read != lens[i]) {
+            fprintf(stderr, "In test %d of testSegStream, read %"PRId32
+                    " particles, but expected %"PRId32".\n",
+                    i, read, lens[i]);
+            res = false;
+        }
+
+        U8BigSeq_Free(m.Bytes);
+        Seg_Free(s);
+    }
+
+    free(state);
+
+    return res;
+}
+
+bool testBoxQuery() {
+    bool res = true;
+
+    /* Each block sits in its own cube of width 8, and block 0's cube wraps
+     * around the edge of the box. The integer field holds each particle's
+     * index so that filtered particles can be identified. */
+    int32_t len = 3*quant_BLOCK_LEN + 500;
+    float L = 64, corners[] = { 60, 12, 28, 44 };
+    rand_State *state = rand_Seed(11, 1);
+    Seg s = randomSegment(len, state);
+    float *x = s.Fields[0].Data;
+    uint64_t *u = s.Fields[4].Data;
+    for (int32_t j = 0; j < len; j++) {
+        u[j] = (uint64_t)j;
+        for (int i = 0; i < 3; i++) {
+            float xi = corners[j / quant_BLOCK_LEN] + 8*rand_Float(state);
+            x[(size_t)i*(size_t)len + (size_t)j] = xi >= L ? xi - L : xi;
+        }
+    }
+    float delta = ((PositionAccuracy*)s.Fields[0].Acc)->Delta;
+    QSeg qs = Quantize(s);
+
+    struct { Box box; int32_t blockLen, blocks[2]; } tests[] = {
+        {{{62, 62, 62}, {66, 66, 66}}, 1, { 0 }}, /* Wraps past L. */
+        {{{-1, 62, -3}, {1, 65, 3}}, 1, { 0 }}, /* Wraps below zero. */
+        {{{5, 5, 5}, {10, 10, 10}}, 0, { 0 }}, /* Between blocks. */
+        {{{14, 14, 14}, {30, 30, 30}}, 2, { 1, 2 }},
+    };
+
+    for (int i = 0; i < LEN(tests); i++) {
+        Box box = tests[i].box;
+
+        /* Without exact, every particle in an overlapping block is kept. */
+        Seg out = UndoQuantizeBox(qs, box, false);
+        int32_t n = 0;
+        for (int32_t k = 0; k < tests[i].blockLen; k++) {
+            int32_t start = tests[i].blocks[k]*quant_BLOCK_LEN;
+            n += start + quant_BLOCK_LEN > len ? len - start : quant_BLOCK_LEN;
+        }
+        if (out.Fields[0].Hd.ParticleLen != n) {
+            fprintf(stderr, "In test %d of testBoxQuery, %"PRId32" particles "
+                    "were decoded, but expected %"PRId32".\n",
+                    i, out.Fields[0].Hd.ParticleLen, n);
+            res = false;
+        }
+        for (int32_t k = 0, at = 0; res && k < tests[i].blockLen; k++) {
+            int32_t start = tests[i].blocks[k]*quant_BLOCK_LEN;
+            int32_t bn = start + quant_BLOCK_LEN > len ?
+                len - start : quant_BLOCK_LEN;
+            Seg expected = sliceSegment(s, start, bn);
+            Seg got = sliceSegment(out, at, bn);
+            if (!segAlmostEqual(expected, got, "testBoxQuery")) {
+                fprintf(stderr, "  (in test %d, block %"PRId32")\n",
+                        i, tests[i].blocks[k]);
+                res = false;
+            }
+            freeSlice(got);
+            freeSlice(expected);
+            at += bn;
+        }
+        Seg_Free(out);
+
+        /* With exact, the result must match a brute force filter, apart
+         * from particles within the accuracy of the box's faces. */
+        out = UndoQuantizeBox(qs, box, true);
+        int32_t m = out.Fields[0].Hd.ParticleLen, kept = 0;
+        uint64_t *idx = out.Fields[4].Data;
+        float *ox = out.Fields[0].Data;
+        for (int32_t j = 0; res && j < len; j++) {
+            bool found = kept < m && idx[kept] == (uint64_t)j;
+            int32_t side = boxSide(x, len, j, box, L, 2*delta);
+            if ((side > 0 && !found) || (side < 0 && found)) {
+                fprintf(stderr, "In test %d of testBoxQuery, particle %"
+                        PRId32" was %s.\n", i, j,
+                        found ? "kept" : "filtered out");
+                res = false;
+            }
+            for (int d = 0; found && d < 3; d++) {
+                float dx = fabsf(ox[(size_t)d*(size_t)m + (size_t)kept] -
+                                 x[(size_t)d*(size_t)len + (size_t)j]);
+                if (dx > L/2) { dx = L - dx; }
+                if (dx > delta) {
+                    fprintf(stderr, "In test %d of testBoxQuery, particle %"
+                            PRId32" moved by %g.\n", i, j, dx);
+                    res = false;
+                }
+            }
+            if (found) { kept++; }
+        }
+        if (res && kept != m) {
+            fprintf(stderr, "In test %d of testBoxQuery, %"PRId32" of %"
+                    PRId32" particles were out of order.\n", i, m - kept, m);
+            res = false;
+        }
+        Seg_Free(out);
+    }
+
+    QSeg_Free(qs);
+
+    /* Block bounds of positions quantized from doubles. */
+    double *xd = malloc(3*sizeof(*xd)*(size_t)len);
+    for (int32_t j = 0; j < 3*len; j++) { xd[j] = x[j]; }
+    free(s.Fields[0].Data);
+    s.Fields[0].Data = xd;
+    s.Fields[0].Layout.Double = 1;
+    qs = Quantize(s);
+    for (int i = 0; i < LEN(tests); i++) {
+        I32Seq blocks = BoxBlocks(qs.Fields[0], tests[i].box);
+        if (blocks.Len != tests[i].blockLen) {
+            fprintf(stderr, "In test %d of testBoxQuery, %"PRId32" blocks "
+                    "of doubles overlapped the box, but expected %"PRId32
+                    ".\n", i, blocks.Len, tests[i].blockLen);
+            res = false;
+        }
+        I32Seq_Free(blocks);
+    }
+
+    QSeg_Free(qs);
+    Seg_Free(s);
+    free(state);
+
+    return res;
+}
+
+/* randomSegment returns a segment with one field of every type. All of its
+ * arrays are on the heap so that it can be freed with Seg_Free. */
+Seg randomSegment(int32_t len, rand_State *state) {
+    Seg s;
+    s.FieldLen = 5;
+    s.Fields = calloc(5, sizeof(s.Fields[0]));
+
+    uint32_t codes[] = { field_Posn, field_Velc, field_Ptid,
+                         field_Unsf, field_Unsi };
+    for (int i = 0; i < 5; i++) {
+        FieldHeader hd = { .FieldCode = codes[i], .AlgoCode = algo_Test,
+                           .AlgoVersion = TestVersion_v0_9,
+                           .ParticleLen = len };
+        s.Fields[i].Hd = hd;
+        s.Fields[i].Valid = true;
+    }
+
+    float *x = malloc(3*sizeof(*x)*(size_t)len + 1);
+    for (int32_t i = 0; i < 3*len; i++) { x[i] = 64*rand_Float(state); }
+    PositionAccuracy xAcc = { .Deltas = NULL, .Delta = 1e-3f,
+                              .Width = 64, .Len = 0 };
+    s.Fields[0].Data = x;
+    s.Fields[0].Acc = calloc(1, sizeof(xAcc));
+    *(PositionAccuracy*)s.Fields[0].Acc = xAcc;
+
+    float *v = malloc(3*sizeof(*v)*(size_t)len + 1);
+    for (int32_t i = 0; i < 3*len; i++) {
+        v[i] = 2000*rand_Float(state) - 1000;
+    }
+    VelocityAccuracy vAcc = { .Deltas = NULL, .Delta = 1,
+                              .Len = 0, .SymLog10Scaled = 0 };
+    s.Fields[1].Data = v;
+    s.Fields[1].Acc = calloc(1, sizeof(vAcc));
+    *(VelocityAccuracy*)s.Fields[1].Acc = vAcc;
+
+    uint64_t *id = malloc(sizeof(*id)*(size_t)len + 1);
+    for (int32_t i = 0; i < len; i++) {
+        id[i] = rand_Uint63Lim(state, 1024*1024*1024);
+    }
+    IDAccuracy idAcc = { .Width = 1024 };
+    s.Fields[2].Data = id;
+    s.Fields[2].Acc = calloc(1, sizeof(idAcc));
+    *(IDAccuracy*)s.Fields[2].Acc = idAcc;
+
+    float *f = malloc(sizeof(*f)*(size_t)len + 1);
+    for (int32_t i = 0; i < len; i++) { f[i] = 100*rand_Float(state); }
+    FloatAccuracy fAcc = { .Deltas = NULL, .Delta = 0.01f, .Len = 0,
+                           .Log10Scaled = 0 };
+    s.Fields[3].Data = f;
+    s.Fields[3].Acc = calloc(1, sizeof(fAcc));
+    *(FloatAccuracy*)s.Fields[3].Acc = fAcc;
+
+    uint64_t *u = malloc(sizeof(*u)*(size_t)len + 1);
+    for (int32_t i = 0; i < len; i++) {
+        u[i] = 1000000 + rand_Uint63Lim(state, 100000);
+    }
+    s.Fields[4].Data = u;
+    s.Fields[4].Acc = calloc(1, sizeof(IntAccuracy));
+
+    return s;
+}
+
+/* segAlmostEqual checks that every value in s2 is within the accuracy of s1
+ * requested for it. */
+bool segAlmostEqual(Seg s1, Seg s2, const char *name) {
+    if (s1.FieldLen != s2.FieldLen) {
+        fprintf(stderr, "In %s, got %"PRId32" fields, but expected %"PRId32
+                ".\n", name, s2.FieldLen, s1.FieldLen);
+        return false;
+    }
+
+    for (int32_t i = 0; i < s1.FieldLen; i++) {
+        Field f1 = s1.Fields[i], f2 = s2.Fields[i];
+        int32_t len = f1.Hd.ParticleLen;
+
+        if (!f2.Valid || f2.Hd.ParticleLen != len ||
+            f2.Hd.FieldCode != f1.Hd.FieldCode) {
+            fprintf(stderr, "In %s, field %"PRId32" has the wrong header or "
+                    "was not valid.\n", name, i);
+            return false;
+        }
+
+        float delta = 0, width = 0;
+        int32_t dims = 1;
+        switch (f1.Hd.FieldCode) {
+        case field_Posn:
+            delta = ((PositionAccuracy*)f1.Acc)->Delta;
+            width = ((PositionAccuracy*)f1.Acc)->Width;
+            dims = 3;
+            break;
+        case field_Velc:
+            delta = ((VelocityAccuracy*)f1.Acc)->Delta;
+            dims = 3;
+            break;
+        case field_Unsf:
+            delta = ((FloatAccuracy*)f1.Acc)->Delta;
+            break;
+        case field_Ptid: case field_Unsi:
+            if (memcmp(f1.Data, f2.Data, sizeof(uint64_t)*(size_t)len)) {
+                fprintf(stderr, "In %s, integer field %"PRId32" was not "
+                        "recovered exactly.\n", name, i);
+                return false;
+            }
+            continue;
+        }
+
+        float *x1 = f1.Data, *x2 = f2.Data;
+        for (int32_t j = 0; j < dims*len; j++) {
+            float d = fabsf(x1[j] - x2[j]);
+            if (width > 0 && d > width / 2) { d = width - d; }
+            if (d > delta) {
+                fprintf(stderr, "In %s, element %"PRId32" of field %"PRId32
+                        " is %g, but expected %g +/- %g.\n",
+                        name, j, i, x2[j], x1[j], delta);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* sliceSegment returns a copy of the particles [start, start + len) of s.
+ * The accuracies are shared with s, so the result should be freed with
+ * freeSlice rather than Seg_Free. */
+Seg sliceSegment(Seg s, int32_t start, int32_t len) {
+    Seg out;
+    out.FieldLen = s.FieldLen;
+    out.Fields = calloc((size_t)s.FieldLen, sizeof(*out.Fields));
+
+    for (int32_t i = 0; i < s.FieldLen; i++) {
+        Field f = s.Fields[i];
+        uint32_t code = f.Hd.FieldCode;
+        size_t size = code == field_Ptid || code == field_Unsi ?
+            sizeof(uint64_t) : sizeof(float);
+        int32_t dims = code == field_Posn || code == field_Velc ? 3 : 1;
+        int32_t fullLen = f.Hd.ParticleLen;
+
+        out.Fields[i] = f;
+        out.Fields[i].Hd.ParticleLen = len;
+        out.Fields[i].Data = malloc((size_t)dims*(size_t)len*size + 1);
+        for (int32_t d = 0; d < dims; d++) {
+            memcpy((uint8_t*)out.Fields[i].Data + (size_t)(d*len)*size,
+                   (uint8_t*)f.Data + (size_t)(d*fullLen + start)*size,
+                   (size_t)len*size);
+        }
+    }
+
+    return out;
+}
+
+void freeSlice(Seg s) {
+    for (int32_t i = 0; i < s.FieldLen; i++) { free(s.Fields[i].Data); }
+    free(s.Fields);
+}
+
+CField dummyCompress(QField qf, void *buffer) {
+    (void) buffer;
+    CField cf;
+    memset(&cf, 0, sizeof(cf));
+    cf.Hd = qf.Hd;
+    return cf;
+}
+
+QField dummyDecompress(CField cf, void *buffer) {
+    (void) buffer;
+    QField qf;
+    memset(&qf, 0, sizeof(qf));
+    qf.Hd = cf.Hd;
+    return qf;
+}
+
+void *dummyAlloc(void) { return NULL; }
+void dummyFree(void *buffer) { (void) buffer; }
+
+/* boxSide returns 1 if particle j of the position data x is inside box, -1
+ * if it is outside, and 0 if it is within margin of a face. Boxes are
+ * periodic with width L. */
+int32_t boxSide(float *x, int32_t len, int32_t j, Box box, float L,
+                float margin) {
+    int32_t side = 1;
+    for (int i = 0; i < 3; i++) {
+        float w = box.X1[i] - box.X0[i];
+        float d = fmodf(x[(size_t)i*(size_t)len + (size_t)j] - box.X0[i], L);
+        if (d < 0) { d += L; }
+
+        if (d > w + margin && d < L - margin) { return -1; }
+        if (d < margin || d > w - margin) { side = 0; }
+    }
+    return side;
+}